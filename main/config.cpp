@@ -14,6 +14,8 @@
 #include "esp_err.h"
 #include "esp_log.h"
 #include "esp_partition.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/semphr.h"
 
 #if __has_include("esp_idf_version.h")
     #include "esp_idf_version.h"
@@ -58,6 +60,24 @@ config_t Config = {
         .OTA_URL   = "",
         .PROMPT    = "c3dp> ",
     },
+    .mtn = {
+        .SHAPER    = "none",
+        .SHP_FX    = "40",
+        .SHP_FY    = "40",
+        .SHP_ZETA  = "0.1",
+        .PA_K      = "0,0,0",
+        .PA_SMOOTH = "0.04",
+        .PROFILE   = "trapezoid",
+        .ARC_TOL   = "0.01",
+        .ARC_TIME  = "0.004",
+        .MESH_MODE = "off",
+        .MESH_AREA = "10,10,190,190",
+        .MESH_CNT  = "5,5",
+        .JOURNAL   = "10",
+        .PID_BED   = "0.31,0.016,1.5,0.0078",
+        .PID_NOZ   = "0.21,0.058,0.2,0.0023",
+        .PWM       = "16,10",
+    },
     .info = {
 #ifdef PROJECT_NAME
         .NAME  = PROJECT_NAME,
@@ -95,6 +115,15 @@ static const char * staticlist[] = {
     Config.app.DNS_RUN,   Config.app.DNS_HOST,
     Config.app.OTA_RUN,   Config.app.OTA_URL,
     Config.app.PROMPT,
+
+    Config.mtn.SHAPER,    Config.mtn.SHP_FX,
+    Config.mtn.SHP_FY,    Config.mtn.SHP_ZETA,
+    Config.mtn.PA_K,      Config.mtn.PA_SMOOTH,
+    Config.mtn.PROFILE,   Config.mtn.ARC_TOL,
+    Config.mtn.ARC_TIME,  Config.mtn.MESH_MODE,
+    Config.mtn.MESH_AREA, Config.mtn.MESH_CNT,
+    Config.mtn.JOURNAL,   Config.mtn.PID_BED,
+    Config.mtn.PID_NOZ,   Config.mtn.PWM,
 };
 */
 
@@ -124,6 +153,23 @@ config_entry_t cfglist[] = {
     {"app.ota.run",     &Config.app.OTA_RUN},
     {"app.ota.url",     &Config.app.OTA_URL},
     {"app.cmd.prompt",  &Config.app.PROMPT},
+
+    {"mtn.shaper",      &Config.mtn.SHAPER},
+    {"mtn.shaper.fx",   &Config.mtn.SHP_FX},
+    {"mtn.shaper.fy",   &Config.mtn.SHP_FY},
+    {"mtn.shaper.zeta", &Config.mtn.SHP_ZETA},
+    {"mtn.pa.k",        &Config.mtn.PA_K},
+    {"mtn.pa.smooth",   &Config.mtn.PA_SMOOTH},
+    {"mtn.profile",     &Config.mtn.PROFILE},
+    {"mtn.arc.tol",     &Config.mtn.ARC_TOL},
+    {"mtn.arc.time",    &Config.mtn.ARC_TIME},
+    {"mtn.mesh.mode",   &Config.mtn.MESH_MODE},
+    {"mtn.mesh.area",   &Config.mtn.MESH_AREA},
+    {"mtn.mesh.count",  &Config.mtn.MESH_CNT},
+    {"mtn.journal",     &Config.mtn.JOURNAL},
+    {"mtn.pid.bed",     &Config.mtn.PID_BED},
+    {"mtn.pid.noz",     &Config.mtn.PID_NOZ},
+    {"mtn.pwm",         &Config.mtn.PWM},
 };
 
 static uint16_t numcfg = sizeof(cfglist) / sizeof(config_entry_t);
@@ -253,7 +299,8 @@ static struct {
     esp_err_t error;                // nvs flash init result
     nvs_handle handle;              // nvs handle obtained from nvs_open
     const esp_partition_t *part;    // nvs flash partition
-} nvs_st = { false, ESP_OK, 0, NULL };
+    SemaphoreHandle_t lock;         // held from config_nvs_open to close
+} nvs_st = { false, ESP_OK, 0, NULL, NULL };
 
 bool config_initialize() {
     config_nvs_init();
@@ -285,6 +332,7 @@ bool config_initialize() {
 
 esp_err_t config_nvs_init() {
     if (nvs_st.init) return nvs_st.error;
+    if (!nvs_st.lock) nvs_st.lock = xSemaphoreCreateRecursiveMutex();
     nvs_st.part = esp_partition_find_first(
         ESP_PARTITION_TYPE_DATA,
         ESP_PARTITION_SUBTYPE_DATA_NVS, NULL);
@@ -342,16 +390,25 @@ esp_err_t config_nvs_init() {
     return err;
 }
 
+// One namespace is open at a time: other tasks wait until it is closed,
+// opening twice in the same task still fails
 esp_err_t config_nvs_open(const char *ns, bool ro) {
-    if (nvs_st.handle) return ESP_FAIL;
     esp_err_t err = ESP_OK;
     if (!nvs_st.init) err = config_nvs_init();
+    if (!nvs_st.lock) return ESP_ERR_NO_MEM;
+    xSemaphoreTakeRecursive(nvs_st.lock, portMAX_DELAY);
+    if (nvs_st.handle) {
+        xSemaphoreGiveRecursive(nvs_st.lock);
+        return ESP_FAIL;
+    }
     if (!err) {
         err = nvs_open(ns, ro ? NVS_READONLY : NVS_READWRITE, &nvs_st.handle);
     }
     if (err) {
         ESP_LOGE(TAG, "Cannot open nvs namespace `%s:` %s",
                  ns, esp_err_to_name(err));
+        nvs_st.handle = 0;
+        xSemaphoreGiveRecursive(nvs_st.lock);
     }
     return err;
 }
@@ -367,6 +424,7 @@ esp_err_t config_nvs_close() {
     if (!nvs_st.handle) return ESP_ERR_NVS_INVALID_HANDLE;
     esp_err_t err = config_nvs_commit();
     nvs_close(nvs_st.handle); nvs_st.handle = 0;
+    xSemaphoreGiveRecursive(nvs_st.lock);
     return err;
 }
 
@@ -384,6 +442,29 @@ bool config_nvs_clear() {
     return config_nvs_close() == ESP_OK;
 }
 
+bool config_nvs_set_str(const char *key, const char *val) {
+    if (config_nvs_open(NAMESPACE_CFG)) return false;
+    bool s = _nvs_set_str(key, val, false);
+    return config_nvs_close() == ESP_OK && s;
+}
+
+bool config_nvs_set_blob(const char *key, const void *buf, size_t len) {
+    if (config_nvs_open(NAMESPACE_CFG)) return false;
+    esp_err_t err = nvs_set_blob(nvs_st.handle, key, buf, len);
+    if (err) ESP_LOGE(TAG, "set blob `%s` fail: %s", key, esp_err_to_name(err));
+    return config_nvs_close() == ESP_OK && !err;
+}
+
+size_t config_nvs_get_blob(const char *key, void *buf, size_t len) {
+    if (config_nvs_open(NAMESPACE_CFG, true)) return 0;
+    esp_err_t err = nvs_get_blob(nvs_st.handle, key, buf, &len);
+    if (err && err != ESP_ERR_NVS_NOT_FOUND) {
+        ESP_LOGE(TAG, "get blob `%s` fail: %s", key, esp_err_to_name(err));
+    }
+    config_nvs_close();
+    return err ? 0 : len;
+}
+
 void config_nvs_list() {
     if (nvs_st.part == NULL) {
         ESP_LOGE(TAG, "Cannot found nvs partition. Skip");
@@ -44,6 +44,26 @@ typedef struct config_application_t {
     const char * PROMPT;    // Console promption string
 } config_app_t;
 
+// Numbers are stored as strings too and parsed when motion is idle
+typedef struct config_motion_t {
+    const char * SHAPER;    // Input shaper of X/Y: none, zv, mzv or ei
+    const char * SHP_FX;    // Resonance frequency of X axis (Hz)
+    const char * SHP_FY;    // Resonance frequency of Y axis (Hz)
+    const char * SHP_ZETA;  // Damping ratio of X/Y resonance (0 ~ 1)
+    const char * PA_K;      // Pressure advance of E1,E2,E3 (comma separated)
+    const char * PA_SMOOTH; // Pressure advance smooth time (seconds)
+    const char * PROFILE;   // Speed profile: trapezoid or scurve
+    const char * ARC_TOL;   // Max chord deviation of G2/G3 segments (mm)
+    const char * ARC_TIME;  // Min time of G2/G3 segments (seconds)
+    const char * MESH_MODE; // Bed mesh correction: off, bilinear or bicubic
+    const char * MESH_AREA; // Probed area by G29: x0,y0,x1,y1 (mm)
+    const char * MESH_CNT;  // Probe points by G29: nx,ny
+    const char * JOURNAL;   // Power-loss checkpoint interval (seconds, 0: off)
+    const char * PID_BED;   // PID of bed heater: kp,ki,kd,kf
+    const char * PID_NOZ;   // PID of nozzle heaters: kp,ki,kd,kf
+    const char * PWM;       // Software PWM of expanders: slots,frequency (Hz)
+} config_mtn_t;
+
 // information are readonly values (after initialization)
 typedef struct config_information_t {
     const char * NAME;      // Program name (PROJECT_NAME if defined)
@@ -56,6 +76,7 @@ typedef struct config_t {
     config_web_t web;
     config_net_t net;
     config_app_t app;
+    config_mtn_t mtn;
     config_info_t info;
 } config_t;
 
@@ -89,6 +110,8 @@ bool config_set(const char *, const char *);
 /* NVS helper functions.
  * These are similar as Arduino-ESP32 library `Preference`.
  * But more lightweight and without dependency on Arduino.
+ * They are safe to call from any task: config_nvs_open holds a lock until
+ * config_nvs_close, so other tasks wait for the namespace in between.
  */
 esp_err_t config_nvs_init();
 esp_err_t config_nvs_open(const char *, bool ro = false); // open namespace
@@ -96,6 +119,9 @@ esp_err_t config_nvs_commit();          // must be called after config_nvs_open
 esp_err_t config_nvs_close();           // close with auto commit
 bool config_nvs_remove(const char *);   // remove one entry
 bool config_nvs_clear();                // remove all entries
+bool config_nvs_set_str(const char *, const char *); // save one entry
+bool config_nvs_set_blob(const char *, const void *, size_t);
+size_t config_nvs_get_blob(const char *, void *, size_t); // return length
 void config_nvs_stats();                // get nvs flash detail
 void config_nvs_list();                 // list all entries
 
@@ -14,9 +14,18 @@
 #include "globals.h"
 #include "drivers.h"
 #include "filesys.h"
+#include "stepper.h"
+#include "gcodeidx.h"
+#include "estimate.h"
+#include "job.h"
+#include "heater.h"
+#include "softpwm.h"
+#include "endstop.h"
+#include "fixedbench.h"
 
 #include "esp_log.h"
 #include "esp_sleep.h"
+#include "esp_timer.h"
 #include "esp_console.h"
 #include "esp_heap_caps.h"
 #include "rom/uart.h"
@@ -547,10 +556,19 @@ esp_console_cmd_t cmd_gpio_level = {
             else level = gpio_get_level(pin);
         } else if (PIN_I2C_MIN < pin_num && pin_num < PIN_I2C_MAX) {
             i2c_pin_num_t pin = static_cast<i2c_pin_num_t>(pin_num);
-            if (level != -1) err = i2c_gpio_set_level(pin, level);
-            else level = i2c_gpio_get_level(pin);
+            if (level == -1) {
+                level = i2c_gpio_get_level(pin);
+            } else if (softpwm_write(pin, level)) {     // owned by PWM
+                err = softpwm_commit();
+            } else {
+                err = i2c_gpio_set_level(pin, level);
+            }
         } else if (PIN_SPI_MIN < pin_num && pin_num < PIN_SPI_MAX) {
             spi_pin_num_t pin = static_cast<spi_pin_num_t>(pin_num);
+            if (level != -1 && (stepper_running() || spi_gpio_claimed())) {
+                printf("GPIO %d is driven by the step ISR now\n", pin_num);
+                return ESP_ERR_INVALID_STATE;
+            }
             if (level != -1) err = spi_gpio_set_level(pin, level);
             else level = spi_gpio_get_level(pin);
         } else return ESP_ERR_INVALID_ARG;
@@ -573,6 +591,302 @@ esp_console_cmd_t cmd_gpio_i2cscan = {
     .argtable = NULL
 };
 
+/******************************************************************************
+ * Motion commands
+ */
+
+static struct {
+    struct arg_lit *reset;
+    struct arg_end *end;
+} stepper_args = {
+    .reset = arg_lit0("r", "reset", "clear statistics after printing"),
+    .end = arg_end(1)
+};
+
+esp_console_cmd_t cmd_motion_stepper = {
+    .command = "stepper",
+    .help = "Get step engine status: rates, ring levels, ISR time and jitter",
+    .hint = NULL,
+    .func = [](int argc, char **argv) -> int {
+        if (!arg_noerror(argc, argv, (void **) &stepper_args))
+            return ESP_ERR_INVALID_ARG;
+        stepper_info();
+        if (stepper_args.reset->count) stepper_stats_reset();
+        return ESP_OK;
+    },
+    .argtable = &stepper_args
+};
+
+static struct {
+    struct arg_lit *reset;
+    struct arg_end *end;
+} endstop_args = {
+    .reset = arg_lit0("r", "reset", "clear statistics after printing"),
+    .end = arg_end(1)
+};
+
+esp_console_cmd_t cmd_motion_endstop = {
+    .command = "endstop",
+    .help = "Get endstop states, expander reads and interrupt to halt latency",
+    .hint = NULL,
+    .func = [](int argc, char **argv) -> int {
+        if (!arg_noerror(argc, argv, (void **) &endstop_args))
+            return ESP_ERR_INVALID_ARG;
+        endstop_info();
+        if (endstop_args.reset->count) endstop_stats_reset();
+        return ESP_OK;
+    },
+    .argtable = &endstop_args
+};
+
+static struct {
+    struct arg_str *path;
+    struct arg_int *layer;
+    struct arg_dbl *z;
+    struct arg_int *offset;
+    struct arg_end *end;
+} gindex_args = {
+    .path = arg_str1(NULL, NULL, "abspath", "layer index file (*.idx)"),
+    .layer = arg_int0("l", "layer", "<n>", "seek to layer number"),
+    .z = arg_dbl0("z", NULL, "<mm>", "seek to first layer at Z"),
+    .offset = arg_int0("o", "offset", "<byte>", "find layer of file offset"),
+    .end = arg_end(4)
+};
+
+static size_t gindex_read(void *buf, size_t len, size_t offset, void *arg) {
+    File *file = (File *)arg;
+    return file->seek(offset) ? file->read((uint8_t *)buf, len) : 0;
+}
+
+esp_console_cmd_t cmd_motion_gindex = {
+    .command = "gindex",
+    .help = "Look up G-code layer index built on upload",
+    .hint = NULL,
+    .func = [](int argc, char **argv) -> int {
+        if (!arg_noerror(argc, argv, (void **) &gindex_args))
+            return ESP_ERR_INVALID_ARG;
+        File file = FFS.open(gindex_args.path->sval[0]);
+        gidx_header_t header;
+        gidx_entry_t entry;
+        int32_t layer = -1;
+        if (!file) return ESP_ERR_NOT_FOUND;
+        if (file.read((uint8_t *)&header, sizeof(header)) != sizeof(header) ||
+            !gidx_check(&header)) {
+            file.close();
+            printf("Invalid layer index file\n");
+            return ESP_ERR_INVALID_STATE;
+        }
+        printf("%u layers up to Z%.2f, %u lines, %u bytes\n", header.layers,
+               header.height, header.lines, header.bytes);
+        if (gindex_args.layer->count) {
+            layer = gindex_args.layer->ival[0];
+            if (!gidx_layer(gindex_read, &file, &header, layer, &entry))
+                layer = -1;
+        } else if (gindex_args.z->count) {
+            layer = gidx_find_z(gindex_read, &file, &header,
+                                gindex_args.z->dval[0], &entry);
+        } else if (gindex_args.offset->count) {
+            layer = gidx_find_offset(gindex_read, &file, &header,
+                                     gindex_args.offset->ival[0], &entry);
+        } else {
+            file.close();
+            return ESP_OK;
+        }
+        file.close();
+        if (layer < 0) {
+            printf("Layer not found\n");
+            return ESP_ERR_NOT_FOUND;
+        }
+        printf("Layer %d Z%.2f: offset %u line %u, X%.3f Y%.3f Z%.3f E%.5f "
+               "F%.0f%s%s%s\n", layer, entry.z, entry.offset, entry.line,
+               entry.pos[AXIS_X], entry.pos[AXIS_Y], entry.pos[AXIS_Z],
+               entry.pos[AXIS_E], entry.feedrate,
+               entry.flags & GIDX_RELATIVE ? " G91" : "",
+               entry.flags & GIDX_RELATIVE_E ? " M83" : "",
+               entry.flags & GIDX_INCH ? " G20" : "");
+        return ESP_OK;
+    },
+    .argtable = &gindex_args
+};
+
+static struct {
+    struct arg_str *path;
+    struct arg_end *end;
+} estimate_args = {
+    .path = arg_str1(NULL, NULL, "abspath", "G-code file on flash"),
+    .end = arg_end(1)
+};
+
+esp_console_cmd_t cmd_motion_estimate = {
+    .command = "estimate",
+    .help = "Estimate print time & filament of G-code file in background",
+    .hint = NULL,
+    .func = [](int argc, char **argv) -> int {
+        if (!arg_noerror(argc, argv, (void **) &estimate_args))
+            return ESP_ERR_INVALID_ARG;
+        const char *path = estimate_args.path->sval[0];
+        if (!FFS.exists(path)) return ESP_ERR_NOT_FOUND;
+        if (!estimate_request(path)) return ESP_ERR_NO_MEM;
+        printf("Queued, result is logged and shown in file list\n");
+        return ESP_OK;
+    },
+    .argtable = &estimate_args
+};
+
+static struct {
+    struct arg_str *path;
+    struct arg_int *offset;
+    struct arg_lit *resume;
+    struct arg_lit *stop;
+    struct arg_end *end;
+} print_args = {
+    .path = arg_str0(NULL, NULL, "abspath", "G-code or .gcb file on flash"),
+    .offset = arg_int0("o", "offset", "<byte>", "start at file offset"),
+    .resume = arg_lit0(NULL, "resume", "continue print interrupted by reset"),
+    .stop = arg_lit0(NULL, "stop", "stop feeding the running print"),
+    .end = arg_end(4)
+};
+
+esp_console_cmd_t cmd_motion_print = {
+    .command = "print",
+    .help = "Print G-code file, resume after power loss or show job status",
+    .hint = NULL,
+    .func = [](int argc, char **argv) -> int {
+        if (!arg_noerror(argc, argv, (void **) &print_args))
+            return ESP_ERR_INVALID_ARG;
+        if (print_args.stop->count) {
+            job_stop();
+        } else if (print_args.resume->count) {
+            if (!job_resume()) return ESP_ERR_INVALID_STATE;
+        } else if (print_args.path->count) {
+            const char *path = print_args.path->sval[0];
+            int offset = 0;
+            if (print_args.offset->count) {
+                offset = print_args.offset->ival[0];
+                if (offset < 0) return ESP_ERR_INVALID_ARG;
+            }
+            if (!FFS.exists(path)) return ESP_ERR_NOT_FOUND;
+            if (!job_start(path, offset)) return ESP_ERR_INVALID_STATE;
+        }
+        job_info();
+        return ESP_OK;
+    },
+    .argtable = &print_args
+};
+
+static struct {
+    struct arg_int *rounds;
+    struct arg_end *end;
+} fixedbench_args = {
+    .rounds = arg_int0("n", "rounds", "<num>", "repeat workloads, default 20"),
+    .end = arg_end(1)
+};
+
+esp_console_cmd_t cmd_motion_fixedbench = {
+    .command = "fixedbench",
+    .help = "Compare float, double and fixed-point kinematics math",
+    .hint = NULL,
+    .func = [](int argc, char **argv) -> int {
+        if (!arg_noerror(argc, argv, (void **) &fixedbench_args))
+            return ESP_ERR_INVALID_ARG;
+        int rounds = 20;
+        if (fixedbench_args.rounds->count) {
+            rounds = fixedbench_args.rounds->ival[0];
+            if (rounds <= 0) return ESP_ERR_INVALID_ARG;
+        }
+        fbench_result_t res[FBENCH_RESULTS];
+        size_t num = fbench_run(
+            []() -> double { return esp_timer_get_time() * 1e-6; },
+            rounds, res, FBENCH_RESULTS);
+        if (!num) return ESP_ERR_NO_MEM;
+        fbench_print(res, num);
+        return ESP_OK;
+    },
+    .argtable = &fixedbench_args
+};
+
+/******************************************************************************
+ * Temperature commands
+ */
+
+static struct {
+    struct arg_int *index;
+    struct arg_dbl *temp;
+    struct arg_lit *tune;
+    struct arg_int *cycles;
+    struct arg_lit *clear;
+    struct arg_lit *reset;
+    struct arg_end *end;
+} heater_args = {
+    .index = arg_int0("i", "index", "<0-3>", "heater: 0 bed, 1-3 nozzles"),
+    .temp = arg_dbl0("s", "set", "<degC>", "set target, 0 to turn off"),
+    .tune = arg_lit0(NULL, "tune", "relay autotune PID at target of -s"),
+    .cycles = arg_int0("n", "cycles", "<num>", "autotune cycles, default 5"),
+    .clear = arg_lit0("c", "clear", "clear fault of heater -i"),
+    .reset = arg_lit0("r", "reset", "clear loop statistics after printing"),
+    .end = arg_end(6)
+};
+
+esp_console_cmd_t cmd_temp_heater = {
+    .command = "heater",
+    .help = "Get heater status, loop jitter and I2C load; set, autotune or "
+            "clear a fault",
+    .hint = NULL,
+    .func = [](int argc, char **argv) -> int {
+        if (!arg_noerror(argc, argv, (void **) &heater_args))
+            return ESP_ERR_INVALID_ARG;
+        int idx = 1, cycles = 5;
+        if (heater_args.index->count) idx = heater_args.index->ival[0];
+        if (heater_args.clear->count) heater_clear_fault(idx);
+        if (heater_args.temp->count) {
+            float temp = heater_args.temp->dval[0];
+            if (heater_args.cycles->count)
+                cycles = heater_args.cycles->ival[0];
+            if (idx < 0 || cycles < 1 || cycles > 20)
+                return ESP_ERR_INVALID_ARG;
+            if (heater_args.tune->count ? !heater_tune(idx, temp, cycles)
+                                        : !heater_set_target(idx, temp))
+                return ESP_ERR_INVALID_ARG;
+        }
+        heater_info();
+        if (heater_args.reset->count) heater_stats_reset();
+        return ESP_OK;
+    },
+    .argtable = &heater_args
+};
+
+static struct {
+    struct arg_int *pin;
+    struct arg_dbl *duty;
+    struct arg_lit *reset;
+    struct arg_end *end;
+} pwm_args = {
+    .pin = arg_int0(NULL, NULL, "<108-123>", "expander pin BED ~ VLV8"),
+    .duty = arg_dbl0(NULL, NULL, "<0-1>", "set duty of pin"),
+    .reset = arg_lit0("r", "reset", "clear statistics after printing"),
+    .end = arg_end(3)
+};
+
+esp_console_cmd_t cmd_temp_pwm = {
+    .command = "pwm",
+    .help = "Get software PWM duties and I2C bus load; set duty of a pin",
+    .hint = NULL,
+    .func = [](int argc, char **argv) -> int {
+        if (!arg_noerror(argc, argv, (void **) &pwm_args))
+            return ESP_ERR_INVALID_ARG;
+        if (pwm_args.duty->count) {
+            if (!pwm_args.pin->count) return ESP_ERR_INVALID_ARG;
+            i2c_pin_num_t pin = (i2c_pin_num_t)pwm_args.pin->ival[0];
+            if (!softpwm_write(pin, pwm_args.duty->dval[0]))
+                return ESP_ERR_INVALID_ARG;
+        }
+        softpwm_info();
+        if (pwm_args.reset->count) softpwm_stats_reset();
+        return ESP_OK;
+    },
+    .argtable = &pwm_args
+};
+
 /******************************************************************************
  * Export register commands
  */
@@ -603,6 +917,16 @@ void console_register_commands() {
         &cmd_gpio_ledc,
         &cmd_gpio_level,
         // &cmd_gpio_i2cscan, // 464 bytes
+
+        &cmd_motion_stepper,
+        &cmd_motion_endstop,
+        &cmd_motion_gindex,
+        &cmd_motion_estimate,
+        &cmd_motion_print,
+        &cmd_motion_fixedbench,
+
+        &cmd_temp_heater,
+        &cmd_temp_pwm,
     };
     esp_log_level_set(NAME, ESP_LOG_INFO);
     ESP_ERROR_CHECK( esp_console_register_help_command() );
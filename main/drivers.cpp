@@ -5,13 +5,17 @@
  */
 
 #include "drivers.h"
+#include "pinbus.h"
 
 #include "esp_log.h"
 #include "esp_attr.h"
+#include "esp_timer.h"
 #include "esp_vfs_dev.h"
 #include "esp_intr_alloc.h"
 #include "soc/soc.h"
+#include "soc/spi_struct.h"
 #include "sys/param.h"
+#include "driver/adc.h"
 #include "driver/rmt.h"
 #include "driver/i2c.h"
 #include "driver/gpio.h"
@@ -20,6 +24,7 @@
 #include "driver/spi_master.h"
 #include "freertos/FreeRTOS.h"
 #include "freertos/task.h"
+#include "freertos/semphr.h"
 
 #define RMT_CLK_DIV 2       // TICK = 1 / (80MHz / RMT_CLK_DIV) = 25ns
 #define RMT_LED_0H  16      // 400ns / 25ns
@@ -152,23 +157,27 @@ bool led_count(uint8_t n) {
     return true;
 }
 
-// I2C GPIO Expander
+// I2C transport of the pin layer (pins.cpp)
 
-static uint8_t i2c_pin_data[3] = { 0, 0, 0 };
-static uint8_t i2c_pin_addr[3] = { 0b0100000, 0b0100001, 0b0100010 };
+#define I2C_LINKS           16          // chip lists with a kept link
+#define I2C_CALIB_BYTES     8           // long read of calibration
+#define I2C_CALIB_RUNS      4
 
-void i2c_initialize() {
-    i2c_config_t master_conf = {
-        .mode = I2C_MODE_MASTER,
-        .sda_io_num = PIN_SDA,
-        .sda_pullup_en = GPIO_PULLUP_ENABLE,
-        .scl_io_num = PIN_SCL,
-        .scl_pullup_en = GPIO_PULLUP_ENABLE,
-    };
-    master_conf.master.clk_speed = 50 * 1000;
-    ESP_ERROR_CHECK( i2c_param_config(NUM_I2C, &master_conf) );
-    ESP_ERROR_CHECK( i2c_driver_install(NUM_I2C, master_conf.mode, 0, 0, 0) );
-}
+/* Building a command link allocates one node per command. Links of
+ * pinbus_i2c_xfer are built on the first use of a chip list and kept:
+ * i2c_master_write and i2c_master_read refer to the bytes instead of
+ * copying them, so a link points at `data` of its slot and only the bytes
+ * change between transfers.
+ */
+typedef struct {
+    uint32_t key;                       // chips and directions, 0 if free
+    i2c_cmd_handle_t cmd;
+    uint8_t data[I2C_PIN_CHIPS];
+} i2c_link_t;
+
+static i2c_link_t i2c_links[I2C_LINKS];
+static SemaphoreHandle_t i2c_lock = NULL;  // of the slots' data
+static uint32_t i2c_bus_hz = I2C_CLK_HZ, i2c_overhead_us = 0;
 
 esp_err_t i2c_master_transfer(
     uint8_t addr, uint8_t rw, uint8_t *data,
@@ -196,48 +205,133 @@ esp_err_t i2c_master_transfer(
     return err;
 }
 
-esp_err_t i2c_gpio_set_level(i2c_pin_num_t pin_num, bool level) {
-    uint8_t
-        pin = pin_num - PIN_I2C_MIN - 1,
-        idx = pin >> 3, bit = pin & 0x7,
-        addr = i2c_pin_addr[idx],
-        *data = i2c_pin_data + idx;
-    bitWrite(*data, bit, level);
-    return i2c_master_transfer(addr, I2C_MASTER_WRITE, data);
+static i2c_cmd_handle_t i2c_link_build(
+    const uint8_t *addr, uint8_t rmask, uint8_t *data, size_t num)
+{
+    i2c_cmd_handle_t cmd = i2c_cmd_link_create();
+    for (size_t i = 0; i < num; i++) {
+        bool read = rmask & BIT(i);
+        i2c_master_start(cmd);          // repeated START after the first
+        i2c_master_write_byte(
+            cmd, (addr[i] << 1) | (read ? I2C_MASTER_READ : I2C_MASTER_WRITE),
+            true);
+        if (read) {
+            i2c_master_read(cmd, data + i, 1, I2C_MASTER_LAST_NACK);
+        } else {
+            i2c_master_write(cmd, data + i, 1, true);
+        }
+    }
+    i2c_master_stop(cmd);
+    return cmd;
+}
+
+esp_err_t pinbus_i2c_xfer(const uint8_t *addr, uint8_t rmask, uint8_t *data,
+                          size_t num)
+{
+    if (!num || num > I2C_PIN_CHIPS) return ESP_ERR_INVALID_ARG;
+    if (!i2c_lock) return ESP_ERR_INVALID_STATE;
+    uint32_t key = num | (rmask & (BIT(num) - 1)) << 2;
+    for (size_t i = 0; i < num; i++) key |= (uint32_t)addr[i] << (8 + 8 * i);
+    esp_err_t err;
+    xSemaphoreTake(i2c_lock, portMAX_DELAY);
+    i2c_link_t *link = NULL;
+    for (uint8_t i = 0; i < I2C_LINKS && !link; i++) {
+        if (i2c_links[i].key == key) link = i2c_links + i;
+    }
+    for (uint8_t i = 0; i < I2C_LINKS && !link; i++) {
+        if (i2c_links[i].key) continue;
+        link = i2c_links + i;
+        link->key = key;
+        link->cmd = i2c_link_build(addr, rmask, link->data, num);
+    }
+    if (link) {
+        memcpy(link->data, data, num);
+        err = i2c_master_cmd_begin(NUM_I2C, link->cmd, pdMS_TO_TICKS(50));
+        memcpy(data, link->data, num);
+    } else {                            // all slots taken: one-off link
+        i2c_cmd_handle_t cmd = i2c_link_build(addr, rmask, data, num);
+        err = i2c_master_cmd_begin(NUM_I2C, cmd, pdMS_TO_TICKS(50));
+        i2c_cmd_link_delete(cmd);
+    }
+    xSemaphoreGive(i2c_lock);
+    return err;
 }
 
-uint8_t i2c_gpio_get_level(i2c_pin_num_t pin_num, bool sync) {
-    uint8_t
-        pin = pin_num - PIN_I2C_MIN - 1,
-        idx = pin >> 3, bit = pin & 0x7,
-        *data = i2c_pin_data + idx;
-    if (sync) i2c_master_transfer(i2c_pin_addr[idx], I2C_MASTER_READ, data);
-    return bitRead(*data, bit);
+esp_err_t pinbus_i2c(uint8_t addr, bool read, uint8_t *data, size_t size) {
+    if (size == 1 && data != NULL)
+        return pinbus_i2c_xfer(&addr, read ? 1 : 0, data, 1);
+    return i2c_master_transfer(
+        addr, read ? I2C_MASTER_READ : I2C_MASTER_WRITE, data, size);
 }
 
-void i2c_detect() {
-    for (uint8_t i = 0; i < 0x10; i++) {
-        if (!i) printf("  ");
-        printf("  %c", i < 10 ? (i + '0') : (i - 10 + 'A'));
+// Shortest time of reading `size` bytes from the endstop chip, us
+static int64_t i2c_read_time(size_t size, bool kept) {
+    uint8_t buf[I2C_CALIB_BYTES];
+    int64_t best = INT64_MAX;
+    for (uint8_t i = 0; i < I2C_CALIB_RUNS; i++) {
+        int64_t t0 = esp_timer_get_time();
+        esp_err_t err = kept
+            ? pinbus_i2c(I2C_PIN_ADDR, true, buf, size)
+            : i2c_master_transfer(I2C_PIN_ADDR, I2C_MASTER_READ, buf, size);
+        if (err) return -1;
+        best = MIN(best, esp_timer_get_time() - t0);
     }
-    for (uint8_t addr = 0; addr < 0x80; addr++) {
-        if (addr % 0x10 == 0) printf("\n%02X", addr);
-        esp_err_t ret = i2c_master_transfer(addr, I2C_MASTER_WRITE, NULL, 0);
-        switch (ret) {
-        case ESP_OK:
-            printf(" %02X", addr); break;
-        case ESP_ERR_TIMEOUT:
-            printf(" UU"); break;
-        default:
-            printf(" --");
+    return best;
+}
+
+/* SCL runs slower than configured: the pull-ups need time to raise the
+ * lines and the controller waits for it on every bit. The difference of a
+ * long and a one byte read is bus time only (9 bits per extra byte), so it
+ * gives the real clock; the rest of a transaction on a kept link is driver
+ * overhead. The configured clock is raised until the real one reaches
+ * I2C_CLK_HZ.
+ */
+static void i2c_calibrate(i2c_config_t *conf) {
+    const uint32_t bits = (I2C_CALIB_BYTES - 1) * 9;
+    uint32_t clk_set = conf->master.clk_speed;
+    for (uint8_t i = 0; i < 4; i++) {
+        int64_t t1 = i2c_read_time(1, false);
+        int64_t tn = i2c_read_time(I2C_CALIB_BYTES, false);
+        int64_t tk = i2c_read_time(1, true);
+        if (t1 < 0 || tn <= t1 || tk < 0) {
+            ESP_LOGW(NAME, "Cannot calibrate I2C clock: no endstop chip");
+            return;
         }
+        i2c_bus_hz = bits * 1000000 / (tn - t1);
+        int64_t bus_us = (int64_t)I2C_XFER_BITS(1) * 1000000 / i2c_bus_hz;
+        i2c_overhead_us = tk > bus_us ? tk - bus_us : 0;
+        if (i2c_bus_hz >= I2C_CLK_HZ * 97 / 100) break;
+        uint32_t clk = (uint64_t)clk_set * I2C_CLK_HZ / i2c_bus_hz;
+        if (clk > I2C_CLK_HZ * 3 / 2) break;   // bus too slow: pull-ups
+        conf->master.clk_speed = clk;
+        if (i2c_param_config(NUM_I2C, conf)) break;
+        clk_set = clk;
     }
+    ESP_LOGI(NAME, "I2C clock %u Hz (set %u Hz), overhead %u us",
+             i2c_bus_hz, clk_set, i2c_overhead_us);
 }
 
-static void IRAM_ATTR gpio_isr_endstop(void *arg) {
-    i2c_master_transfer(i2c_pin_addr[0], I2C_MASTER_READ, i2c_pin_data + 0);
-    static char buf[9]; itoa(i2c_pin_data[0], buf, 2);
-    printf("Endstops value: 0b%s", buf);
+uint32_t i2c_bus_speed() { return i2c_bus_hz; }
+
+uint32_t i2c_bus_overhead() { return i2c_overhead_us; }
+
+void i2c_initialize() {
+    i2c_config_t master_conf = {
+        .mode = I2C_MODE_MASTER,
+        .sda_io_num = PIN_SDA,
+        .sda_pullup_en = GPIO_PULLUP_ENABLE,
+        .scl_io_num = PIN_SCL,
+        .scl_pullup_en = GPIO_PULLUP_ENABLE,
+    };
+    master_conf.master.clk_speed = I2C_CLK_HZ;
+    ESP_ERROR_CHECK( i2c_param_config(NUM_I2C, &master_conf) );
+    ESP_ERROR_CHECK( i2c_driver_install(NUM_I2C, master_conf.mode, 0, 0, 0) );
+    if (!i2c_lock) i2c_lock = xSemaphoreCreateMutex();
+    i2c_calibrate(&master_conf);
+    // outputs off (PCF8574 powers up high) and endstops read in one go
+    esp_err_t err = i2c_sync_vals();
+    if (err) ESP_LOGE(NAME, "Cannot refresh expanders: %s",
+                      esp_err_to_name(err));
 }
 
 void gpio_initialize() {
@@ -249,16 +343,25 @@ void gpio_initialize() {
         .intr_type    = GPIO_INTR_NEGEDGE,
     };
     ESP_ERROR_CHECK( gpio_config(&inp_conf) );
+    // handler of PIN_INT is added by endstop_loop_begin
     ESP_ERROR_CHECK( gpio_install_isr_service(0) );
-    ESP_ERROR_CHECK( gpio_isr_handler_add(PIN_INT, gpio_isr_endstop, NULL) );
 }
 
+// SPI transport of the pin layer (pins.cpp)
+
 // If transmitted data is 32bits or less, spi_transaction_t can use tx_data.
 // Here we have no more than 4 chips, thus SPI_TRANS_USE_TXDATA.
 static spi_device_handle_t spi_pin_hdlr;
 static spi_transaction_t spi_pin_trans;
 static uint8_t spi_pin_data[2] = { 0, 0 };
 
+// Ring of queued frame transactions. Transactions on one device complete in
+// order, so slot `spi_frame_next % SPI_FRAME_QUEUE` is free once the number
+// of frames in flight is less than SPI_FRAME_QUEUE.
+static spi_transaction_t spi_frame_trans[SPI_FRAME_QUEUE];
+DMA_ATTR static uint8_t spi_frame_data[SPI_FRAME_QUEUE][4];
+static uint32_t spi_frame_next = 0, spi_frame_inflight = 0;
+
 void spi_initialize() {
     spi_bus_config_t hspi_busconf = {
         .mosi_io_num = PIN_HMOSI,
@@ -282,7 +385,7 @@ void spi_initialize() {
         .input_delay_ns = 0,
         .spics_io_num = PIN_HCS1,
         .flags = 0,
-        .queue_size = 1, // only one transaction exists in the queue
+        .queue_size = SPI_FRAME_QUEUE,
         .pre_cb = NULL,
         .post_cb = NULL
     };
@@ -298,21 +401,110 @@ void spi_initialize() {
     // } else {
         spi_pin_trans.tx_buffer = spi_pin_data;
     // }
+    for (uint8_t i = 0; i < SPI_FRAME_QUEUE; i++) {
+        spi_frame_trans[i].length = spi_pin_data_len * 8;
+        spi_frame_trans[i].tx_buffer = spi_frame_data[i];
+    }
+}
+
+static esp_err_t spi_frame_reclaim() {
+    spi_transaction_t *trans;
+    esp_err_t err = spi_device_get_trans_result(
+        spi_pin_hdlr, &trans, portMAX_DELAY);
+    if (!err) spi_frame_inflight--;
+    return err;
 }
 
-esp_err_t spi_gpio_flush() {
+esp_err_t pinbus_spi_write(spi_frame_t frame) {
+    // polling transaction is not allowed when queued ones are not finished
+    esp_err_t err = pinbus_spi_wait();
+    if (err) return err;
+    spi_pin_data[0] = frame & 0xFF;
+    spi_pin_data[1] = frame >> 8;
     return spi_device_polling_transmit(spi_pin_hdlr, &spi_pin_trans);
 }
 
-esp_err_t spi_gpio_set_level(spi_pin_num_t pin_num, bool level) {
-    uint8_t pin = pin_num - PIN_SPI_MIN - 1, idx = pin >> 3, bit = pin & 0x7;
-    bitWrite(spi_pin_data[idx], bit, level);
-    return spi_gpio_flush();
+esp_err_t pinbus_spi_queue(spi_frame_t frame) {
+    esp_err_t err;
+    if (spi_frame_inflight == SPI_FRAME_QUEUE) {
+        if ((err = spi_frame_reclaim())) return err;
+    }
+    uint8_t slot = spi_frame_next++ % SPI_FRAME_QUEUE;
+    spi_frame_data[slot][0] = frame & 0xFF;
+    spi_frame_data[slot][1] = frame >> 8;
+    err = spi_device_queue_trans(
+        spi_pin_hdlr, spi_frame_trans + slot, portMAX_DELAY);
+    if (!err) spi_frame_inflight++;
+    return err;
+}
+
+esp_err_t pinbus_spi_wait() {
+    esp_err_t err = ESP_OK;
+    while (spi_frame_inflight && !(err = spi_frame_reclaim())) {}
+    return err;
+}
+
+static bool spi_pin_claimed = false;
+
+esp_err_t pinbus_spi_claim(spi_frame_t frame) {
+    if (spi_pin_claimed) return ESP_OK;
+    esp_err_t err = pinbus_spi_wait();
+    if (!err) err = spi_device_acquire_bus(spi_pin_hdlr, portMAX_DELAY);
+    if (err) return err;
+    // One transaction loads clock, mode and CS settings of our device into
+    // the registers. Then disconnect DMA so that data_buf is shifted out.
+    spi_pin_data[0] = frame & 0xFF;
+    spi_pin_data[1] = frame >> 8;
+    if (( err = spi_device_polling_transmit(spi_pin_hdlr, &spi_pin_trans) )) {
+        spi_device_release_bus(spi_pin_hdlr);
+        return err;
+    }
+    SPI2.dma_out_link.start = 0;
+    SPI2.dma_conf.out_rst = 1;
+    SPI2.dma_conf.out_rst = 0;
+    SPI2.user.usr_miso = 0;
+    SPI2.user.usr_mosi = 1;
+    SPI2.mosi_dlen.usr_mosi_dbitlen = sizeof(spi_frame_t) * 8 - 1;
+    spi_pin_claimed = true;
+    return ESP_OK;
+}
+
+void pinbus_spi_release() {
+    if (!spi_pin_claimed) return;
+    while (SPI2.cmd.usr) {}
+    spi_pin_claimed = false;
+    spi_device_release_bus(spi_pin_hdlr);
 }
 
-uint8_t spi_gpio_get_level(spi_pin_num_t pin_num) {
-    uint8_t pin = pin_num - PIN_SPI_MIN - 1, idx = pin >> 3, bit = pin & 0x7;
-    return bitRead(spi_pin_data[idx], bit);
+void IRAM_ATTR pinbus_spi_write_isr(spi_frame_t frame) {
+    while (SPI2.cmd.usr) {}             // previous frame is still shifting
+    SPI2.data_buf[0] = frame;           // low byte is sent first
+    SPI2.cmd.usr = 1;
+}
+
+// Thermistors
+
+static const adc1_channel_t adc_temp_chan[ADC_TEMP_NUM] = {
+    ADC_BED, ADC_NOZ1, ADC_NOZ2, ADC_NOZ3
+};
+
+void adc_initialize() {
+    ESP_ERROR_CHECK( adc1_config_width(ADC_WIDTH_BIT_12) );
+    for (uint8_t i = 0; i < ADC_TEMP_NUM; i++) {
+        ESP_ERROR_CHECK(
+            adc1_config_channel_atten(adc_temp_chan[i], ADC_ATTEN_DB_11) );
+    }
+}
+
+int adc_temp_raw(uint8_t idx) {
+    if (idx >= ADC_TEMP_NUM) return -1;
+    uint32_t sum = 0;
+    for (uint8_t i = 0; i < 1 << (2 * ADC_TEMP_OVERSAMPLE); i++) {
+        int raw = adc1_get_raw(adc_temp_chan[idx]);
+        if (raw < 0) return -1;
+        sum += raw;
+    }
+    return sum >> ADC_TEMP_OVERSAMPLE;
 }
 
 // Others
@@ -345,4 +537,5 @@ void driver_initialize() {
     i2c_initialize();
     gpio_initialize();
     spi_initialize();
+    adc_initialize();
 }
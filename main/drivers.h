@@ -9,7 +9,16 @@
 
 #include "globals.h"
 
+#ifdef __XTENSA__
 #include "esp_err.h"
+#else
+// host builds of the pin layer (tools/bench), see pinbus.h
+typedef int esp_err_t;
+#define ESP_OK                  0
+#define ESP_FAIL                -1
+#define ESP_ERR_INVALID_ARG     0x102
+#define ESP_ERR_TIMEOUT         0x107
+#endif
 
 #define _I2C_NUMBER(num) I2C_NUM_##num
 #define I2C_NUMBER(num) _I2C_NUMBER(num)
@@ -20,6 +29,9 @@
 #define _GPIO_NUMBER(num) GPIO_NUM_##num
 #define GPIO_NUMBER(num) _GPIO_NUMBER(num)
 
+#define _ADC_NUMBER(num) ADC1_CHANNEL_##num
+#define ADC_NUMBER(num) _ADC_NUMBER(num)
+
 #define NUM_RMT     RMT_CHANNEL_0
 #define NUM_LED     CONFIG_LED_NUM
 #define NUM_I2C     I2C_NUMBER(CONFIG_I2C_NUM)
@@ -38,6 +50,11 @@
 #define PIN_HCS1    GPIO_NUMBER(CONFIG_GPIO_HSPI_CS1)
 #define PIN_HSDCD   GPIO_NUMBER(CONFIG_GPIO_HSPI_SDCD)
 
+#define ADC_BED     ADC_NUMBER(CONFIG_ADC_TEMP_BED)
+#define ADC_NOZ1    ADC_NUMBER(CONFIG_ADC_TEMP_NOZ1)
+#define ADC_NOZ2    ADC_NUMBER(CONFIG_ADC_TEMP_NOZ2)
+#define ADC_NOZ3    ADC_NUMBER(CONFIG_ADC_TEMP_NOZ3)
+
 
 void driver_initialize();
 
@@ -84,6 +101,7 @@ uint32_t led_color(uint8_t idx = 0);    // get color of LED specified by `idx`
 
 
 // We use PCF8574 for IO expansion: Endstops | Temprature | Valves
+// Pin layer of both expanders is in pins.cpp, transports in pinbus.h
 
 typedef enum {
     PIN_I2C_MIN = 99,
@@ -103,15 +121,52 @@ typedef enum {
     PIN_I2C_MAX
 } i2c_pin_num_t;
 
+#define I2C_PIN_CHIPS   3
+#define I2C_PIN_ADDR    0x20            // of chip 0, then +1, +2
+#define I2C_PIN_INPUTS  BIT(0)          // chips read: endstops
+#define I2C_PIN_OUTPUTS (BIT(1) | BIT(2))
+#define I2C_CLK_HZ      100000          // PCF8574 maximum, see i2c_initialize
+
+// Bits on the bus of one transaction with `n` chips, one byte each: START,
+// address and byte with ACK, a repeated START between chips, STOP
+#define I2C_XFER_BITS(n) ((n) * 19 + 1)
+
 // Transfer data with PCF8574. idx indicates index of { endstops, temp, valves }
 esp_err_t i2c_set_val(uint8_t idx);
 esp_err_t i2c_get_val(uint8_t idx);
 
+// Set patterns of chips in bit mask `mask` to vals[idx], one transaction
+esp_err_t i2c_set_vals(uint8_t mask, const uint8_t *vals);
+
+// Write chips in `wmask` from their patterns and read chips in `rmask`, all
+// in one transaction. Default is a full refresh: outputs and endstops.
+esp_err_t i2c_sync_vals(uint8_t wmask = I2C_PIN_OUTPUTS,
+                        uint8_t rmask = I2C_PIN_INPUTS);
+
+// SCL frequency measured by i2c_initialize (Hz) and the time a transaction
+// takes besides its bits (us): driver, command link and interrupts
+uint32_t i2c_bus_speed();
+uint32_t i2c_bus_overhead();
+
 void i2c_detect();
 
 esp_err_t i2c_gpio_set_level(i2c_pin_num_t pin, bool level);
 uint8_t i2c_gpio_get_level(i2c_pin_num_t pin, bool sync = false);
 
+// Set bits of `mask` on chip `idx` to `levels` in one transaction
+esp_err_t i2c_gpio_set_levels(uint8_t idx, uint8_t mask, uint8_t levels);
+
+
+// Thermistors: bed, nozzle 1-3 on ADC1 (12 bit, 0 ~ 3.3V). One reading sums
+// 4^n samples and decimates by 2^n: ADC noise dithers the input, so the
+// result has n more bits and 2^n times less noise.
+#define ADC_TEMP_NUM        4
+#define ADC_TEMP_OVERSAMPLE 2           // n
+#define ADC_TEMP_BITS       (12 + ADC_TEMP_OVERSAMPLE)
+#define ADC_TEMP_MAX        ((1 << ADC_TEMP_BITS) - 1)
+
+int adc_temp_raw(uint8_t idx);          // -1 if `idx` is invalid
+
 
 // IO expansion by 74HC595 (SPI connection): Steppers
 typedef enum {
@@ -133,4 +188,32 @@ esp_err_t spi_gpio_flush();
 esp_err_t spi_gpio_set_level(spi_pin_num_t pin, bool level);
 uint8_t spi_gpio_get_level(spi_pin_num_t pin_num);
 
+/* A step frame is the full bit pattern of all 74HC595 outputs (DIR/STEP/EN
+ * of all axes) in one time slot. Bit n of the frame is pin PIN_SPI_MIN+1+n.
+ * Instead of one SPI transaction per pin toggle, a sequence of frames is
+ * queued as DMA transactions and shifted out one transfer per frame (the
+ * chips latch on CS rising edge at the end of each transaction).
+ */
+typedef uint16_t spi_frame_t;
+
+#define SPI_FRAME_BIT(pin)  ((spi_frame_t)1 << ((pin) - PIN_SPI_MIN - 1))
+#define SPI_FRAME_QUEUE     16  // max number of transactions in flight
+
+spi_frame_t spi_gpio_get_frame();   // current (last queued) output pattern
+
+// Queue `num` frames, block only when the transaction queue is full
+esp_err_t spi_gpio_queue_frames(const spi_frame_t *frames, size_t num);
+
+// Wait until all queued frames are transmitted
+esp_err_t spi_gpio_wait_frames();
+
+/* Direct register access for the step ISR (see stepper.h). The bus must be
+ * claimed first: other devices on HSPI (SD card) are blocked and the pin
+ * functions above must not be used until spi_gpio_release.
+ */
+esp_err_t spi_gpio_claim();
+void spi_gpio_release();
+bool spi_gpio_claimed();
+void spi_gpio_write_isr(spi_frame_t frame);
+
 #endif // _DRIVERS_H_
@@ -0,0 +1,35 @@
+/*
+ * File: endstop.cpp
+ * Authors: Hank <hankso1106@gmail.com>
+ * Create: 2026-10-18 19:02:36
+ */
+
+#include "endstop.h"
+
+void endstop_init(endstop_t *e, uint8_t state) {
+    e->state = e->last = state;
+    e->count = ENDSTOP_SAMPLES;
+}
+
+uint8_t endstop_update(endstop_t *e, uint8_t triggered) {
+    if (triggered != e->last) {
+        e->last = triggered;
+        e->count = 0;
+    }
+    if (e->count < ENDSTOP_SAMPLES) e->count++;
+    if (e->last == e->state || e->count < ENDSTOP_SAMPLES) return 0;
+    uint8_t changed = e->state ^ e->last;
+    e->state = e->last;
+    return changed;
+}
+
+bool endstop_settled(const endstop_t *e) { return e->last == e->state; }
+
+uint8_t endstop_axes(uint8_t state, bool max) {
+    uint8_t axes = 0;
+    state &= ENDSTOP_AXES;
+    for (uint8_t i = 0; i < ENDSTOP_NUM / 2; i++) {
+        if (state & BIT(i * 2 + max)) axes |= BIT(i);
+    }
+    return axes;
+}
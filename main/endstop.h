@@ -0,0 +1,63 @@
+/*
+ * File: endstop.h
+ * Authors: Hank <hankso1106@gmail.com>
+ * Create: 2026-10-18 19:02:36
+ *
+ * Endstops on the first PCF8574 (PIN_XMIN ~ PIN_PROB), active low. The chip
+ * pulls PIN_INT low when an input changes. The GPIO interrupt only takes
+ * the time and wakes the endstop task, everything else is task context:
+ *
+ *      INT -> ISR (timestamp, notify) -> task: read, read, read ...
+ *                                                  |
+ *                      ENDSTOP_SAMPLES equal readings in a row: new state
+ *                                                  v
+ *              stepper_halt: the step ISR drops steps of moves towards
+ *              triggered switches from its next event on
+ *
+ * A reading that differs from the previous one restarts the count, so
+ * contact bounce and spikes are filtered by a few back-to-back reads (one
+ * I2C transaction each, which also clears INT) instead of sleeping for
+ * ticks. Steps away from a triggered switch still go out, so an axis can
+ * back off it. Dropped steps are lost: home again after a stop.
+ */
+
+#ifndef _ENDSTOP_H_
+#define _ENDSTOP_H_
+
+#include "globals.h"
+
+#define ENDSTOP_NUM         8           // PIN_XMIN ~ PIN_PROB
+#define ENDSTOP_AXES        0x3F        // XMIN ~ ZMAX, bit 2i / 2i+1: axis i
+#define ENDSTOP_SAMPLES     3           // equal readings to take a change
+#define ENDSTOP_READS_MAX   16          // then wait for the next wake-up
+#define ENDSTOP_POLL_MS     100         // read even without interrupts
+
+typedef struct {
+    uint8_t state;              // debounced, bit i: PIN_XMIN + i triggered
+    uint8_t last;               // last reading
+    uint8_t count;              // readings equal to `last` in a row
+} endstop_t;
+
+void endstop_init(endstop_t *e, uint8_t state);
+
+// Feed one reading (bit set: triggered). Return bits of state changed.
+uint8_t endstop_update(endstop_t *e, uint8_t triggered);
+
+bool endstop_settled(const endstop_t *e);  // last reading is the state
+
+// Axes (bit i: axis i) at their min or max switch in `state`
+uint8_t endstop_axes(uint8_t state, bool max);
+
+/* Implemented in endstop_task.cpp: a task of the highest priority reads
+ * and debounces on interrupts (and every ENDSTOP_POLL_MS), then halts
+ * axes through the step engine (stepper.h). Latency from the interrupt to
+ * the halt is measured for every switch triggered.
+ */
+void endstop_initialize();
+void endstop_loop_begin(int xCoreID = 0);
+
+uint8_t endstop_state();                // debounced triggered bits
+void endstop_info();                    // states, reads and stop latency
+void endstop_stats_reset();
+
+#endif // _ENDSTOP_H_
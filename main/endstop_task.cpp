@@ -0,0 +1,168 @@
+/*
+ * File: endstop_task.cpp
+ * Authors: Hank <hankso1106@gmail.com>
+ * Create: 2026-10-18 19:02:36
+ */
+
+#include "endstop.h"
+#include "drivers.h"
+#include "stepper.h"
+#include "job.h"
+
+#include <string.h>
+
+#include "esp_log.h"
+#include "esp_attr.h"
+#include "esp_timer.h"
+#include "driver/gpio.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+
+static const char *TAG = "Endstop";
+
+static const char * const endstop_names[ENDSTOP_NUM] = {
+    "XMIN", "XMAX", "YMIN", "YMAX", "ZMIN", "ZMAX", "EVAL", "PROB",
+};
+
+static endstop_t endstops;
+static TaskHandle_t endstop_task = NULL;
+static volatile int64_t isr_at;         // us, last interrupt
+
+static struct {
+    int64_t since;
+    uint32_t irqs;              // interrupts taken
+    uint32_t reads, errors;
+    int64_t read_us;            // time of all reads
+    uint32_t changes;           // of debounced state
+    uint32_t polled;            // changes found without interrupt
+    uint32_t hits;              // switches triggered after interrupts
+    int64_t stop_us, stop_min, stop_max;    // interrupt to stepper_halt
+} stats;
+
+static void IRAM_ATTR endstop_isr(void *arg) {
+    BaseType_t woken = pdFALSE;
+    isr_at = esp_timer_get_time();
+    vTaskNotifyGiveFromISR(endstop_task, &woken);
+    if (woken) portYIELD_FROM_ISR();
+}
+
+// One transaction with the endstop chip, which clears its INT too
+static esp_err_t endstop_read(uint8_t *triggered) {
+    int64_t t0 = esp_timer_get_time();
+    esp_err_t err = i2c_sync_vals(0, I2C_PIN_INPUTS);
+    stats.read_us += esp_timer_get_time() - t0;
+    if (err) {
+        stats.errors++;
+        return err;
+    }
+    stats.reads++;
+    uint8_t bits = 0;
+    for (uint8_t i = 0; i < ENDSTOP_NUM; i++) {
+        if (!i2c_gpio_get_level((i2c_pin_num_t)(PIN_XMIN + i)))
+            bits |= BIT(i);
+    }
+    *triggered = bits;
+    return ESP_OK;
+}
+
+static void endstop_apply(uint8_t changed, int64_t since, bool irq) {
+    uint8_t state = endstops.state;
+    stepper_halt(endstop_axes(state, false), endstop_axes(state, true));
+    int64_t latency = esp_timer_get_time() - since;
+    stats.changes++;
+    if (!irq) stats.polled++;
+    if (irq && (changed & state)) {
+        stats.hits++;
+        stats.stop_us += latency;
+        if (latency < stats.stop_min || !stats.stop_min)
+            stats.stop_min = latency;
+        if (latency > stats.stop_max) stats.stop_max = latency;
+    }
+    // report after the halt, logging takes longer than all of above
+    for (uint8_t i = 0; i < ENDSTOP_NUM; i++) {
+        if (!(changed & BIT(i))) continue;
+        ESP_LOGI(TAG, "%s %s after %lld us", endstop_names[i],
+                 state & BIT(i) ? "triggered" : "released",
+                 (long long)latency);
+    }
+    if ((changed & state & ENDSTOP_AXES) && stepper_running()) {
+        ESP_LOGW(TAG, "Axis halted while moving, home before printing");
+        if (job_running()) job_stop();
+    }
+}
+
+static void endstop_loop(void *arg) {
+    for (;;) {
+        uint32_t n = ulTaskNotifyTake(
+            pdTRUE, pdMS_TO_TICKS(ENDSTOP_POLL_MS));
+        int64_t since = n ? isr_at : esp_timer_get_time();
+        if (n) stats.irqs++;
+        uint8_t changed = 0, triggered;
+        for (uint8_t i = 0; i < ENDSTOP_READS_MAX; i++) {
+            if (endstop_read(&triggered)) break;
+            changed |= endstop_update(&endstops, triggered);
+            if (endstop_settled(&endstops)) break;
+        }
+        if (changed) endstop_apply(changed, since, n);
+    }
+}
+
+void endstop_initialize() {
+    uint8_t triggered = 0;
+    esp_err_t err = endstop_read(&triggered);
+    if (err) ESP_LOGE(TAG, "Cannot read endstops: %s", esp_err_to_name(err));
+    endstop_init(&endstops, triggered);
+    stepper_halt(endstop_axes(triggered, false),
+                 endstop_axes(triggered, true));
+    endstop_stats_reset();
+}
+
+uint8_t endstop_state() { return endstops.state; }
+
+void endstop_info() {
+    uint8_t state = endstops.state;
+    for (uint8_t i = 0; i < ENDSTOP_NUM; i++) {
+        printf("%s%s %s", i ? "  " : "", endstop_names[i],
+               state & BIT(i) ? "hit" : "open");
+    }
+    printf("\n");
+    double secs = (esp_timer_get_time() - stats.since) / 1e6;
+    printf("Reads: %u interrupts, %u reads (%.0f us avg), %u errors in "
+           "%.0fs\n", stats.irqs, stats.reads,
+           stats.reads ? (double)stats.read_us / stats.reads : 0.0,
+           stats.errors, secs);
+    printf("Changes: %u (%u found by polling)\n",
+           stats.changes, stats.polled);
+    if (stats.hits) {
+        printf("Stop: %u hits, %lld / %.0f / %lld us from interrupt to "
+               "halt (min/avg/max)\n", stats.hits, (long long)stats.stop_min,
+               (double)stats.stop_us / stats.hits, (long long)stats.stop_max);
+    }
+}
+
+void endstop_stats_reset() {
+    memset(&stats, 0, sizeof(stats));
+    stats.since = esp_timer_get_time();
+}
+
+void endstop_loop_begin(int xCoreID) {
+    const char * const pcName = "endstop";
+    const uint32_t usStackDepth = 2560;
+    void * const pvParameters = NULL;
+    const UBaseType_t uxPriority = configMAX_PRIORITIES - 1;
+#ifndef CONFIG_FREERTOS_UNICORE
+    if (xCoreID == 0 || xCoreID == 1) {
+        xTaskCreatePinnedToCore(
+            endstop_loop, pcName, usStackDepth,
+            pvParameters, uxPriority, &endstop_task, xCoreID);
+    } else
+#endif
+    {
+        xTaskCreate(
+            endstop_loop, pcName, usStackDepth,
+            pvParameters, uxPriority, &endstop_task);
+    }
+    // after the task exists: the ISR notifies it
+    esp_err_t err = gpio_isr_handler_add(PIN_INT, endstop_isr, NULL);
+    if (err) ESP_LOGE(TAG, "Cannot add interrupt: %s", esp_err_to_name(err));
+}
@@ -0,0 +1,65 @@
+/*
+ * File: estimate.cpp
+ * Authors: Hank <hankso1106@gmail.com>
+ * Create: 2026-10-17 21:12:40
+ */
+
+#include "estimate.h"
+
+// Consume the oldest block like the step generator would
+static void consume(estimator_t *est) {
+    planner_block_t *block = planner_current(&est->planner);
+    if (!block) return;
+    est->time += planner_block_time(block);
+    est->filament += block->delta[AXIS_E];
+    est->result.blocks++;
+    planner_discard(&est->planner);
+}
+
+static void execute(const gcode_cmd_t *cmd, void *arg) {
+    estimator_t *est = (estimator_t *)arg;
+    float dwell = motion_dwell(cmd);
+    if (dwell >= 0) {
+        // the motion task stops before G4 like at the end of the queue
+        while (planner_count(&est->planner)) consume(est);
+        est->dwell += dwell;
+        return;
+    }
+    while (motion_execute(&est->motion, cmd) == MOTION_BUSY) consume(est);
+}
+
+void estimate_init(estimator_t *est) {
+    memset(&est->result, 0, sizeof(est->result));
+    memcpy(est->result.magic, ESTIMATE_MAGIC, sizeof(est->result.magic));
+    est->time = est->dwell = est->filament = 0;
+    gcode_parser_init(&est->parser);
+    motion_initialize(&est->motion, &est->planner);
+}
+
+void estimate_feed(estimator_t *est, const char *buf, size_t len) {
+    gcode_parse(&est->parser, buf, len, execute, est);
+    est->result.size += len;
+}
+
+const estimate_t * estimate_end(estimator_t *est) {
+    gcode_parse_end(&est->parser, execute, est);
+    while (planner_count(&est->planner)) consume(est);
+    est->result.lines = est->parser.lines;
+    est->result.time = est->time + est->dwell;
+    est->result.dwell = est->dwell;
+    est->result.filament = est->filament;
+    return &est->result;
+}
+
+bool estimate_check(const estimate_t *result) {
+    return !memcmp(result->magic, ESTIMATE_MAGIC, sizeof(result->magic));
+}
+
+bool estimate_cache_path(const char *path, char *buf, size_t len) {
+    const char *dot = strrchr(path, '.'), *slash = strrchr(path, '/');
+    size_t base = dot && (!slash || dot > slash) ? dot - path : strlen(path);
+    if (base + 5 > len) return false;
+    memcpy(buf, path, base);
+    strcpy(buf + base, ".est");
+    return true;
+}
@@ -0,0 +1,70 @@
+/*
+ * File: estimate.h
+ * Authors: Hank <hankso1106@gmail.com>
+ * Create: 2026-10-17 21:12:40
+ *
+ * Print time and filament estimation. G-code is fed through the tokenizer,
+ * motion interpreter and look-ahead planner exactly like the motion task
+ * does, but into a private planner instance, and every planned block is
+ * consumed immediately: its trapezoid (or S-curve, which has the same phase
+ * times) duration is summed. Blocks are taken out one at a time when the
+ * planner is full, so junction speeds see the same look-ahead depth as while
+ * printing. Dwell (G4) is included, and the moves before it come to a stop
+ * like on the printer. Heating and other M commands are not included.
+ *
+ * Feeding is incremental, so a file can be processed in small chunks between
+ * other work. On the ESP32 a low priority task does this after upload and
+ * caches the result as `<name>.est` next to the G-code, which the file list
+ * (CFS::list JSON) shows as `time` and `filament`.
+ *
+ * Example:
+ *      static estimator_t est;             // about 5KB, keep off the stack
+ *      estimate_init(&est);
+ *      estimate_feed(&est, buf, len);      // for each chunk
+ *      const estimate_t *res = estimate_end(&est);
+ */
+
+#ifndef _ESTIMATE_H_
+#define _ESTIMATE_H_
+
+#include "motion.h"
+
+#define ESTIMATE_MAGIC      "EST1"
+#define ESTIMATE_PATH       64          // max length of queued file path
+#define ESTIMATE_CHUNK      512         // bytes read per step of the task
+
+typedef struct {
+    char magic[4];              // ESTIMATE_MAGIC
+    uint32_t size;              // source file size (to validate cache)
+    uint32_t mtime;             // source file last write time
+    uint32_t lines;             // source text lines
+    uint32_t blocks;            // planned linear moves
+    float time;                 // seconds of motion and dwell
+    float dwell;                // seconds of G4 included in `time`
+    float filament;             // net mm of E extruded
+} estimate_t;
+
+typedef struct {
+    gcode_parser_t parser;
+    planner_t planner;
+    motion_t motion;
+    double time, dwell, filament;   // summed in double over long prints
+    estimate_t result;
+} estimator_t;
+
+void estimate_init(estimator_t *est);
+void estimate_feed(estimator_t *est, const char *buf, size_t len);
+const estimate_t * estimate_end(estimator_t *est);
+
+bool estimate_check(const estimate_t *result);
+
+// Cache file of G-code `path`: extension replaced by `.est`
+bool estimate_cache_path(const char *path, char *buf, size_t len);
+
+/* Implemented in estimate_task.cpp: a low priority task estimates G-code
+ * files on FFS queued by estimate_request and writes the `.est` cache.
+ */
+void estimate_loop_begin(int xCoreID = 0);
+bool estimate_request(const char *path);    // false if queue is full
+
+#endif // _ESTIMATE_H_
@@ -0,0 +1,90 @@
+/*
+ * File: estimate_task.cpp
+ * Authors: Hank <hankso1106@gmail.com>
+ * Create: 2026-10-17 21:12:40
+ */
+
+#include "estimate.h"
+#include "filesys.h"
+
+#include "esp_log.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "freertos/queue.h"
+
+static const char *TAG = "Estimate";
+
+static QueueHandle_t path_queue = NULL;
+static estimator_t est;
+
+static void estimate_file(const char *path) {
+    char cache[ESTIMATE_PATH + 4], buf[ESTIMATE_CHUNK];
+    File file = FFS.open(path);
+    if (!file || file.isDirectory()) {
+        ESP_LOGE(TAG, "Cannot open %s", path);
+        return;
+    }
+    uint32_t size = file.size(), mtime = file.getLastWrite();
+    uint32_t t0 = xTaskGetTickCount();
+    size_t len;
+    estimate_init(&est);
+    while ((len = file.read((uint8_t *)buf, sizeof(buf)))) {
+        estimate_feed(&est, buf, len);
+        taskYIELD();
+    }
+    file.close();
+    estimate_t result = *estimate_end(&est);
+    result.size = size;
+    result.mtime = mtime;
+    if (!estimate_cache_path(path, cache, sizeof(cache))) return;
+    File out = FFS.open(cache, "w");
+    if (!out) {
+        ESP_LOGE(TAG, "Cannot write %s", cache);
+        return;
+    }
+    out.write((const uint8_t *)&result, sizeof(result));
+    out.close();
+    ESP_LOGI(TAG, "%s: %.0fs (dwell %.0fs), %.1fmm filament, %u blocks "
+             "in %ums", path, result.time, result.dwell, result.filament,
+             result.blocks, (xTaskGetTickCount() - t0) * portTICK_PERIOD_MS);
+}
+
+static void estimate_loop(void *arg) {
+    char path[ESTIMATE_PATH];
+    for (;;) {
+        if (xQueueReceive(path_queue, path, portMAX_DELAY)) {
+            estimate_file(path);
+        }
+    }
+}
+
+bool estimate_request(const char *path) {
+    char buf[ESTIMATE_PATH];
+    if (!path_queue || strlen(path) >= sizeof(buf)) return false;
+    strcpy(buf, path);
+    return xQueueSend(path_queue, buf, 0) == pdTRUE;
+}
+
+void estimate_loop_begin(int xCoreID) {
+    if (!path_queue) path_queue = xQueueCreate(4, ESTIMATE_PATH);
+    if (!path_queue) {
+        ESP_LOGE(TAG, "No memory for estimate queue");
+        return;
+    }
+    const char * const pcName = "estimate";
+    const uint32_t usStackDepth = 4096;
+    void * const pvParameters = NULL;
+    const UBaseType_t uxPriority = tskIDLE_PRIORITY + 1;
+#ifndef CONFIG_FREERTOS_UNICORE
+    if (xCoreID == 0 || xCoreID == 1) {
+        xTaskCreatePinnedToCore(
+            estimate_loop, pcName, usStackDepth,
+            pvParameters, uxPriority, NULL, xCoreID);
+    } else
+#endif
+    {
+        xTaskCreate(
+            estimate_loop, pcName, usStackDepth,
+            pvParameters, uxPriority, NULL);
+    }
+}
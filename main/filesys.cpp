@@ -7,6 +7,7 @@
 #include "filesys.h"
 #include "drivers.h"
 #include "globals.h"
+#include "estimate.h"
 
 #include "cJSON.h"
 #include "esp_err.h"
@@ -67,13 +68,38 @@ bool CFSImpl::mkdir(const char *path) {
 
 bool CFSImpl::rmdir(const char *path) { return remove(path); }
 
+typedef struct {
+    CFS *fs;
+    cJSON *list;
+} jsonify_arg_t;
+
+// Print time estimate cached by estimate_task.cpp, if still valid
+static bool _estimate_file(CFS *fs, File file, estimate_t *res) {
+    char path[ESTIMATE_PATH + 4];
+    if (file.isDirectory()) return false;
+    if (!estimate_cache_path(file.name(), path, sizeof(path))) return false;
+    if (!strcmp(path, file.name()) || !fs->exists(path)) return false;
+    File cache = fs->open(path);
+    bool valid = cache.read((uint8_t *)res, sizeof(*res)) == sizeof(*res)
+        && estimate_check(res) && res->size == file.size()
+        && res->mtime == (uint32_t)file.getLastWrite();
+    cache.close();
+    return valid;
+}
+
 void _jsonify_file(File file, void *arg) {
+    jsonify_arg_t *ctx = (jsonify_arg_t *)arg;
+    estimate_t res;
     cJSON *obj = cJSON_CreateObject();
     cJSON_AddStringToObject(obj, "name", file.name());
     cJSON_AddNumberToObject(obj, "size", file.size());
     cJSON_AddNumberToObject(obj, "date", file.getLastWrite());
     cJSON_AddStringToObject(obj, "type", file.isDirectory() ? "folder":"file");
-    cJSON_AddItemToArray((cJSON *)arg, obj);
+    if (_estimate_file(ctx->fs, file, &res)) {
+        cJSON_AddNumberToObject(obj, "time", res.time);
+        cJSON_AddNumberToObject(obj, "filament", res.filament);
+    }
+    cJSON_AddItemToArray(ctx->list, obj);
 }
 
 void _loginfo_file(File file, void *arg) {
@@ -89,10 +115,10 @@ void CFS::list(const char *path, FILE *stream) {
 }
 
 char * CFS::list(const char *path) {
-    cJSON *lst = cJSON_CreateArray();
-    walk(path, &_jsonify_file, lst);
-    char *json = cJSON_Print(lst);
-    cJSON_Delete(lst);
+    jsonify_arg_t arg = { .fs = this, .list = cJSON_CreateArray() };
+    walk(path, &_jsonify_file, &arg);
+    char *json = cJSON_Print(arg.list);
+    cJSON_Delete(arg.list);
     return json;
 }
 
@@ -0,0 +1,162 @@
+/*
+ * File: fixed.h
+ * Authors: Hank <hankso1106@gmail.com>
+ * Create: 2026-10-17 22:51:37
+ *
+ * Q format fixed-point numbers for kinematics: value = raw / 2^Q, raw kept
+ * in T (int32_t by default) and products computed in W (int64_t). ESP32 has
+ * a single precision FPU without divide or square root instructions, and
+ * double math is done in software, so fixed-point avoids both.
+ *
+ * Formats used by the firmware style of kinematics (see fixedbench.h):
+ *      fixed_t<16>     positions (mm, +-32768) and speeds (mm/s)
+ *      fixed_t<8>      squared speeds (mm^2/s^2, up to 8.3e6)
+ *
+ * Operators keep the format of their operands. fixed_mul<QR>() multiplies
+ * two formats into a third one; fixed_sqrt<QR>(), fixed_recip<QR>() and
+ * fixed_cast<QR>() also give their result in QR, e.g. 1 / d of a Q16
+ * distance in Q30 to keep the unit vector precise.
+ *
+ * fixed_sqrt and fixed_recip normalize the argument by count-leading-zeros
+ * and run Newton iterations in Q30 with 32x32->64 multiplies only: no
+ * division, no loop over bits. Square roots are exact (rounded down) and
+ * reciprocals within 1 LSB.
+ *
+ * Example:
+ *      typedef fixed_t<16> q16;
+ *      q16 d = fixed_sqrt<16>(fixed_mul<8>(dx, dx) + fixed_mul<8>(dy, dy));
+ *      q16 ux = fixed_mul<16>(dx, fixed_recip<30>(d));
+ */
+
+#ifndef _FIXED_H_
+#define _FIXED_H_
+
+#include <stdint.h>
+
+#define FIXED_NORM          30          // Q of normalized Newton iterations
+
+// Shift right by `s` bits, or left if `s` is negative
+template <typename W>
+static inline W fixed_shift(W v, int s) { return s >= 0 ? v >> s : v << -s; }
+
+template <int Q, typename T = int32_t, typename W = int64_t>
+struct fixed_t {
+    T raw;
+
+    static constexpr W ONE = (W)1 << Q;
+
+    static fixed_t from_raw(W r) { fixed_t x; x.raw = (T)r; return x; }
+    static fixed_t from(float v) {
+        return from_raw((W)(v * ONE + (v < 0 ? -0.5f : 0.5f)));
+    }
+    static fixed_t from(double v) {
+        return from_raw((W)(v * ONE + (v < 0 ? -0.5 : 0.5)));
+    }
+    static fixed_t from(int32_t v) { return from_raw((W)v << Q); }
+
+    float to_float() const { return (float)raw / ONE; }
+    double to_double() const { return (double)raw / ONE; }
+    T to_int() const { return raw >> Q; }                   // floor
+    T round() const { return (raw + (ONE >> 1)) >> Q; }
+
+    fixed_t operator+(fixed_t b) const { return from_raw(raw + b.raw); }
+    fixed_t operator-(fixed_t b) const { return from_raw(raw - b.raw); }
+    fixed_t operator-() const { return from_raw(-(W)raw); }
+    fixed_t operator*(fixed_t b) const {
+        return from_raw(((W)raw * b.raw) >> Q);
+    }
+    fixed_t operator/(fixed_t b) const {
+        return from_raw(((W)raw << Q) / b.raw);
+    }
+    fixed_t operator*(int32_t n) const { return from_raw((W)raw * n); }
+    fixed_t operator>>(int n) const { return from_raw(raw >> n); }
+    fixed_t operator<<(int n) const { return from_raw((W)raw << n); }
+    fixed_t & operator+=(fixed_t b) { raw += b.raw; return *this; }
+    fixed_t & operator-=(fixed_t b) { raw -= b.raw; return *this; }
+
+    bool operator<(fixed_t b) const { return raw < b.raw; }
+    bool operator>(fixed_t b) const { return raw > b.raw; }
+    bool operator<=(fixed_t b) const { return raw <= b.raw; }
+    bool operator>=(fixed_t b) const { return raw >= b.raw; }
+    bool operator==(fixed_t b) const { return raw == b.raw; }
+    bool operator!=(fixed_t b) const { return raw != b.raw; }
+};
+
+template <int QR, int Q, typename T, typename W>
+static inline fixed_t<QR, T, W> fixed_cast(fixed_t<Q, T, W> x) {
+    return fixed_t<QR, T, W>::from_raw(fixed_shift((W)x.raw, Q - QR));
+}
+
+template <int QR, int QA, int QB, typename T, typename W>
+static inline fixed_t<QR, T, W> fixed_mul(fixed_t<QA, T, W> a,
+                                          fixed_t<QB, T, W> b) {
+    return fixed_t<QR, T, W>::from_raw(
+        fixed_shift((W)a.raw * b.raw, QA + QB - QR));
+}
+
+// 1 / sqrt(m) in Q30 for m in [2^28, 2^30), i.e. [0.25, 1) in Q30
+static inline uint32_t fixed_rsqrt_norm(uint32_t m) {
+    // linear guess on [0.25, 1): 2.2 - 1.25 m, error < 12%
+    uint64_t y = (uint64_t)(2.2 * (1 << FIXED_NORM))
+               - ((5 * (uint64_t)m) >> 2);
+    for (int i = 0; i < 4; i++) {           // y = y * (3 - m y^2) / 2
+        uint64_t yy = (y * y) >> FIXED_NORM;
+        uint64_t t = (3ULL << FIXED_NORM) - ((m * yy) >> FIXED_NORM);
+        y = (y * t) >> (FIXED_NORM + 1);
+    }
+    return (uint32_t)y;
+}
+
+// 1 / m in Q30 for m in [2^29, 2^30), i.e. [0.5, 1) in Q30
+static inline uint32_t fixed_recip_norm(uint32_t m) {
+    // 48/17 - 32/17 m, error < 1/17
+    uint64_t y = 3031741621ULL - ((32 * (uint64_t)m) / 17);
+    for (int i = 0; i < 3; i++) {           // y = y * (2 - m y)
+        uint64_t t = (2ULL << FIXED_NORM) - ((m * y) >> FIXED_NORM);
+        y = (y * t) >> FIXED_NORM;
+    }
+    return (uint32_t)y;
+}
+
+// floor(sqrt(v)) of an unsigned integer
+static inline uint64_t fixed_isqrt(uint64_t v) {
+    if (!v) return 0;
+    int e = 64 - __builtin_clzll(v) - FIXED_NORM;   // v = m * 2^e
+    if (e & 1) e++;                                 // even, m in [2^28, 2^30)
+    uint32_t m = (uint32_t)fixed_shift(v, e);
+    uint64_t s = ((uint64_t)m * fixed_rsqrt_norm(m)) >> FIXED_NORM;
+    // sqrt(v) = s / 2^30 * 2^((e + 30) / 2), off by one at most
+    uint64_t r = fixed_shift(s, (FIXED_NORM - e) / 2);
+    if (r > 0xFFFFFFFF || r * r > v) r--;
+    if (r < 0xFFFFFFFF && (r + 1) * (r + 1) <= v) r++;
+    return r;
+}
+
+// Square root of `x`, result in QR
+template <int QR, int Q, typename T, typename W>
+static inline fixed_t<QR, T, W> fixed_sqrt(fixed_t<Q, T, W> x) {
+    if (x.raw <= 0) return fixed_t<QR, T, W>::from_raw(0);
+    // sqrt(raw / 2^Q) * 2^QR = sqrt(raw * 2^(2 QR - Q))
+    return fixed_t<QR, T, W>::from_raw(
+        fixed_isqrt(fixed_shift((uint64_t)x.raw, Q - 2 * QR)));
+}
+
+// 1 / x in QR, saturated to the largest value of T when x is too small
+template <int QR, int Q, typename T, typename W>
+static inline fixed_t<QR, T, W> fixed_recip(fixed_t<Q, T, W> x) {
+    typedef fixed_t<QR, T, W> F;
+    const W max = ((W)1 << (sizeof(T) * 8 - 1)) - 1;
+    if (!x.raw) return F::from_raw(max);
+    uint64_t a = x.raw < 0 ? -(W)x.raw : x.raw;
+    int e = 64 - __builtin_clzll(a) - FIXED_NORM;   // a = m * 2^e
+    uint32_t m = (uint32_t)fixed_shift(a, e);
+    // x = m / 2^30 * 2^(30 + e - Q), so 1 / x * 2^QR = y * 2^(Q + QR - 60 - e)
+    int s = 2 * FIXED_NORM + e - Q - QR;
+    uint64_t y = fixed_recip_norm(m);
+    W r = s >= 0 ? (W)(y >> s) : -s < __builtin_clzll(y) - 1 ? (W)(y << -s)
+                                                             : max;
+    if (r > max) r = max;
+    return F::from_raw(x.raw < 0 ? -r : r);
+}
+
+#endif // _FIXED_H_
@@ -0,0 +1,193 @@
+/*
+ * File: fixedbench.cpp
+ * Authors: Hank <hankso1106@gmail.com>
+ * Create: 2026-10-17 23:08:14
+ */
+
+#include "fixedbench.h"
+#include "fixed.h"
+
+#include "math.h"
+#include <stdio.h>
+#include <stdlib.h>
+
+#define ACCEL           3000.0f         // mm/s^2
+#define STEPS_PER_MM    80.0f
+#define TICK_HZ         10e6f           // stepper timer
+
+typedef fixed_t<16> q16;
+typedef fixed_t<8> q8;
+
+typedef struct {
+    float delta[3];             // mm
+    float exit_speed;           // mm/s
+} block_in_t;
+
+typedef struct {
+    q16 delta[3];
+    q16 exit_speed;
+} block_fx_t;
+
+typedef struct {
+    block_in_t blocks[FBENCH_INPUTS];
+    block_fx_t blocks_fx[FBENCH_INPUTS];
+    float v0[FBENCH_INPUTS];    // start speed of accelerations (mm/s)
+    q16 v0_fx[FBENCH_INPUTS];
+    uint32_t ticks[FBENCH_STEPS], ref[FBENCH_STEPS];
+} inputs_t;
+
+static inline float fb_sqrt(float v) { return sqrtf(v); }
+static inline double fb_sqrt(double v) { return sqrt(v); }
+
+template <typename F>
+static F planner_fp(const block_in_t *b) {
+    F dx = b->delta[0], dy = b->delta[1], dz = b->delta[2];
+    F v = b->exit_speed;
+    F d = fb_sqrt(dx * dx + dy * dy + dz * dz);
+    F ux = dx * (1 / d);
+    return fb_sqrt(v * v + 2 * (F)ACCEL * d) * ux;
+}
+
+static q16 planner_fx(const block_fx_t *b) {
+    static const q16 accel2 = q16::from(2 * ACCEL);
+    const q16 *dt = b->delta;
+    q8 d2 = fixed_mul<8>(dt[0], dt[0]) + fixed_mul<8>(dt[1], dt[1])
+          + fixed_mul<8>(dt[2], dt[2]);
+    q16 d = fixed_sqrt<16>(d2);
+    q16 ux = fixed_mul<16>(dt[0], fixed_recip<30>(d));
+    q8 v2 = fixed_mul<8>(b->exit_speed, b->exit_speed)
+          + fixed_mul<8>(accel2, d);
+    return fixed_sqrt<16>(v2) * ux;
+}
+
+template <typename F>
+static void stepgen_fp(float v0, uint32_t *ticks) {
+    const F k = 2 * ACCEL / STEPS_PER_MM, hz = TICK_HZ / ACCEL;
+    F v = v0, v2 = v * v;
+    for (int n = 0; n < FBENCH_STEPS; n++) {
+        ticks[n] = (uint32_t)((fb_sqrt(v2 + k * (n + 1)) - v) * hz);
+    }
+}
+
+static void stepgen_fx(q16 v0, uint32_t *ticks) {
+    static const q8 k = q8::from(2 * ACCEL / STEPS_PER_MM);
+    static const q8 hz = q8::from(TICK_HZ / ACCEL);
+    q8 v2 = fixed_mul<8>(v0, v0);
+    for (int n = 0; n < FBENCH_STEPS; n++) {
+        q16 dv = fixed_sqrt<16>(v2 + k * (n + 1)) - v0;
+        ticks[n] = fixed_mul<0>(dv, hz).raw;
+    }
+}
+
+static void generate(inputs_t *in) {
+    uint32_t seed = 12345;
+    for (int i = 0; i < FBENCH_INPUTS; i++) {
+        for (int j = 0; j < 4; j++) {
+            seed = seed * 1103515245 + 12345;
+            float r = (seed >> 8) / 16777216.0f;    // [0, 1)
+            if (j < 2) {
+                in->blocks[i].delta[j] = (r - 0.5f) * 200;
+            } else if (j == 2) {
+                in->blocks[i].delta[j] = (r - 0.5f) * 10;
+            } else {
+                in->blocks[i].exit_speed = r * 200;
+                in->v0[i] = (1 - r) * 200;
+            }
+        }
+        in->blocks[i].delta[0] += in->blocks[i].delta[0] < 0 ? -1 : 1;
+        for (int j = 0; j < 3; j++) {
+            in->blocks_fx[i].delta[j] = q16::from(in->blocks[i].delta[j]);
+        }
+        in->blocks_fx[i].exit_speed = q16::from(in->blocks[i].exit_speed);
+        in->v0_fx[i] = q16::from(in->v0[i]);
+    }
+}
+
+static double max_diff(const uint32_t *a, const uint32_t *b) {
+    int32_t diff = 0;
+    for (int n = 0; n < FBENCH_STEPS; n++) {
+        int32_t d = abs((int32_t)(a[n] - b[n]));
+        if (d > diff) diff = d;
+    }
+    return diff;
+}
+
+size_t fbench_run(fbench_clock_t clock, uint32_t rounds,
+                  fbench_result_t *res, size_t num) {
+    const char *types[] = { "float", "double", "fixed" };
+    inputs_t *in = (inputs_t *)malloc(sizeof(inputs_t));
+    volatile float sink = 0;
+    volatile uint32_t tsink = 0;
+    size_t cnt = 0;
+    if (!in || num < FBENCH_RESULTS) {
+        free(in);
+        return 0;
+    }
+    generate(in);
+    for (int type = 0; type < 3; type++) {
+        fbench_result_t *r = res + cnt++;
+        r->name = "planner";
+        r->type = types[type];
+        r->unit = "mm/s";
+        r->ops = rounds * FBENCH_INPUTS;
+        double t0 = clock();
+        for (uint32_t k = 0; k < rounds; k++) {
+            for (int i = 0; i < FBENCH_INPUTS; i++) {
+                if (type == 0) {
+                    sink = sink + planner_fp<float>(in->blocks + i);
+                } else if (type == 1) {
+                    sink = sink + planner_fp<double>(in->blocks + i);
+                } else {
+                    sink = sink + planner_fx(in->blocks_fx + i).raw;
+                }
+            }
+        }
+        r->seconds = clock() - t0;
+        r->max_error = 0;
+        for (int i = 0; i < FBENCH_INPUTS; i++) {
+            double ref = planner_fp<double>(in->blocks + i), val;
+            if (type == 0) val = planner_fp<float>(in->blocks + i);
+            else if (type == 1) val = ref;
+            else val = planner_fx(in->blocks_fx + i).to_double();
+            if (fabs(val - ref) > r->max_error) r->max_error = fabs(val - ref);
+        }
+    }
+    for (int type = 0; type < 3; type++) {
+        fbench_result_t *r = res + cnt++;
+        r->name = "stepgen";
+        r->type = types[type];
+        r->unit = "ticks";
+        r->ops = rounds * FBENCH_INPUTS * FBENCH_STEPS;
+        double t0 = clock();
+        for (uint32_t k = 0; k < rounds; k++) {
+            for (int i = 0; i < FBENCH_INPUTS; i++) {
+                if (type == 0) stepgen_fp<float>(in->v0[i], in->ticks);
+                else if (type == 1) stepgen_fp<double>(in->v0[i], in->ticks);
+                else stepgen_fx(in->v0_fx[i], in->ticks);
+                tsink = tsink + in->ticks[FBENCH_STEPS - 1];
+            }
+        }
+        r->seconds = clock() - t0;
+        r->max_error = 0;
+        for (int i = 0; i < FBENCH_INPUTS; i++) {
+            stepgen_fp<double>(in->v0[i], in->ref);
+            if (type == 0) stepgen_fp<float>(in->v0[i], in->ticks);
+            else if (type == 1) stepgen_fp<double>(in->v0[i], in->ticks);
+            else stepgen_fx(in->v0_fx[i], in->ticks);
+            double err = max_diff(in->ticks, in->ref);
+            if (err > r->max_error) r->max_error = err;
+        }
+    }
+    free(in);
+    return cnt;
+}
+
+void fbench_print(const fbench_result_t *res, size_t num) {
+    printf("Workload Type    Ops/s        ns/op  Max error\n");
+    for (size_t i = 0; i < num; i++) {
+        const fbench_result_t *r = res + i;
+        double secs = r->seconds > 0 ? r->seconds : 1e-9;
+        printf("%-8s %-7s %10.0f %10.1f  %.4f %s\n", r->name, r->type,
+               r->ops / secs, secs / r->ops * 1e9, r->max_error, r->unit);
+    }
+}
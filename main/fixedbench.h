@@ -0,0 +1,45 @@
+/*
+ * File: fixedbench.h
+ * Authors: Hank <hankso1106@gmail.com>
+ * Create: 2026-10-17 23:08:14
+ *
+ * Kinematics workloads computed in float, double and fixed-point (fixed.h),
+ * shared by the console command `fixedbench` on ESP32 and the host
+ * benchmark tools/bench/fixed.cpp, so both run exactly the same code:
+ *
+ *      planner     per block: distance, unit vector (reciprocal) and max
+ *                  speed sqrt(v^2 + 2 a d), output X speed in mm/s
+ *      stepgen     per step of an acceleration: t = (sqrt(v0^2 + 2 a s) - v0)
+ *                  / a, output in timer ticks
+ *
+ * Errors are measured against the double results.
+ */
+
+#ifndef _FIXEDBENCH_H_
+#define _FIXEDBENCH_H_
+
+#include <stdint.h>
+#include <stddef.h>
+
+#define FBENCH_INPUTS       256         // blocks / accelerations per round
+#define FBENCH_STEPS        64          // steps per acceleration
+#define FBENCH_RESULTS      6           // 2 workloads x 3 types
+
+typedef struct {
+    const char *name;           // workload
+    const char *type;           // float | double | fixed
+    const char *unit;           // unit of max_error
+    uint32_t ops;               // blocks or steps computed
+    double seconds;
+    double max_error;
+} fbench_result_t;
+
+typedef double (*fbench_clock_t)();     // monotonic time in seconds
+
+// Run every workload `rounds` times. Return number of results filled.
+size_t fbench_run(fbench_clock_t clock, uint32_t rounds,
+                  fbench_result_t *res, size_t num);
+
+void fbench_print(const fbench_result_t *res, size_t num);
+
+#endif // _FIXEDBENCH_H_
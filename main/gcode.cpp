@@ -0,0 +1,233 @@
+/*
+ * File: gcode.cpp
+ * Authors: Hank <hankso1106@gmail.com>
+ * Create: 2026-10-17 10:12:40
+ */
+
+#include "gcode.h"
+
+enum {
+    ST_WORD,        // waiting for a letter (start of word)
+    ST_VALUE,       // reading number after letter
+    ST_CSUM,        // reading checksum after `*`
+    ST_TEXT,        // skipping text argument until `;` or EOL
+    ST_COMMENT,     // skipping `;` comment until EOL
+    ST_PAREN,       // skipping `(...)` comment
+};
+
+static const float inv10[] = {
+    1, 1e-1, 1e-2, 1e-3, 1e-4, 1e-5, 1e-6, 1e-7, 1e-8, 1e-9
+};
+
+// Commands whose arguments are free text (filename, message etc.)
+static bool is_text_cmd(const gcode_cmd_t *cmd) {
+    if (cmd->letter != 'M') return false;
+    switch (cmd->code) {
+    case 23: case 28: case 30: case 32: case 117: case 118: case 928:
+        return true;
+    default:
+        return false;
+    }
+}
+
+static void reset_line(gcode_parser_t *p) {
+    p->cmd.line = -1;
+    p->cmd.code = p->cmd.subcode = p->cmd.checksum = 0;
+    p->cmd.letter = 0;
+    p->cmd.flags = p->cmd.nparam = 0;
+    p->state = ST_WORD;
+    p->sum = 0;
+}
+
+static void reset_value(gcode_parser_t *p) {
+    p->neg = p->dot = p->digit = false;
+    p->ival = p->fval = p->fdig = 0;
+}
+
+static void finish_word(gcode_parser_t *p) {
+    gcode_cmd_t *cmd = &p->cmd;
+    char letter = p->letter;
+    bool line = letter == 'N' && !cmd->letter && !cmd->nparam;
+    bool code = !cmd->letter && (letter == 'G' || letter == 'M' ||
+                                 letter == 'T');
+    if (!p->digit && (line || code)) {
+        cmd->flags |= GCODE_BAD_WORD;   // bare letters are only params
+        return;
+    }
+    if (line) {
+        cmd->line = p->neg ? -(int32_t)p->ival : p->ival;
+        cmd->flags |= GCODE_HAS_LINE;
+    } else if (code) {
+        cmd->letter = letter;
+        cmd->code = p->ival;
+        cmd->subcode = p->fval;
+    } else if (cmd->nparam < GCODE_MAX_PARAMS) {
+        gcode_param_t *param = cmd->params + cmd->nparam++;
+        param->letter = letter;
+        param->bare = !p->digit;
+        param->value = p->ival + p->fval * inv10[p->fdig];
+        if (p->neg) param->value = -param->value;
+    } else {
+        cmd->flags |= GCODE_OVERFLOW;
+    }
+}
+
+static size_t finish_line(gcode_parser_t *p, gcode_cb_t cb, void *arg) {
+    gcode_cmd_t *cmd = &p->cmd;
+    if (p->state == ST_VALUE) finish_word(p);
+    size_t emitted = 0;
+    if (cmd->letter || cmd->nparam || (cmd->flags & GCODE_HAS_LINE)) {
+        if ((cmd->flags & GCODE_HAS_CSUM) && cmd->checksum != p->sum) {
+            cmd->flags |= GCODE_BAD_CSUM;
+        }
+        if (cmd->flags & (GCODE_BAD_CSUM | GCODE_BAD_WORD | GCODE_OVERFLOW)) {
+            p->errors++;
+        }
+        if (cb) cb(cmd, arg);
+        emitted = 1;
+    }
+    reset_line(p);
+    return emitted;
+}
+
+void gcode_parser_init(gcode_parser_t *parser) {
+    memset(parser, 0, sizeof(gcode_parser_t));
+    reset_line(parser);
+    reset_value(parser);
+}
+
+size_t gcode_parse(gcode_parser_t *p, const char *buf, size_t len,
+                   gcode_cb_t cb, void *arg) {
+    size_t emitted = 0;
+    for (const char *end = buf + len; buf < end; buf++) {
+        char c = *buf;
+        if (c == '\n') {
+            p->lines++;
+            emitted += finish_line(p, cb, arg);
+            continue;
+        }
+        switch (p->state) {
+        case ST_COMMENT:
+            continue;
+        case ST_PAREN:
+            p->sum ^= c;
+            if (c == ')') p->state = ST_WORD;
+            continue;
+        case ST_TEXT:
+        text:
+            if (c == ';') {
+                p->state = ST_COMMENT;
+            } else if (c == '*') {
+                p->cmd.flags |= GCODE_HAS_CSUM;
+                p->state = ST_CSUM;
+            } else {
+                p->sum ^= c;
+                if (c != ' ' && c != '\t' && c != '\r') {
+                    p->cmd.flags |= GCODE_HAS_TEXT;
+                }
+            }
+            continue;
+        case ST_CSUM:
+            if (c >= '0' && c <= '9') {
+                p->cmd.checksum = p->cmd.checksum * 10 + (c - '0');
+            } else if (c == ';') {
+                p->state = ST_COMMENT;
+            }
+            continue;
+        case ST_VALUE:
+            if (c >= '0' && c <= '9') {
+                p->sum ^= c;
+                p->digit = true;
+                if (!p->dot) {
+                    if (p->ival < 100000000) p->ival = p->ival * 10 + c - '0';
+                } else if (p->fdig < 9) {
+                    p->fval = p->fval * 10 + c - '0';
+                    p->fdig++;
+                }
+                continue;
+            } else if (c == '.' && !p->dot) {
+                p->sum ^= c;
+                p->dot = true;
+                continue;
+            } else if ((c == '-' || c == '+') && !p->digit && !p->dot) {
+                p->sum ^= c;
+                p->neg = c == '-';
+                continue;
+            }
+            finish_word(p);
+            p->state = ST_WORD;
+            if (is_text_cmd(&p->cmd) && !p->cmd.nparam) {
+                p->state = ST_TEXT;
+                goto text;      // parse current char as text argument
+            }
+            // fall through - current char starts a new word
+        case ST_WORD:
+            if (c == ' ' || c == '\t' || c == '\r') {
+                p->sum ^= c;
+            } else if (c == ';') {
+                p->state = ST_COMMENT;
+            } else if (c == '(') {
+                p->sum ^= c;
+                p->state = ST_PAREN;
+            } else if (c == '*') {
+                p->cmd.flags |= GCODE_HAS_CSUM;
+                p->cmd.checksum = 0;
+                p->state = ST_CSUM;
+            } else {
+                p->sum ^= c;
+                if (c >= 'a' && c <= 'z') c -= 'a' - 'A';
+                if (c >= 'A' && c <= 'Z') {
+                    p->letter = c;
+                    p->state = ST_VALUE;
+                    reset_value(p);
+                } else {
+                    p->cmd.flags |= GCODE_BAD_WORD;
+                }
+            }
+            continue;
+        }
+    }
+    return emitted;
+}
+
+size_t gcode_parse_end(gcode_parser_t *p, gcode_cb_t cb, void *arg) {
+    return finish_line(p, cb, arg);
+}
+
+bool gcode_param(const gcode_cmd_t *cmd, char letter, float *value) {
+    for (uint8_t i = 0; i < cmd->nparam; i++) {
+        if (cmd->params[i].letter != letter) continue;
+        if (cmd->params[i].bare) return false;
+        if (value) *value = cmd->params[i].value;
+        return true;
+    }
+    return false;
+}
+
+bool gcode_seen(const gcode_cmd_t *cmd, char letter) {
+    for (uint8_t i = 0; i < cmd->nparam; i++) {
+        if (cmd->params[i].letter == letter) return true;
+    }
+    return false;
+}
+
+int gcode_format(const gcode_cmd_t *cmd, char *buf, size_t len) {
+    int idx = 0;
+    if (cmd->flags & GCODE_HAS_LINE) {
+        idx += snprintf(buf + idx, len > (size_t)idx ? len - idx : 0,
+                        "N%d ", cmd->line);
+    }
+    if (cmd->letter) {
+        idx += snprintf(buf + idx, len > (size_t)idx ? len - idx : 0,
+                        cmd->subcode ? "%c%u.%u " : "%c%u ",
+                        cmd->letter, cmd->code, cmd->subcode);
+    }
+    for (uint8_t i = 0; i < cmd->nparam; i++) {
+        const gcode_param_t *param = cmd->params + i;
+        idx += snprintf(buf + idx, len > (size_t)idx ? len - idx : 0,
+                        param->bare ? "%c " : "%c%g ",
+                        param->letter, param->value);
+    }
+    if (idx && (size_t)idx <= len) buf[--idx] = '\0';  // strip last space
+    return idx;
+}
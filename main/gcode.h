@@ -0,0 +1,95 @@
+/*
+ * File: gcode.h
+ * Authors: Hank <hankso1106@gmail.com>
+ * Create: 2026-10-17 10:12:40
+ *
+ * Streaming G-code tokenizer. Input is consumed byte by byte with a small
+ * state machine, so a line may be split across any number of buffers (HTTP
+ * request body, 512 bytes chunks read from FFS/SDFS etc.). Nothing is copied
+ * into Arduino String and no memory is allocated per line: each complete line
+ * is assembled into the parser owned `gcode_cmd_t` and handed to a callback.
+ *
+ * Supported syntax:
+ *  [N<line>] <G|M|T><code>[.<sub>] [<letter>[<value>] ...] [*<checksum>]
+ *  Comments `; ...` and `( ... )` are skipped. Letters are case insensitive.
+ *  Text arguments (e.g. M117 message) are skipped and GCODE_HAS_TEXT is set.
+ *  A letter without value (e.g. `G28 X Y`, `M84 E`) is kept as bare param.
+ *
+ * Example:
+ *      gcode_parser_t parser;
+ *      gcode_parser_init(&parser);
+ *      while ((len = file.read(buf, sizeof(buf)))) {
+ *          gcode_parse(&parser, (char *)buf, len, callback, NULL);
+ *      }
+ *      gcode_parse_end(&parser, callback, NULL);
+ */
+
+#ifndef _GCODE_H_
+#define _GCODE_H_
+
+#include "globals.h"
+
+#define GCODE_MAX_PARAMS    12
+
+// bits of gcode_cmd_t.flags
+#define GCODE_HAS_LINE      (1 << 0)    // line number N is specified
+#define GCODE_HAS_CSUM      (1 << 1)    // checksum *NN is specified
+#define GCODE_BAD_CSUM      (1 << 2)    // checksum mismatch
+#define GCODE_HAS_TEXT      (1 << 3)    // text argument skipped
+#define GCODE_OVERFLOW      (1 << 4)    // too many parameters (dropped)
+#define GCODE_BAD_WORD      (1 << 5)    // bad char or G/M/T/N without number
+
+typedef struct {
+    char letter;                // 'A' - 'Z'
+    bool bare;                  // letter without value (value is 0)
+    float value;
+} gcode_param_t;
+
+typedef struct {
+    int32_t line;               // value of N word (-1 if not specified)
+    uint16_t code;              // e.g. 28 in `G28`, 104 in `M104`
+    uint8_t subcode;            // e.g. 1 in `G29.1` (0 if not specified)
+    char letter;                // 'G' | 'M' | 'T' or 0 (empty line)
+    uint8_t checksum;           // value of *NN word
+    uint8_t flags;              // combination of GCODE_XXX bits
+    uint8_t nparam;
+    gcode_param_t params[GCODE_MAX_PARAMS];
+} gcode_cmd_t;
+
+typedef void (*gcode_cb_t)(const gcode_cmd_t *cmd, void *arg);
+
+typedef struct {
+    gcode_cmd_t cmd;            // command being assembled
+    uint8_t state;              // tokenizer state
+    uint8_t sum;                // running XOR checksum of current line
+    char letter;                // letter of current word
+    bool neg, dot, digit;       // sign / decimal point / got digit
+    uint8_t fdig;               // number of fraction digits
+    uint32_t ival, fval;        // integer / fraction digits of current value
+    uint32_t lines;             // number of lines consumed
+    uint32_t errors;            // number of lines with error flags
+} gcode_parser_t;
+
+void gcode_parser_init(gcode_parser_t *parser);
+
+/* Feed `len` bytes of `buf` into parser. Callback is called once for every
+ * non-empty line (command, parameters or line number). Partially received
+ * line is kept in parser state until the following chunk arrives.
+ * Return number of commands emitted.
+ */
+size_t gcode_parse(gcode_parser_t *parser, const char *buf, size_t len,
+                   gcode_cb_t cb, void *arg);
+
+// Flush the last line if the input does not end with a newline.
+size_t gcode_parse_end(gcode_parser_t *parser, gcode_cb_t cb, void *arg);
+
+// Get value of parameter by letter. Return false if not found or bare.
+bool gcode_param(const gcode_cmd_t *cmd, char letter, float *value);
+
+// Check if parameter is specified, with or without value.
+bool gcode_seen(const gcode_cmd_t *cmd, char letter);
+
+// Print command in normalized form (e.g. `N2 G1 X1.5 Y2`). Like snprintf.
+int gcode_format(const gcode_cmd_t *cmd, char *buf, size_t len);
+
+#endif // _GCODE_H_
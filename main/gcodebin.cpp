@@ -0,0 +1,207 @@
+/*
+ * File: gcodebin.cpp
+ * Authors: Hank <hankso1106@gmail.com>
+ * Create: 2026-10-17 19:48:51
+ */
+
+#include "gcodebin.h"
+
+#include "math.h"
+#include "stddef.h"
+#include "sys/param.h"
+
+static const char axis_letters[NUM_AXIS] = { 'X', 'Y', 'Z', 'E' };
+
+static inline int32_t * rec_values(void *record) {
+    return (int32_t *)((char *)record + offsetof(gcb_record_t, value));
+}
+
+static bool flush(gcb_encoder_t *enc) {
+    size_t len = enc->num * sizeof(gcb_record_t);
+    if (!enc->num || enc->error) return !enc->error;
+    if (enc->write(enc->buf, len, enc->arg) != len) enc->error = true;
+    enc->num = 0;
+    return !enc->error;
+}
+
+// Follow modal states like motion.cpp to compute statistics
+static void track(gcb_encoder_t *enc, const gcode_cmd_t *cmd) {
+    gcb_header_t *hdr = &enc->header;
+    float value, target[NUM_AXIS];
+    if (cmd->letter == 'M') {
+        if (cmd->code == 82) enc->relative_e = false;
+        if (cmd->code == 83) enc->relative_e = true;
+        return;
+    }
+    if (cmd->letter != 'G') return;
+    switch (cmd->code) {
+    case 20: enc->units = 25.4; return;
+    case 21: enc->units = 1; return;
+    case 28: {
+        bool all = true;
+        for (uint8_t i = 0; i < AXIS_E; i++) {
+            if (gcode_seen(cmd, axis_letters[i])) all = false;
+        }
+        for (uint8_t i = 0; i < AXIS_E; i++) {
+            if (all || gcode_seen(cmd, axis_letters[i])) enc->pos[i] = 0;
+        }
+        return;
+    }
+    case 90: enc->relative = enc->relative_e = false; return;
+    case 91: enc->relative = enc->relative_e = true; return;
+    case 92:
+        for (uint8_t i = 0; i < NUM_AXIS; i++) {
+            if (gcode_param(cmd, axis_letters[i], &value)) {
+                enc->pos[i] = value * enc->units;
+            }
+        }
+        return;
+    case 0: case 1: case 2: case 3:
+        break;
+    default:
+        return;
+    }
+    hdr->moves++;
+    for (uint8_t i = 0; i < NUM_AXIS; i++) {
+        target[i] = enc->pos[i];
+        if (!gcode_param(cmd, axis_letters[i], &value)) continue;
+        value *= enc->units;
+        bool relative = i == AXIS_E ? enc->relative_e : enc->relative;
+        target[i] = relative ? target[i] + value : value;
+    }
+    float de = target[AXIS_E] - enc->pos[AXIS_E];
+    if (de > 0) {
+        // extent by end points only: arcs may bulge out a little
+        hdr->filament += de;
+        for (uint8_t i = 0; i < 3; i++) {
+            float lo = MIN(enc->pos[i], target[i]);
+            float hi = MAX(enc->pos[i], target[i]);
+            if (!hdr->layers || lo < hdr->min[i]) hdr->min[i] = lo;
+            if (!hdr->layers || hi > hdr->max[i]) hdr->max[i] = hi;
+        }
+        if (!hdr->layers || target[AXIS_Z] > enc->layer_z + 1e-4f) {
+            enc->layer_z = target[AXIS_Z];
+            hdr->layers++;
+        }
+    }
+    memcpy(enc->pos, target, sizeof(target));
+}
+
+static void encode_cmd(const gcode_cmd_t *cmd, void *arg) {
+    gcb_encoder_t *enc = (gcb_encoder_t *)arg;
+    gcb_header_t *hdr = &enc->header;
+    if (!cmd->letter) {
+        if (cmd->nparam) hdr->dropped++;    // parameters without command
+        return;
+    }
+    if (enc->error) return;
+    track(enc, cmd);
+
+    // parameters in letter order, duplicated letters are dropped
+    gcode_param_t params[GCODE_MAX_PARAMS];
+    uint8_t num = 0;
+    for (uint8_t i = 0; i < cmd->nparam; i++) {
+        gcode_param_t param = cmd->params[i];
+        uint8_t j = num++;
+        for (; j && params[j - 1].letter > param.letter; j--) {
+            params[j] = params[j - 1];
+        }
+        params[j] = param;
+    }
+    int32_t values[GCODE_MAX_PARAMS];
+    uint32_t mask = 0;
+    uint8_t n = 0;
+    if (cmd->flags & GCODE_OVERFLOW) hdr->dropped++;
+    for (uint8_t i = 0; i < num; i++) {
+        uint32_t bit = 1UL << (params[i].letter - 'A');
+        double value = (double)params[i].value * GCB_SCALE;
+        if (mask & bit || fabs(value) > INT32_MAX) {
+            hdr->dropped++;
+            continue;
+        }
+        mask |= bit;
+        values[n++] = params[i].bare ? GCB_BARE : lround(value);
+    }
+
+    gcb_record_t rec;
+    rec.letter = cmd->letter;
+    rec.subcode = cmd->subcode;
+    rec.code = cmd->code;
+    rec.mask = mask;
+    uint8_t total = gcb_records(&rec);
+    if (enc->num + total > GCB_BUFFER && !flush(enc)) return;
+    // header values and continuation records are contiguous words
+    int32_t *words = (int32_t *)(enc->buf + enc->num);
+    memset(words, 0, total * sizeof(gcb_record_t));
+    memcpy(words, &rec, offsetof(gcb_record_t, value));
+    memcpy(rec_values(words), values, n * sizeof(int32_t));
+    enc->num += total;
+    hdr->records += total;
+    hdr->commands++;
+}
+
+bool gcb_encode_init(gcb_encoder_t *enc, gcb_write_t write, void *arg) {
+    memset(enc, 0, sizeof(gcb_encoder_t));
+    gcode_parser_init(&enc->parser);
+    memcpy(enc->header.magic, GCB_MAGIC, sizeof(enc->header.magic));
+    enc->header.header_size = sizeof(gcb_header_t);
+    enc->header.record_size = sizeof(gcb_record_t);
+    enc->header.scale = GCB_SCALE;
+    enc->units = 1;
+    enc->write = write;
+    enc->arg = arg;
+    // placeholder, rewritten by caller when statistics are complete
+    if (write(&enc->header, sizeof(gcb_header_t), arg) != sizeof(gcb_header_t))
+        enc->error = true;
+    return !enc->error;
+}
+
+bool gcb_encode(gcb_encoder_t *enc, const char *buf, size_t len) {
+    if (enc->error) return false;
+    enc->header.text_bytes += len;
+    gcode_parse(&enc->parser, buf, len, encode_cmd, enc);
+    return !enc->error;
+}
+
+bool gcb_encode_end(gcb_encoder_t *enc) {
+    gcode_parse_end(&enc->parser, encode_cmd, enc);
+    enc->header.lines = enc->parser.lines;
+    return flush(enc);
+}
+
+bool gcb_check(const gcb_header_t *header) {
+    return !memcmp(header->magic, GCB_MAGIC, sizeof(header->magic))
+        && header->header_size == sizeof(gcb_header_t)
+        && header->record_size == sizeof(gcb_record_t)
+        && header->scale == GCB_SCALE;
+}
+
+uint8_t gcb_records(const gcb_record_t *record) {
+    uint8_t n = __builtin_popcount(record->mask);
+    if (n <= GCB_HEAD_VALUES) return 1;
+    return 1 + (n - GCB_HEAD_VALUES + GCB_MORE_VALUES - 1) / GCB_MORE_VALUES;
+}
+
+uint8_t gcb_decode(const gcb_record_t *record, size_t num, gcode_cmd_t *cmd) {
+    const float scale = 1.0f / GCB_SCALE;
+    uint8_t total = gcb_records(record);
+    if (!num || total > num) return 0;
+    const int32_t *values = rec_values((void *)record);
+    uint32_t mask = record->mask;
+    cmd->line = -1;
+    cmd->code = record->code;
+    cmd->subcode = record->subcode;
+    cmd->letter = record->letter;
+    cmd->checksum = 0;
+    cmd->flags = 0;
+    cmd->nparam = 0;
+    while (mask && cmd->nparam < GCODE_MAX_PARAMS) {
+        gcode_param_t *param = cmd->params + cmd->nparam;
+        param->letter = 'A' + __builtin_ctz(mask);
+        param->bare = values[cmd->nparam] == GCB_BARE;
+        param->value = param->bare ? 0 : values[cmd->nparam] * scale;
+        cmd->nparam++;
+        mask &= mask - 1;
+    }
+    return total;
+}
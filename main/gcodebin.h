@@ -0,0 +1,98 @@
+/*
+ * File: gcodebin.h
+ * Authors: Hank <hankso1106@gmail.com>
+ * Create: 2026-10-17 19:48:51
+ *
+ * Precompiled (binary) G-code. Text uploaded by HTTP is tokenized once and
+ * stored as fixed-width records, so printing reads 20 bytes per command in
+ * most cases and needs no text parsing: the print job (job.h) unpacks
+ * records into `gcode_cmd_t` and queues them like parsed lines.
+ *
+ * File layout:
+ *      gcb_header_t                68 bytes, statistics of the whole file
+ *      gcb_record_t[records]       20 bytes each
+ *
+ * Parameter values are quantized to 1 / GCB_SCALE (0.1um for coordinates)
+ * and stored in ascending letter order, `mask` tells which letters are
+ * present, bare letters (e.g. `G28 X`) store GCB_BARE. A record holds
+ * GCB_HEAD_VALUES values (enough for `G1 X Y E`), more values continue in
+ * the following records as plain int32_t[5], see `gcb_records`. Line
+ * numbers, checksums, comments and text arguments are dropped. Values out of
+ * range are counted in header `dropped`.
+ *
+ * Example (streaming conversion):
+ *      gcb_encoder_t enc;
+ *      gcb_encode_init(&enc, write_cb, &file);    // writes empty header
+ *      gcb_encode(&enc, buf, len);                 // for each chunk
+ *      gcb_encode_end(&enc);                       // flush records
+ *      file.seek(0); file.write(&enc.header, sizeof(enc.header));
+ */
+
+#ifndef _GCODEBIN_H_
+#define _GCODEBIN_H_
+
+#include "gcode.h"
+#include "planner.h"
+
+#define GCB_MAGIC           "GCB1"
+#define GCB_SCALE           10000       // 0.1um, +-214m
+#define GCB_BARE            INT32_MIN   // letter without value
+#define GCB_HEAD_VALUES     3
+#define GCB_MORE_VALUES     5           // values in a continuation record
+#define GCB_BUFFER          32          // records per write (640 bytes)
+
+typedef struct {
+    char magic[4];              // GCB_MAGIC
+    uint16_t header_size;       // sizeof(gcb_header_t)
+    uint16_t record_size;       // sizeof(gcb_record_t)
+    uint32_t scale;             // GCB_SCALE
+    uint32_t records;           // number of records following the header
+    uint32_t commands;          // number of commands in the records
+    uint32_t moves;             // G0/G1/G2/G3 records
+    uint32_t lines;             // source text lines
+    uint32_t text_bytes;        // source text size
+    uint32_t dropped;           // parameters or lines that were not encoded
+    uint32_t layers;            // Z levels where extrusion happens
+    float filament;             // mm of E extruded (retractions excluded)
+    float min[3], max[3];       // XYZ extent of extruding moves (mm)
+} gcb_header_t;
+
+typedef struct {
+    char letter;                // 'G' | 'M' | 'T'
+    uint8_t subcode;
+    uint16_t code;
+    uint32_t mask;              // bit (letter - 'A') of each parameter
+    int32_t value[GCB_HEAD_VALUES]; // quantized values in letter order
+} gcb_record_t;
+
+// Return bytes written. A short write stops the encoder.
+typedef size_t (*gcb_write_t)(const void *buf, size_t len, void *arg);
+
+typedef struct {
+    gcode_parser_t parser;
+    gcb_header_t header;
+    gcb_record_t buf[GCB_BUFFER];
+    uint8_t num;                // records buffered
+    float pos[NUM_AXIS];        // tracked for statistics (mm)
+    float units, layer_z;
+    bool relative, relative_e;
+    bool error;                 // write failed
+    gcb_write_t write;
+    void *arg;
+} gcb_encoder_t;
+
+bool gcb_encode_init(gcb_encoder_t *enc, gcb_write_t write, void *arg);
+bool gcb_encode(gcb_encoder_t *enc, const char *buf, size_t len);
+bool gcb_encode_end(gcb_encoder_t *enc);   // `header` is final after this
+
+bool gcb_check(const gcb_header_t *header);
+
+// Number of records (including continuation) of the command at `record`.
+uint8_t gcb_records(const gcb_record_t *record);
+
+/* Unpack the command starting at `record` from `num` available records.
+ * Return records consumed, or 0 if the command continues beyond `num`.
+ */
+uint8_t gcb_decode(const gcb_record_t *record, size_t num, gcode_cmd_t *cmd);
+
+#endif // _GCODEBIN_H_
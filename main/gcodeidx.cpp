@@ -0,0 +1,218 @@
+/*
+ * File: gcodeidx.cpp
+ * Authors: Hank <hankso1106@gmail.com>
+ * Create: 2026-10-17 20:31:05
+ */
+
+#include "gcodeidx.h"
+
+#include "sys/param.h"
+
+#define GIDX_Z_EPSILON      1e-4f
+
+static const char axis_letters[NUM_AXIS] = { 'X', 'Y', 'Z', 'E' };
+static const float frac_scale[] = {
+    1, 1e-1, 1e-2, 1e-3, 1e-4, 1e-5, 1e-6, 1e-7, 1e-8, 1e-9
+};
+
+static bool flush(gidx_builder_t *idx) {
+    size_t len = idx->num * sizeof(gidx_entry_t);
+    if (!idx->num || idx->error) return !idx->error;
+    if (idx->write(idx->buf, len, idx->arg) != len) idx->error = true;
+    idx->num = 0;
+    return !idx->error;
+}
+
+// Parse a decimal number without exponent. Return end of number.
+static const char * number(const char *s, float *value) {
+    bool neg = *s == '-';
+    uint32_t ival = 0, fval = 0;
+    uint8_t fdig = 0;
+    if (*s == '-' || *s == '+') s++;
+    for (; *s >= '0' && *s <= '9'; s++) ival = ival * 10 + (*s - '0');
+    if (*s == '.') {
+        for (s++; *s >= '0' && *s <= '9'; s++) {
+            if (fdig < 9) fval = fval * 10 + (*s - '0'), fdig++;
+        }
+    }
+    *value = ival + fval * frac_scale[fdig];
+    if (neg) *value = -*value;
+    return s;
+}
+
+static void add_layer(gidx_builder_t *idx, const gidx_entry_t *entry) {
+    gidx_entry_t *dst = idx->buf + idx->num;
+    *dst = idx->has_pending ? idx->pending : *entry;
+    dst->z = idx->state.pos[AXIS_Z];
+    idx->header.height = dst->z;
+    idx->header.layers++;
+    if (++idx->num == GIDX_BUFFER) flush(idx);
+}
+
+static void process(gidx_builder_t *idx) {
+    gidx_entry_t *st = &idx->state;
+    const char *s = idx->line;
+    char letter = 0;
+    float code = 0, value;
+    idx->line[idx->len] = '\0';
+
+    // command word, optionally after line number
+    while (*s) {
+        char raw = *s++, c = raw & ~0x20;   // upper case
+        if (raw == ' ' || raw == '\t' || raw == '\r') continue;
+        if (c == 'N') {
+            s = number(s, &value);
+        } else if (c == 'G' || c == 'M') {
+            letter = c;
+            s = number(s, &code);
+            break;
+        } else {
+            return;
+        }
+    }
+    uint16_t cmd = code;
+    if (letter == 'M') {
+        if (cmd == 82) st->flags &= ~GIDX_RELATIVE_E;
+        if (cmd == 83) st->flags |= GIDX_RELATIVE_E;
+        return;
+    }
+    if (letter != 'G') return;
+    switch (cmd) {
+    case 20: st->flags |= GIDX_INCH; return;
+    case 21: st->flags &= ~GIDX_INCH; return;
+    case 90: st->flags &= ~(GIDX_RELATIVE | GIDX_RELATIVE_E); return;
+    case 91: st->flags |= GIDX_RELATIVE | GIDX_RELATIVE_E; return;
+    case 0: case 1: case 2: case 3: case 28: case 92:
+        break;
+    default:
+        return;
+    }
+
+    gidx_entry_t before = *st;
+    bool has[NUM_AXIS] = { false }, extrude = false;
+    float values[NUM_AXIS];
+    while (*s && *s != ';' && *s != '(' && *s != '*') {
+        char c = *s++ & ~0x20;
+        if (c < 'A' || c > 'Z') continue;
+        s = number(s, &value);
+        if (c == 'F') st->feedrate = value;
+        for (uint8_t i = 0; i < NUM_AXIS; i++) {
+            if (c == axis_letters[i]) has[i] = true, values[i] = value;
+        }
+    }
+    if (cmd == 28) {                    // home given axes or XYZ
+        bool all = !has[AXIS_X] && !has[AXIS_Y] && !has[AXIS_Z];
+        for (uint8_t i = 0; i < AXIS_E; i++) {
+            if (all || has[i]) st->pos[i] = 0;
+        }
+    } else if (cmd == 92) {
+        for (uint8_t i = 0; i < NUM_AXIS; i++) {
+            if (has[i]) st->pos[i] = values[i];
+        }
+    } else {
+        for (uint8_t i = 0; i < NUM_AXIS; i++) {
+            if (!has[i]) continue;
+            uint8_t rel = i == AXIS_E ? GIDX_RELATIVE_E : GIDX_RELATIVE;
+            float target = st->flags & rel ? st->pos[i] + values[i] : values[i];
+            if (i == AXIS_E) {
+                extrude = target > st->pos[i] &&
+                          (has[AXIS_X] || has[AXIS_Y] || cmd >= 2);
+            }
+            st->pos[i] = target;
+        }
+    }
+    if (st->pos[AXIS_Z] != before.pos[AXIS_Z] && !idx->has_pending) {
+        idx->pending = before;
+        idx->has_pending = true;
+    }
+    if (!extrude) return;
+    if (!idx->header.layers ||
+        st->pos[AXIS_Z] > idx->header.height + GIDX_Z_EPSILON) {
+        add_layer(idx, &before);
+    }
+    idx->has_pending = false;
+}
+
+bool gidx_init(gidx_builder_t *idx, gidx_write_t write, void *arg) {
+    memset(idx, 0, sizeof(gidx_builder_t));
+    memcpy(idx->header.magic, GIDX_MAGIC, sizeof(idx->header.magic));
+    idx->header.header_size = sizeof(gidx_header_t);
+    idx->header.entry_size = sizeof(gidx_entry_t);
+    idx->write = write;
+    idx->arg = arg;
+    // placeholder, rewritten by caller when statistics are complete
+    if (write(&idx->header, sizeof(gidx_header_t), arg) != sizeof(gidx_header_t))
+        idx->error = true;
+    return !idx->error;
+}
+
+bool gidx_feed(gidx_builder_t *idx, const char *buf, size_t len) {
+    const char *p = buf, *end = buf + len;
+    if (idx->error) return false;
+    while (p < end) {
+        if (!idx->len && !idx->skip) {  // line start: only G/M/N or blank
+            char c = *p & ~0x20;
+            idx->skip = c != 'G' && c != 'M' && c != 'N' &&
+                        *p != ' ' && *p != '\t';
+        }
+        const char *nl = (const char *)memchr(p, '\n', end - p);
+        const char *eol = nl ? nl : end;
+        if (!idx->skip && idx->len < GIDX_LINE) {
+            size_t n = MIN((size_t)(eol - p), (size_t)(GIDX_LINE - idx->len));
+            memcpy(idx->line + idx->len, p, n);
+            idx->len += n;
+        }
+        if (!nl) break;
+        if (!idx->skip) process(idx);
+        idx->len = 0;
+        idx->skip = false;
+        idx->state.line++;
+        idx->state.offset = idx->header.bytes + (nl + 1 - buf);
+        p = nl + 1;
+    }
+    idx->header.bytes += len;
+    return !idx->error;
+}
+
+bool gidx_end(gidx_builder_t *idx) {
+    if (idx->len && !idx->skip) process(idx);
+    idx->header.lines = idx->state.line;
+    if (idx->header.bytes > idx->state.offset) idx->header.lines++;
+    return flush(idx);
+}
+
+bool gidx_check(const gidx_header_t *header) {
+    return !memcmp(header->magic, GIDX_MAGIC, sizeof(header->magic))
+        && header->header_size == sizeof(gidx_header_t)
+        && header->entry_size == sizeof(gidx_entry_t);
+}
+
+bool gidx_layer(gidx_read_t read, void *arg, const gidx_header_t *header,
+                uint32_t layer, gidx_entry_t *entry) {
+    if (layer >= header->layers) return false;
+    size_t offset = header->header_size + layer * header->entry_size;
+    return read(entry, sizeof(gidx_entry_t), offset, arg) == sizeof(*entry);
+}
+
+int32_t gidx_find_z(gidx_read_t read, void *arg, const gidx_header_t *header,
+                    float z, gidx_entry_t *entry) {
+    uint32_t lo = 0, hi = header->layers;   // first entry with Z >= z
+    while (lo < hi) {
+        uint32_t mid = (lo + hi) / 2;
+        if (!gidx_layer(read, arg, header, mid, entry)) return -1;
+        if (entry->z < z - GIDX_Z_EPSILON) lo = mid + 1; else hi = mid;
+    }
+    return gidx_layer(read, arg, header, lo, entry) ? lo : -1;
+}
+
+int32_t gidx_find_offset(gidx_read_t read, void *arg,
+                         const gidx_header_t *header, uint32_t offset,
+                         gidx_entry_t *entry) {
+    uint32_t lo = 0, hi = header->layers;   // first entry after offset
+    while (lo < hi) {
+        uint32_t mid = (lo + hi) / 2;
+        if (!gidx_layer(read, arg, header, mid, entry)) return -1;
+        if (entry->offset <= offset) lo = mid + 1; else hi = mid;
+    }
+    return lo && gidx_layer(read, arg, header, lo - 1, entry) ? lo - 1 : -1;
+}
@@ -0,0 +1,107 @@
+/*
+ * File: gcodeidx.h
+ * Authors: Hank <hankso1106@gmail.com>
+ * Create: 2026-10-17 20:31:05
+ *
+ * Layer index of a G-code text file, built while the file streams in (e.g.
+ * by onUpload) and stored as a sidecar, so that resuming, starting from a
+ * layer and progress reporting can seek into the file directly instead of
+ * scanning it again.
+ *
+ * File layout:
+ *      gidx_header_t               24 bytes
+ *      gidx_entry_t[layers]        32 bytes each, ascending Z and offset
+ *
+ * A layer is a Z level where extrusion happens (same as gcodebin.h). Its
+ * entry points at the first Z move after the last extrusion of the previous
+ * layer, so a layer change with Z hop and travel is replayed as a whole.
+ * The entry saves modal state before that line: position, feedrate and
+ * G91/M83/G20 flags, everything needed to resume there.
+ *
+ * The scanner does not tokenize every line: lines are split by memchr, lines
+ * not starting with G/M/N are skipped and only the first GIDX_LINE bytes of
+ * the others are parsed, so it runs about twice as fast as the tokenizer.
+ *
+ * Example (streaming):
+ *      gidx_builder_t idx;
+ *      gidx_init(&idx, write_cb, &file);       // writes empty header
+ *      gidx_feed(&idx, buf, len);              // for each chunk
+ *      gidx_end(&idx);                         // flush entries
+ *      file.seek(0); file.write(&idx.header, sizeof(idx.header));
+ */
+
+#ifndef _GCODEIDX_H_
+#define _GCODEIDX_H_
+
+#include "globals.h"
+#include "planner.h"
+
+#define GIDX_MAGIC          "GIX1"
+#define GIDX_LINE           64          // bytes of a line to parse
+#define GIDX_BUFFER         16          // entries per write (512 bytes)
+
+#define GIDX_RELATIVE       (1 << 0)    // G91
+#define GIDX_RELATIVE_E     (1 << 1)    // M83
+#define GIDX_INCH           (1 << 2)    // G20
+
+typedef struct {
+    char magic[4];              // GIDX_MAGIC
+    uint16_t header_size;       // sizeof(gidx_header_t)
+    uint16_t entry_size;        // sizeof(gidx_entry_t)
+    uint32_t layers;            // number of entries
+    uint32_t lines;             // source text lines
+    uint32_t bytes;             // source text size
+    float height;               // Z of the last layer
+} gidx_header_t;
+
+typedef struct {
+    uint32_t offset;            // byte offset of the line in G-code file
+    uint32_t line;              // zero based line number
+    float pos[NUM_AXIS];        // XYZE before the line (file units)
+    float feedrate;             // last F word (file units/min)
+    float z;                    // Z where extrusion of this layer happens
+    uint8_t flags;              // GIDX_XXX modal states
+    uint8_t reserved[3];
+} gidx_entry_t;
+
+// Return bytes written. A short write stops the builder.
+typedef size_t (*gidx_write_t)(const void *buf, size_t len, void *arg);
+
+// Read `len` bytes at `offset` of the index file. Return bytes read.
+typedef size_t (*gidx_read_t)(void *buf, size_t len, size_t offset, void *arg);
+
+typedef struct {
+    gidx_header_t header;
+    gidx_entry_t buf[GIDX_BUFFER];
+    uint8_t num;                // entries buffered
+    gidx_entry_t state;         // modal state at start of current line
+    gidx_entry_t pending;       // first Z move since last extrusion
+    bool has_pending;
+    bool error;                 // write failed
+    char line[GIDX_LINE + 1];   // beginning of current line
+    uint8_t len;
+    bool skip;                  // current line is not interesting
+    gidx_write_t write;
+    void *arg;
+} gidx_builder_t;
+
+bool gidx_init(gidx_builder_t *idx, gidx_write_t write, void *arg);
+bool gidx_feed(gidx_builder_t *idx, const char *buf, size_t len);
+bool gidx_end(gidx_builder_t *idx);     // `header` is final after this
+
+bool gidx_check(const gidx_header_t *header);
+
+// Read entry of `layer` (zero based). Return false if out of range.
+bool gidx_layer(gidx_read_t read, void *arg, const gidx_header_t *header,
+                uint32_t layer, gidx_entry_t *entry);
+
+// First layer at or above `z`. Return layer number or -1 if none.
+int32_t gidx_find_z(gidx_read_t read, void *arg, const gidx_header_t *header,
+                    float z, gidx_entry_t *entry);
+
+// Layer containing byte `offset`. Return layer number or -1 if before first.
+int32_t gidx_find_offset(gidx_read_t read, void *arg,
+                         const gidx_header_t *header, uint32_t offset,
+                         gidx_entry_t *entry);
+
+#endif // _GCODEIDX_H_
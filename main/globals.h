@@ -31,6 +31,12 @@
 #define CONFIG_GPIO_HSPI_CS0 15
 #define CONFIG_GPIO_HSPI_CS1 22
 
+// thermistors on ADC1 channels: bed GPIO36, nozzle 1-3 GPIO39, 34, 33
+#define CONFIG_ADC_TEMP_BED 0
+#define CONFIG_ADC_TEMP_NOZ1 3
+#define CONFIG_ADC_TEMP_NOZ2 6
+#define CONFIG_ADC_TEMP_NOZ3 5
+
 #define CONFIG_RMT_CHANNEL 0
 #define CONFIG_LED_NUM  20
 #define CONFIG_I2C_NUM  0
@@ -43,6 +49,9 @@
 #endif
 
 // make it compatiable with Arduino
+#if !defined(BIT) && !defined(__XTENSA__)   // host builds (tools/bench)
+#define BIT(nr)             (1UL << (nr))
+#endif
 #ifndef bitRead
 #define bitRead(v, b)       ((v) & BIT(b))
 #define bitSet(v, b)        ((v) |= BIT(b))
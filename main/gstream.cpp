@@ -0,0 +1,157 @@
+/*
+ * File: gstream.cpp
+ * Authors: Hank <hankso1106@gmail.com>
+ * Create: 2026-10-18 09:12:47
+ */
+
+#include "gstream.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+enum {
+    ST_IDLE,
+    ST_HEAD,                    // reading header line
+    ST_BODY,                    // queuing lines
+    ST_DROP,                    // a line was not queued: drop the rest
+    ST_SKIP,                    // message does not start at `acked`
+    ST_BUSY,                    // stream is owned by another client
+    ST_NONE,                    // no stream to continue
+    ST_BAD,                     // invalid header
+};
+
+void gstream_init(gstream_t *gs, const gstream_sink_t *sink) {
+    memset(gs, 0, sizeof(gstream_t));
+    gs->sink = *sink;
+    gs->owner = gs->client = GSTREAM_NONE;
+    gcode_parser_init(&gs->parser);
+}
+
+bool gstream_is_message(const char *data, size_t len) {
+    size_t hlen = strlen(GSTREAM_HEADER);
+    return len >= hlen && !memcmp(data, GSTREAM_HEADER, hlen);
+}
+
+void gstream_begin(gstream_t *gs, uint32_t client) {
+    gs->client = client;
+    gs->state = ST_HEAD;
+    gs->hlen = 0;
+    gs->last = '\n';
+    gs->stats.messages++;
+}
+
+static uint32_t credit_limit(gstream_t *gs) {
+    return gs->acked + gs->sink.space(gs->sink.arg);
+}
+
+static void reject(gstream_t *gs) {
+    gs->acked = gs->parser.lines - 1;   // callback is at end of the line
+    gs->state = ST_DROP;
+}
+
+static void on_line(const gcode_cmd_t *cmd, void *arg) {
+    gstream_t *gs = (gstream_t *)arg;
+    if (gs->state != ST_BODY) return;
+    if (cmd->flags & GCODE_BAD_CSUM) {
+        gs->stats.errors++;
+        reject(gs);
+    } else if (!gs->sink.push(cmd, gs->sink.arg)) {
+        gs->stats.rejected++;
+        reject(gs);
+    } else {
+        gs->stats.commands++;
+    }
+}
+
+static void parse_head(gstream_t *gs) {
+    char *end;
+    gs->head[gs->hlen] = '\0';
+    if (!gstream_is_message(gs->head, gs->hlen)) {
+        gs->state = ST_BAD;
+        return;
+    }
+    const char *str = gs->head + strlen(GSTREAM_HEADER);
+    uint32_t seq = gs->seq = strtoul(str, &end, 10);
+    if (end == str) {
+        gs->state = ST_BAD;
+    } else if (seq && gs->owner == GSTREAM_NONE) {
+        gs->state = ST_NONE;
+    } else if (gs->owner != gs->client && gs->owner != GSTREAM_NONE) {
+        gs->state = ST_BUSY;
+    } else if (seq && seq != gs->acked) {
+        gs->stats.skipped++;
+        gs->state = ST_SKIP;
+    } else {
+        if (!seq) {                     // open a new stream
+            gs->owner = gs->client;
+            gs->acked = gs->limit = 0;
+        }
+        gcode_parser_init(&gs->parser);
+        gs->parser.lines = seq;
+        gs->state = ST_BODY;
+    }
+}
+
+void gstream_feed(gstream_t *gs, const char *data, size_t len) {
+    while (len && gs->state == ST_HEAD) {
+        char c = *data++; len--;
+        if (c == '\n') {
+            parse_head(gs);
+        } else if (gs->hlen < GSTREAM_HEAD_LEN) {
+            gs->head[gs->hlen++] = c;
+        } else {
+            gs->state = ST_BAD;
+        }
+    }
+    if (!len || (gs->state != ST_BODY && gs->state != ST_DROP)) return;
+    gcode_parse(&gs->parser, data, len, on_line, gs);
+    gs->last = data[len - 1];
+}
+
+int gstream_end(gstream_t *gs, char *buf, size_t len) {
+    if (gs->state == ST_HEAD) parse_head(gs);   // header only: query credit
+    uint8_t state = gs->state;
+    if (state == ST_BODY || state == ST_DROP) {
+        if (gs->last != '\n') gcode_parse(&gs->parser, "\n", 1, on_line, gs);
+        if (gs->state == ST_BODY) gs->acked = gs->parser.lines;
+        gs->stats.lines += gs->acked - gs->seq;
+        gs->stats.dropped += gs->parser.lines - gs->acked;
+    }
+    gs->state = ST_IDLE;
+    gs->client = GSTREAM_NONE;
+    switch (state) {
+    case ST_BUSY: return snprintf(buf, len, "error stream busy");
+    case ST_NONE: return snprintf(buf, len, "error no stream");
+    case ST_BAD:  return snprintf(buf, len, "error bad header");
+    default:;
+    }
+    gs->limit = credit_limit(gs);
+    gs->idle = 0;
+    return snprintf(buf, len, "ack %u %u %u", (unsigned)gs->seq,
+                    (unsigned)gs->acked, (unsigned)gs->limit);
+}
+
+bool gstream_poll(gstream_t *gs, char *buf, size_t len) {
+    if (gs->owner == GSTREAM_NONE || gs->client != GSTREAM_NONE) return false;
+    uint32_t limit = credit_limit(gs);
+    if ((int32_t)(limit - gs->limit) <= 0) {
+        gs->idle = 0;
+        return false;
+    }
+    if (limit - gs->limit < GSTREAM_CREDIT_STEP &&
+        ++gs->idle < GSTREAM_CREDIT_IDLE) return false;
+    gs->limit = limit;
+    gs->idle = 0;
+    gs->stats.credits++;
+    snprintf(buf, len, "credit %u %u", (unsigned)gs->acked, (unsigned)limit);
+    return true;
+}
+
+void gstream_close(gstream_t *gs, uint32_t client) {
+    if (gs->client == client) {
+        gs->state = ST_IDLE;
+        gs->client = GSTREAM_NONE;
+    }
+    if (gs->owner == client) gs->owner = GSTREAM_NONE;
+}
@@ -0,0 +1,97 @@
+/*
+ * File: gstream.h
+ * Authors: Hank <hankso1106@gmail.com>
+ * Create: 2026-10-18 09:12:47
+ *
+ * Credit based G-code streaming. Instead of one line per round trip, the
+ * printer advertises how many lines it can take (free slots of the command
+ * buffer) and the client keeps sending until that limit, so many lines are in
+ * flight at once. Lines are numbered from 0 since the stream was opened.
+ *
+ * Client -> printer, text message of whole lines (last newline optional):
+ *      gcode <seq>\n           seq: number of the first line in this message
+ *      <line>\n                seq 0 opens a new stream
+ *      ...                     header alone queries the credit
+ *
+ * Printer -> client:
+ *      ack <seq> <acked> <limit>   reply of the message starting at `seq`
+ *      credit <acked> <limit>      pushed when the limit has grown
+ *      error <reason>              stream busy | no stream | bad header
+ *
+ * `acked` lines were accepted, the client may send lines below `limit`.
+ * When a line can not be queued (buffer taken by other producers, bad
+ * checksum) the rest of the message is dropped, and following messages are
+ * skipped until one starts at `acked` again (go-back-N): if a reply has
+ * seq <= acked < seq + lines of that message, resend from `acked`; replies
+ * of skipped messages have seq > acked and are ignored.
+ *
+ * The module does not know the transport nor the command buffer, see `sink`.
+ * Messages may arrive in pieces of any size (gstream_feed), lines are parsed
+ * in place (gcode.h), nothing is buffered.
+ */
+
+#ifndef _GSTREAM_H_
+#define _GSTREAM_H_
+
+#include "gcode.h"
+
+#define GSTREAM_NONE        UINT32_MAX  // no client
+#define GSTREAM_HEADER      "gcode "
+#define GSTREAM_HEAD_LEN    20          // max length of the header line
+#define GSTREAM_POLL_MS     2           // period of gstream_poll
+#define GSTREAM_CREDIT_STEP 4           // push credit when limit grows this
+#define GSTREAM_CREDIT_IDLE 5           // or grows at all for this many polls
+
+typedef struct {
+    // Queue one command without blocking. Return false if buffer is full.
+    bool (*push)(const gcode_cmd_t *cmd, void *arg);
+    uint32_t (*space)(void *arg);       // free slots of the command buffer
+    void *arg;
+} gstream_sink_t;
+
+typedef struct {
+    uint32_t messages;
+    uint32_t lines;             // lines accepted
+    uint32_t commands;          // commands queued
+    uint32_t dropped;           // lines dropped after a rejected one
+    uint32_t rejected;          // lines not queued: buffer full
+    uint32_t errors;            // lines not queued: bad checksum
+    uint32_t skipped;           // messages not starting at `acked`
+    uint32_t credits;           // credit messages pushed
+} gstream_stats_t;
+
+typedef struct {
+    gstream_sink_t sink;
+    gcode_parser_t parser;      // parser.lines counts the stream
+    uint32_t owner;             // client of the stream
+    uint32_t client;            // client of the message being fed
+    uint32_t seq;               // first line of the message being fed
+    uint32_t acked;             // lines accepted
+    uint32_t limit;             // last advertised limit
+    uint8_t state;              // of the message being fed
+    uint8_t idle;               // polls since the limit started growing
+    char last;                  // last byte fed
+    char head[GSTREAM_HEAD_LEN + 1];
+    uint8_t hlen;
+    gstream_stats_t stats;
+} gstream_t;
+
+void gstream_init(gstream_t *gs, const gstream_sink_t *sink);
+
+// Whether a message starting with these bytes is a stream message
+bool gstream_is_message(const char *data, size_t len);
+
+void gstream_begin(gstream_t *gs, uint32_t client);
+void gstream_feed(gstream_t *gs, const char *data, size_t len);
+
+// Finish the message. Write the reply into `buf`, return its length.
+int gstream_end(gstream_t *gs, char *buf, size_t len);
+
+/* Call periodically while the command buffer drains. Return true and write
+ * a `credit` message into `buf` if it should be sent to `gs->owner`.
+ */
+bool gstream_poll(gstream_t *gs, char *buf, size_t len);
+
+void gstream_close(gstream_t *gs, uint32_t client);  // client disconnected
+
+#endif // _GSTREAM_H_
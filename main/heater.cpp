@@ -0,0 +1,223 @@
+/*
+ * File: heater.cpp
+ * Authors: Hank <hankso1106@gmail.com>
+ * Create: 2026-10-18 13:40:07
+ */
+
+#include "heater.h"
+
+#include <math.h>
+
+#define TUNE_OVERSHOOT      20          // degC above target to give up
+#define TUNE_TIMEOUT        1200        // seconds without a relay switch
+#define TUNE_HYSTERESIS     0.5f        // degC, keeps noise from chattering
+
+static float clampf(float v, float lo, float hi) {
+    return v < lo ? lo : v > hi ? hi : v;
+}
+
+void heater_init(heater_t *h, const pid_param_t *pid, uint16_t window,
+                 const guard_param_t *guard) {
+    memset(h, 0, sizeof(heater_t));
+    h->pid = *pid;
+    h->max_duty = 1;
+    h->temp = NAN;
+    h->window = window ? window : 1;
+    h->guard.param = *guard;
+}
+
+// Return the fault found with this reading, FAULT_NONE if there is none
+static heater_fault_t guard_update(heater_t *h, float temp, float dt) {
+    heater_guard_t *g = &h->guard;
+    const guard_param_t *p = &g->param;
+    float target = h->tune.state == TUNE_RUNNING ? h->tune.target : h->target;
+    if (isnan(temp)) {
+        if (g->invalid < GUARD_SENSOR_SAMPLES) g->invalid++;
+        if (target > 0 && g->invalid >= GUARD_SENSOR_SAMPLES)
+            return FAULT_SENSOR;
+        return FAULT_NONE;
+    }
+    g->invalid = 0;
+    if (temp > p->max_temp) return FAULT_OVERHEAT;
+    if (target <= 0) {
+        g->state = GUARD_IDLE;
+        g->target = 0;
+        return FAULT_NONE;
+    }
+    float band = target - p->hold_band;
+    if (target != g->target) {
+        g->target = target;
+        g->state = temp < band ? GUARD_HEATING : GUARD_HOLD;
+        g->ref = temp;
+        g->timer = 0;
+        return FAULT_NONE;
+    }
+    g->timer += dt;
+    if (g->state == GUARD_HEATING) {
+        if (temp >= band) {
+            g->state = GUARD_HOLD;
+            g->timer = 0;
+        } else if (g->timer >= p->heat_period) {
+            if (temp < g->ref + p->heat_rise) return FAULT_HEATING;
+            g->ref = temp;
+            g->timer = 0;
+        }
+    } else if (temp >= band) {
+        g->timer = 0;
+    } else if (g->timer >= p->hold_period) {
+        return FAULT_RUNAWAY;
+    }
+    return FAULT_NONE;
+}
+
+static float tune_update(heater_t *h, float temp, float dt) {
+    heater_tune_t *t = &h->tune;
+    float max = h->max_duty;
+    t->time += dt;
+    if (temp > t->tmax) t->tmax = temp;
+    if (temp < t->tmin) t->tmin = temp;
+    if (temp > t->target + TUNE_OVERSHOOT ||
+        t->time - fmaxf(t->t_high, t->t_low) > TUNE_TIMEOUT) {
+        t->state = TUNE_FAILED;
+        return 0;
+    }
+    if (t->heating && temp > t->target + TUNE_HYSTERESIS) {
+        t->heating = false;
+        t->t_low = t->time;
+    } else if (!t->heating && temp < t->target - TUNE_HYSTERESIS) {
+        // one oscillation done: max was after the switch to low, min after
+        // the previous switch to high
+        float high = t->t_low - t->t_high, low = t->time - t->t_low;
+        if (t->count > 1) {                     // first two are warm-up
+            float n = t->count - 1;
+            float a = (t->tmax - t->tmin) / 2, e = TUNE_HYSTERESIS;
+            float ku = 4 * t->d / (M_PI * sqrtf(fmaxf(a * a - e * e, .01f)));
+            t->ku += (ku - t->ku) / n;
+            t->tu += (high + low - t->tu) / n;
+        }
+        if (t->count) {
+            t->bias += t->d * (high - low) / (high + low);
+            t->bias = clampf(t->bias, 0.05f * max, 0.95f * max);
+            t->d = t->bias > max / 2 ? max - t->bias : t->bias;
+        }
+        t->heating = true;
+        t->t_high = t->time;
+        t->tmin = t->tmax = temp;
+        if (++t->count > t->cycles + 1) {
+            pid_param_t *r = &t->result;
+            r->kp = 0.6f * t->ku;
+            r->ki = 2 * r->kp / t->tu;
+            r->kd = r->kp * t->tu / 8;
+            r->kf = t->bias / (t->target - HEATER_AMBIENT);
+            t->state = TUNE_DONE;
+            return 0;
+        }
+    }
+    return t->heating ? t->bias + t->d : t->bias - t->d;
+}
+
+float heater_update(heater_t *h, float temp, float dt) {
+    float last = h->temp;
+    h->temp = temp;
+    heater_fault_t fault = FAULT_NONE;
+    if (h->guard.state != GUARD_FAULT &&
+        (fault = guard_update(h, temp, dt)) != FAULT_NONE) {
+        h->guard.state = GUARD_FAULT;
+        h->guard.fault = fault;
+    }
+    if (h->guard.state == GUARD_FAULT) {
+        if (h->tune.state == TUNE_RUNNING) h->tune.state = TUNE_FAILED;
+        h->target = h->integral = 0;
+        return h->duty = 0;
+    }
+    if (isnan(temp) || dt <= 0) {
+        if (h->tune.state == TUNE_RUNNING) h->tune.state = TUNE_FAILED;
+        h->integral = 0;
+        return h->duty = 0;
+    }
+    if (!isnan(last)) {
+        float rate = (temp - last) / dt;
+        h->deriv += (rate - h->deriv) * dt / (HEATER_DERIV_TAU + dt);
+    }
+    if (h->tune.state == TUNE_RUNNING) {
+        h->duty = tune_update(h, temp, dt);
+        if (h->tune.state != TUNE_RUNNING) h->target = 0;
+        return h->duty;
+    }
+    if (h->target <= 0) {
+        h->integral = 0;
+        return h->duty = 0;
+    }
+    float err = h->target - temp, max = h->max_duty;
+    if (err > HEATER_RANGE) {
+        h->integral = 0;
+        return h->duty = max;
+    }
+    const pid_param_t *p = &h->pid;
+    float base = p->kf * (h->target - HEATER_AMBIENT) + p->kp * err -
+                 p->kd * h->deriv;
+    float integral = h->integral + p->ki * err * dt;
+    float out = base + integral;
+    // conditional integration: hold it while saturated in that direction
+    if ((out > max && err > 0) || (out < 0 && err < 0)) integral = h->integral;
+    h->integral = clampf(integral, -max, max);
+    return h->duty = clampf(base + h->integral, 0, max);
+}
+
+bool heater_output(heater_t *h) {
+    if (!h->tick) {
+        float want = h->duty * h->window + h->carry;
+        int on = clampf(roundf(want), 0, h->window);
+        if (on < HEATER_MIN_PULSE) on = 0;
+        else if (h->window - on < HEATER_MIN_PULSE) on = h->window;
+        h->carry = clampf(want - on, -HEATER_MIN_PULSE, HEATER_MIN_PULSE);
+        h->on = on;
+    }
+    // turning off does not wait for the end of the window
+    bool level = h->duty > 0 && h->tick < h->on;
+    if (++h->tick >= h->window) h->tick = 0;
+    if (level != h->level) h->edges++;
+    return h->level = level;
+}
+
+bool heater_autotune(heater_t *h, float target, uint8_t cycles) {
+    if (target <= HEATER_AMBIENT || !cycles) return false;
+    if (h->guard.state == GUARD_FAULT) return false;
+    heater_tune_t *t = &h->tune;
+    memset(t, 0, sizeof(heater_tune_t));
+    t->target = h->target = target;
+    t->cycles = cycles;
+    t->bias = t->d = h->max_duty / 2;
+    t->heating = true;
+    t->tmin = t->tmax = isnan(h->temp) ? 0 : h->temp;
+    h->integral = 0;
+    t->state = TUNE_RUNNING;
+    return true;
+}
+
+void heater_clear(heater_t *h) {
+    heater_guard_t *g = &h->guard;
+    g->state = GUARD_IDLE;
+    g->fault = FAULT_NONE;
+    g->target = 0;
+    g->invalid = 0;
+}
+
+const char * heater_fault_str(heater_fault_t fault) {
+    switch (fault) {
+    case FAULT_NONE:        return "none";
+    case FAULT_SENSOR:      return "sensor";
+    case FAULT_OVERHEAT:    return "overheat";
+    case FAULT_HEATING:     return "heating";
+    case FAULT_RUNAWAY:     return "runaway";
+    }
+    return "unknown";
+}
+
+bool heater_parse_pid(const char *str, pid_param_t *pid) {
+    pid_param_t p = { 0, 0, 0, 0 };
+    if (!str || sscanf(str, "%f,%f,%f,%f", &p.kp, &p.ki, &p.kd, &p.kf) < 3)
+        return false;
+    *pid = p;
+    return true;
+}
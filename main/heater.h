@@ -0,0 +1,202 @@
+/*
+ * File: heater.h
+ * Authors: Hank <hankso1106@gmail.com>
+ * Create: 2026-10-18 13:40:07
+ *
+ * Heater control: bed and nozzle 1-3 are switched by PIN_BED..PIN_NOZ3 on
+ * the PCF8574. A task runs every HEATER_PERIOD_MS, reads the thermistors
+ * and updates one PID controller per heater:
+ *
+ *      duty = kf * (target - ambient)          feed-forward, holding power
+ *           + kp * error
+ *           + integral(ki * error)             clamped, see below
+ *           - kd * d(temp)/dt                  on measurement, filtered
+ *
+ * Anti-windup: the integral only grows while the output is not saturated in
+ * the same direction, and is limited to [-max, max]. Far below the target
+ * (more than HEATER_RANGE) the heater is fully on and the integral is reset,
+ * so a long warm-up does not wind it up.
+ *
+ * Outputs are time-proportioned: the duty is latched at the start of a
+ * window of `window` periods and the pin is on for the first part of it.
+ * The rounding error is carried into the next window, so the average duty
+ * is exact at any resolution. A pin changes at most twice per window,
+ * which bounds the I2C writes no matter how often PID runs; pulses shorter
+ * than HEATER_MIN_PULSE periods are merged into the next window.
+ *
+ * Autotune uses the relay method (Astrom-Hagglund): the output switches
+ * between bias + d and bias - d whenever the temperature crosses the
+ * target, and the bias is adjusted until on and off times are equal. The
+ * oscillation amplitude `a` and period `Tu` give the ultimate gain
+ * Ku = 4d / (pi * a), then Ziegler-Nichols: kp = 0.6 Ku, ki = 2 kp / Tu,
+ * kd = kp * Tu / 8. The final bias is the holding power, which gives kf.
+ *
+ * A guard watches every heater in the same update and latches a fault that
+ * forces the output off until it is cleared:
+ *
+ *      IDLE ----> HEATING ----> HOLD           target set, then reached
+ *                 |             |              (within hold_band)
+ *                 +---> FAULT <-+
+ *
+ *      sensor      GUARD_SENSOR_SAMPLES invalid readings in a row while on
+ *      overheat    reading above max_temp, in any state
+ *      heating     less than heat_rise gained in heat_period while warming
+ *                  up: heater or thermistor fell off the block
+ *      runaway     below target - hold_band for hold_period after reaching
+ *                  it: same causes, or a heater cartridge failing
+ *
+ * Autotune is guarded like a target at the tune temperature. On the ESP32
+ * the loop that finds a fault turns all heaters off, writes the outputs at
+ * once and stops the print job, so outputs are off one loop run after the
+ * reading (`heater` prints the time measured), which is at most
+ * HEATER_PERIOD_MS after the temperature crossed the limit.
+ *
+ * Units: temperatures in degC, duty 0 ~ 1, kp in 1/degC, ki in 1/(degC s),
+ * kd in s/degC, kf in 1/degC.
+ */
+
+#ifndef _HEATER_H_
+#define _HEATER_H_
+
+#include "gcode.h"
+
+#define HEATER_NUM          4           // bed, nozzle 1-3
+#define HEATER_PERIOD_MS    100         // control loop period
+#define HEATER_WINDOW_BED   40          // periods per output window (4s)
+#define HEATER_WINDOW_NOZ   10          // (1s)
+#define HEATER_MIN_PULSE    1           // shortest on or off time (periods)
+#define HEATER_RANGE        10          // degC below target to use PID
+#define HEATER_TOLERANCE    2           // degC around target for M109/M190
+#define HEATER_AMBIENT      25          // degC, base of feed-forward
+#define HEATER_DERIV_TAU    2           // filter of derivative (seconds)
+#define HEATER_MAX_BED      120         // degC, highest target accepted
+#define HEATER_MAX_NOZ      280
+
+// Guard parameters (see guard_param_t), thermal protection of Marlin
+#define GUARD_BED           { 60, 2, 20, 2, HEATER_MAX_BED + 15 }
+#define GUARD_NOZ           { 20, 2, 40, 4, HEATER_MAX_NOZ + 15 }
+#define GUARD_SENSOR_SAMPLES 5          // invalid readings to a sensor fault
+
+typedef struct {
+    float kp, ki, kd, kf;
+} pid_param_t;
+
+typedef enum {
+    TUNE_OFF,
+    TUNE_RUNNING,
+    TUNE_DONE,
+    TUNE_FAILED,
+} tune_state_t;
+
+typedef struct {
+    tune_state_t state;
+    float target;
+    float bias, d;              // relay output is bias +/- d
+    uint8_t cycles;             // oscillations to average
+    uint8_t count;              // oscillations done
+    bool heating;               // relay is high
+    float tmin, tmax;           // of current oscillation
+    float time;                 // seconds since start
+    float t_high, t_low;        // time of last switch to high and to low
+    float ku, tu;               // averaged over measured oscillations
+    pid_param_t result;
+} heater_tune_t;
+
+typedef enum {
+    GUARD_IDLE,
+    GUARD_HEATING,
+    GUARD_HOLD,
+    GUARD_FAULT,
+} guard_state_t;
+
+typedef enum {
+    FAULT_NONE,
+    FAULT_SENSOR,
+    FAULT_OVERHEAT,
+    FAULT_HEATING,
+    FAULT_RUNAWAY,
+} heater_fault_t;
+
+typedef struct {
+    float heat_period;          // seconds to gain heat_rise while heating
+    float heat_rise;            // degC
+    float hold_period;          // seconds allowed below hold band
+    float hold_band;            // degC below target
+    float max_temp;             // degC
+} guard_param_t;
+
+typedef struct {
+    guard_param_t param;
+    guard_state_t state;
+    heater_fault_t fault;
+    float target;               // guarded target, 0 if off
+    float ref;                  // degC at start of heating period
+    float timer;                // seconds in heating period or below band
+    uint8_t invalid;            // invalid readings in a row
+} heater_guard_t;
+
+typedef struct {
+    pid_param_t pid;
+    float max_duty;             // power limit
+    float target;               // degC, 0: off
+    float temp;                 // last reading, NAN if invalid
+    float integral;             // integral term (duty)
+    float deriv;                // filtered dtemp/dt (degC/s)
+    float duty;                 // controller output
+    float carry;                // window rounding error carried over
+    uint16_t window;            // periods per output window
+    uint16_t tick;              // period in current window
+    uint16_t on;                // periods on in current window
+    uint32_t edges;             // output changes
+    bool level;                 // output pin
+    heater_tune_t tune;
+    heater_guard_t guard;
+} heater_t;
+
+void heater_init(heater_t *h, const pid_param_t *pid, uint16_t window,
+                 const guard_param_t *guard);
+
+// Run controller with a new reading `dt` seconds after the last one
+float heater_update(heater_t *h, float temp, float dt);
+
+// Advance output window by one period and return the pin level
+bool heater_output(heater_t *h);
+
+// Start relay autotune around `target`. Result in h->tune when TUNE_DONE.
+bool heater_autotune(heater_t *h, float target, uint8_t cycles = 5);
+
+// Clear a latched fault. The heater stays off until a new target.
+void heater_clear(heater_t *h);
+
+const char * heater_fault_str(heater_fault_t fault);
+
+// Parse "kp,ki,kd,kf"
+bool heater_parse_pid(const char *str, pid_param_t *pid);
+
+/* Implemented in heater_task.cpp: the control task on the ESP32. Index 0
+ * is the bed, 1 ~ 3 are nozzles.
+ */
+void heater_initialize();               // load PID from Config
+void heater_loop_begin(int xCoreID = 0);
+
+bool heater_set_target(uint8_t idx, float target);
+bool heater_reached(uint8_t idx);       // within HEATER_TOLERANCE or off
+bool heater_tune(uint8_t idx, float target, uint8_t cycles);
+void heater_clear_fault(uint8_t idx);
+
+/* M104/M109 S<temp> [T<n>], M140/M190 S<temp>: set targets. Return -1 if
+ * `cmd` is not one of them, else the heater to wait for (M109/M190) or
+ * HEATER_NUM if there is nothing to wait for.
+ */
+int heater_gcode(const gcode_cmd_t *cmd, uint8_t extruder);
+
+/* Readings from `from` to `to` seconds as a telemetry response (see
+ * telemetry.h), `from` < 0 counts back from now. Return bytes in `buf`.
+ */
+size_t heater_history(int32_t from, uint32_t to, uint16_t points,
+                      void *buf, size_t len);
+
+void heater_info();                     // temps, duty, loop jitter, I2C load
+void heater_stats_reset();
+
+#endif // _HEATER_H_
@@ -0,0 +1,327 @@
+/*
+ * File: heater_task.cpp
+ * Authors: Hank <hankso1106@gmail.com>
+ * Create: 2026-10-18 13:40:07
+ */
+
+#include "heater.h"
+#include "config.h"
+#include "drivers.h"
+#include "thermistor.h"
+#include "telemetry.h"
+#include "job.h"
+#include "softpwm.h"
+
+#include <math.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "esp_log.h"
+#include "esp_timer.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "freertos/semphr.h"
+
+#define THERM_RAW_MIN       64          // below: shorted
+#define THERM_RAW_MAX       (ADC_TEMP_MAX - 64) // above: open
+
+static const char *TAG = "Heater";
+
+static const i2c_pin_num_t heater_pins[HEATER_NUM] = {
+    PIN_BED, PIN_NOZ1, PIN_NOZ2, PIN_NOZ3
+};
+static const char * const heater_names[HEATER_NUM] = {
+    "Bed", "Nozzle1", "Nozzle2", "Nozzle3"
+};
+
+// 100K NTC thermistor, beta 3950, pulled up by 4.7K to ADC reference
+static constexpr therm_lut_t therm_lut =
+    therm_build(therm_beta(100000, 25, 3950, 4700));
+static_assert(ADC_TEMP_BITS == THERM_CODE_BITS, "ADC codes index the table");
+
+static heater_t heaters[HEATER_NUM];
+static portMUX_TYPE heater_mux = portMUX_INITIALIZER_UNLOCKED;
+
+// History of readings, read by the HTTP server: a mutex, not the spinlock,
+// as a response copies up to TELEM_RESPONSE_MAX bytes
+static telem_t telem;
+static SemaphoreHandle_t telem_lock = NULL;
+
+static struct {
+    int64_t since;              // us, start of statistics
+    uint32_t loops;
+    int64_t jitter_sum, jitter_max; // us of period deviation
+    int64_t run_max;            // us of one loop
+    uint32_t writes, errors;    // I2C writes of heater outputs
+    int64_t i2c_us;             // time spent in these writes
+    uint32_t faults;
+    int64_t react_us, react_max; // us from reading a fault to outputs off
+} stats;
+
+static float read_temp(uint8_t idx) {
+    int raw = adc_temp_raw(idx);
+    if (raw < THERM_RAW_MIN || raw > THERM_RAW_MAX) return NAN;
+    return therm_lookup(&therm_lut, raw);
+}
+
+static void tune_finished(uint8_t idx, const heater_tune_t *tune) {
+    if (tune->state == TUNE_FAILED) {
+        ESP_LOGE(TAG, "%s autotune failed", heater_names[idx]);
+        return;
+    }
+    char buf[64];
+    const pid_param_t *r = &tune->result;
+    snprintf(buf, sizeof(buf), "%.4f,%.5f,%.4f,%.5f",
+             r->kp, r->ki, r->kd, r->kf);
+    ESP_LOGI(TAG, "%s autotune: Ku %.4f Tu %.1fs, PID %s", heater_names[idx],
+             tune->ku, tune->tu, buf);
+    // nozzles share one entry, bed has its own
+    portENTER_CRITICAL(&heater_mux);
+    for (uint8_t i = idx ? 1 : 0; i < (idx ? HEATER_NUM : 1); i++) {
+        heaters[i].pid = *r;
+    }
+    portEXIT_CRITICAL(&heater_mux);
+    // Config keeps the pointer: set a copy, free the one of the last result
+    static char *tuned[2];
+    const char *key = idx ? "mtn.pid.noz" : "mtn.pid.bed";
+    char *val = strdup(buf);
+    if (!val || !config_set(key, val)) {
+        ESP_LOGW(TAG, "Cannot set PID of %s", heater_names[idx]);
+        free(val);
+        return;
+    }
+    if (config_get(key) == val) {
+        free(tuned[!!idx]);
+        tuned[!!idx] = val;
+    } else {
+        free(val);                      // same as before, old one kept
+    }
+    if (!config_nvs_set_str(key, config_get(key)))
+        ESP_LOGW(TAG, "Cannot save PID of %s", heater_names[idx]);
+}
+
+static void heater_loop(void *arg) {
+    const int64_t period = HEATER_PERIOD_MS * 1000;
+    TickType_t wake = xTaskGetTickCount();
+    int64_t last = esp_timer_get_time();
+    uint8_t written = 0;
+    bool sync = true;
+    float temps[HEATER_NUM];
+    heater_tune_t tunes[HEATER_NUM];
+    tune_state_t tuning[HEATER_NUM];
+    heater_fault_t faults[HEATER_NUM];  // new in this loop
+    stats.since = last;
+    for (;;) {
+        vTaskDelayUntil(&wake, pdMS_TO_TICKS(HEATER_PERIOD_MS));
+        int64_t now = esp_timer_get_time();
+        int64_t jitter = llabs(now - last - period);
+        float dt = (now - last) / 1e6f;
+        last = now;
+        for (uint8_t i = 0; i < HEATER_NUM; i++) temps[i] = read_temp(i);
+        xSemaphoreTake(telem_lock, portMAX_DELAY);
+        telem_add(&telem, temps);
+        xSemaphoreGive(telem_lock);
+
+        uint8_t levels = 0;                 // bit i: heater i on
+        bool fault = false;
+        portENTER_CRITICAL(&heater_mux);
+        for (uint8_t i = 0; i < HEATER_NUM; i++) {
+            heater_t *h = heaters + i;
+            tuning[i] = h->tune.state;
+            heater_fault_t was = h->guard.fault;
+            heater_update(h, temps[i], dt);
+            faults[i] = h->guard.fault != was ? h->guard.fault : FAULT_NONE;
+            if (faults[i] != FAULT_NONE) fault = true;
+            tunes[i] = h->tune;
+        }
+        for (uint8_t i = 0; i < HEATER_NUM; i++) {
+            heater_t *h = heaters + i;
+            if (fault) {                        // all heaters off
+                h->target = 0;
+                if (h->tune.state == TUNE_RUNNING) h->tune.state = TUNE_OFF;
+                h->duty = 0;
+            }
+            if (heater_output(h)) levels |= 1 << i;
+        }
+        portEXIT_CRITICAL(&heater_mux);
+
+        // outputs change at most twice per window, write only then instead
+        // of waiting for the next PWM slot
+        if (sync || fault || levels != written) {
+            int64_t t0 = esp_timer_get_time();
+            for (uint8_t i = 0; i < HEATER_NUM; i++)
+                softpwm_write(heater_pins[i], levels & (1 << i) ? 1 : 0);
+            esp_err_t err = softpwm_commit();
+            int64_t t1 = esp_timer_get_time();
+            stats.i2c_us += t1 - t0;
+            stats.writes++;
+            if (err) stats.errors++;
+            sync = err != ESP_OK;
+            written = levels;
+            if (fault && !err) {
+                stats.react_us = t1 - now;
+                if (stats.react_us > stats.react_max)
+                    stats.react_max = stats.react_us;
+            }
+        }
+        for (uint8_t i = 0; fault && i < HEATER_NUM; i++) {
+            if (faults[i] == FAULT_NONE) continue;
+            stats.faults++;
+            ESP_LOGE(TAG, "%s %s fault at %.1f degC: all heaters off in "
+                     "%lld us", heater_names[i], heater_fault_str(faults[i]),
+                     temps[i], sync ? -1LL : stats.react_us);
+        }
+        if (fault) job_stop();
+        for (uint8_t i = 0; i < HEATER_NUM; i++) {
+            if (tuning[i] == TUNE_RUNNING && tunes[i].state != TUNE_RUNNING)
+                tune_finished(i, tunes + i);
+        }
+        int64_t run = esp_timer_get_time() - now;
+        stats.loops++;
+        stats.jitter_sum += jitter;
+        if (jitter > stats.jitter_max) stats.jitter_max = jitter;
+        if (run > stats.run_max) stats.run_max = run;
+    }
+}
+
+void heater_initialize() {
+    pid_param_t bed = { 0, 0, 0, 0 }, noz = bed;
+    if (!heater_parse_pid(Config.mtn.PID_BED, &bed))
+        ESP_LOGE(TAG, "Invalid mtn.pid.bed: %s", Config.mtn.PID_BED);
+    if (!heater_parse_pid(Config.mtn.PID_NOZ, &noz))
+        ESP_LOGE(TAG, "Invalid mtn.pid.noz: %s", Config.mtn.PID_NOZ);
+    const guard_param_t guard_bed = GUARD_BED, guard_noz = GUARD_NOZ;
+    heater_init(heaters, &bed, HEATER_WINDOW_BED, &guard_bed);
+    for (uint8_t i = 1; i < HEATER_NUM; i++) {
+        heater_init(heaters + i, &noz, HEATER_WINDOW_NOZ, &guard_noz);
+    }
+    telem_init(&telem, 1000 / HEATER_PERIOD_MS);
+    if (!telem_lock) telem_lock = xSemaphoreCreateMutex();
+}
+
+bool heater_set_target(uint8_t idx, float target) {
+    if (idx >= HEATER_NUM) return false;
+    if (target < 0 || target > (idx ? HEATER_MAX_NOZ : HEATER_MAX_BED)) {
+        ESP_LOGW(TAG, "%s target %.0f out of range", heater_names[idx],
+                 target);
+        return false;
+    }
+    portENTER_CRITICAL(&heater_mux);
+    bool ok = heaters[idx].guard.state != GUARD_FAULT;
+    if (ok) {
+        heaters[idx].tune.state = TUNE_OFF;
+        heaters[idx].target = target;
+    }
+    portEXIT_CRITICAL(&heater_mux);
+    if (!ok) ESP_LOGW(TAG, "%s has a fault, clear it first",
+                      heater_names[idx]);
+    return ok;
+}
+
+void heater_clear_fault(uint8_t idx) {
+    if (idx >= HEATER_NUM) return;
+    portENTER_CRITICAL(&heater_mux);
+    heater_clear(heaters + idx);
+    portEXIT_CRITICAL(&heater_mux);
+}
+
+bool heater_reached(uint8_t idx) {
+    if (idx >= HEATER_NUM) return true;
+    const heater_t *h = heaters + idx;
+    return h->target <= 0 || fabsf(h->temp - h->target) <= HEATER_TOLERANCE;
+}
+
+bool heater_tune(uint8_t idx, float target, uint8_t cycles) {
+    if (idx >= HEATER_NUM ||
+        target > (idx ? HEATER_MAX_NOZ : HEATER_MAX_BED)) return false;
+    portENTER_CRITICAL(&heater_mux);
+    bool ok = heater_autotune(heaters + idx, target, cycles);
+    portEXIT_CRITICAL(&heater_mux);
+    return ok;
+}
+
+int heater_gcode(const gcode_cmd_t *cmd, uint8_t extruder) {
+    float val;
+    uint8_t idx;
+    if (cmd->letter != 'M') return -1;
+    switch (cmd->code) {
+    case 104: case 109:
+        idx = 1 + (gcode_param(cmd, 'T', &val) ? (uint8_t)val : extruder);
+        break;
+    case 140: case 190:
+        idx = 0;
+        break;
+    default:
+        return -1;
+    }
+    if (idx >= HEATER_NUM) return HEATER_NUM;
+    if (gcode_param(cmd, 'S', &val) && !heater_set_target(idx, val))
+        return HEATER_NUM;
+    return cmd->code == 109 || cmd->code == 190 ? idx : HEATER_NUM;
+}
+
+size_t heater_history(int32_t from, uint32_t to, uint16_t points,
+                      void *buf, size_t len) {
+    if (!telem_lock) return 0;
+    xSemaphoreTake(telem_lock, portMAX_DELAY);
+    uint32_t now = telem_now(&telem);
+    if (from < 0) from = -from > (int32_t)now ? 0 : now + from;
+    len = telem_read(&telem, from, to, points, buf, len);
+    xSemaphoreGive(telem_lock);
+    return len;
+}
+
+void heater_info() {
+    heater_t hs[HEATER_NUM];
+    portENTER_CRITICAL(&heater_mux);
+    memcpy(hs, heaters, sizeof(hs));
+    portEXIT_CRITICAL(&heater_mux);
+    printf("Heater    Temp  Target  Duty  kp/ki/kd/kf\n");
+    for (uint8_t i = 0; i < HEATER_NUM; i++) {
+        const heater_t *h = hs + i;
+        printf("%-8s %5.1f  %6.1f  %3.0f%%  %.4g/%.4g/%.4g/%.4g",
+               heater_names[i], h->temp, h->target, h->duty * 100,
+               h->pid.kp, h->pid.ki, h->pid.kd, h->pid.kf);
+        if (h->tune.state == TUNE_RUNNING)
+            printf("  tuning %u/%u", h->tune.count, h->tune.cycles + 2);
+        if (h->guard.state == GUARD_FAULT)
+            printf("  FAULT %s", heater_fault_str(h->guard.fault));
+        printf("\n");
+    }
+    double secs = (esp_timer_get_time() - stats.since) / 1e6;
+    uint32_t n = stats.loops ? stats.loops : 1;
+    printf("Loop: %u runs every %dms, jitter %.0f / %lld us (avg/max), "
+           "run %lld us max\n", stats.loops, HEATER_PERIOD_MS,
+           (double)stats.jitter_sum / n, stats.jitter_max, stats.run_max);
+    printf("I2C:  %u writes (%.2f/s), %.0f us each, bus load %.3f%%, "
+           "%u errors\n", stats.writes, secs > 0 ? stats.writes / secs : 0.0,
+           stats.writes ? (double)stats.i2c_us / stats.writes : 0.0,
+           secs > 0 ? stats.i2c_us / secs / 1e4 : 0.0, stats.errors);
+    printf("Guard: %u faults, outputs off %lld / %lld us (last/max) after "
+           "loop wake-up\n", stats.faults, stats.react_us, stats.react_max);
+}
+
+void heater_stats_reset() {
+    int64_t now = esp_timer_get_time();
+    memset(&stats, 0, sizeof(stats));
+    stats.since = now;
+}
+
+void heater_loop_begin(int xCoreID) {
+    const char * const pcName = "heater";
+    const uint32_t usStackDepth = 3072;
+    void * const pvParameters = NULL;
+    const UBaseType_t uxPriority = tskIDLE_PRIORITY + 5;
+#ifndef CONFIG_FREERTOS_UNICORE
+    if (xCoreID == 0 || xCoreID == 1) {
+        xTaskCreatePinnedToCore(
+            heater_loop, pcName, usStackDepth,
+            pvParameters, uxPriority, NULL, xCoreID);
+    } else
+#endif
+    {
+        xTaskCreate(
+            heater_loop, pcName, usStackDepth,
+            pvParameters, uxPriority, NULL);
+    }
+}
@@ -0,0 +1,348 @@
+/*
+ * File: job.cpp
+ * Authors: Hank <hankso1106@gmail.com>
+ * Create: 2026-10-18 11:05:23
+ */
+
+#include "job.h"
+#include "config.h"
+#include "stepper.h"
+#include "filesys.h"
+#include "gcodebin.h"
+
+#include "esp_log.h"
+#include "esp_timer.h"
+#include "esp_partition.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "freertos/queue.h"
+
+static const char *TAG = "Job";
+
+typedef struct {
+    char path[JOURNAL_PATH];
+    uint32_t offset;
+    bool resume;
+} job_request_t;
+
+typedef struct {
+    uint32_t offset;            // file offset after the line being parsed
+    uint32_t queued;            // offset of the last command queued
+    uint32_t commands;          // number of commands queued
+    uint32_t errors;            // bad lines or records
+} job_ctx_t;
+
+static QueueHandle_t job_queue = NULL;
+static const esp_partition_t *part = NULL;
+static journal_t journal;
+static journal_state_t recovered;   // state found at boot
+static bool mounted = false;
+static char job_path[JOURNAL_PATH];
+static volatile bool running = false, stopping = false;
+
+/******************************************************************************
+ * Journal on raw partition
+ */
+
+static bool part_read(uint32_t addr, void *buf, size_t len, void *arg) {
+    return esp_partition_read(part, addr, buf, len) == ESP_OK;
+}
+
+static bool part_write(uint32_t addr, const void *buf, size_t len, void *arg) {
+    return esp_partition_write(part, addr, buf, len) == ESP_OK;
+}
+
+static bool part_erase(uint32_t sector, void *arg) {
+    return esp_partition_erase_range(
+        part, sector * JOURNAL_SECTOR, JOURNAL_SECTOR) == ESP_OK;
+}
+
+static uint32_t millis32() { return esp_timer_get_time() / 1000; }
+
+// Save state of the last executed command, now if `force` else batched
+static void checkpoint(bool printing, bool force = false) {
+    if (!mounted) return;
+    journal_state_t state;
+    stepper_snapshot(&state);
+    snprintf(state.path, sizeof(state.path), "%s", job_path);
+    if (printing) state.flags |= JOURNAL_PRINTING;
+    journal_update(&journal, &state);
+    uint32_t errors = journal.stats.errors;
+    if (force) journal_flush(&journal, millis32());
+    else journal_tick(&journal, millis32());
+    if (journal.stats.errors != errors)
+        ESP_LOGW(TAG, "Checkpoint failed: %u errors", journal.stats.errors);
+}
+
+void job_initialize() {
+    part = esp_partition_find_first(
+        ESP_PARTITION_TYPE_DATA, (esp_partition_subtype_t)0x40, JOB_PARTITION);
+    if (!part) {
+        ESP_LOGW(TAG, "No %s partition, power-loss recovery disabled",
+                 JOB_PARTITION);
+        return;
+    }
+    journal_flash_t flash = {
+        part_read, part_write, part_erase, part->size / JOURNAL_SECTOR, NULL
+    };
+    uint32_t interval = atoi(Config.mtn.JOURNAL) * 1000;
+    int64_t t0 = esp_timer_get_time();
+    bool found = journal_mount(&journal, &flash, interval);
+    mounted = true;
+    ESP_LOGI(TAG, "Journal mounted in %lldus: record %u, generation %u, "
+             "%u skipped", esp_timer_get_time() - t0, journal.seq,
+             journal.generation, journal.stats.skipped);
+    if (!found) return;
+    recovered = journal.state;
+    if (!(recovered.flags & JOURNAL_PRINTING)) return;
+    ESP_LOGW(TAG, "Print of %s interrupted at offset %u Z%.2f, "
+             "run `print --resume` to continue", recovered.path,
+             recovered.offset, recovered.position[AXIS_Z]);
+}
+
+/******************************************************************************
+ * Job task
+ */
+
+static void queue_cmd(const gcode_cmd_t *cmd, void *arg) {
+    job_ctx_t *ctx = (job_ctx_t *)arg;
+    while (!stopping) {
+        if (stepper_queue_gcode(cmd, JOB_TICK_MS, ctx->offset)) {
+            ctx->queued = ctx->offset;
+            ctx->commands++;
+            break;
+        }
+        checkpoint(true);
+    }
+}
+
+static void queue_line(const char *line, job_ctx_t *ctx) {
+    gcode_parser_t parser;
+    gcode_parser_init(&parser);
+    gcode_parse(&parser, line, strlen(line), queue_cmd, ctx);
+    gcode_parse_end(&parser, queue_cmd, ctx);
+}
+
+// Bring heaters, fans, modes and position back to the recovered state
+static void restore(const journal_state_t *st) {
+    job_ctx_t ctx = { JOURNAL_NONE, JOURNAL_NONE };
+    char buf[80];
+    uint8_t i;
+    for (i = 0; i < 2; i++) {                   // set all, then wait for all
+        snprintf(buf, sizeof(buf), "M%d S%.0f\n", i ? 190 : 140,
+                 st->target[0]);
+        if (st->target[0]) queue_line(buf, &ctx);
+        for (uint8_t n = 0; n < JOURNAL_HEATERS - 1; n++) {
+            if (!st->target[1 + n]) continue;
+            snprintf(buf, sizeof(buf), "M%d S%.0f T%u\n", i ? 109 : 104,
+                     st->target[1 + n], n);
+            queue_line(buf, &ctx);
+        }
+    }
+    for (i = 0; i < JOURNAL_FANS; i++) {
+        if (!st->fan[i]) continue;
+        snprintf(buf, sizeof(buf), "M106 P%u S%u\n", i, st->fan[i]);
+        queue_line(buf, &ctx);
+    }
+    snprintf(buf, sizeof(buf), "T%u\n", st->extruder);
+    queue_line(buf, &ctx);
+    queue_line("G21\n", &ctx);
+    snprintf(buf, sizeof(buf), "G92 X%.3f Y%.3f Z%.3f E%.5f\n",
+             st->position[AXIS_X], st->position[AXIS_Y],
+             st->position[AXIS_Z], st->position[AXIS_E]);
+    queue_line(buf, &ctx);
+    snprintf(buf, sizeof(buf), "G1 F%.0f\n", st->feedrate * 60);
+    queue_line(buf, &ctx);
+    queue_line(st->flags & JOURNAL_RELATIVE ? "G91\n" : "G90\n", &ctx);
+    queue_line(st->flags & JOURNAL_RELATIVE_E ? "M83\n" : "M82\n", &ctx);
+    if (st->flags & JOURNAL_INCH) queue_line("G20\n", &ctx);
+}
+
+static bool is_gcb(const char *path) {
+    size_t len = strlen(path);
+    return len > 4 && !strcasecmp(path + len - 4, ".gcb");
+}
+
+// Feed G-code text line by line so that each command knows where the next
+// one starts
+static void feed_text(File &file, job_ctx_t *ctx) {
+    char buf[JOB_CHUNK];
+    gcode_parser_t parser;
+    gcode_parser_init(&parser);
+    size_t len;
+    while (!stopping && (len = file.read((uint8_t *)buf, sizeof(buf)))) {
+        const char *p = buf, *end = buf + len, *eol;
+        while (p < end) {
+            eol = (const char *)memchr(p, '\n', end - p);
+            eol = eol ? eol + 1 : end;
+            ctx->offset += eol - p;
+            gcode_parse(&parser, p, eol - p, queue_cmd, ctx);
+            p = eol;
+        }
+        checkpoint(true);
+    }
+    if (!stopping) {
+        ctx->offset = file.size();
+        gcode_parse_end(&parser, queue_cmd, ctx);
+    }
+    ctx->errors = parser.errors;
+}
+
+// Feed precompiled records (gcodebin.h), offsets are at command boundaries
+static void feed_gcb(File &file, job_ctx_t *ctx) {
+    const size_t size = JOB_CHUNK / sizeof(gcb_record_t);
+    gcb_record_t buf[size];
+    gcode_cmd_t cmd;
+    size_t num = 0, len;
+    uint8_t used;
+    do {
+        len = file.read((uint8_t *)(buf + num),
+                        (size - num) * sizeof(gcb_record_t));
+        num += len / sizeof(gcb_record_t);
+        size_t i = 0;
+        while (!stopping && i < num &&
+               (used = gcb_decode(buf + i, num - i, &cmd))) {
+            ctx->offset += used * sizeof(gcb_record_t);
+            queue_cmd(&cmd, ctx);
+            i += used;
+        }
+        memmove(buf, buf + i, (num - i) * sizeof(gcb_record_t));
+        num -= i;
+        checkpoint(true);
+    } while (!stopping && len && !(len % sizeof(gcb_record_t)));
+    if (!stopping && (num || len)) ctx->errors++;   // truncated file
+}
+
+static void run_job(const job_request_t *req) {
+    File file = FFS.open(req->path);
+    if (!file || file.isDirectory()) {
+        ESP_LOGE(TAG, "Cannot open %s", req->path);
+        return;
+    }
+    uint32_t size = file.size(), offset = req->offset;
+    bool binary = is_gcb(req->path);
+    if (binary) {
+        gcb_header_t header;
+        if (file.read((uint8_t *)&header, sizeof(header)) != sizeof(header)
+            || !gcb_check(&header)) {
+            ESP_LOGE(TAG, "Invalid binary G-code %s", req->path);
+            file.close();
+            return;
+        }
+        if (offset < sizeof(header)) offset = sizeof(header);
+    }
+    if (offset > size || !file.seek(offset) || (binary &&
+        (offset - sizeof(gcb_header_t)) % sizeof(gcb_record_t))) {
+        ESP_LOGE(TAG, "Invalid offset %u of %s", offset, req->path);
+        file.close();
+        return;
+    }
+    strcpy(job_path, req->path);
+    running = true;
+    stopping = false;
+    if (req->resume) restore(&recovered);
+    stepper_snapshot_offset(offset);
+    ESP_LOGI(TAG, "Printing %s from offset %u", req->path, offset);
+
+    job_ctx_t ctx = { offset, offset, 0, 0 };
+    uint32_t t0 = xTaskGetTickCount();
+    if (binary) {
+        feed_gcb(file, &ctx);
+    } else {
+        feed_text(file, &ctx);
+    }
+    file.close();
+    // wait for the motion task to execute what was queued
+    journal_state_t state;
+    for (;;) {
+        stepper_snapshot(&state);
+        if (stopping || state.offset == ctx.queued) break;
+        checkpoint(true);
+        vTaskDelay(pdMS_TO_TICKS(JOB_TICK_MS));
+    }
+    ESP_LOGI(TAG, "%s %s at offset %u: %u commands, %u errors in %us",
+             stopping ? "Stopped" : "Finished", req->path, state.offset,
+             ctx.commands, ctx.errors,
+             (xTaskGetTickCount() - t0) * portTICK_PERIOD_MS / 1000);
+    running = false;
+    checkpoint(false, true);
+    recovered.flags &= ~JOURNAL_PRINTING;
+}
+
+static void job_loop(void *arg) {
+    job_request_t req;
+    for (;;) {
+        if (xQueueReceive(job_queue, &req, portMAX_DELAY)) run_job(&req);
+    }
+}
+
+static bool request(const char *path, uint32_t offset, bool resume) {
+    job_request_t req;
+    if (!job_queue || running || strlen(path) >= sizeof(req.path))
+        return false;
+    strcpy(req.path, path);
+    req.offset = offset;
+    req.resume = resume;
+    return xQueueSend(job_queue, &req, 0) == pdTRUE;
+}
+
+bool job_start(const char *path, uint32_t offset) {
+    return request(path, offset, false);
+}
+
+bool job_resume() {
+    if (!(recovered.flags & JOURNAL_PRINTING)) return false;
+    return request(recovered.path, recovered.offset, true);
+}
+
+void job_stop() { if (running) stopping = true; }
+
+bool job_running() { return running; }
+
+void job_info() {
+    journal_state_t state;
+    stepper_snapshot(&state);
+    if (running) {
+        printf("Printing %s at offset %u Z%.2f%s\n", job_path, state.offset,
+               state.position[AXIS_Z], stopping ? " (stopping)" : "");
+    } else if (recovered.flags & JOURNAL_PRINTING) {
+        printf("Interrupted %s at offset %u Z%.2f\n", recovered.path,
+               recovered.offset, recovered.position[AXIS_Z]);
+    } else {
+        printf("Idle\n");
+    }
+    if (!mounted) {
+        printf("Journal: not available\n");
+        return;
+    }
+    const journal_stats_t *s = &journal.stats;
+    printf("Journal: record %u in sector %u/%u (generation %u), every %us\n"
+           "  %u written, %u erases, %u errors, %u skipped at mount\n",
+           journal.seq, journal.sector, journal.flash.sectors,
+           journal.generation, journal.interval / 1000,
+           s->records, s->erases, s->errors, s->skipped);
+}
+
+void job_loop_begin(int xCoreID) {
+    if (!job_queue) job_queue = xQueueCreate(1, sizeof(job_request_t));
+    if (!job_queue) {
+        ESP_LOGE(TAG, "No memory for job queue");
+        return;
+    }
+    const char * const pcName = "job";
+    const uint32_t usStackDepth = 4096;
+    void * const pvParameters = NULL;
+    const UBaseType_t uxPriority = tskIDLE_PRIORITY + 2;
+#ifndef CONFIG_FREERTOS_UNICORE
+    if (xCoreID == 0 || xCoreID == 1) {
+        xTaskCreatePinnedToCore(
+            job_loop, pcName, usStackDepth,
+            pvParameters, uxPriority, NULL, xCoreID);
+    } else
+#endif
+    {
+        xTaskCreate(
+            job_loop, pcName, usStackDepth,
+            pvParameters, uxPriority, NULL);
+    }
+}
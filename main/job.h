@@ -0,0 +1,41 @@
+/*
+ * File: job.h
+ * Authors: Hank <hankso1106@gmail.com>
+ * Create: 2026-10-18 11:05:23
+ *
+ * Print job: a low priority task streams a G-code file on flash into the
+ * command queue of the motion task. Every command carries the offset where
+ * the next one starts, so the state after the last executed command (see
+ * stepper_snapshot) tells where to resume. Files named `*.gcb` are played
+ * as precompiled records (gcodebin.h) without text parsing, their offsets
+ * count from the start of the file and fall on command boundaries.
+ *
+ * While printing, the state is checkpointed into the power-loss journal
+ * (journal.h) on the `journal` partition every `mtn.journal` seconds, and
+ * once more with JOURNAL_PRINTING cleared when the job ends or is stopped.
+ * At boot the last record is recovered; if a print was interrupted,
+ * job_resume restores heater targets, fans, modes and position (G92, axes
+ * are assumed not to have moved) and continues from its offset. Commands
+ * still buffered in the planner or move rings when power failed are
+ * replayed, as the snapshot follows the step output.
+ */
+
+#ifndef _JOB_H_
+#define _JOB_H_
+
+#include "journal.h"
+
+#define JOB_PARTITION       "journal"   // data partition, subtype 0x40
+#define JOB_CHUNK           512         // bytes read per step
+#define JOB_TICK_MS         100         // queue wait between checkpoints
+
+void job_initialize();                  // mount journal, report interruption
+void job_loop_begin(int xCoreID = 0);
+
+bool job_start(const char *path, uint32_t offset = 0);
+bool job_resume();                      // continue interrupted print
+void job_stop();
+bool job_running();
+void job_info();                        // print job and journal status
+
+#endif // _JOB_H_
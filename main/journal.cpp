@@ -0,0 +1,203 @@
+/*
+ * File: journal.cpp
+ * Authors: Hank <hankso1106@gmail.com>
+ * Create: 2026-10-18 11:05:23
+ */
+
+#include "journal.h"
+
+#include <stddef.h>
+#include <string.h>
+
+static_assert(sizeof(journal_record_t) <= JOURNAL_SLOT, "record too large");
+
+uint32_t journal_crc32(uint32_t crc, const void *buf, size_t len) {
+    static const uint32_t table[16] = {
+        0x00000000, 0x1DB71064, 0x3B6E20C8, 0x26D930AC,
+        0x76DC4190, 0x6B6B51F4, 0x4DB26158, 0x5005713C,
+        0xEDB88320, 0xF00F9344, 0xD6D6A3E8, 0xCB61B38C,
+        0x9B64C2B0, 0x86D3D2D4, 0xA00AE278, 0xBDBDF21C,
+    };
+    const uint8_t *p = (const uint8_t *)buf;
+    crc = ~crc;
+    while (len--) {
+        crc ^= *p++;
+        crc = (crc >> 4) ^ table[crc & 0xF];
+        crc = (crc >> 4) ^ table[crc & 0xF];
+    }
+    return ~crc;
+}
+
+static uint32_t header_crc(const journal_header_t *h) {
+    return journal_crc32(0, h, offsetof(journal_header_t, crc));
+}
+
+static uint32_t record_crc(const journal_record_t *r) {
+    return journal_crc32(0, r, offsetof(journal_record_t, crc));
+}
+
+static bool is_erased(const void *buf, size_t len) {
+    const uint8_t *p = (const uint8_t *)buf;
+    while (len--) if (*p++ != 0xFF) return false;
+    return true;
+}
+
+static uint32_t slot_addr(uint32_t sector, uint32_t slot) {
+    return sector * JOURNAL_SECTOR + slot * JOURNAL_SLOT;
+}
+
+static bool flash_read(journal_t *j, uint32_t addr, void *buf, size_t len) {
+    j->stats.mount_reads += len;
+    if (j->flash.read(addr, buf, len, j->flash.arg)) return true;
+    j->stats.errors++;
+    return false;
+}
+
+static bool read_header(journal_t *j, uint32_t sector, journal_header_t *h) {
+    return flash_read(j, slot_addr(sector, 0), h, sizeof(*h)) &&
+           h->magic == JOURNAL_MAGIC && h->crc == header_crc(h);
+}
+
+/* Find the last valid record of `sector` and the slot after the last used
+ * one. Slots are written in order, so scanning stops at the first erased.
+ */
+static bool scan_sector(journal_t *j, uint32_t sector, journal_record_t *last,
+                        uint32_t *next) {
+    journal_record_t rec;
+    bool found = false;
+    uint32_t slot;
+    for (slot = 1; slot < JOURNAL_SLOTS; slot++) {
+        if (!flash_read(j, slot_addr(sector, slot), &rec, sizeof(rec))) break;
+        if (is_erased(&rec, sizeof(rec))) break;
+        if (rec.crc == record_crc(&rec)) {
+            *last = rec;
+            found = true;
+        } else {
+            j->stats.skipped++;
+        }
+    }
+    *next = slot;
+    return found;
+}
+
+bool journal_mount(journal_t *j, const journal_flash_t *flash,
+                   uint32_t interval_ms) {
+    memset(j, 0, sizeof(journal_t));
+    j->flash = *flash;
+    j->interval = interval_ms;
+    journal_header_t h;
+    for (uint32_t i = 0; i < flash->sectors; i++) {
+        if (!read_header(j, i, &h) || h.generation <= j->generation) continue;
+        j->generation = h.generation;
+        j->sector = i;
+    }
+    if (!j->generation) return false;           // empty or never written
+    journal_record_t rec;
+    j->valid = scan_sector(j, j->sector, &rec, &j->slot);
+    if (!j->valid && flash->sectors > 1) {
+        // current sector was just rotated in: last record is in previous one
+        uint32_t prev = (j->sector + flash->sectors - 1) % flash->sectors,
+                 unused;
+        if (read_header(j, prev, &h) && h.generation == j->generation - 1) {
+            j->valid = scan_sector(j, prev, &rec, &unused);
+            j->stats.previous = j->valid;
+        }
+    }
+    if (j->valid) {
+        j->seq = rec.seq;
+        j->state = rec.state;
+    }
+    return j->valid;
+}
+
+// Erase the oldest sector and make it the current one
+static bool rotate(journal_t *j) {
+    uint32_t sector = j->generation ? (j->sector + 1) % j->flash.sectors : 0;
+    journal_header_t h = { JOURNAL_MAGIC, j->generation + 1, 0 };
+    h.crc = header_crc(&h);
+    j->stats.erases++;
+    if (!j->flash.erase(sector, j->flash.arg) ||
+        !j->flash.write(slot_addr(sector, 0), &h, sizeof(h), j->flash.arg)) {
+        j->stats.errors++;
+        return false;
+    }
+    j->sector = sector;
+    j->generation = h.generation;
+    j->slot = 1;
+    return true;
+}
+
+static bool append(journal_t *j) {
+    journal_record_t rec, check;
+    memset(&rec, 0, sizeof(rec));
+    rec.seq = j->seq + 1;
+    rec.state = j->state;
+    rec.crc = record_crc(&rec);
+    // a slot failing to program is left behind, try the next one
+    for (uint32_t tries = 0; tries < JOURNAL_SLOTS; tries++) {
+        if (!j->generation || j->slot >= JOURNAL_SLOTS) {
+            if (!rotate(j)) return false;
+        }
+        uint32_t addr = slot_addr(j->sector, j->slot++);
+        if (j->flash.write(addr, &rec, sizeof(rec), j->flash.arg) &&
+            j->flash.read(addr, &check, sizeof(check), j->flash.arg) &&
+            !memcmp(&rec, &check, sizeof(rec))) {
+            j->seq = rec.seq;
+            j->valid = true;
+            j->stats.records++;
+            return true;
+        }
+        j->stats.errors++;
+    }
+    return false;
+}
+
+void journal_update(journal_t *j, const journal_state_t *state) {
+    if (!memcmp(&j->state, state, sizeof(journal_state_t))) return;
+    j->state = *state;
+    j->pending = true;
+}
+
+bool journal_tick(journal_t *j, uint32_t now_ms) {
+    if (!j->interval || !j->pending || now_ms - j->last_ms < j->interval)
+        return false;
+    return journal_flush(j, now_ms);
+}
+
+bool journal_flush(journal_t *j, uint32_t now_ms) {
+    if (!j->pending) return true;
+    j->last_ms = now_ms;
+    if (!append(j)) return false;
+    j->pending = false;
+    return true;
+}
+
+void journal_track(journal_state_t *state, const gcode_cmd_t *cmd) {
+    float val;
+    if (cmd->letter == 'T') {
+        if (cmd->code < JOURNAL_HEATERS - 1) state->extruder = cmd->code;
+        return;
+    }
+    if (cmd->letter != 'M') return;
+    switch (cmd->code) {
+    case 104: case 109: {                       // nozzle S<temp> [T<idx>]
+        uint8_t idx = state->extruder;
+        if (gcode_param(cmd, 'T', &val)) idx = val;
+        if (idx < JOURNAL_HEATERS - 1 && gcode_param(cmd, 'S', &val))
+            state->target[1 + idx] = val;
+        break;
+    }
+    case 140: case 190:                         // bed S<temp>
+        if (gcode_param(cmd, 'S', &val)) state->target[0] = val;
+        break;
+    case 106: case 107: {                       // fan [P<idx>] [S<0-255>]
+        uint8_t idx = gcode_param(cmd, 'P', &val) ? val : 0;
+        if (idx >= JOURNAL_FANS) break;
+        if (cmd->code == 107) val = 0;
+        else if (!gcode_param(cmd, 'S', &val)) val = 255;
+        state->fan[idx] = val < 0 ? 0 : val > 255 ? 255 : val;
+        break;
+    }
+    default:;
+    }
+}
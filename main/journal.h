@@ -0,0 +1,126 @@
+/*
+ * File: journal.h
+ * Authors: Hank <hankso1106@gmail.com>
+ * Create: 2026-10-18 11:05:23
+ *
+ * Power-loss recovery journal: print state (file offset, positions, heater
+ * targets, fans) is checkpointed into a small raw flash region instead of
+ * rewriting one NVS key again and again. Records are appended and sectors
+ * are used in rotation, so each sector is erased once per
+ * JOURNAL_SLOTS - 1 records and all of them wear evenly.
+ *
+ * Region layout, JOURNAL_SECTOR bytes per sector:
+ *      slot 0              journal_header_t (magic, generation, crc)
+ *      slot 1 ...          journal_record_t (seq, state, crc)
+ *
+ * The sector with the highest generation is the current one. A new record
+ * goes to the first erased slot after it; when the sector is full, the next
+ * one (the oldest) is erased and gets generation + 1. Updates are batched in
+ * RAM: journal_update only copies the state, journal_tick writes it when
+ * the interval passed and it changed, journal_flush writes it now.
+ *
+ * Power may fail at any point of a write or erase. Every record and header
+ * carries a CRC32, so a torn one is simply not valid: mounting picks the
+ * last valid record of the current sector, or of the previous generation
+ * when the current one has none yet. Slots which are not erased are never
+ * written again, so a torn record is skipped instead of being overwritten.
+ * Mounting reads the headers and at most two sectors, which takes a few
+ * milliseconds on the SPI flash.
+ *
+ * The module is independent of ESP-IDF: flash access goes through
+ * `journal_flash_t` (esp_partition_* on the ESP32, see job.cpp).
+ */
+
+#ifndef _JOURNAL_H_
+#define _JOURNAL_H_
+
+#include "gcode.h"
+#include "planner.h"
+
+#define JOURNAL_MAGIC       0x314E524A  // "JRN1"
+#define JOURNAL_SECTOR      4096        // erase unit of SPI flash
+#define JOURNAL_SLOT        128         // bytes per record
+#define JOURNAL_SLOTS       (JOURNAL_SECTOR / JOURNAL_SLOT)
+#define JOURNAL_PATH        64
+#define JOURNAL_HEATERS     4           // bed, nozzle 1-3
+#define JOURNAL_FANS        3
+#define JOURNAL_NONE        UINT32_MAX  // offset of commands not from a file
+
+// bits of journal_state_t.flags
+#define JOURNAL_PRINTING    (1 << 0)    // job running: resume at `offset`
+#define JOURNAL_RELATIVE    (1 << 1)    // G91
+#define JOURNAL_RELATIVE_E  (1 << 2)    // M83
+#define JOURNAL_INCH        (1 << 3)    // G20
+
+typedef struct {
+    char path[JOURNAL_PATH];    // file being printed
+    uint32_t offset;            // byte offset of the next command in file
+    float position[NUM_AXIS];   // logical XYZE after the last command (mm)
+    float feedrate;             // mm/s
+    float target[JOURNAL_HEATERS];  // M140/M104 targets (degC)
+    uint8_t fan[JOURNAL_FANS];  // M106 S values
+    uint8_t extruder;           // T0-T2
+    uint8_t flags;              // JOURNAL_XXX
+    uint8_t reserved[3];
+} journal_state_t;
+
+typedef struct {
+    uint32_t magic;             // JOURNAL_MAGIC
+    uint32_t generation;        // counts sector rotations
+    uint32_t crc;
+} journal_header_t;
+
+typedef struct {
+    uint32_t seq;               // record number, counts up across sectors
+    journal_state_t state;
+    uint32_t crc;               // of seq and state
+} journal_record_t;
+
+typedef struct {
+    // Read/program `len` bytes at `addr` of the region. Return false on error.
+    bool (*read)(uint32_t addr, void *buf, size_t len, void *arg);
+    bool (*write)(uint32_t addr, const void *buf, size_t len, void *arg);
+    bool (*erase)(uint32_t sector, void *arg);  // set sector to 0xFF
+    uint32_t sectors;           // region size in JOURNAL_SECTOR
+    void *arg;
+} journal_flash_t;
+
+typedef struct {
+    uint32_t records;           // records written
+    uint32_t erases;            // sectors erased
+    uint32_t skipped;           // invalid records found by mount (torn)
+    uint32_t previous;          // mount found last record in previous sector
+    uint32_t errors;            // flash operations failed
+    uint32_t mount_reads;       // bytes read by last mount
+} journal_stats_t;
+
+typedef struct {
+    journal_flash_t flash;
+    uint32_t sector;            // current sector
+    uint32_t generation;        // of current sector (0: none valid)
+    uint32_t slot;              // next slot to write in current sector
+    uint32_t seq;               // of last valid record
+    uint32_t interval;          // ms between records, 0 to disable
+    uint32_t last_ms;           // time of last record
+    bool pending;               // `state` differs from last record
+    bool valid;                 // a record was found or written
+    journal_state_t state;      // latest state (recovered by mount)
+    journal_stats_t stats;
+} journal_t;
+
+/* Scan the region and load the last valid record into `j->state`.
+ * Return true if one was found.
+ */
+bool journal_mount(journal_t *j, const journal_flash_t *flash,
+                   uint32_t interval_ms);
+
+void journal_update(journal_t *j, const journal_state_t *state);
+bool journal_tick(journal_t *j, uint32_t now_ms);   // true if written
+bool journal_flush(journal_t *j, uint32_t now_ms);  // write pending state
+
+// Track heater targets, fans and extruder set by `cmd` into `state`
+void journal_track(journal_state_t *state, const gcode_cmd_t *cmd);
+
+uint32_t journal_crc32(uint32_t crc, const void *buf, size_t len);
+
+#endif // _JOURNAL_H_
@@ -8,6 +8,12 @@
 #include "server.h"
 #include "console.h"
 #include "filesys.h"
+#include "stepper.h"
+#include "estimate.h"
+#include "job.h"
+#include "heater.h"
+#include "softpwm.h"
+#include "endstop.h"
 
 #include "esp_task_wdt.h"
 
@@ -44,7 +50,12 @@ void fs_initialize() {
  * Task list:
  *  WiFi/AsyncTCP/WebServer Core 0
  *  Console (command dispatcher) Core 1
- *  Marlin GCode parser Core 1
+ *  Motion (planner + step generator) Core 1, step timer ISR Core 1
+ *  Estimate (print time of uploaded G-code, low priority) Core 0
+ *  Job (feed G-code file to motion, power-loss journal) Core 0
+ *  Heater (PID of bed and nozzles every 100ms) Core 0
+ *  SoftPWM (slots of expander outputs: heaters, fans, valves) Core 0
+ *  Endstop (read and debounce on interrupt, halt axes, highest) Core 0
  */
 
 void init() {
@@ -54,6 +65,11 @@ void init() {
     ESP_LOGI(TAG, "Init Task Watchdog Timer");	twdt_initialize();
     ESP_LOGI(TAG, "Init File Systems");         fs_initialize();
     ESP_LOGI(TAG, "Init GPIO Drivers");	        driver_initialize();
+    ESP_LOGI(TAG, "Init Step Engine");          stepper_initialize();
+    ESP_LOGI(TAG, "Init Endstops");             endstop_initialize();
+    ESP_LOGI(TAG, "Init Software PWM");         softpwm_initialize();
+    ESP_LOGI(TAG, "Init Heater Control");       heater_initialize();
+    ESP_LOGI(TAG, "Init Print Job Journal");    job_initialize();
     ESP_LOGI(TAG, "Init WiFi Connection");	    wifi_initialize();
     ESP_LOGI(TAG, "Init Command Line Console"); console_initialize();
     fflush(stdout);
@@ -63,6 +79,12 @@ void setup() {
     wifi_loop_begin();
     server_loop_begin();
     console_loop_begin();
+    stepper_loop_begin();
+    estimate_loop_begin();
+    job_loop_begin();
+    endstop_loop_begin();
+    softpwm_loop_begin();
+    heater_loop_begin();
 }
 
 void loop() {
@@ -0,0 +1,180 @@
+/*
+ * File: mesh.cpp
+ * Authors: Hank <hankso1106@gmail.com>
+ * Create: 2026-10-17 21:58:16
+ */
+
+#include "mesh.h"
+
+#include "math.h"
+#include "sys/param.h"
+#include <strings.h>
+
+#define MESH_NUDGE          1e-4f       // mm past a boundary we stand on
+
+mesh_mode_t mesh_parse(const char *name) {
+    if (!strcasecmp(name, "bilinear")) return MESH_BILINEAR;
+    if (!strcasecmp(name, "bicubic")) return MESH_BICUBIC;
+    return MESH_OFF;
+}
+
+static inline float height(const mesh_grid_t *g, int i, int j) {
+    return g->z[j * g->nx + i];
+}
+
+// Slopes per cell by central differences, one sided at borders
+static float slope_x(const mesh_grid_t *g, int i, int j) {
+    int lo = i > 0 ? i - 1 : i, hi = i < g->nx - 1 ? i + 1 : i;
+    return (height(g, hi, j) - height(g, lo, j)) / (hi - lo);
+}
+
+static float slope_y(const mesh_grid_t *g, int i, int j) {
+    int lo = j > 0 ? j - 1 : j, hi = j < g->ny - 1 ? j + 1 : j;
+    return (height(g, i, hi) - height(g, i, lo)) / (hi - lo);
+}
+
+static float slope_xy(const mesh_grid_t *g, int i, int j) {
+    int lo = j > 0 ? j - 1 : j, hi = j < g->ny - 1 ? j + 1 : j;
+    return (slope_x(g, i, hi) - slope_x(g, i, lo)) / (hi - lo);
+}
+
+static void bicubic(const mesh_grid_t *g, int cx, int cy, float a[16]) {
+    static const float M[4][4] = {
+        { 1, 0, 0, 0 }, { 0, 0, 1, 0 }, { -3, 3, -2, -1 }, { 2, -2, 1, 1 }
+    };
+    float F[4][4], T[4][4];
+    for (int i = 0; i < 2; i++) {
+        for (int j = 0; j < 2; j++) {
+            F[i][j] = height(g, cx + i, cy + j);
+            F[i][j + 2] = slope_y(g, cx + i, cy + j);
+            F[i + 2][j] = slope_x(g, cx + i, cy + j);
+            F[i + 2][j + 2] = slope_xy(g, cx + i, cy + j);
+        }
+    }
+    // A = M * F * M^T
+    for (int i = 0; i < 4; i++) {
+        for (int j = 0; j < 4; j++) {
+            T[i][j] = 0;
+            for (int k = 0; k < 4; k++) T[i][j] += M[i][k] * F[k][j];
+        }
+    }
+    for (int i = 0; i < 4; i++) {
+        for (int j = 0; j < 4; j++) {
+            a[i * 4 + j] = 0;
+            for (int k = 0; k < 4; k++) a[i * 4 + j] += T[i][k] * M[j][k];
+        }
+    }
+}
+
+bool mesh_init(mesh_t *mesh, const mesh_grid_t *g, mesh_mode_t mode) {
+    mesh->mode = MESH_OFF;
+    if (mode == MESH_OFF) return true;
+    if (g->nx < 2 || g->ny < 2 || g->nx > MESH_MAX_POINTS ||
+        g->ny > MESH_MAX_POINTS || g->x1 <= g->x0 || g->y1 <= g->y0)
+        return false;
+    mesh->nx = g->nx;
+    mesh->ny = g->ny;
+    mesh->x0 = g->x0;
+    mesh->y0 = g->y0;
+    mesh->inv_dx = (g->nx - 1) / (g->x1 - g->x0);
+    mesh->inv_dy = (g->ny - 1) / (g->y1 - g->y0);
+    for (int cy = 0; cy < g->ny - 1; cy++) {
+        for (int cx = 0; cx < g->nx - 1; cx++) {
+            float *a = mesh->coef[cy * (g->nx - 1) + cx];
+            if (mode == MESH_BICUBIC) {
+                bicubic(g, cx, cy, a);
+                continue;
+            }
+            float z00 = height(g, cx, cy), z10 = height(g, cx + 1, cy);
+            float z01 = height(g, cx, cy + 1), z11 = height(g, cx + 1, cy + 1);
+            memset(a, 0, 16 * sizeof(float));
+            a[0] = z00;
+            a[1] = z01 - z00;                   // v
+            a[4] = z10 - z00;                   // u
+            a[5] = z11 - z10 - z01 + z00;       // u v
+        }
+    }
+    mesh->mode = mode;
+    return true;
+}
+
+float mesh_z(const mesh_t *mesh, float x, float y) {
+    if (mesh->mode == MESH_OFF) return 0;
+    float fx = (x - mesh->x0) * mesh->inv_dx;
+    float fy = (y - mesh->y0) * mesh->inv_dy;
+    int cx = fx < 0 ? 0 : MIN((int)fx, mesh->nx - 2);
+    int cy = fy < 0 ? 0 : MIN((int)fy, mesh->ny - 2);
+    float u = MIN(MAX(fx - cx, 0), 1), v = MIN(MAX(fy - cy, 0), 1);
+    const float *a = mesh->coef[cy * (mesh->nx - 1) + cx];
+    if (mesh->mode == MESH_BILINEAR) {
+        return a[0] + a[1] * v + u * (a[4] + a[5] * v);
+    }
+    float z = 0;
+    for (int i = 3; i >= 0; i--) {
+        const float *r = a + i * 4;
+        z = z * u + (((r[3] * v + r[2]) * v + r[1]) * v + r[0]);
+    }
+    return z;
+}
+
+// Fraction of the line where it reaches the next grid line along one axis
+static float next_line(float a, float b, float t, float origin, float inv,
+                       int num) {
+    float d = b - a;
+    if (fabsf(d) < 1e-6f) return 1;
+    float p = a + t * d + (d > 0 ? MESH_NUDGE : -MESH_NUDGE);
+    float f = (p - origin) * inv;
+    int k = d > 0 ? (int)floorf(f) + 1 : (int)ceilf(f) - 1;
+    if (d > 0 && k < 0) k = 0;
+    if (d < 0 && k > num - 1) k = num - 1;
+    if (k < 0 || k > num - 1) return 1;
+    float s = (origin + k / inv - a) / d;
+    return s > t && s < 1 ? s : 1;
+}
+
+float mesh_next(const mesh_t *mesh, const float a[2], const float b[2],
+                float t) {
+    if (mesh->mode == MESH_OFF) return 1;
+    float tx = next_line(a[0], b[0], t, mesh->x0, mesh->inv_dx, mesh->nx);
+    float ty = next_line(a[1], b[1], t, mesh->y0, mesh->inv_dy, mesh->ny);
+    return MIN(tx, ty);
+}
+
+size_t mesh_pack(const mesh_grid_t *g, void *buf, size_t len) {
+    size_t n = g->nx * g->ny;
+    if (g->nx > MESH_MAX_POINTS || g->ny > MESH_MAX_POINTS ||
+        len < MESH_PACKED_SIZE(g->nx, g->ny)) return 0;
+    int16_t area[4] = {
+        (int16_t)lroundf(g->x0 * 10), (int16_t)lroundf(g->y0 * 10),
+        (int16_t)lroundf(g->x1 * 10), (int16_t)lroundf(g->y1 * 10),
+    };
+    uint8_t *p = (uint8_t *)buf;
+    p[0] = g->nx;
+    p[1] = g->ny;
+    memcpy(p + 2, area, sizeof(area));
+    for (size_t i = 0; i < n; i++) {
+        float um = MIN(MAX(g->z[i] * 1000, INT16_MIN), INT16_MAX);
+        int16_t z = lroundf(um);
+        memcpy(p + 10 + 2 * i, &z, 2);
+    }
+    return MESH_PACKED_SIZE(g->nx, g->ny);
+}
+
+bool mesh_unpack(mesh_grid_t *g, const void *buf, size_t len) {
+    const uint8_t *p = (const uint8_t *)buf;
+    int16_t area[4], z;
+    if (len < 2 || p[0] > MESH_MAX_POINTS || p[1] > MESH_MAX_POINTS ||
+        len < MESH_PACKED_SIZE(p[0], p[1])) return false;
+    g->nx = p[0];
+    g->ny = p[1];
+    memcpy(area, p + 2, sizeof(area));
+    g->x0 = area[0] / 10.0f;
+    g->y0 = area[1] / 10.0f;
+    g->x1 = area[2] / 10.0f;
+    g->y1 = area[3] / 10.0f;
+    for (size_t i = 0; i < (size_t)g->nx * g->ny; i++) {
+        memcpy(&z, p + 10 + 2 * i, 2);
+        g->z[i] = z / 1000.0f;
+    }
+    return true;
+}
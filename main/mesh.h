@@ -0,0 +1,74 @@
+/*
+ * File: mesh.h
+ * Authors: Hank <hankso1106@gmail.com>
+ * Create: 2026-10-17 21:58:16
+ *
+ * Bed mesh Z compensation. A grid of nx * ny probed heights covers the
+ * rectangle [x0, x1] * [y0, y1]. Each cell gets its polynomial coefficients
+ * computed once, so correcting a point costs one cell lookup and a few
+ * multiply-adds:
+ *
+ *      bilinear    z = a00 + a10 u + a01 v + a11 u v               (3 FMA)
+ *      bicubic     z = sum a_ij u^i v^j, i, j = 0..3 by Horner     (15 FMA)
+ *
+ * with (u, v) in [0, 1] the position inside the cell. Bicubic cells match
+ * heights and slopes (central differences of neighbour points) at corners,
+ * so the surface is smooth across cells. Outside the grid the border value
+ * is extended.
+ *
+ * Inside a cell the correction is not linear, so the motion layer splits
+ * lines where they cross cell boundaries (see mesh_next). For bicubic, the
+ * surface between boundaries still bends a little: keep cells small compared
+ * to its curvature.
+ *
+ * Stored in NVS as packed int16 (0.1mm for area, 1um for heights): 10 bytes
+ * header + 2 bytes per point.
+ */
+
+#ifndef _MESH_H_
+#define _MESH_H_
+
+#include "globals.h"
+
+#define MESH_MAX_POINTS     10          // per axis
+#define MESH_MAX_CELLS      ((MESH_MAX_POINTS - 1) * (MESH_MAX_POINTS - 1))
+#define MESH_PACKED_SIZE(nx, ny) ((size_t)(10 + 2 * (nx) * (ny)))
+
+typedef enum {
+    MESH_OFF,
+    MESH_BILINEAR,
+    MESH_BICUBIC,
+} mesh_mode_t;
+
+typedef struct {
+    uint8_t nx, ny;                 // number of points (2 to MESH_MAX_POINTS)
+    float x0, y0, x1, y1;           // probed area (mm)
+    float z[MESH_MAX_POINTS * MESH_MAX_POINTS];     // heights, row by row
+} mesh_grid_t;
+
+typedef struct {
+    mesh_mode_t mode;
+    uint8_t nx, ny;
+    float x0, y0;
+    float inv_dx, inv_dy;           // cells per mm
+    float coef[MESH_MAX_CELLS][16]; // a_ij at [i * 4 + j]
+} mesh_t;
+
+mesh_mode_t mesh_parse(const char *name);   // "off|bilinear|bicubic"
+
+// Compute cell coefficients of `grid`. Return false if grid is invalid.
+bool mesh_init(mesh_t *mesh, const mesh_grid_t *grid, mesh_mode_t mode);
+
+float mesh_z(const mesh_t *mesh, float x, float y);
+
+/* Next position (as fraction of line from `a` to `b`) after `t` where the
+ * line crosses a cell boundary, or 1 if it stays in the cell till the end.
+ */
+float mesh_next(const mesh_t *mesh, const float a[2], const float b[2],
+                float t);
+
+// Compact storage. Return bytes used (0 if `len` is too small or invalid).
+size_t mesh_pack(const mesh_grid_t *grid, void *buf, size_t len);
+bool mesh_unpack(mesh_grid_t *grid, const void *buf, size_t len);
+
+#endif // _MESH_H_
@@ -0,0 +1,308 @@
+/*
+ * File: motion.cpp
+ * Authors: Hank <hankso1106@gmail.com>
+ * Create: 2026-10-17 11:48:03
+ */
+
+#include "motion.h"
+
+#include "math.h"
+
+motion_config_t motion_config = {
+    .arc_tolerance = 0.01,
+    .arc_min_time = 0.004,          // 32 blocks >= 128ms
+};
+
+static const char axis_letters[NUM_AXIS] = { 'X', 'Y', 'Z', 'E' };
+
+static motion_t motion;                 // planner set by motion_initialize
+
+void motion_initialize(motion_t *m, planner_t *pl) {
+    memset(m, 0, sizeof(motion_t));
+    m->state.feedrate = 25;         // F1500 mm/min
+    m->state.units = 1;
+    m->planner = pl;
+    planner_initialize(pl);
+}
+
+const motion_state_t * motion_state(motion_t *m) { return &m->state; }
+
+// Resolve target position from X/Y/Z/E parameters by modal states
+static bool get_target(motion_t *m, const gcode_cmd_t *cmd,
+                       float target[NUM_AXIS]) {
+    bool moved = false;
+    float value;
+    for (uint8_t i = 0; i < NUM_AXIS; i++) {
+        target[i] = m->state.position[i];
+        if (!gcode_param(cmd, axis_letters[i], &value)) continue;
+        value *= m->state.units;
+        bool relative = i == AXIS_E ? m->state.relative_e : m->state.relative;
+        target[i] = relative ? target[i] + value : value;
+        moved = true;
+    }
+    return moved;
+}
+
+// Queue pieces of the split line until planner is full
+static motion_err_t split_continue(motion_t *m) {
+    split_t *sp = &m->split;
+    float point[NUM_AXIS];
+    while (sp->t < 1) {
+        if (planner_full(m->planner)) return MOTION_BUSY;
+        float t = mesh_next(m->mesh, sp->start, sp->target, sp->t);
+        for (uint8_t i = 0; i < NUM_AXIS; i++) {
+            point[i] = t < 1 ? sp->start[i] + t * (sp->target[i] - sp->start[i])
+                             : sp->target[i];
+        }
+        point[AXIS_Z] += mesh_z(m->mesh, point[AXIS_X], point[AXIS_Y]);
+        planner_buffer_line(m->planner, point, m->state.feedrate, sp->line,
+                            m->state.extruder);
+        if (t < 1) m->state.mesh_segments++;
+        sp->t = t;
+    }
+    sp->active = false;
+    return MOTION_OK;
+}
+
+// Queue a line to logical `target`, corrected by mesh if there is one
+static motion_err_t line_to(motion_t *m, const float target[NUM_AXIS],
+                            uint32_t line) {
+    motion_err_t err = MOTION_OK;
+    if (!m->mesh) {
+        planner_buffer_line(m->planner, target, m->state.feedrate, line,
+                            m->state.extruder);
+    } else {
+        split_t *sp = &m->split;
+        memcpy(sp->start, m->queued, sizeof(sp->start));
+        memcpy(sp->target, target, sizeof(sp->target));
+        sp->t = 0;
+        sp->line = line;
+        sp->active = true;
+        err = split_continue(m);
+    }
+    memcpy(m->queued, target, sizeof(m->queued));
+    return err;
+}
+
+static motion_err_t linear_move(motion_t *m, const gcode_cmd_t *cmd) {
+    float target[NUM_AXIS], value;
+    if (m->split.active) return split_continue(m);  // same command again
+    if (planner_full(m->planner)) return MOTION_BUSY;
+    if (gcode_param(cmd, 'F', &value) && value > 0) {
+        m->state.feedrate = value * m->state.units / 60;
+    }
+    if (!get_target(m, cmd, target)) return MOTION_OK;
+    int32_t line = cmd->flags & GCODE_HAS_LINE ? cmd->line : 0;
+    memcpy(m->state.position, target, sizeof(target));
+    return line_to(m, target, line);
+}
+
+// Compute arc from current position to `target` (G2 if `cw`, else G3)
+static bool arc_init(motion_t *m, const gcode_cmd_t *cmd,
+                     const float target[NUM_AXIS], bool cw) {
+    arc_t *arc = &m->arc;
+    const float *pos = m->state.position;
+    float x = target[AXIS_X] - pos[AXIS_X], y = target[AXIS_Y] - pos[AXIS_Y];
+    float i = 0, j = 0, r;
+    if (gcode_param(cmd, 'R', &r)) {
+        // center is on the bisector of start & target, at distance h
+        r *= m->state.units;
+        float d2 = x * x + y * y, h2 = 4 * r * r - d2;
+        if (d2 < 1e-12f || h2 < 0) return false;
+        float h = -sqrtf(h2 / d2);
+        if (!cw) h = -h;
+        if (r < 0) h = -h;          // negative R: arc longer than 180 degree
+        i = 0.5f * (x - y * h);
+        j = 0.5f * (y + x * h);
+    } else {
+        bool has_i = gcode_param(cmd, 'I', &i);
+        bool has_j = gcode_param(cmd, 'J', &j);
+        if (!has_i && !has_j) return false;
+        i *= m->state.units;
+        j *= m->state.units;
+    }
+    arc->center[0] = pos[AXIS_X] + i;
+    arc->center[1] = pos[AXIS_Y] + j;
+    arc->radius[0] = -i;
+    arc->radius[1] = -j;
+    float radius = sqrtf(i * i + j * j);
+    if (radius < MOTION_ARC_MIN_LENGTH) return false;
+    float rt0 = x - i, rt1 = y - j;
+    float angle = atan2f(arc->radius[0] * rt1 - arc->radius[1] * rt0,
+                         arc->radius[0] * rt0 + arc->radius[1] * rt1);
+    // same start & target is a full circle
+    const float eps = 5e-7f;
+    if (cw) {
+        if (angle >= -eps) angle -= 2 * M_PI;
+    } else if (angle <= eps) {
+        angle += 2 * M_PI;
+    }
+
+    // chord of length L deviates L^2 / 8r from the arc
+    float tol = motion_config.arc_tolerance;
+    float len = tol < radius ? 2 * sqrtf(tol * (2 * radius - tol)) : radius;
+    float min_len = m->state.feedrate * motion_config.arc_min_time;
+    if (len < min_len) len = min_len;
+    if (len < MOTION_ARC_MIN_LENGTH) len = MOTION_ARC_MIN_LENGTH;
+    float travel = hypotf(angle * radius, target[AXIS_Z] - pos[AXIS_Z]);
+    arc->segments = ceilf(travel / len);
+    if (arc->segments < 1) arc->segments = 1;
+    arc->theta = angle / arc->segments;
+    arc->cos_t = cosf(arc->theta);
+    arc->sin_t = sinf(arc->theta);
+    memcpy(arc->r, arc->radius, sizeof(arc->r));
+    memcpy(arc->start, pos, sizeof(arc->start));
+    memcpy(arc->target, target, sizeof(arc->target));
+    arc->done = 0;
+    arc->line = cmd->flags & GCODE_HAS_LINE ? cmd->line : 0;
+    arc->active = true;
+    return true;
+}
+
+// Queue remaining segments of the arc until planner is full
+static motion_err_t arc_continue(motion_t *m) {
+    arc_t *arc = &m->arc;
+    float point[NUM_AXIS];
+    if (m->split.active && split_continue(m) == MOTION_BUSY) {
+        return MOTION_BUSY;
+    }
+    while (arc->done < arc->segments) {
+        if (planner_full(m->planner)) return MOTION_BUSY;
+        uint32_t n = ++arc->done;
+        if (n == arc->segments) {
+            memcpy(point, arc->target, sizeof(point));
+        } else {
+            float r0 = arc->r[0], r1 = arc->r[1];
+            if (n % MOTION_ARC_CORRECTION) {
+                arc->r[0] = r0 * arc->cos_t - r1 * arc->sin_t;
+                arc->r[1] = r0 * arc->sin_t + r1 * arc->cos_t;
+            } else {
+                // rotate start point exactly to remove accumulated error
+                float c = cosf(n * arc->theta), s = sinf(n * arc->theta);
+                arc->r[0] = arc->radius[0] * c - arc->radius[1] * s;
+                arc->r[1] = arc->radius[0] * s + arc->radius[1] * c;
+            }
+            float k = (float)n / arc->segments;
+            for (uint8_t i = 0; i < NUM_AXIS; i++) {
+                point[i] = arc->start[i] +
+                           k * (arc->target[i] - arc->start[i]);
+            }
+            point[AXIS_X] = arc->center[0] + arc->r[0];
+            point[AXIS_Y] = arc->center[1] + arc->r[1];
+        }
+        m->state.arc_segments++;
+        if (line_to(m, point, arc->line) == MOTION_BUSY) return MOTION_BUSY;
+    }
+    arc->active = false;
+    return MOTION_OK;
+}
+
+static motion_err_t arc_move(motion_t *m, const gcode_cmd_t *cmd,
+                             bool cw) {
+    float target[NUM_AXIS], value;
+    if (m->arc.active) return arc_continue(m);  // same command again
+    if (gcode_param(cmd, 'F', &value) && value > 0) {
+        m->state.feedrate = value * m->state.units / 60;
+    }
+    get_target(m, cmd, target);
+    if (!arc_init(m, cmd, target, cw)) {
+        return linear_move(m, cmd);            // degenerated: straight line
+    }
+    memcpy(m->state.position, target, sizeof(target));
+    return arc_continue(m);
+}
+
+static void set_position(motion_t *m, const float target[NUM_AXIS]) {
+    float physical[NUM_AXIS];
+    memcpy(physical, target, sizeof(physical));
+    if (m->mesh) {
+        physical[AXIS_Z] += mesh_z(m->mesh, target[AXIS_X], target[AXIS_Y]);
+    }
+    memcpy(m->state.position, target, sizeof(m->state.position));
+    memcpy(m->queued, target, sizeof(m->queued));
+    planner_set_position(m->planner, physical);
+}
+
+void motion_set_mesh(motion_t *m, const mesh_t *mesh) {
+    m->mesh = mesh && mesh->mode != MESH_OFF ? mesh : NULL;
+    float target[NUM_AXIS];
+    memcpy(target, m->queued, sizeof(target));
+    m->split.active = false;
+    set_position(m, target);
+}
+
+motion_err_t motion_execute(motion_t *m, const gcode_cmd_t *cmd) {
+    float target[NUM_AXIS];
+    if (cmd->letter == 'G') {
+        switch (cmd->code) {
+        case 0: case 1:
+            return linear_move(m, cmd);
+        case 2: case 3:
+            return arc_move(m, cmd, cmd->code == 2);
+        case 4:
+            return MOTION_OK;
+        case 20:
+            m->state.units = 25.4; return MOTION_OK;
+        case 21:
+            m->state.units = 1; return MOTION_OK;
+        case 28: {
+            bool all = true;
+            for (uint8_t i = 0; i < AXIS_E; i++) {
+                if (gcode_seen(cmd, axis_letters[i])) all = false;
+            }
+            memcpy(target, m->state.position, sizeof(target));
+            for (uint8_t i = 0; i < AXIS_E; i++) {
+                if (all || gcode_seen(cmd, axis_letters[i])) target[i] = 0;
+            }
+            set_position(m, target);
+            return MOTION_OK;
+        }
+        case 90:
+            m->state.relative = m->state.relative_e = false; return MOTION_OK;
+        case 91:
+            m->state.relative = m->state.relative_e = true; return MOTION_OK;
+        case 92: {
+            // G92 values are always absolute
+            bool rel = m->state.relative, rel_e = m->state.relative_e;
+            m->state.relative = m->state.relative_e = false;
+            get_target(m, cmd, target);
+            m->state.relative = rel;
+            m->state.relative_e = rel_e;
+            set_position(m, target);
+            return MOTION_OK;
+        }
+        }
+    } else if (cmd->letter == 'M') {
+        switch (cmd->code) {
+        case 82:
+            m->state.relative_e = false; return MOTION_OK;
+        case 83:
+            m->state.relative_e = true; return MOTION_OK;
+        }
+    } else if (cmd->letter == 'T') {
+        if (cmd->code >= NUM_EXTRUDER) return MOTION_UNKNOWN;
+        m->state.extruder = cmd->code;
+        return MOTION_OK;
+    }
+    return MOTION_UNKNOWN;
+}
+
+float motion_dwell(const gcode_cmd_t *cmd) {
+    float value;
+    if (cmd->letter != 'G' || cmd->code != 4) return -1;
+    if (gcode_param(cmd, 'P', &value)) return fmaxf(value, 0) / 1000;
+    if (gcode_param(cmd, 'S', &value)) return fmaxf(value, 0);
+    return 0;
+}
+
+// Default instance
+
+void motion_initialize() { motion_initialize(&motion, &planner); }
+
+motion_err_t motion_execute(const gcode_cmd_t *cmd) {
+    return motion_execute(&motion, cmd);
+}
+
+const motion_state_t * motion_state() { return &motion.state; }
+
+void motion_set_mesh(const mesh_t *mesh) { motion_set_mesh(&motion, mesh); }
@@ -0,0 +1,122 @@
+/*
+ * File: motion.h
+ * Authors: Hank <hankso1106@gmail.com>
+ * Create: 2026-10-17 11:48:03
+ *
+ * G-code interpreter for motion commands: keeps modal states (absolute or
+ * relative positioning, units, feedrate) and turns parsed moves into planner
+ * blocks.
+ *
+ * Supported commands:
+ *  G0/G1   linear move             G20/G21 inch/millimeter units
+ *  G2/G3   CW/CCW arc in XY plane  G28     home (zero given axes or XYZ)
+ *  G4      dwell (see below)       G92     set position
+ *  G90/G91 absolute/relative       M82/M83 absolute/relative E
+ *  T0-T2   select extruder E1-E3
+ *
+ * G4 queues nothing: the caller lets the queued moves finish (the last one
+ * stops) and then waits `motion_dwell`, so the pause is spent at rest.
+ *
+ * Arcs (center by I/J offsets or radius by R) are split into lines whose
+ * chord deviates at most `arc_tolerance` from the circle. Segments are
+ * rotated incrementally by a fixed rotation matrix and the exact position is
+ * recomputed every MOTION_ARC_CORRECTION segments to stop drift. Segments
+ * last at least `arc_min_time` at the feedrate (chord error may exceed the
+ * tolerance then), so that a ring of short blocks still holds enough motion
+ * for look-ahead. An arc may fill the
+ * planner many times: MOTION_BUSY is returned and the rest of the arc is
+ * queued when the same command is executed again.
+ *
+ * With a bed mesh set, Z of every line end is corrected by the mesh height
+ * at its XY, and lines (including arc segments) are split where they cross
+ * mesh cells, so the path follows the surface. Logical positions (G-code
+ * coordinates) are kept in `motion_state_t`, the planner gets corrected ones.
+ *
+ * Functions without `motion_t *` work on the default instance, which feeds
+ * the default planner. Other instances own their planner (e.g. print time
+ * estimation runs the same code over a file).
+ */
+
+#ifndef _MOTION_H_
+#define _MOTION_H_
+
+#include "gcode.h"
+#include "planner.h"
+#include "mesh.h"
+
+#define MOTION_ARC_CORRECTION   16  // exact arc position every N segments
+#define MOTION_ARC_MIN_LENGTH   0.01f   // mm
+
+typedef struct {
+    float arc_tolerance;        // max distance between chord and arc (mm)
+    float arc_min_time;         // min time per arc segment (s)
+} motion_config_t;
+
+typedef enum {
+    MOTION_OK = 0,
+    MOTION_BUSY,        // planner is full, execute the same command again
+    MOTION_UNKNOWN,     // not a motion command: skipped
+} motion_err_t;
+
+typedef struct {
+    float position[NUM_AXIS];   // logical position of last target (mm)
+    float feedrate;             // mm/s
+    float units;                // 1 for mm, 25.4 for inch
+    bool relative;              // G91
+    bool relative_e;            // M83
+    uint8_t extruder;           // T0-T2
+    uint32_t arc_segments;      // lines queued for G2/G3
+    uint32_t mesh_segments;     // extra lines from splitting at mesh cells
+} motion_state_t;
+
+// Arc being split into lines, kept while planner is full
+typedef struct {
+    bool active;
+    float center[2];            // XY
+    float radius[2];            // start point relative to center
+    float start[NUM_AXIS];
+    float target[NUM_AXIS];
+    float theta;                // angle per segment (rad, signed)
+    float cos_t, sin_t;         // rotation matrix of `theta`
+    float r[2];                 // current point relative to center
+    uint32_t segments, done;
+    uint32_t line;
+} arc_t;
+
+// Line being split at mesh cells, kept while planner is full
+typedef struct {
+    bool active;
+    float start[NUM_AXIS];      // logical positions
+    float target[NUM_AXIS];
+    float t;                    // fraction of the line queued
+    uint32_t line;
+} split_t;
+
+typedef struct {
+    planner_t *planner;         // blocks are queued here
+    const mesh_t *mesh;         // Z correction (NULL if disabled)
+    motion_state_t state;
+    float queued[NUM_AXIS];     // logical position of last queued line end
+    arc_t arc;
+    split_t split;
+} motion_t;
+
+extern motion_config_t motion_config;
+
+void motion_initialize(motion_t *m, planner_t *pl);    // also init `pl`
+motion_err_t motion_execute(motion_t *m, const gcode_cmd_t *cmd);
+const motion_state_t * motion_state(motion_t *m);
+
+// Set bed mesh (NULL to disable). Only call it when motion is settled.
+void motion_set_mesh(motion_t *m, const mesh_t *mesh);
+
+// Pause of G4 in seconds (P in ms, or S), -1 if `cmd` is not G4.
+float motion_dwell(const gcode_cmd_t *cmd);
+
+// Same on the default instance
+void motion_initialize();
+motion_err_t motion_execute(const gcode_cmd_t *cmd);
+const motion_state_t * motion_state();
+void motion_set_mesh(const mesh_t *mesh);
+
+#endif // _MOTION_H_
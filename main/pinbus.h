@@ -0,0 +1,47 @@
+/*
+ * File: pinbus.h
+ * Authors: Hank <hankso1106@gmail.com>
+ * Create: 2026-10-18 00:20:36
+ *
+ * Transports under the expander pin layer (pins.cpp). The pin layer keeps
+ * the output patterns of the PCF8574 and 74HC595 chips and maps pin numbers
+ * to bits; these functions only move bytes. On ESP32 they are the I2C and
+ * HSPI drivers in drivers.cpp. Host builds (tools/bench/vchip.cpp) put
+ * virtual chips behind them instead, which record every output transition.
+ */
+
+#ifndef _PINBUS_H_
+#define _PINBUS_H_
+
+#include "drivers.h"
+
+/* One I2C transaction: address byte, then `size` bytes written or read.
+ * `size` 0 only checks if the address is acknowledged.
+ */
+esp_err_t pinbus_i2c(uint8_t addr, bool read, uint8_t *data, size_t size);
+
+/* One byte with each of `num` chips (up to I2C_PIN_CHIPS) in one
+ * transaction: repeated START between them, one STOP at the end. data[i] is
+ * read from addr[i] if bit i of `rmask` is set, else written to it. The
+ * command link of a chip list is built once and reused.
+ */
+esp_err_t pinbus_i2c_xfer(const uint8_t *addr, uint8_t rmask, uint8_t *data,
+                          size_t num);
+
+// Shift one frame into the 74HC595 chain and latch it, wait until done
+esp_err_t pinbus_spi_write(spi_frame_t frame);
+
+// Queue one frame as a transaction, block only when the queue is full
+esp_err_t pinbus_spi_queue(spi_frame_t frame);
+
+// Wait until all queued frames are latched
+esp_err_t pinbus_spi_wait();
+
+// Take the bus for pinbus_spi_write_isr, `frame` is output first
+esp_err_t pinbus_spi_claim(spi_frame_t frame);
+void pinbus_spi_release();
+
+// Start shifting out `frame`, wait only for the previous one (IRAM)
+void pinbus_spi_write_isr(spi_frame_t frame);
+
+#endif // _PINBUS_H_
@@ -0,0 +1,147 @@
+/*
+ * File: pins.cpp
+ * Authors: Hank <hankso1106@gmail.com>
+ * Create: 2026-10-18 00:20:36
+ *
+ * Pin layer of the I/O expanders, transports are in pinbus.h
+ */
+
+#include "drivers.h"
+#include "pinbus.h"
+
+#ifdef __XTENSA__
+#include "esp_attr.h"
+#include "soc/soc.h"
+#else
+#define IRAM_ATTR
+#endif
+
+// I2C GPIO Expander
+
+static uint8_t i2c_pin_data[I2C_PIN_CHIPS] = { 0, 0, 0 };
+static const uint8_t i2c_pin_addr[I2C_PIN_CHIPS] = {
+    I2C_PIN_ADDR, I2C_PIN_ADDR + 1, I2C_PIN_ADDR + 2
+};
+
+esp_err_t i2c_set_val(uint8_t idx) {
+    if (idx >= I2C_PIN_CHIPS) return ESP_ERR_INVALID_ARG;
+    return pinbus_i2c(i2c_pin_addr[idx], false, i2c_pin_data + idx, 1);
+}
+
+esp_err_t i2c_get_val(uint8_t idx) {
+    if (idx >= I2C_PIN_CHIPS) return ESP_ERR_INVALID_ARG;
+    return pinbus_i2c(i2c_pin_addr[idx], true, i2c_pin_data + idx, 1);
+}
+
+esp_err_t i2c_set_vals(uint8_t mask, const uint8_t *vals) {
+    for (uint8_t idx = 0; idx < I2C_PIN_CHIPS; idx++) {
+        if (mask & BIT(idx)) i2c_pin_data[idx] = vals[idx];
+    }
+    return i2c_sync_vals(mask, 0);
+}
+
+esp_err_t i2c_sync_vals(uint8_t wmask, uint8_t rmask) {
+    uint8_t addr[I2C_PIN_CHIPS], data[I2C_PIN_CHIPS], reads = 0, num = 0;
+    for (uint8_t idx = 0; idx < I2C_PIN_CHIPS; idx++) {
+        if (!((wmask | rmask) & BIT(idx))) continue;
+        if (rmask & BIT(idx)) reads |= BIT(num);
+        addr[num] = i2c_pin_addr[idx];
+        data[num++] = i2c_pin_data[idx];
+    }
+    if (!num) return ESP_OK;
+    esp_err_t err = pinbus_i2c_xfer(addr, reads, data, num);
+    if (err) return err;
+    for (uint8_t idx = 0, i = 0; idx < I2C_PIN_CHIPS; idx++) {
+        if (!((wmask | rmask) & BIT(idx))) continue;
+        if (rmask & BIT(idx)) i2c_pin_data[idx] = data[i];
+        i++;
+    }
+    return ESP_OK;
+}
+
+esp_err_t i2c_gpio_set_level(i2c_pin_num_t pin_num, bool level) {
+    uint8_t pin = pin_num - PIN_I2C_MIN - 1, idx = pin >> 3, bit = pin & 0x7;
+    bitWrite(i2c_pin_data[idx], bit, level);
+    return i2c_set_val(idx);
+}
+
+esp_err_t i2c_gpio_set_levels(uint8_t idx, uint8_t mask, uint8_t levels) {
+    if (idx >= I2C_PIN_CHIPS) return ESP_ERR_INVALID_ARG;
+    i2c_pin_data[idx] = (i2c_pin_data[idx] & ~mask) | (levels & mask);
+    return i2c_set_val(idx);
+}
+
+uint8_t i2c_gpio_get_level(i2c_pin_num_t pin_num, bool sync) {
+    uint8_t pin = pin_num - PIN_I2C_MIN - 1, idx = pin >> 3, bit = pin & 0x7;
+    if (sync) i2c_get_val(idx);
+    return bitRead(i2c_pin_data[idx], bit);
+}
+
+void i2c_detect() {
+    for (uint8_t i = 0; i < 0x10; i++) {
+        if (!i) printf("  ");
+        printf("  %c", i < 10 ? (i + '0') : (i - 10 + 'A'));
+    }
+    for (uint8_t addr = 0; addr < 0x80; addr++) {
+        if (addr % 0x10 == 0) printf("\n%02X", addr);
+        esp_err_t ret = pinbus_i2c(addr, false, NULL, 0);
+        switch (ret) {
+        case ESP_OK:
+            printf(" %02X", addr); break;
+        case ESP_ERR_TIMEOUT:
+            printf(" UU"); break;
+        default:
+            printf(" --");
+        }
+    }
+}
+
+// 74HC595 chain: bit n of the frame is pin PIN_SPI_MIN+1+n
+
+static spi_frame_t spi_pin_frame = 0;
+
+esp_err_t spi_gpio_flush() { return pinbus_spi_write(spi_pin_frame); }
+
+spi_frame_t spi_gpio_get_frame() { return spi_pin_frame; }
+
+esp_err_t spi_gpio_queue_frames(const spi_frame_t *frames, size_t num) {
+    esp_err_t err = ESP_OK;
+    for (size_t i = 0; i < num; i++) {
+        if ((err = pinbus_spi_queue(frames[i]))) break;
+        spi_pin_frame = frames[i];
+    }
+    return err;
+}
+
+esp_err_t spi_gpio_wait_frames() { return pinbus_spi_wait(); }
+
+static bool spi_pin_claimed = false;
+
+esp_err_t spi_gpio_claim() {
+    esp_err_t err = pinbus_spi_claim(spi_pin_frame);
+    if (!err) spi_pin_claimed = true;
+    return err;
+}
+
+void spi_gpio_release() {
+    pinbus_spi_release();
+    spi_pin_claimed = false;
+}
+
+bool spi_gpio_claimed() { return spi_pin_claimed; }
+
+void IRAM_ATTR spi_gpio_write_isr(spi_frame_t frame) {
+    pinbus_spi_write_isr(frame);
+    spi_pin_frame = frame;
+}
+
+esp_err_t spi_gpio_set_level(spi_pin_num_t pin_num, bool level) {
+    uint8_t bit = pin_num - PIN_SPI_MIN - 1;
+    bitWrite(spi_pin_frame, bit, level);
+    return spi_gpio_flush();
+}
+
+uint8_t spi_gpio_get_level(spi_pin_num_t pin_num) {
+    uint8_t bit = pin_num - PIN_SPI_MIN - 1;
+    return bitRead(spi_pin_frame, bit) != 0;
+}
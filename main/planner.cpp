@@ -0,0 +1,244 @@
+/*
+ * File: planner.cpp
+ * Authors: Hank <hankso1106@gmail.com>
+ * Create: 2026-10-17 11:05:21
+ */
+
+#include "planner.h"
+
+#include "math.h"
+#include "sys/param.h"
+
+#define BLOCK_MASK (PLANNER_BLOCKS - 1)
+#if PLANNER_BLOCKS & BLOCK_MASK
+#error "PLANNER_BLOCKS must be power of 2"
+#endif
+
+planner_config_t planner_config = {
+    .max_speed = { 300, 300, 10, 60 },
+    .step_speed = {},               // set by stepgen_update
+    .max_accel = { 3000, 3000, 100, 5000 },
+    .accel = 1500,
+    .junction_deviation = 0.013,
+    .min_speed = 0,
+    .profile = PLANNER_TRAPEZOID,
+};
+
+planner_t planner;
+
+static inline planner_block_t * block_at(planner_t *pl, uint32_t idx) {
+    return pl->blocks + (idx & BLOCK_MASK);
+}
+
+void planner_initialize(planner_t *pl) {
+    planner_reset(pl);
+    memset(pl->position, 0, sizeof(pl->position));
+    memset(&pl->stats, 0, sizeof(pl->stats));
+}
+
+void planner_reset(planner_t *pl) { pl->tail = pl->planned = pl->head = 0; }
+
+uint8_t planner_count(planner_t *pl) { return pl->head - pl->tail; }
+
+bool planner_full(planner_t *pl) {
+    return pl->head - pl->tail >= PLANNER_BLOCKS;
+}
+
+const planner_stats_t * planner_stats(planner_t *pl) { return &pl->stats; }
+
+void planner_set_position(planner_t *pl, const float pos[NUM_AXIS]) {
+    memcpy(pl->position, pos, sizeof(pl->position));
+}
+
+void planner_get_position(planner_t *pl, float pos[NUM_AXIS]) {
+    memcpy(pos, pl->position, sizeof(pl->position));
+}
+
+float planner_block_time(const planner_block_t *block) {
+    return block->accel_time + block->cruise_time + block->decel_time;
+}
+
+static float junction_speed_sqr(const planner_block_t *prev,
+                                const planner_block_t *block) {
+    float min_sqr = planner_config.min_speed * planner_config.min_speed;
+    float cos_theta = 0;
+    for (uint8_t i = AXIS_X; i <= AXIS_Z; i++) {
+        cos_theta -= prev->unit[i] * block->unit[i];
+    }
+    if (cos_theta > 0.999999f) return min_sqr;  // 180 degree reversal
+    if (cos_theta < -0.999999f) return block->nominal_speed_sqr; // straight
+    // sin(theta / 2) by trigonometric half angle identity
+    float sin_half = sqrtf(0.5f * (1 - cos_theta));
+    float v_sqr = block->accel * planner_config.junction_deviation
+                * sin_half / (1 - sin_half);
+    return v_sqr > min_sqr ? v_sqr : min_sqr;
+}
+
+static void recalculate(planner_t *pl) {
+    uint32_t head = pl->head, planned = pl->planned;
+    if (head - planned < 2) return;     // only one plannable block
+
+    // Reverse pass: newest block must be able to stop at its end
+    uint32_t idx = head - 1;
+    planner_block_t *next = block_at(pl, idx), *curr;
+    float entry = MIN(next->max_entry_speed_sqr, next->delta_v2);
+    next->entry_speed_sqr = entry;
+    while (--idx != planned) {
+        curr = block_at(pl, idx);
+        if (curr->entry_speed_sqr != curr->max_entry_speed_sqr) {
+            entry = next->entry_speed_sqr + curr->delta_v2;
+            curr->entry_speed_sqr = MIN(entry, curr->max_entry_speed_sqr);
+        }
+        next = curr;
+    }
+
+    // Forward pass: limited by acceleration from planned block
+    next = block_at(pl, planned);
+    for (idx = planned + 1; idx != head; idx++) {
+        curr = next;
+        next = block_at(pl, idx);
+        if (curr->entry_speed_sqr < next->entry_speed_sqr) {
+            entry = curr->entry_speed_sqr + curr->delta_v2;
+            if (entry < next->entry_speed_sqr) {
+                next->entry_speed_sqr = entry;
+                planned = idx;          // optimal: fully accelerated
+            }
+        }
+        if (next->entry_speed_sqr == next->max_entry_speed_sqr) {
+            planned = idx;              // optimal: at junction limit
+        }
+    }
+    pl->planned = planned;
+}
+
+bool planner_buffer_line(planner_t *pl, const float target[NUM_AXIS],
+                         float speed, uint32_t line, uint8_t extruder) {
+    if (planner_full(pl)) {
+        pl->stats.full++;
+        return false;
+    }
+    planner_block_t *block = block_at(pl, pl->head);
+    float dist = 0;
+    for (uint8_t i = 0; i < NUM_AXIS; i++) {
+        block->start[i] = pl->position[i];
+        block->delta[i] = target[i] - pl->position[i];
+        if (i != AXIS_E) dist += block->delta[i] * block->delta[i];
+    }
+    dist = sqrtf(dist);
+    if (dist < 1e-3f) dist = fabsf(block->delta[AXIS_E]);   // E only move
+    if (dist < 1e-3f) return true;      // too short: merge into next move
+
+    float inv = 1 / dist, accel = planner_config.accel;
+    for (uint8_t i = 0; i < NUM_AXIS; i++) {
+        float unit = block->unit[i] = block->delta[i] * inv;
+        if (unit < 0) unit = -unit;
+        float limit = planner_config.max_speed[i];
+        if (planner_config.step_speed[i] > 0 &&
+            planner_config.step_speed[i] < limit) {
+            limit = planner_config.step_speed[i];
+        }
+        if (unit * speed > limit) speed = limit / unit;
+        if (unit * accel > planner_config.max_accel[i]) {
+            accel = planner_config.max_accel[i] / unit;
+        }
+    }
+    block->distance = dist;
+    block->accel = accel;
+    block->delta_v2 = 2 * accel * dist;
+    block->nominal_speed_sqr = speed * speed;
+    block->entry_speed_sqr = block->exit_speed_sqr = 0;
+    block->line = line;
+    block->extruder = extruder;
+    block->flags = 0;
+
+    if (pl->head == pl->planned) {
+        // first plannable block: start from rest or from frozen exit speed
+        block->max_entry_speed_sqr = 0;
+    } else {
+        planner_block_t *prev = block_at(pl, pl->head - 1);
+        float v_sqr = junction_speed_sqr(prev, block);
+        v_sqr = MIN(v_sqr, block->nominal_speed_sqr);
+        block->max_entry_speed_sqr = MIN(v_sqr, prev->nominal_speed_sqr);
+    }
+
+    memcpy(pl->position, target, sizeof(pl->position));
+    pl->head++;
+    pl->stats.blocks++;
+    recalculate(pl);
+    return true;
+}
+
+static void calculate_trapezoid(planner_block_t *block) {
+    float a = block->accel, dist = block->distance;
+    float v0_sqr = block->entry_speed_sqr, v1_sqr = block->exit_speed_sqr;
+    float vc_sqr = block->nominal_speed_sqr;
+    float accel_dist = (vc_sqr - v0_sqr) / (2 * a);
+    float decel_dist = (vc_sqr - v1_sqr) / (2 * a);
+    if (accel_dist + decel_dist > dist) {
+        // triangle profile: cannot reach nominal speed
+        vc_sqr = (block->delta_v2 + v0_sqr + v1_sqr) / 2;
+        accel_dist = MAX(0, (vc_sqr - v0_sqr) / (2 * a));
+        accel_dist = MIN(accel_dist, dist);
+        decel_dist = dist - accel_dist;
+    }
+    float v0 = sqrtf(v0_sqr), v1 = sqrtf(v1_sqr), vc = sqrtf(vc_sqr);
+    float cruise_dist = dist - accel_dist - decel_dist;
+    block->entry_speed = v0;
+    block->exit_speed = v1;
+    block->cruise_speed = vc;
+    block->accel_dist = accel_dist;
+    block->cruise_dist = cruise_dist > 0 ? cruise_dist : 0;
+    block->accel_time = MAX(0, vc - v0) / a;
+    block->decel_time = MAX(0, vc - v1) / a;
+    block->cruise_time = vc > 0 ? block->cruise_dist / vc : 0;
+}
+
+planner_block_t * planner_current(planner_t *pl) {
+    if (pl->head == pl->tail) return NULL;
+    planner_block_t *block = block_at(pl, pl->tail);
+    if (block->flags & BLOCK_BUSY) return block;
+    // Freeze entry speed of the successor, which is our exit speed
+    if (pl->planned == pl->tail) pl->planned = pl->tail + 1;
+    if (pl->tail + 1 != pl->head) {
+        block->exit_speed_sqr = block_at(pl, pl->tail + 1)->entry_speed_sqr;
+    } else {
+        block->exit_speed_sqr = 0;
+        block->flags |= BLOCK_STARVED;
+        pl->stats.starved++;
+    }
+    block->flags |= BLOCK_BUSY;
+    if (planner_config.profile == PLANNER_SCURVE) block->flags |= BLOCK_SCURVE;
+    calculate_trapezoid(block);
+    return block;
+}
+
+void planner_discard(planner_t *pl) {
+    if (pl->head == pl->tail) return;
+    block_at(pl, pl->tail)->flags &= ~BLOCK_BUSY;
+    if (pl->planned == pl->tail) pl->planned++;
+    pl->tail++;
+}
+
+// Default instance
+
+void planner_initialize() { planner_initialize(&planner); }
+void planner_reset() { planner_reset(&planner); }
+uint8_t planner_count() { return planner_count(&planner); }
+bool planner_full() { return planner_full(&planner); }
+const planner_stats_t * planner_stats() { return planner_stats(&planner); }
+
+void planner_set_position(const float pos[NUM_AXIS]) {
+    planner_set_position(&planner, pos);
+}
+
+void planner_get_position(float pos[NUM_AXIS]) {
+    planner_get_position(&planner, pos);
+}
+
+bool planner_buffer_line(const float target[NUM_AXIS], float speed,
+                         uint32_t line, uint8_t extruder) {
+    return planner_buffer_line(&planner, target, speed, line, extruder);
+}
+
+planner_block_t * planner_current() { return planner_current(&planner); }
+void planner_discard() { planner_discard(&planner); }
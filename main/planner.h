@@ -0,0 +1,153 @@
+/*
+ * File: planner.h
+ * Authors: Hank <hankso1106@gmail.com>
+ * Create: 2026-10-17 11:05:21
+ *
+ * Look-ahead trapezoidal motion planner.
+ *
+ * Linear moves are appended to a statically allocated ring of blocks, so
+ * nothing is allocated per move. Speed at the junction of two consecutive
+ * moves is limited by junction deviation (the maximum distance the toolhead
+ * may deviate from the corner if it were following a circular arc). After
+ * each new block, entry speeds are recomputed backward (from the newest block
+ * which must stop at the end) and forward (limited by acceleration). Blocks
+ * which can no longer be improved are skipped on the next pass, so planning
+ * cost is amortized O(1) per block.
+ *
+ * The consumer (step generator) fetches the oldest block by planner_current,
+ * which freezes its entry & exit speeds and computes the trapezoid profile,
+ * then releases it by planner_discard when all steps are generated.
+ *
+ *      speed
+ *        ^   cruise_speed
+ *        |     _______________
+ *        |    /               \
+ *        |   /                 \ exit_speed
+ *        |  / entry_speed
+ *        |
+ *        +-----------------------------> time
+ *          accel    cruise    decel
+ *
+ * With PLANNER_SCURVE profile, accel/decel phases keep their duration and
+ * distance but speed follows an S-curve (see scurve.h), so look-ahead is the
+ * same for both profiles and the step generator only evaluates differently.
+ *
+ * Functions without `planner_t *` work on the default instance `planner`,
+ * fed by the motion task. Other instances (e.g. print time estimation) share
+ * `planner_config` but nothing else.
+ */
+
+#ifndef _PLANNER_H_
+#define _PLANNER_H_
+
+#include "globals.h"
+
+#define NUM_AXIS 4
+#define NUM_EXTRUDER 3      // E1-E3 take turns on AXIS_E (T0-T2)
+
+enum { AXIS_X, AXIS_Y, AXIS_Z, AXIS_E };
+
+#ifndef PLANNER_BLOCKS
+#define PLANNER_BLOCKS 32   // must be power of 2
+#endif
+
+// bits of planner_block_t.flags
+#define BLOCK_BUSY      (1 << 0)    // fetched by consumer: speeds are frozen
+#define BLOCK_STARVED   (1 << 1)    // fetched without successor: exit is 0
+#define BLOCK_SCURVE    (1 << 2)    // speed changes follow S-curve (scurve.h)
+
+typedef enum {
+    PLANNER_TRAPEZOID,
+    PLANNER_SCURVE,                 // same phase times, jerk limited speed
+} planner_profile_t;
+
+typedef struct {
+    float max_speed[NUM_AXIS];      // mm/s
+    float step_speed[NUM_AXIS];     // mm/s of step engine limit, 0: none
+    float max_accel[NUM_AXIS];      // mm/s^2
+    float accel;                    // default acceleration (mm/s^2)
+    float junction_deviation;       // mm
+    float min_speed;                // minimum junction speed (mm/s)
+    planner_profile_t profile;      // applied to blocks fetched after change
+} planner_config_t;
+
+typedef struct {
+    float start[NUM_AXIS];          // start position (mm)
+    float delta[NUM_AXIS];          // distance of each axis (mm)
+    float unit[NUM_AXIS];           // unit vector of movement
+    float distance;                 // XYZ length (or |E| for E only moves)
+    float accel;                    // mm/s^2
+    float nominal_speed_sqr;        // (mm/s)^2 requested feedrate
+    float max_entry_speed_sqr;      // (mm/s)^2 junction limit
+    float entry_speed_sqr;          // (mm/s)^2
+    float exit_speed_sqr;           // (mm/s)^2 valid after planner_current
+    float delta_v2;                 // 2 * accel * distance
+
+    // trapezoid profile, valid after planner_current
+    float entry_speed, cruise_speed, exit_speed;   // mm/s
+    float accel_time, cruise_time, decel_time;     // seconds
+    float accel_dist, cruise_dist;                 // mm
+
+    uint32_t line;                  // source line number (for resuming)
+    uint8_t extruder;               // active extruder (0 to NUM_EXTRUDER-1)
+    uint8_t flags;
+} planner_block_t;
+
+typedef struct {
+    uint32_t blocks;                // number of blocks planned
+    uint32_t starved;               // blocks fetched without successor
+    uint32_t underruns;             // fetch attempts on empty queue
+    uint32_t full;                  // append attempts on full queue
+} planner_stats_t;
+
+typedef struct {
+    planner_block_t blocks[PLANNER_BLOCKS];
+    planner_stats_t stats;
+    float position[NUM_AXIS];
+    // Free running counters. Index into ring by `& (PLANNER_BLOCKS - 1)`.
+    //  tail:    oldest block (the one being executed if BLOCK_BUSY)
+    //  planned: oldest block whose entry speed may still change
+    //  head:    next free slot
+    uint32_t tail, planned, head;
+} planner_t;
+
+extern planner_config_t planner_config;
+extern planner_t planner;
+
+void planner_initialize(planner_t *pl);
+void planner_reset(planner_t *pl);  // discard all blocks
+
+/* Append a linear move from current position to `target` (mm) at `speed`
+ * (mm/s). Return false if the ring is full (try again after planner_discard).
+ * Moves shorter than 1um are merged into the next one and return true.
+ */
+bool planner_buffer_line(planner_t *pl, const float target[NUM_AXIS],
+                         float speed, uint32_t line = 0, uint8_t extruder = 0);
+
+// Set current position without movement (e.g. G92 or after homing)
+void planner_set_position(planner_t *pl, const float pos[NUM_AXIS]);
+void planner_get_position(planner_t *pl, float pos[NUM_AXIS]);
+
+planner_block_t * planner_current(planner_t *pl);   // NULL if queue is empty
+void planner_discard(planner_t *pl);                // release block fetched
+
+uint8_t planner_count(planner_t *pl);               // number of queued blocks
+bool planner_full(planner_t *pl);
+float planner_block_time(const planner_block_t *block);
+
+const planner_stats_t * planner_stats(planner_t *pl);
+
+// Same on the default instance
+void planner_initialize();
+void planner_reset();
+bool planner_buffer_line(const float target[NUM_AXIS], float speed,
+                         uint32_t line = 0, uint8_t extruder = 0);
+void planner_set_position(const float pos[NUM_AXIS]);
+void planner_get_position(float pos[NUM_AXIS]);
+planner_block_t * planner_current();
+void planner_discard();
+uint8_t planner_count();
+bool planner_full();
+const planner_stats_t * planner_stats();
+
+#endif // _PLANNER_H_
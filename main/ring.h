@@ -0,0 +1,92 @@
+/*
+ * File: ring.h
+ * Authors: Hank <hankso1106@gmail.com>
+ * Create: 2026-10-17 23:40:26
+ *
+ * Lock-free single-producer/single-consumer ring, e.g. motion task (producer)
+ * to step timer ISR (consumer). No FreeRTOS queue, no critical section: the
+ * producer only writes `head`, the consumer only writes `tail`, both are free
+ * running counters so the level is always `head - tail`.
+ *
+ * `head` and `tail` live on separate cache lines together with the counters
+ * written by the same side, so the two cores do not bounce one line between
+ * them. Stores of an index use release order and loads of the other index use
+ * acquire order: the slot is visible before the index that publishes it.
+ *
+ * Counters:
+ *      full    push failed because the ring was full (producer is ahead)
+ *      peak    highest level seen by the producer after a push
+ *      dry     consumer found the ring empty right after taking an item,
+ *              i.e. the producer did not keep up (or the stream ended)
+ *
+ * Methods are forced inline, so they end up in IRAM with the ISR using them.
+ */
+
+#ifndef _RING_H_
+#define _RING_H_
+
+#include <stddef.h>
+#include <stdint.h>
+
+#ifdef __XTENSA__
+#define RING_CACHE_LINE     32
+#else
+#define RING_CACHE_LINE     64
+#endif
+
+#define RING_INLINE         inline __attribute__((always_inline))
+
+template <typename T, uint32_t N>
+struct spsc_ring_t {
+    static_assert(N && !(N & (N - 1)), "ring size must be a power of 2");
+
+    // producer side
+    alignas(RING_CACHE_LINE) uint32_t head;
+    uint32_t full, peak;
+    // consumer side
+    alignas(RING_CACHE_LINE) uint32_t tail;
+    uint32_t dry;
+    bool taken;                 // last front() returned an item
+    alignas(RING_CACHE_LINE) T buf[N];
+
+    void reset() { head = tail = full = peak = dry = 0; taken = false; }
+    void reset_stats() { full = peak = dry = 0; }
+
+    RING_INLINE uint32_t level() const {
+        return __atomic_load_n(&head, __ATOMIC_ACQUIRE)
+             - __atomic_load_n(&tail, __ATOMIC_ACQUIRE);
+    }
+
+    // Producer: copy `item` in. Return false if full.
+    RING_INLINE bool push(const T &item) {
+        uint32_t h = head;
+        uint32_t level = h - __atomic_load_n(&tail, __ATOMIC_ACQUIRE);
+        if (level >= N) {
+            full++;
+            return false;
+        }
+        buf[h & (N - 1)] = item;
+        __atomic_store_n(&head, h + 1, __ATOMIC_RELEASE);
+        if (level + 1 > peak) peak = level + 1;
+        return true;
+    }
+
+    // Consumer: oldest item or NULL if empty. Valid until pop().
+    RING_INLINE const T * front() {
+        uint32_t t = tail;
+        if (t == __atomic_load_n(&head, __ATOMIC_ACQUIRE)) {
+            if (taken) dry++;
+            taken = false;
+            return NULL;
+        }
+        taken = true;
+        return buf + (t & (N - 1));
+    }
+
+    // Consumer: release item returned by front()
+    RING_INLINE void pop() {
+        __atomic_store_n(&tail, tail + 1, __ATOMIC_RELEASE);
+    }
+};
+
+#endif // _RING_H_
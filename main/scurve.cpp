@@ -0,0 +1,64 @@
+/*
+ * File: scurve.cpp
+ * Authors: Hank <hankso1106@gmail.com>
+ * Create: 2026-10-17 18:02:37
+ */
+
+#include "scurve.h"
+
+#define QMUL(a, b) (((a) * (b)) >> SCURVE_Q)
+
+float scurve_position(float u) {
+    float u2 = u * u;
+    return u2 * u2 * (2.5f + u * (u - 3));
+}
+
+float scurve_speed(float u) {
+    return u * u * u * (10 + u * (6 * u - 15));
+}
+
+bool scurve_init(scurve_phase_t *phase, float v0, float v1) {
+    float sum = v0 + v1;
+    if (!(sum > 0)) return false;
+    phase->alpha = (int64_t)(2 * v0 / sum * SCURVE_ONE);
+    phase->beta = 2 * (SCURVE_ONE - phase->alpha);
+    return true;
+}
+
+// Fixed-point P(u) and B(u). Every intermediate value stays below 2^62.
+static inline int64_t qposition(int64_t u) {
+    int64_t u2 = QMUL(u, u);
+    return QMUL(QMUL(u2, u2), 5 * SCURVE_ONE / 2 + QMUL(u, u - 3 * SCURVE_ONE));
+}
+
+static inline int64_t qspeed(int64_t u) {
+    int64_t u3 = QMUL(QMUL(u, u), u), u4 = QMUL(u3, u), u5 = QMUL(u4, u);
+    return 10 * u3 - 15 * u4 + 6 * u5;
+}
+
+int64_t scurve_solve(const scurve_phase_t *phase, int64_t sigma, int64_t lo,
+                     int64_t tol, uint32_t *iters) {
+    int64_t hi = SCURVE_ONE, u = lo;
+    if (sigma <= 0) return 0;
+    if (sigma >= SCURVE_ONE) return SCURVE_ONE;
+    if (tol < 1) tol = 1;
+    // s(u) is increasing: keep f(lo) < 0 <= f(hi)
+    for (uint8_t i = 0; i < SCURVE_MAX_ITERS && hi - lo > tol; i++) {
+        int64_t f = QMUL(phase->alpha, u) + QMUL(phase->beta, qposition(u))
+                  - sigma;
+        (*iters)++;
+        if (f < 0) {
+            lo = u;
+        } else {
+            hi = u;
+        }
+        int64_t df = phase->alpha + QMUL(phase->beta, qspeed(u));
+        if (df > 0) {
+            int64_t step = (f << SCURVE_Q) / df;
+            if (step <= tol && step >= -tol) return u - step;   // converged
+            u -= step;
+        }
+        if (u <= lo || u >= hi) u = (lo + hi) / 2;    // Newton went astray
+    }
+    return u;
+}
@@ -0,0 +1,52 @@
+/*
+ * File: scurve.h
+ * Authors: Hank <hankso1106@gmail.com>
+ * Create: 2026-10-17 18:02:37
+ *
+ * Jerk limited (S-curve) speed change. During a phase of T seconds speed goes
+ * from v0 to v1 along a 5th-order Bezier curve (6th-order position) instead of
+ * a straight line:
+ *
+ *      v(u) = v0 + (v1 - v0) * B(u),   B(u) = 10u^3 - 15u^4 + 6u^5
+ *      s(u) = v0 * T * u + (v1 - v0) * T * P(u),   P(u) = integral of B
+ *
+ * with u = t / T in [0, 1]. Acceleration and jerk are 0 at both ends, so
+ * trapezoid corners become smooth. P(1) = 1/2 like the straight line, so a
+ * phase has the same duration and distance as in the trapezoid profile and
+ * the planner does not change: acceleration of the planner is the average,
+ * peak acceleration is 15/8 of it.
+ *
+ * Step times are found by inverting s(u) with a fixed-point (Q30) Newton
+ * iteration safeguarded by bisection, so cost per step is bounded by
+ * SCURVE_MAX_ITERS without floating point.
+ */
+
+#ifndef _SCURVE_H_
+#define _SCURVE_H_
+
+#include <stdint.h>
+
+#define SCURVE_Q            30
+#define SCURVE_ONE          (1LL << SCURVE_Q)
+#define SCURVE_MAX_ITERS    8
+
+/* Phase normalized by its distance D = (v0 + v1) / 2 * T:
+ *      s(u) / D = alpha * u + beta * P(u),   alpha + beta / 2 = 1
+ */
+typedef struct {
+    int64_t alpha, beta;            // Q30
+} scurve_phase_t;
+
+float scurve_position(float u);     // P(u)
+float scurve_speed(float u);        // B(u)
+
+// Setup phase from speed `v0` to `v1`. Return false if nothing to move.
+bool scurve_init(scurve_phase_t *phase, float v0, float v1);
+
+/* Find u (Q30) where s(u) / D reaches `sigma` (Q30), searching in [lo, 1].
+ * Stop when bracket is narrower than `tol`. Iterations are added to `iters`.
+ */
+int64_t scurve_solve(const scurve_phase_t *phase, int64_t sigma, int64_t lo,
+                     int64_t tol, uint32_t *iters);
+
+#endif // _SCURVE_H_
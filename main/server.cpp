@@ -11,9 +11,19 @@
 #include "drivers.h"
 #include "filesys.h"
 #include "console.h"
+#include "gcode.h"
+#include "gcodebin.h"
+#include "gcodeidx.h"
+#include "gstream.h"
+#include "estimate.h"
+#include "stepper.h"
+#include "heater.h"
+#include "telemetry.h"
 
 #include "esp_log.h"
+#include "esp_timer.h"
 #include "esp_system.h"
+#include "freertos/semphr.h"
 
 static const char
 *TAG = "Server",
@@ -74,6 +84,21 @@ void log_param(AsyncWebServerRequest *req) {
  * HTTP & static files API
  */
 
+// Queue parsed commands to motion task and echo them in normalized form
+// (one line per command). Async TCP task must not block: when the command
+// queue is full, reply `busy` and let client resend the line later.
+static void onCommandGCode(const gcode_cmd_t *cmd, void *arg) {
+    static char line[128];
+    const char *status = "ok";
+    gcode_format(cmd, line, sizeof(line));
+    if (cmd->flags & GCODE_BAD_CSUM) {
+        status = "checksum";
+    } else if (!stepper_queue_gcode(cmd)) {
+        status = "busy";
+    }
+    fprintf((FILE *)arg, "%s %s\n", status, line);
+}
+
 void onCommand(AsyncWebServerRequest *req) {
     log_msg(req);
     if (req->hasParam("exec", true)) {
@@ -87,14 +112,44 @@ void onCommand(AsyncWebServerRequest *req) {
             req->send(200);
         }
     } else if (req->hasParam("gcode", true)) {
-        const char *gcode = req->getParam("gcode", true)->value().c_str();
-        printf("GCode parser: `%s`\n", gcode);
-        req->send(500, "text/plain", "GCode parser not implemented yet");
+        const String &gcode = req->getParam("gcode", true)->value();
+        char *ret = NULL; size_t size = 0;
+        FILE *buf = open_memstream(&ret, &size);
+        if (!buf) return req->send(500, "text/plain", "No memory");
+        gcode_parser_t parser;
+        gcode_parser_init(&parser);
+        gcode_parse(&parser, gcode.c_str(), gcode.length(),
+                    onCommandGCode, buf);
+        gcode_parse_end(&parser, onCommandGCode, buf);
+        fclose(buf);
+        req->send(parser.errors ? 400 : 200, "text/plain", ret ? ret : "");
+        if (ret) free(ret);
     } else {
         req->send(400, "text/plain", "Invalid parameter");
     }
 }
 
+/* Temperature history as one binary response (telemetry.h), e.g. the last
+ * 10 minutes: /temp?from=-600. Clients polling the chart ask for frames
+ * after the last one they have: /temp?from=<start + count * period>.
+ */
+void onTemp(AsyncWebServerRequest *req) {
+    int32_t from = -300;
+    uint32_t to = UINT32_MAX, points = 300;
+    if (req->hasParam("from")) from = req->getParam("from")->value().toInt();
+    if (req->hasParam("to")) to = req->getParam("to")->value().toInt();
+    if (req->hasParam("points"))
+        points = req->getParam("points")->value().toInt();
+    uint8_t *buf = (uint8_t *)malloc(TELEM_RESPONSE_MAX);
+    if (!buf) return req->send(500, "text/plain", "No memory");
+    size_t len = heater_history(from, to, points, buf, TELEM_RESPONSE_MAX);
+    AsyncResponseStream *res = req->beginResponseStream(
+        "application/octet-stream", len ? len : 1);
+    res->write(buf, len);
+    free(buf);
+    req->send(res);
+}
+
 void onUpdate(AsyncWebServerRequest *req) {
     log_msg(req);
     String update = Config.web.VIEW_OTA;
@@ -259,8 +314,20 @@ void onDelete(AsyncWebServerRequest *req) {
     }
 }
 
+static size_t file_write(const void *buf, size_t len, void *arg) {
+    return ((File *)arg)->write((const uint8_t *)buf, len);
+}
+
+/* G-code files get a layer index `*.idx` built while receiving (gcodeidx.h)
+ * and a print time estimate `*.est` computed in background (estimate.h).
+ * With `?binary` G-code is also converted to `*.gcb`: printing that file
+ * (`print /name.gcb`) reads precompiled records instead of parsing text (see
+ * gcodebin.h and job.h).
+ */
 void onUpload(AsyncWebServerRequest *request, String filename, size_t index, uint8_t *data, size_t len, bool final) {
-    static File file;
+    static File file, bin, idx;
+    static gcb_encoder_t encoder;
+    static gidx_builder_t builder;
     if (!index) {
         log_msg(request);
         if (file) return request->send(400, "text/plain", "Busy uploading");
@@ -270,10 +337,31 @@ void onUpload(AsyncWebServerRequest *request, String filename, size_t index, uin
         }
         ESP_LOGW(TAG, "Uploading file: %s\n", filename.c_str());
         file = FFS.open(filename, "w");
+        if (file && (
+            filename.endsWith(".gcode") || filename.endsWith(".gco") ||
+            filename.endsWith(".g")))
+        {
+            String name = filename.substring(0, filename.lastIndexOf('.'));
+            idx = FFS.open(name + ".idx", "w");
+            if (idx && !gidx_init(&builder, file_write, &idx)) idx.close();
+            if (request->hasParam("binary")) {
+                bin = FFS.open(name + ".gcb", "w");
+                if (bin && !gcb_encode_init(&encoder, file_write, &bin))
+                    bin.close();
+            }
+        }
     }
     if (file) {
         led_on();
         file.write(data, len);
+        if (bin && !gcb_encode(&encoder, (const char *)data, len)) {
+            ESP_LOGE(TAG, "Convert to binary failed");
+            bin.close();
+        }
+        if (idx && !gidx_feed(&builder, (const char *)data, len)) {
+            ESP_LOGE(TAG, "Build layer index failed");
+            idx.close();
+        }
         ESP_LOGI(TAG, "\rProgress: %s", format_size(index));
         led_off();
     }
@@ -282,6 +370,29 @@ void onUpload(AsyncWebServerRequest *request, String filename, size_t index, uin
         file.close();
         ESP_LOGW(TAG, "Update success: %s\n", format_size(index + len));
     }
+    if (final && bin) {
+        if (gcb_encode_end(&encoder) && bin.seek(0)) {
+            bin.write((const uint8_t *)&encoder.header, sizeof(gcb_header_t));
+        }
+        ESP_LOGW(TAG, "Binary: %u records (%s), %u moves, %u layers, "
+                 "%.1fmm filament, %u dropped", encoder.header.records,
+                 format_size(bin.size()), encoder.header.moves,
+                 encoder.header.layers, encoder.header.filament,
+                 encoder.header.dropped);
+        bin.close();
+    }
+    if (final && idx) {
+        if (gidx_end(&builder) && idx.seek(0)) {
+            idx.write((const uint8_t *)&builder.header, sizeof(gidx_header_t));
+        }
+        ESP_LOGW(TAG, "Index: %u layers up to Z%.2f",
+                 builder.header.layers, builder.header.height);
+        idx.close();
+        if (!filename.startsWith("/")) filename = "/" + filename;
+        if (!estimate_request(filename.c_str())) {
+            ESP_LOGE(TAG, "Estimate queue full, skip %s", filename.c_str());
+        }
+    }
 }
 
 void onUploadStrict(AsyncWebServerRequest *request, String filename, size_t index, uint8_t *data, size_t len, bool final){
@@ -320,6 +431,91 @@ void onErrorFileManager(AsyncWebServerRequest *req) {
  * WebSocket message parser and callbacks
  */
 
+/* G-code stream messages (gstream.h) are not buffered: every packet is parsed
+ * in place and lines go to the command queue of motion task as they come.
+ * Credits grown while the queue drains are pushed by a periodic timer. The
+ * timer runs in esp_timer task, so it sends only while holding `ws_lock`,
+ * which the async_tcp task holds while handling any WebSocket event.
+ */
+static gstream_t stream;
+static SemaphoreHandle_t stream_lock = NULL, ws_lock = NULL;
+static uint32_t stream_sid = -1;        // client feeding a stream message
+static uint32_t stream_skip = -1;       // client whose message is dropped
+
+static bool onStreamPush(const gcode_cmd_t *cmd, void *arg) {
+    return stepper_queue_gcode(cmd);
+}
+
+static uint32_t onStreamSpace(void *arg) { return stepper_queue_space(); }
+
+static void onStreamTimer(void *arg) {
+    static char buf[32];
+    if (!xSemaphoreTake(ws_lock, 0)) return;    // try again next period
+    xSemaphoreTake(stream_lock, portMAX_DELAY);
+    uint32_t owner = stream.owner;
+    bool push = gstream_poll(&stream, buf, sizeof(buf));
+    xSemaphoreGive(stream_lock);
+    if (push) ((AsyncWebSocket *)arg)->text(owner, buf);
+    xSemaphoreGive(ws_lock);
+}
+
+static void stream_initialize(AsyncWebSocket *ws) {
+    if (stream_lock) return;
+    const gstream_sink_t sink = { onStreamPush, onStreamSpace, NULL };
+    gstream_init(&stream, &sink);
+    stream_lock = xSemaphoreCreateMutex();
+    ws_lock = xSemaphoreCreateMutex();
+    esp_timer_handle_t timer;
+    esp_timer_create_args_t args = {
+        .callback = onStreamTimer,
+        .arg = ws,
+        .dispatch_method = ESP_TIMER_TASK,
+        .name = "gstream",
+    };
+    if (esp_timer_create(&args, &timer) == ESP_OK) {
+        esp_timer_start_periodic(timer, GSTREAM_POLL_MS * 1000);
+    }
+}
+
+// Return true if the packet belongs to a G-code stream message
+static bool onStreamData(
+    AsyncWebSocketClient *client, AwsFrameInfo *info, char *data, size_t size)
+{
+    static char reply[48];
+    uint32_t cid = client->id();
+    bool end = info->final && info->index + size == info->len;
+    if (info->num == 0 && info->index == 0) {
+        if (stream_skip == cid) stream_skip = -1;
+        if (info->message_opcode != WS_TEXT) return false;
+        if (!gstream_is_message(data, size)) return false;
+        if (stream_sid != -1 && stream_sid != cid) {
+            // following packets of this message are dropped too
+            ESP_LOGW(TAG, "ws#%d error: stream message busy. Skip\n", cid);
+            client->text("error stream busy");
+            if (!end) stream_skip = cid;
+            return true;
+        }
+        stream_sid = cid;
+        xSemaphoreTake(stream_lock, portMAX_DELAY);
+        gstream_begin(&stream, cid);
+        xSemaphoreGive(stream_lock);
+    } else if (stream_skip == cid) {
+        if (end) stream_skip = -1;
+        return true;
+    } else if (stream_sid != cid) {
+        return false;
+    }
+    xSemaphoreTake(stream_lock, portMAX_DELAY);
+    gstream_feed(&stream, data, size);
+    if (end) gstream_end(&stream, reply, sizeof(reply));
+    xSemaphoreGive(stream_lock);
+    if (end) {
+        stream_sid = -1;
+        client->text(reply);
+    }
+    return true;
+}
+
 void handle_websocket_message(AsyncWebSocketClient *client, char *data) {
     char *ret = console_handle_rpc(data);
     if (ret) {
@@ -357,6 +553,7 @@ void onWebSocketData(
     static uint32_t wsid = -1;
     static size_t idx = 0, buflen = 0;
     uint32_t cid = client->id();
+    if (onStreamData(client, info, data, size)) return;
     if (wsid != cid) {
         if (wsid != -1) {
             ESP_LOGW(TAG, "ws#%d error: message buffer busy. Skip\n", cid);
@@ -439,6 +636,7 @@ clean:
 
 void onWebSocket(AsyncWebSocket *server, AsyncWebSocketClient *client, AwsEventType type, void *arg, uint8_t *data, size_t datalen) {
     static char header[32];
+    xSemaphoreTake(ws_lock, portMAX_DELAY);
     snprintf(header, 32, "ws#%u %s:%d", client->id(),
              client->remoteIP().toString().c_str(), client->remotePort());
     switch (type) {
@@ -449,6 +647,11 @@ void onWebSocket(AsyncWebSocket *server, AsyncWebSocketClient *client, AwsEventT
         break;
     case WS_EVT_DISCONNECT:
         ESP_LOGD(TAG, "%s disconnected", header);
+        xSemaphoreTake(stream_lock, portMAX_DELAY);
+        gstream_close(&stream, client->id());
+        xSemaphoreGive(stream_lock);
+        if (stream_sid == client->id()) stream_sid = -1;
+        if (stream_skip == client->id()) stream_skip = -1;
         break;
     case WS_EVT_ERROR:
         ESP_LOGW(TAG, "%s error(%u)", header, *((uint16_t *)arg));
@@ -459,6 +662,7 @@ void onWebSocket(AsyncWebSocket *server, AsyncWebSocketClient *client, AwsEventT
         break;
     default:;
     }
+    xSemaphoreGive(ws_lock);
 }
 
 
@@ -480,6 +684,7 @@ void WebServerClass::begin() {
 
 void WebServerClass::register_sta_api() {
     _server.on("/cmd", HTTP_POST, onCommand);
+    _server.on("/temp", HTTP_GET, onTemp);
 
     _server.serveStatic("/sta", FFS, Config.web.DIR_STA)
         .setDefaultFile("index.html")
@@ -513,6 +718,7 @@ void WebServerClass::register_ap_api() {
 }
 
 void WebServerClass::register_ws_api() {
+    stream_initialize(&_wsocket);
     _wsocket.onEvent(onWebSocket);
     _wsocket.setAuthentication(Config.web.WS_NAME, Config.web.WS_PASS);
     _server.addHandler(&_wsocket);
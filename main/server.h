@@ -10,8 +10,10 @@
  *
  * API list:
  *  Name    Method  Description
- *  /ws     POST    Websocket connection point: messages are parsed as JSON
+ *  /ws     POST    Websocket connection point: messages are parsed as JSON,
+ *                  or G-code streamed with credit flow control (gstream.h)
  *  /cmd    POST    Manually send in command string just like using console
+ *  /temp   GET     Temperature history in binary frames (telemetry.h)
  *
  * softAP only:
  *  Name    Method  Description
@@ -0,0 +1,77 @@
+/*
+ * File: shaper.cpp
+ * Authors: Hank <hankso1106@gmail.com>
+ * Create: 2026-10-17 16:20:05
+ */
+
+#include "shaper.h"
+
+#include <math.h>
+#include <string.h>
+#include <strings.h>
+
+static const char * const names[] = { "none", "zv", "mzv", "ei" };
+
+shaper_type_t shaper_parse(const char *name) {
+    for (uint8_t i = SHAPER_ZV; name && i <= SHAPER_EI; i++) {
+        if (!strcasecmp(name, names[i])) return (shaper_type_t)i;
+    }
+    return SHAPER_NONE;
+}
+
+const char * shaper_name(shaper_type_t type) {
+    return type <= SHAPER_EI ? names[type] : names[SHAPER_NONE];
+}
+
+bool shaper_init(shaper_t *shaper, shaper_type_t type, float freq, float zeta) {
+    memset(shaper, 0, sizeof(shaper_t));
+    if (type == SHAPER_NONE || !(freq > 0) || !(zeta >= 0 && zeta < 1))
+        return false;
+    float df = sqrtf(1 - zeta * zeta);
+    float td = 1 / (freq * df);                     // damped period
+    float k;
+    switch (type) {
+    case SHAPER_ZV:
+        k = expf(-zeta * M_PI / df);
+        shaper->num = 2;
+        shaper->a[0] = 1;           shaper->t[0] = 0;
+        shaper->a[1] = k;           shaper->t[1] = 0.5f * td;
+        break;
+    case SHAPER_MZV:
+        k = expf(-0.75f * zeta * M_PI / df);
+        shaper->num = 3;
+        shaper->a[0] = 1 - M_SQRT1_2;
+        shaper->a[1] = (M_SQRT2 - 1) * k;
+        shaper->a[2] = shaper->a[0] * k * k;
+        shaper->t[0] = 0;
+        shaper->t[1] = 0.375f * td;
+        shaper->t[2] = 0.75f * td;
+        break;
+    case SHAPER_EI: {
+        const float vtol = 0.05f;                   // vibration tolerance
+        k = expf(-zeta * M_PI / df);
+        shaper->num = 3;
+        shaper->a[0] = 0.25f * (1 + vtol);
+        shaper->a[1] = 0.5f * (1 - vtol) * k;
+        shaper->a[2] = shaper->a[0] * k * k;
+        shaper->t[0] = 0;
+        shaper->t[1] = 0.5f * td;
+        shaper->t[2] = td;
+        break;
+    }
+    default:
+        return false;
+    }
+    float sum = 0;
+    for (uint8_t j = 0; j < shaper->num; j++) sum += shaper->a[j];
+    for (uint8_t j = 0; j < shaper->num; j++) shaper->a[j] /= sum;
+    return true;
+}
+
+float shaper_center(const shaper_t *shaper) {
+    float center = 0;
+    for (uint8_t j = 0; j < shaper->num; j++) {
+        center += shaper->a[j] * shaper->t[j];
+    }
+    return center;
+}
@@ -0,0 +1,47 @@
+/*
+ * File: shaper.h
+ * Authors: Hank <hankso1106@gmail.com>
+ * Create: 2026-10-17 16:20:05
+ *
+ * Input shapers for resonance compensation. A shaper is a short train of
+ * impulses (amplitude a_j at time t_j). Convolving the commanded position
+ * with it cancels vibration around frequency `freq` with damping ratio `zeta`:
+ *
+ *      x_shaped(t) = sum(a_j * x(t - t_j)),    sum(a_j) = 1
+ *
+ *      ZV   2 impulses, 1/2 period:    shortest, sensitive to freq error
+ *      MZV  3 impulses, 3/4 period:    good trade-off
+ *      EI   3 impulses, 1 period:      most robust, most smoothing
+ */
+
+#ifndef _SHAPER_H_
+#define _SHAPER_H_
+
+#include <stdint.h>
+
+#define SHAPER_MAX_PULSES 3
+
+typedef enum {
+    SHAPER_NONE,
+    SHAPER_ZV,
+    SHAPER_MZV,
+    SHAPER_EI,
+} shaper_type_t;
+
+typedef struct {
+    uint8_t num;                    // number of impulses, 0 if disabled
+    float a[SHAPER_MAX_PULSES];     // amplitudes
+    float t[SHAPER_MAX_PULSES];     // delays (seconds), increasing
+} shaper_t;
+
+// Compute impulses. Return false (shaper disabled) on invalid parameters.
+bool shaper_init(shaper_t *shaper, shaper_type_t type, float freq, float zeta);
+
+// Parse "zv", "mzv", "ei" (case insensitive), anything else is SHAPER_NONE
+shaper_type_t shaper_parse(const char *name);
+const char * shaper_name(shaper_type_t type);
+
+// Weighted mean delay: shaped motion lags commanded motion by this time
+float shaper_center(const shaper_t *shaper);
+
+#endif // _SHAPER_H_
@@ -0,0 +1,80 @@
+/*
+ * File: softpwm.cpp
+ * Authors: Hank <hankso1106@gmail.com>
+ * Create: 2026-10-18 17:05:12
+ */
+
+#include "softpwm.h"
+
+#include <string.h>
+
+void softpwm_init(softpwm_t *p, uint16_t res) {
+    memset(p, 0, sizeof(softpwm_t));
+    p->res = res < 1 ? 1 : res > SOFTPWM_RES_MAX ? SOFTPWM_RES_MAX : res;
+    p->sync = true;
+}
+
+static int channel(i2c_pin_num_t pin) {
+    int ch = pin - SOFTPWM_PIN0;
+    return ch >= 0 && ch < SOFTPWM_PINS ? ch : -1;
+}
+
+bool softpwm_set(softpwm_t *p, i2c_pin_num_t pin, float duty) {
+    int ch = channel(pin);
+    if (ch < 0) return false;
+    duty = duty < 0 ? 0 : duty > 1 ? 1 : duty;
+    p->duty[ch] = (uint16_t)(duty * p->res + 0.5f);
+    return true;
+}
+
+float softpwm_get(const softpwm_t *p, i2c_pin_num_t pin) {
+    int ch = channel(pin);
+    return ch < 0 ? 0 : (float)p->duty[ch] / p->res;
+}
+
+// Bytes of all chips in the current slot
+static void compute(softpwm_t *p) {
+    for (uint8_t c = 0; c < SOFTPWM_CHIPS; c++) {
+        uint8_t byte = 0;
+        const uint16_t *duty = p->duty + c * 8;
+        for (uint8_t bit = 0; bit < 8; bit++) {
+            if (duty[bit] > p->slot) byte |= 1 << bit;
+        }
+        p->out[c] = byte;
+    }
+}
+
+static esp_err_t write(softpwm_t *p) {
+    uint8_t mask = 0, vals[SOFTPWM_CHIP0 + SOFTPWM_CHIPS], num = 0;
+    for (uint8_t c = 0; c < SOFTPWM_CHIPS; c++) {
+        if (!p->sync && p->out[c] == p->written[c]) continue;
+        mask |= 1 << (SOFTPWM_CHIP0 + c);
+        vals[SOFTPWM_CHIP0 + c] = p->out[c];
+        num++;
+    }
+    if (!num) return ESP_OK;
+    esp_err_t err = i2c_set_vals(mask, vals);
+    p->stats.trans++;
+    p->stats.bytes += num;
+    p->stats.bits += I2C_XFER_BITS(num);
+    if (err) {
+        p->stats.errors++;
+        p->sync = true;                 // state of chips is unknown
+        return err;
+    }
+    memcpy(p->written, p->out, sizeof(p->written));
+    p->sync = false;
+    return ESP_OK;
+}
+
+esp_err_t softpwm_slot(softpwm_t *p) {
+    if (++p->slot >= p->res) p->slot = 0;
+    p->stats.slots++;
+    compute(p);
+    return write(p);
+}
+
+esp_err_t softpwm_flush(softpwm_t *p) {
+    compute(p);
+    return write(p);
+}
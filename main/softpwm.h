@@ -0,0 +1,87 @@
+/*
+ * File: softpwm.h
+ * Authors: Hank <hankso1106@gmail.com>
+ * Create: 2026-10-18 17:05:12
+ *
+ * Software PWM of the output expanders: temperature chip (heaters, fans)
+ * and valve chip, 16 channels from PIN_BED to PIN_VLV8. A PWM period is
+ * `res` slots, a timer runs one slot every 1 / (res * freq) seconds:
+ *
+ *      slot        0   1   2   3   4   5   6   7       res = 8
+ *      duty 3/8    ############
+ *      duty 5/8    ####################
+ *      byte        11  11  11  01  01  00  00  00      written: 0, 3, 5
+ *
+ * All channels turn on at slot 0 and off at slot `duty`, so the bytes of
+ * a chip change at most once per distinct duty, not once per channel edge.
+ * For each slot the byte of every chip is computed from all its channels
+ * and only chips whose byte changed are written, together in one I2C
+ * transaction (i2c_set_vals). Idle slots cost nothing on the bus.
+ *
+ * Bus time is counted from the bits of each transaction (I2C_XFER_BITS)
+ * and the bus clock, so utilisation is known without timing the driver.
+ *
+ * Heaters keep their own time-proportioned windows (heater.h) and set
+ * their channels fully on or off; softpwm_flush writes a change at once
+ * instead of waiting for the next slot.
+ */
+
+#ifndef _SOFTPWM_H_
+#define _SOFTPWM_H_
+
+#include "drivers.h"
+#include "gcode.h"
+
+#define SOFTPWM_CHIPS       2           // PCF8574 of temperature, valves
+#define SOFTPWM_CHIP0       1           // index of first one in pins.cpp
+#define SOFTPWM_PINS        (SOFTPWM_CHIPS * 8)
+#define SOFTPWM_PIN0        PIN_BED     // pin of channel 0
+#define SOFTPWM_RES_MAX     256
+
+typedef struct {
+    uint32_t slots;             // slots run
+    uint32_t trans;             // I2C transactions
+    uint32_t bytes;             // chip bytes written
+    uint32_t errors;
+    uint64_t bits;              // on the bus, see I2C_XFER_BITS
+} softpwm_stats_t;
+
+typedef struct {
+    uint16_t res;               // slots per period
+    uint16_t slot;              // slot in effect
+    uint16_t duty[SOFTPWM_PINS];    // slots on per period, 0 ~ res
+    uint8_t out[SOFTPWM_CHIPS];     // bytes of the slot in effect
+    uint8_t written[SOFTPWM_CHIPS]; // bytes on the chips
+    bool sync;                  // write all chips next time
+    softpwm_stats_t stats;
+} softpwm_t;
+
+void softpwm_init(softpwm_t *p, uint16_t res);
+
+// Set duty (0 ~ 1) of `pin`. Return false if it is not a PWM channel.
+bool softpwm_set(softpwm_t *p, i2c_pin_num_t pin, float duty);
+float softpwm_get(const softpwm_t *p, i2c_pin_num_t pin);
+
+// Advance to the next slot and write chips that changed
+esp_err_t softpwm_slot(softpwm_t *p);
+
+// Write duties changed in the current slot now
+esp_err_t softpwm_flush(softpwm_t *p);
+
+/* Implemented in softpwm_task.cpp: a high priority task on the ESP32 runs
+ * the slots from a periodic timer. Config.mtn.PWM is "res,freq".
+ */
+void softpwm_initialize();
+void softpwm_loop_begin(int xCoreID = 0);
+
+bool softpwm_write(i2c_pin_num_t pin, float duty);     // from next slot
+float softpwm_read(i2c_pin_num_t pin);
+esp_err_t softpwm_commit();             // write changes now (softpwm_flush)
+
+// M106 [P<fan>] [S<0-255>], M107 [P<fan>]. Return false for other commands.
+bool softpwm_gcode(const gcode_cmd_t *cmd);
+
+void softpwm_info();                    // duties, slot timing, bus load
+void softpwm_stats_reset();
+
+#endif // _SOFTPWM_H_
@@ -0,0 +1,178 @@
+/*
+ * File: softpwm_task.cpp
+ * Authors: Hank <hankso1106@gmail.com>
+ * Create: 2026-10-18 17:05:12
+ */
+
+#include "softpwm.h"
+#include "config.h"
+
+#include "esp_log.h"
+#include "esp_timer.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "freertos/semphr.h"
+
+#define SOFTPWM_SLOT_MIN    1000        // us, longer than a two chip write
+#define SOFTPWM_FANS        3
+
+static const char *TAG = "SoftPWM";
+
+static const char * const pin_names[SOFTPWM_PINS] = {
+    "BED",  "NOZ1", "NOZ2", "NOZ3", "FAN1", "FAN2", "FAN3", "RSV",
+    "VLV1", "VLV2", "VLV3", "VLV4", "VLV5", "VLV6", "VLV7", "VLV8",
+};
+
+static softpwm_t pwm;
+static SemaphoreHandle_t pwm_lock = NULL;
+static TaskHandle_t pwm_task = NULL;
+static uint32_t slot_us;
+
+static struct {
+    int64_t since;              // us, start of statistics
+    softpwm_stats_t base;       // pwm.stats at that time
+    uint32_t late;              // slots missed: task woke up too late
+    int64_t busy_us, busy_max;  // time of a slot (compute and I2C)
+} stats;
+
+static void onSlotTimer(void *arg) { xTaskNotifyGive(pwm_task); }
+
+static void softpwm_loop(void *arg) {
+    for (;;) {
+        uint32_t n = ulTaskNotifyTake(pdTRUE, portMAX_DELAY);
+        if (n > 1) stats.late += n - 1;
+        int64_t t0 = esp_timer_get_time();
+        xSemaphoreTake(pwm_lock, portMAX_DELAY);
+        softpwm_slot(&pwm);
+        xSemaphoreGive(pwm_lock);
+        int64_t busy = esp_timer_get_time() - t0;
+        stats.busy_us += busy;
+        if (busy > stats.busy_max) stats.busy_max = busy;
+    }
+}
+
+void softpwm_initialize() {
+    unsigned res = 16, freq = 10;
+    if (sscanf(Config.mtn.PWM, "%u,%u", &res, &freq) != 2 || !res || !freq) {
+        ESP_LOGE(TAG, "Invalid mtn.pwm: %s, use 16,10", Config.mtn.PWM);
+        res = 16;
+        freq = 10;
+    }
+    if (res > SOFTPWM_RES_MAX) res = SOFTPWM_RES_MAX;
+    if (freq > 1000000 / res) freq = 1000000 / res;     // slot_us >= 1
+    slot_us = 1000000 / (res * freq);
+    if (slot_us < SOFTPWM_SLOT_MIN) {
+        slot_us = SOFTPWM_SLOT_MIN;
+        ESP_LOGW(TAG, "%u slots at %uHz too fast, run at %uHz", res, freq,
+                 1000000 / (res * slot_us));
+    }
+    softpwm_init(&pwm, res);
+    if (!pwm_lock) pwm_lock = xSemaphoreCreateMutex();
+    xSemaphoreTake(pwm_lock, portMAX_DELAY);
+    esp_err_t err = softpwm_flush(&pwm);    // all outputs off
+    xSemaphoreGive(pwm_lock);
+    if (err) ESP_LOGE(TAG, "Cannot reset outputs: %s", esp_err_to_name(err));
+    stats.since = esp_timer_get_time();
+}
+
+bool softpwm_write(i2c_pin_num_t pin, float duty) {
+    if (!pwm_lock) return false;
+    xSemaphoreTake(pwm_lock, portMAX_DELAY);
+    bool ok = softpwm_set(&pwm, pin, duty);
+    xSemaphoreGive(pwm_lock);
+    return ok;
+}
+
+float softpwm_read(i2c_pin_num_t pin) { return softpwm_get(&pwm, pin); }
+
+esp_err_t softpwm_commit() {
+    if (!pwm_lock) return ESP_FAIL;
+    xSemaphoreTake(pwm_lock, portMAX_DELAY);
+    esp_err_t err = softpwm_flush(&pwm);
+    xSemaphoreGive(pwm_lock);
+    return err;
+}
+
+bool softpwm_gcode(const gcode_cmd_t *cmd) {
+    float val = 0;
+    if (cmd->letter != 'M' || (cmd->code != 106 && cmd->code != 107))
+        return false;
+    uint8_t fan = gcode_param(cmd, 'P', &val) ? (uint8_t)val : 0;
+    if (fan >= SOFTPWM_FANS) {
+        ESP_LOGW(TAG, "No fan %u", fan);
+        return true;
+    }
+    if (cmd->code == 107 || !gcode_param(cmd, 'S', &val)) {
+        val = cmd->code == 107 ? 0 : 255;
+    }
+    softpwm_write((i2c_pin_num_t)(PIN_FAN1 + fan), val / 255);
+    return true;
+}
+
+void softpwm_info() {
+    softpwm_t p;
+    xSemaphoreTake(pwm_lock, portMAX_DELAY);
+    memcpy(&p, &pwm, sizeof(p));
+    xSemaphoreGive(pwm_lock);
+    for (uint8_t ch = 0; ch < SOFTPWM_PINS; ch++) {
+        printf("%s%-4s %3u%%", ch % 8 ? "  " : "", pin_names[ch],
+               (p.duty[ch] * 100 + p.res / 2) / p.res);
+        if (ch % 8 == 7) printf("\n");
+    }
+    double secs = (esp_timer_get_time() - stats.since) / 1e6;
+    softpwm_stats_t s = p.stats, *b = &stats.base;
+    s.slots -= b->slots; s.trans -= b->trans; s.bytes -= b->bytes;
+    s.errors -= b->errors; s.bits -= b->bits;
+    uint32_t n = s.slots ? s.slots : 1;
+    printf("Slots: %u x %uus (%.1fHz PWM), %u run, %u late, "
+           "%.0f / %lld us (avg/max)\n", p.res, slot_us,
+           1e6 / (p.res * slot_us), s.slots, stats.late,
+           (double)stats.busy_us / n, (long long)stats.busy_max);
+    if (secs <= 0) return;
+    double bus = s.bits * 1e6 / i2c_bus_speed() + s.trans * i2c_bus_overhead();
+    printf("I2C:   %.1f transactions/s (%.2f per slot), %.1f bytes/s, "
+           "bus load %.2f%% at %uHz, busy %.2f%%, %u errors\n",
+           s.trans / secs, (double)s.trans / n, s.bytes / secs,
+           s.bits * 100.0 / i2c_bus_speed() / secs, i2c_bus_speed(),
+           bus / 1e4 / secs, s.errors);
+}
+
+void softpwm_stats_reset() {
+    xSemaphoreTake(pwm_lock, portMAX_DELAY);
+    stats.base = pwm.stats;
+    xSemaphoreGive(pwm_lock);
+    stats.since = esp_timer_get_time();
+    stats.late = 0;
+    stats.busy_us = stats.busy_max = 0;
+}
+
+void softpwm_loop_begin(int xCoreID) {
+    const char * const pcName = "softpwm";
+    const uint32_t usStackDepth = 2048;
+    void * const pvParameters = NULL;
+    const UBaseType_t uxPriority = tskIDLE_PRIORITY + 6;
+#ifndef CONFIG_FREERTOS_UNICORE
+    if (xCoreID == 0 || xCoreID == 1) {
+        xTaskCreatePinnedToCore(
+            softpwm_loop, pcName, usStackDepth,
+            pvParameters, uxPriority, &pwm_task, xCoreID);
+    } else
+#endif
+    {
+        xTaskCreate(
+            softpwm_loop, pcName, usStackDepth,
+            pvParameters, uxPriority, &pwm_task);
+    }
+    esp_timer_handle_t timer;
+    esp_timer_create_args_t args = {
+        .callback = onSlotTimer,
+        .arg = NULL,
+        .dispatch_method = ESP_TIMER_TASK,
+        .name = "softpwm",
+    };
+    if (esp_timer_create(&args, &timer) == ESP_OK) {
+        esp_timer_start_periodic(timer, slot_us);
+    } else {
+        ESP_LOGE(TAG, "Cannot create slot timer");
+    }
+}
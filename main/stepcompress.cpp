@@ -0,0 +1,76 @@
+/*
+ * File: stepcompress.cpp
+ * Authors: Hank <hankso1106@gmail.com>
+ * Create: 2026-10-17 15:12:40
+ */
+
+#include "stepcompress.h"
+
+#define MAX_COUNT 0xFFFF
+
+static inline int64_t div_round(int64_t num, int64_t den) {
+    return num >= 0 ? (num + den / 2) / den : -((-num + den / 2) / den);
+}
+
+// Decode move and compare with exact step times
+static bool check(const uint32_t *t, uint32_t cnt, int64_t interval,
+                  int64_t add, int64_t err) {
+    if (interval <= 0 || interval > (int64_t)UINT32_MAX) return false;
+    if (add < INT16_MIN || add > INT16_MAX) return false;
+    if (interval + (int64_t)(cnt - 1) * add <= 0) return false;
+    int64_t time = 0;
+    for (uint32_t j = 0; j < cnt; j++) {
+        time += interval;
+        interval += add;
+        int64_t diff = time - t[j];
+        if (diff > err || diff < -err) return false;
+    }
+    return true;
+}
+
+// Try to fit `cnt` steps with one move through the first and last step
+static bool fit(const uint32_t *t, uint32_t cnt, uint32_t err,
+                step_move_t *move) {
+    int64_t n = cnt, m = n * (n - 1) / 2, last = t[cnt - 1];
+    int64_t interval = t[0], add = 0;
+    if (cnt > 1) add = div_round(last - n * interval, m);
+    if (!check(t, cnt, interval, add, err)) {
+        // rounding of add moves the last step: spread it over the first one
+        interval = div_round(last - m * add, n);
+        if (!check(t, cnt, interval, add, err)) return false;
+    }
+    move->interval = interval;
+    move->count = cnt;
+    move->add = add;
+    return true;
+}
+
+uint16_t stepcompress(const uint32_t *times, uint32_t num,
+                      uint32_t max_error, step_move_t *move) {
+    move->interval = times[0];
+    move->count = 1;
+    move->add = 0;
+    if (num > MAX_COUNT) num = MAX_COUNT;
+    // exponential search for a failing count, then bisect
+    uint32_t good = 1, bad = num + 1, cnt = 2;
+    step_move_t tmp;
+    while (cnt <= num) {
+        if (!fit(times, cnt, max_error, &tmp)) {
+            bad = cnt;
+            break;
+        }
+        good = cnt;
+        *move = tmp;
+        cnt = cnt * 2 > num && cnt < num ? num : cnt * 2;
+    }
+    while (bad - good > 1) {
+        cnt = (good + bad) / 2;
+        if (fit(times, cnt, max_error, &tmp)) {
+            good = cnt;
+            *move = tmp;
+        } else {
+            bad = cnt;
+        }
+    }
+    return move->count;
+}
@@ -0,0 +1,50 @@
+/*
+ * File: stepcompress.h
+ * Authors: Hank <hankso1106@gmail.com>
+ * Create: 2026-10-17 15:12:40
+ *
+ * Compressed step timing. A run of steps of one axis is stored as
+ *
+ *      interval: ticks from previous step to the first step of the run
+ *      count:    number of steps in the run
+ *      add:      added to interval after each step
+ *
+ * so step j (0 based) of a move happens at
+ *
+ *      t_j = (j + 1) * interval + add * j * (j + 1) / 2
+ *
+ * after the previous step. Constant speed and (approximately) constant
+ * acceleration are expanded by adding two integers per step. The encoder
+ * only accepts a move if every decoded step stays within `max_error` ticks
+ * of the exact time, and the next move starts from the decoded time of the
+ * last step, so errors never accumulate.
+ *
+ * A move with count 0 carries no step: interval advances the axis clock
+ * (used for gaps longer than 32-bit offsets) and add >= 0 sets DIR level.
+ */
+
+#ifndef _STEPCOMPRESS_H_
+#define _STEPCOMPRESS_H_
+
+#include <stdint.h>
+
+typedef struct {
+    uint32_t interval;
+    uint16_t count;
+    int16_t add;
+} step_move_t;
+
+/* Encode the longest move that reproduces `times` (offsets in ticks from the
+ * previous step, increasing) within `max_error`. At least one step is always
+ * encoded. Return number of steps in `move`.
+ */
+uint16_t stepcompress(const uint32_t *times, uint32_t num,
+                      uint32_t max_error, step_move_t *move);
+
+// Ticks from previous step to the last step of move
+static inline uint32_t step_move_duration(const step_move_t *move) {
+    int64_t n = move->count;
+    return n * move->interval + move->add * (n * (n - 1) / 2);
+}
+
+#endif // _STEPCOMPRESS_H_
@@ -0,0 +1,521 @@
+/*
+ * File: stepgen.cpp
+ * Authors: Hank <hankso1106@gmail.com>
+ * Create: 2026-10-17 13:02:18
+ */
+
+#include "stepgen.h"
+#include "scurve.h"
+
+#include "math.h"
+
+// Bits follow the order of spi_pin_num_t in drivers.h (E is extruder E1)
+stepgen_config_t stepgen_config = {
+    .steps_per_mm = { 80, 80, 400, 93 },
+    .invert_dir = { false, false, false, false },
+    .step_bits = { 1 << 1, 1 << 3, 1 << 5, 1 << 7 },
+    .dir_bits = { 1 << 0, 1 << 2, 1 << 4, 1 << 6 },
+    .idle_bits = 0,                 // EN pins are active low
+    .tick_hz = 10 * 1000 * 1000,    // 80MHz APB clock / 8
+    .min_interval = 80,             // 8us: pulse width + SPI transfer
+    .max_error = 50,                // 5us
+    .shaper = {},                   // disabled
+    .pa_advance = {},               // disabled
+    .pa_smooth = 0.04,
+};
+
+// Copy of a planner block, kept after the block is discarded
+typedef struct {
+    float duration;             // seconds
+    float pos[NUM_AXIS];        // start position (mm)
+    float unit[NUM_AXIS];
+    float entry_speed, cruise_speed, accel;
+    float accel_time, cruise_time, accel_dist, cruise_dist;
+    float advance;              // pressure advance K of E (0 if not printing)
+    // S-curve profile: fixed-point inversion of accel/decel phases
+    bool scurve;
+    float decel_time, decel_dist;
+    scurve_phase_t accel_phase, decel_phase;
+    uint32_t accel_ticks, decel_start, decel_ticks;
+} segment_t;
+
+typedef struct {
+    // unshaped axes: trapezoid inversion
+    uint32_t steps;             // steps to do in current block
+    uint32_t done;              // steps generated
+    float ds;                   // path distance per step (mm)
+    int64_t u;                  // S-curve phase progress of last step (Q30)
+    uint8_t phase;              // S-curve phase of last step (0: accel)
+    int8_t block_level;         // DIR level in current block
+    // shaped axes: search of shaped position
+    float t;                    // time searched (relative to block start)
+    float p;                    // shaped position at `t` (steps)
+    float v;                    // shaped velocity estimate (steps/s)
+    int8_t sign;                // direction of last shaped step
+    shaper_t pulses;            // impulses delayed to a common center
+    bool advance;               // add pressure advance (E only)
+    // output
+    bool shaped;
+    bool exhausted;             // no more steps in current block
+    bool peek;                  // next step generated but not buffered
+    int8_t peek_level;
+    uint64_t peek_tick;
+    int8_t dir;                 // DIR level to emit, -1 if none
+    int8_t level;               // last emitted DIR level
+    uint32_t num;               // buffered step times
+    uint32_t buf[STEPGEN_BUFFER];   // step times relative to base
+    uint64_t base;              // decoded time of last emitted step
+    uint64_t last;              // exact time of last generated step
+} axis_state_t;
+
+static struct {
+    bool busy;                  // current block not finished
+    segment_t hist[STEPGEN_HISTORY];
+    uint32_t nhist;             // segments loaded (index of next one)
+    axis_state_t axis[NUM_AXIS];
+    int32_t position[NUM_AXIS]; // steps
+    uint64_t start;             // block start time (ticks)
+    uint64_t delay;             // ticks unshaped axes are delayed
+    float lag;                  // same delay in seconds
+    float window;               // half of pressure advance smooth time
+    float settle;               // seconds shaped axes need to settle
+    float settled;              // seconds passed since last block
+    uint64_t horizon;
+    stepgen_stats_t stats;
+} st;
+
+#define SEGMENT(n) (st.hist + (n) % STEPGEN_HISTORY)
+
+void stepgen_reset() {
+    memset(&st, 0, sizeof(st));
+    for (uint8_t i = 0; i < NUM_AXIS; i++) {
+        st.axis[i].dir = st.axis[i].level = -1;
+    }
+    stepgen_update();
+}
+
+/* Align all axes to the same delay: shaped axes lag by the center of their
+ * shaper and pressure advance by half of the smooth time, so every axis is
+ * delayed to the largest of them. This keeps X/Y and E synchronized. The
+ * planner is limited to step rates the engine can output (see stepgen.h).
+ */
+void stepgen_update() {
+    const stepgen_config_t *cfg = &stepgen_config;
+    float delay = 0, window = 0;
+    for (uint8_t i = 0; i < NUM_EXTRUDER && cfg->pa_smooth > 0; i++) {
+        if (cfg->pa_advance[i] > 0) window = 0.5f * cfg->pa_smooth;
+    }
+    for (uint8_t i = 0; i < NUM_AXIS; i++) {
+        const shaper_t *shaper = cfg->shaper + i;
+        if (shaper->num && delay < shaper_center(shaper)) {
+            delay = shaper_center(shaper);
+        }
+    }
+    if (delay < window) delay = window;
+    st.delay = delay * cfg->tick_hz;
+    st.lag = delay;
+    st.window = window;
+    st.settle = 0;
+    for (uint8_t i = 0; i < NUM_AXIS; i++) {
+        axis_state_t *ax = st.axis + i;
+        ax->pulses = cfg->shaper[i];
+        ax->advance = i == AXIS_E && window > 0;
+        if (ax->advance && !ax->pulses.num) {
+            ax->pulses.num = 1;         // E itself is not shaped
+            ax->pulses.a[0] = 1;
+        }
+        ax->shaped = ax->pulses.num > 0;
+        float shift = delay - shaper_center(&ax->pulses);
+        for (uint8_t j = 0; j < ax->pulses.num; j++) ax->pulses.t[j] += shift;
+        ax->p = st.position[i];         // axes are at rest
+        ax->v = 0;
+        ax->sign = 0;
+        if (ax->shaped && st.settle < ax->pulses.t[ax->pulses.num - 1]) {
+            st.settle = ax->pulses.t[ax->pulses.num - 1];
+        }
+        if (ax->advance && st.settle < delay + window) {
+            st.settle = delay + window;
+        }
+    }
+    st.settled = st.settle;
+    for (uint8_t i = 0; i < NUM_AXIS; i++) {
+        float spm = cfg->steps_per_mm[i];
+        planner_config.step_speed[i] = cfg->min_interval && spm > 0
+            ? STEPGEN_RATE_USE * cfg->tick_hz / cfg->min_interval / spm : 0;
+    }
+}
+
+bool stepgen_busy() { return st.busy; }
+
+uint64_t stepgen_horizon() { return st.horizon; }
+
+void stepgen_position(int32_t steps[NUM_AXIS]) {
+    memcpy(steps, st.position, sizeof(st.position));
+}
+
+const stepgen_stats_t * stepgen_stats() { return &st.stats; }
+
+uint16_t stepgen_step_mask() {
+    uint16_t mask = 0;
+    for (uint8_t i = 0; i < NUM_AXIS; i++) mask |= stepgen_config.step_bits[i];
+    return mask;
+}
+
+// Path distance at `t` seconds since segment start
+static inline float segment_distance(const segment_t *seg, float t) {
+    if (t <= 0) return 0;
+    if (t > seg->duration) t = seg->duration;
+    float a = seg->accel, v0 = seg->entry_speed, vc = seg->cruise_speed;
+    if (t <= seg->accel_time) {
+        if (!seg->scurve) return (v0 + 0.5f * a * t) * t;
+        float T = seg->accel_time;
+        return v0 * t + a * T * T * scurve_position(t / T);
+    }
+    t -= seg->accel_time;
+    if (t <= seg->cruise_time) return seg->accel_dist + vc * t;
+    t -= seg->cruise_time;
+    float s = seg->accel_dist + seg->cruise_dist;
+    if (!seg->scurve) return s + (vc - 0.5f * a * t) * t;
+    float T = seg->decel_time;
+    return s + vc * t - a * T * T * scurve_position(t < T ? t / T : 1);
+}
+
+// Time (seconds since segment start) when path distance `s` is reached
+static float segment_time(const segment_t *seg, float s) {
+    float a = seg->accel;
+    if (s <= seg->accel_dist) {
+        float v0 = seg->entry_speed;
+        return (sqrtf(v0 * v0 + 2 * a * s) - v0) / a;
+    }
+    s -= seg->accel_dist;
+    if (s <= seg->cruise_dist) return seg->accel_time + s / seg->cruise_speed;
+    s -= seg->cruise_dist;
+    float vc = seg->cruise_speed, disc = vc * vc - 2 * a * s;
+    return seg->accel_time + seg->cruise_time
+         + (vc - (disc > 0 ? sqrtf(disc) : 0)) / a;
+}
+
+/* Ticks since segment start when path distance `s` is reached by axis `i`.
+ * S-curve phases are inverted in fixed point, starting from the last step
+ * of the same axis as steps only go forward along the path.
+ */
+static uint32_t segment_ticks(const segment_t *seg, float s, uint8_t i) {
+    if (!seg->scurve) return segment_time(seg, s) * stepgen_config.tick_hz;
+    axis_state_t *ax = st.axis + i;
+    const scurve_phase_t *phase;
+    uint32_t start, ticks;
+    float sigma;
+    if (s <= seg->accel_dist && seg->accel_ticks) {
+        if (ax->phase != 0) ax->u = 0;
+        ax->phase = 0;
+        phase = &seg->accel_phase;
+        start = 0;
+        ticks = seg->accel_ticks;
+        sigma = s / seg->accel_dist;
+    } else if (s > seg->accel_dist + seg->cruise_dist && seg->decel_ticks) {
+        if (ax->phase != 2) ax->u = 0;
+        ax->phase = 2;
+        phase = &seg->decel_phase;
+        start = seg->decel_start;
+        ticks = seg->decel_ticks;
+        sigma = (s - seg->accel_dist - seg->cruise_dist) / seg->decel_dist;
+    } else {
+        ax->phase = 1;
+        return segment_time(seg, s) * stepgen_config.tick_hz;
+    }
+    ax->u = scurve_solve(phase, (int64_t)(sigma * SCURVE_ONE), ax->u,
+                         SCURVE_ONE / ticks, &st.stats.iters);
+    return start + (uint32_t)((ax->u * ticks) >> SCURVE_Q);
+}
+
+// Commanded position of axis `i` at `t` seconds since current block start
+static float axis_position(uint8_t i, float t) {
+    uint32_t n = st.nhist - 1, first = st.nhist > STEPGEN_HISTORY
+                                     ? st.nhist - STEPGEN_HISTORY : 0;
+    const segment_t *seg = SEGMENT(n);
+    while (t < 0 && n > first) {
+        seg = SEGMENT(--n);
+        t += seg->duration;
+    }
+    return seg->pos[i] + seg->unit[i] * segment_distance(seg, t);
+}
+
+/* Pressure advance of E at `t` seconds since current block start: K times
+ * E distance in (t - window, t + window) divided by the window, i.e. K times
+ * average extrusion speed. Each segment uses its own K.
+ */
+static float advance_position(float t) {
+    uint32_t n = st.nhist - 1, first = st.nhist > STEPGEN_HISTORY
+                                     ? st.nhist - STEPGEN_HISTORY : 0;
+    float lo = t - st.window, hi = t + st.window, start = 0, dist = 0;
+    for (;;) {
+        const segment_t *seg = SEGMENT(n);
+        if (seg->advance && hi > start) {
+            float t0 = lo > start ? lo - start : 0, t1 = hi - start;
+            dist += seg->advance * seg->unit[AXIS_E] * (
+                segment_distance(seg, t1) - segment_distance(seg, t0));
+        }
+        if (lo >= start || n == first) break;
+        start -= SEGMENT(--n)->duration;
+    }
+    return dist / (2 * st.window);
+}
+
+// Shaped (or advanced) position of axis `i` in steps
+static float shaped_position(uint8_t i, float t) {
+    const axis_state_t *ax = st.axis + i;
+    const shaper_t *sh = &ax->pulses;
+    float pos = 0;
+    for (uint8_t j = 0; j < sh->num; j++) {
+        pos += sh->a[j] * axis_position(i, t - sh->t[j]);
+    }
+    if (ax->advance) pos += advance_position(t - st.lag);
+    return pos * stepgen_config.steps_per_mm[i];
+}
+
+/* Find when shaped position of axis `i` leaves (n - 0.5, n + 0.5) steps.
+ * Probe forward with the step of time the last velocity estimate needs to
+ * cross the nearest threshold, then refine the bracket by regula falsi
+ * (Illinois variant). Return false if no step until end of current block.
+ */
+static bool shaped_step(uint8_t i, float *time, int8_t *sign) {
+    axis_state_t *ax = st.axis + i;
+    const segment_t *seg = SEGMENT(st.nhist - 1);
+    const float tick = 1.0f / stepgen_config.tick_hz;
+    float hi = st.position[i] + 0.5f, lo = st.position[i] - 0.5f;
+    float t = ax->t, p = ax->p;
+    // position right after a step is at the threshold: don't step back on
+    // rounding noise of the evaluation
+    if (ax->sign > 0) lo -= STEPGEN_HYSTERESIS;
+    if (ax->sign < 0) hi += STEPGEN_HYSTERESIS;
+    while (t < seg->duration) {
+        float gap = ax->v > 0 ? hi - p : p - lo, speed = fabsf(ax->v);
+        float dt = speed * STEPGEN_SCAN_MAX > gap ? gap / speed
+                                                  : STEPGEN_SCAN_MAX;
+        if (dt < STEPGEN_SCAN_MIN) dt = STEPGEN_SCAN_MIN;
+        float t2 = fminf(t + dt, seg->duration), p2 = shaped_position(i, t2);
+        st.stats.evals++;
+        if (p2 < hi && p2 > lo) {
+            ax->v = (p2 - p) / (t2 - t);
+            t = t2;
+            p = p2;
+            continue;
+        }
+        float target = p2 >= hi ? hi : lo;
+        float fa = p - target, fb = p2 - target, ta = t;
+        int8_t side = 0;
+        for (uint8_t iter = 0; iter < 32 && t2 - ta > tick; iter++) {
+            float tm = t2 - fb * (t2 - ta) / (fb - fa);
+            if (!(tm > ta && tm < t2)) tm = 0.5f * (ta + t2);
+            float fm = shaped_position(i, tm) - target;
+            st.stats.evals++;
+            if ((fm >= 0) == (fb >= 0)) {
+                t2 = tm;
+                fb = fm;
+                if (side == -1) fa *= 0.5f;
+                side = -1;
+            } else {
+                ta = tm;
+                fa = fm;
+                if (side == 1) fb *= 0.5f;
+                side = 1;
+            }
+        }
+        ax->v = (fb + target - p) / (t2 - t);
+        ax->t = t2;
+        ax->p = fb + target;
+        *time = t2;
+        *sign = ax->sign = target == hi ? 1 : -1;
+        return true;
+    }
+    ax->t = t;
+    ax->p = p;
+    return false;
+}
+
+// Generate next exact step of axis `i` into peek slot
+static bool axis_step(uint8_t i) {
+    const stepgen_config_t *cfg = &stepgen_config;
+    axis_state_t *ax = st.axis + i;
+    uint64_t t;
+    if (ax->shaped) {
+        float time;
+        int8_t sign;
+        if (!shaped_step(i, &time, &sign)) return false;
+        st.position[i] += sign;
+        ax->peek_level = (sign < 0) != cfg->invert_dir[i];
+        t = st.start + (uint64_t)(time * cfg->tick_hz);
+    } else {
+        if (ax->done >= ax->steps) return false;
+        float s = (ax->done + 0.5f) * ax->ds;
+        ax->done++;
+        ax->peek_level = ax->block_level;
+        t = st.start + st.delay + segment_ticks(SEGMENT(st.nhist - 1), s, i);
+    }
+    if (t < ax->last + cfg->min_interval) {
+        t = ax->last + cfg->min_interval;
+        st.stats.clamped++;
+    }
+    ax->last = ax->peek_tick = t;
+    ax->peek = true;
+    return true;
+}
+
+// Buffer step times until direction changes or buffer is full
+static void axis_fill(uint8_t i) {
+    axis_state_t *ax = st.axis + i;
+    while (ax->num < STEPGEN_BUFFER) {
+        if (!ax->peek && (ax->exhausted || !axis_step(i))) {
+            ax->exhausted = true;
+            break;
+        }
+        if (ax->peek_level != ax->level) {
+            if (!ax->num) ax->dir = ax->level = ax->peek_level;
+            break;
+        }
+        if (ax->peek_tick - ax->base > STEPGEN_MAX_OFFSET) break;
+        ax->buf[ax->num++] = ax->peek_tick - ax->base;
+        ax->peek = false;
+    }
+}
+
+static inline bool axis_pending(const axis_state_t *ax) {
+    return ax->dir >= 0 || ax->num || ax->peek || !ax->exhausted;
+}
+
+static void update_horizon() {
+    const segment_t *seg = SEGMENT(st.nhist - 1);
+    uint64_t horizon = st.start + (uint64_t)(
+        seg->duration * stepgen_config.tick_hz);
+    for (uint8_t i = 0; i < NUM_AXIS; i++) {
+        const axis_state_t *ax = st.axis + i;
+        if (axis_pending(ax) && ax->base < horizon) horizon = ax->base;
+    }
+    st.horizon = horizon;
+}
+
+static void load_segment(const segment_t *seg) {
+    const stepgen_config_t *cfg = &stepgen_config;
+    *SEGMENT(st.nhist++) = *seg;
+    for (uint8_t i = 0; i < NUM_AXIS; i++) {
+        axis_state_t *ax = st.axis + i;
+        ax->exhausted = false;
+        ax->u = 0;
+        ax->phase = 0;
+        if (ax->shaped) {
+            ax->t = 0;
+            continue;
+        }
+        float end = (seg->pos[i] + seg->unit[i] * segment_distance(
+            seg, seg->duration)) * cfg->steps_per_mm[i];
+        int32_t target = lroundf(end), steps = target - st.position[i];
+        ax->steps = steps < 0 ? -steps : steps;
+        ax->done = 0;
+        ax->ds = ax->steps ? segment_distance(seg, seg->duration) / ax->steps
+                           : 0;
+        ax->block_level = (steps < 0) != cfg->invert_dir[i];
+        st.position[i] = target;
+    }
+    st.busy = true;
+    st.stats.blocks++;
+}
+
+bool stepgen_load(const planner_block_t *block) {
+    if (st.busy) return false;
+    segment_t seg;
+    memset(&seg, 0, sizeof(seg));
+    if (!block) {
+        // pause until shaped axes settled at the last position
+        if (st.settled >= st.settle) return false;
+        const segment_t *prev = SEGMENT(st.nhist - 1);
+        for (uint8_t i = 0; i < NUM_AXIS; i++) {
+            seg.pos[i] = prev->pos[i]
+                       + prev->unit[i] * segment_distance(prev, prev->duration);
+        }
+        seg.duration = seg.cruise_time = st.settle - st.settled;
+        st.settled = st.settle;
+    } else {
+        memcpy(seg.pos, block->start, sizeof(seg.pos));
+        memcpy(seg.unit, block->unit, sizeof(seg.unit));
+        seg.duration = planner_block_time(block);
+        seg.entry_speed = block->entry_speed;
+        seg.cruise_speed = block->cruise_speed;
+        seg.accel = block->accel;
+        seg.accel_time = block->accel_time;
+        seg.cruise_time = block->cruise_time;
+        seg.accel_dist = block->accel_dist;
+        seg.cruise_dist = block->cruise_dist;
+        if (block->flags & BLOCK_SCURVE) {
+            uint32_t hz = stepgen_config.tick_hz;
+            seg.scurve = true;
+            seg.decel_time = block->decel_time;
+            seg.decel_dist = block->distance - seg.accel_dist - seg.cruise_dist;
+            scurve_init(&seg.accel_phase, seg.entry_speed, seg.cruise_speed);
+            scurve_init(&seg.decel_phase, seg.cruise_speed, block->exit_speed);
+            seg.accel_ticks = seg.accel_time * hz;
+            seg.decel_start = (seg.accel_time + seg.cruise_time) * hz;
+            seg.decel_ticks = seg.decel_time * hz;
+        }
+        // only advance E while printing: not on retraction or E only moves
+        bool xy = block->unit[AXIS_X] || block->unit[AXIS_Y];
+        seg.advance = xy && block->unit[AXIS_E] > 0 && block->extruder <
+            NUM_EXTRUDER ? stepgen_config.pa_advance[block->extruder] : 0;
+        st.settled = 0;
+    }
+    load_segment(&seg);
+    return true;
+}
+
+bool stepgen_next(uint8_t *axis, step_move_t *move) {
+    while (st.busy) {
+        // axis lagging behind goes first, so that all axes advance together
+        axis_state_t *ax = NULL;
+        for (uint8_t i = 0; i < NUM_AXIS; i++) {
+            axis_state_t *tmp = st.axis + i;
+            if (!axis_pending(tmp) || (ax && ax->base <= tmp->base)) continue;
+            ax = tmp;
+            *axis = i;
+        }
+        if (!ax) break;
+        if (ax->dir < 0) axis_fill(*axis);
+        if (ax->dir >= 0) {
+            move->interval = 0;
+            move->count = 0;
+            move->add = ax->dir;
+            ax->dir = -1;
+        } else if (ax->num) {
+            // decoded steps must not overtake the next exact step
+            uint32_t err = stepgen_config.max_error;
+            if (err >= stepgen_config.min_interval) {
+                err = stepgen_config.min_interval - 1;
+            }
+            uint32_t cnt = stepcompress(ax->buf, ax->num, err, move);
+            uint32_t dur = step_move_duration(move);
+            ax->num -= cnt;
+            for (uint32_t j = 0; j < ax->num; j++) {
+                ax->buf[j] = ax->buf[j + cnt] - dur;
+            }
+            ax->base += dur;
+            st.stats.steps[*axis] += cnt;
+        } else if (ax->peek) {
+            // next step is too far away: advance axis clock only
+            move->interval = STEPGEN_MAX_OFFSET;
+            move->count = 0;
+            move->add = -1;
+            ax->base += STEPGEN_MAX_OFFSET;
+        } else {
+            continue;                   // no more steps on this axis
+        }
+        st.stats.moves++;
+        update_horizon();
+        return true;
+    }
+    if (st.busy) {
+        // block finished: next block starts at the end of this one
+        st.start += (uint64_t)(
+            SEGMENT(st.nhist - 1)->duration * stepgen_config.tick_hz);
+        st.horizon = st.start;
+        st.busy = false;
+    }
+    return false;
+}
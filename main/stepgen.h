@@ -0,0 +1,100 @@
+/*
+ * File: stepgen.h
+ * Authors: Hank <hankso1106@gmail.com>
+ * Create: 2026-10-17 13:02:18
+ *
+ * Step generator: turns trapezoid blocks from the planner into compressed
+ * step timing of each axis (see stepcompress.h). All math (trapezoid
+ * inversion, compression) is done here, in task context, so the step ISR
+ * only adds integers to expand moves:
+ *
+ *      planner block -> step times of each axis -> (interval, count, add)
+ *
+ * Time is counted in timer ticks since stepgen_reset. Moves of all axes are
+ * produced roughly in time order (the axis lagging behind goes first) and
+ * stepgen_horizon tells until when the timeline is complete, i.e. no step
+ * earlier than the horizon will be produced later.
+ *
+ * Axes with an input shaper (see shaper.h) follow the shaped position, which
+ * depends on recent blocks too. Copies of the last STEPGEN_HISTORY blocks are
+ * kept for that, and step times are found by searching when the shaped
+ * position crosses the middle between two steps. Other axes are delayed by
+ * the shaper center to stay synchronized and use the fast trapezoid inversion.
+ * After the last block, stepgen_load(NULL) adds a pause to let shaped axes
+ * settle at the final position.
+ *
+ * Blocks fetched with BLOCK_SCURVE follow the S-curve speed profile. Their
+ * accel/decel phases are inverted in fixed point (see scurve.h), starting
+ * from the previous step of the same axis.
+ *
+ * Pressure advance moves E ahead of the commanded position by K times the
+ * extrusion speed, for blocks extruding while X/Y moves. The speed is the
+ * average over `pa_smooth` seconds centered on the time evaluated, so E is
+ * delayed by half of the window too and uses the same search as shaped axes.
+ *
+ * Steps closer than `min_interval` are delayed (clamped). If an axis keeps
+ * stepping faster than that, its steps pile up past the end of the block
+ * while the horizon stays there: its move ring fills with moves the ISR may
+ * not run yet and the step engine jams. stepgen_update prevents that by
+ * limiting the planner (planner_config.step_speed) to STEPGEN_RATE_USE of
+ * the highest step rate on every axis.
+ */
+
+#ifndef _STEPGEN_H_
+#define _STEPGEN_H_
+
+#include "planner.h"
+#include "stepcompress.h"
+#include "shaper.h"
+
+#define STEPGEN_BUFFER      128     // step times of each axis to compress
+#define STEPGEN_MAX_OFFSET  (1UL << 30) // longest gap in one move (ticks)
+#define STEPGEN_HISTORY     32      // blocks kept for shaped axes
+#define STEPGEN_SCAN_MIN    5e-6f   // time steps searching shaped position
+#define STEPGEN_SCAN_MAX    1e-3f
+#define STEPGEN_HYSTERESIS  0.05f   // steps to go back before reversing
+#define STEPGEN_RATE_USE    0.8f    // of 1 / min_interval planned at most
+
+typedef struct {
+    float steps_per_mm[NUM_AXIS];
+    bool invert_dir[NUM_AXIS];
+    uint16_t step_bits[NUM_AXIS];   // frame bit of STEP pin of each axis
+    uint16_t dir_bits[NUM_AXIS];    // frame bit of DIR pin of each axis
+    uint16_t idle_bits;             // bits always output (e.g. EN pins)
+    uint32_t tick_hz;               // timer ticks per second
+    uint32_t min_interval;          // minimum ticks between two steps
+    uint32_t max_error;             // compression error (< min_interval)
+    shaper_t shaper[NUM_AXIS];      // input shaper of each axis
+    float pa_advance[NUM_EXTRUDER]; // pressure advance K (s), 0 to disable
+    float pa_smooth;                // pressure advance smooth time (s)
+} stepgen_config_t;
+
+typedef struct {
+    uint32_t blocks;            // blocks converted
+    uint32_t moves;             // compressed moves generated
+    uint32_t steps[NUM_AXIS];   // steps generated per axis
+    uint32_t clamped;           // steps delayed to respect min_interval
+    uint32_t evals;             // shaped position evaluations
+    uint32_t iters;             // S-curve solver iterations
+} stepgen_stats_t;
+
+extern stepgen_config_t stepgen_config;
+
+void stepgen_reset();
+void stepgen_update();                  // apply changes of stepgen_config
+
+/* Start generating moves of `block`. Return false if previous one not done.
+ * NULL means no more blocks: load a pause if shaped axes have not settled.
+ */
+bool stepgen_load(const planner_block_t *block);
+
+// Generate the next move of current block. Return false if block finished.
+bool stepgen_next(uint8_t *axis, step_move_t *move);
+
+bool stepgen_busy();                    // current block not finished
+uint64_t stepgen_horizon();             // all steps before it are generated
+uint16_t stepgen_step_mask();           // all STEP bits
+void stepgen_position(int32_t steps[NUM_AXIS]);
+const stepgen_stats_t * stepgen_stats();
+
+#endif // _STEPGEN_H_
@@ -0,0 +1,118 @@
+/*
+ * File: stepout.h
+ * Authors: Hank <hankso1106@gmail.com>
+ * Create: 2026-10-18 00:20:36
+ *
+ * Step output core: expands compressed moves (stepcompress.h) of all axes
+ * into 74HC595 frames. It is shared by the step timer ISR (stepper.cpp) and
+ * the host simulator (tools/bench/stepsim.cpp), which drive it the same way:
+ *
+ *      load()      pop moves of an axis until one with steps is loaded,
+ *                  DIR-only moves update `frame` on the way
+ *      earliest()  time of the next step of all axes
+ *      fire()      STEP bits of all axes due within `window` of `event_t`
+ *
+ * The caller outputs `frame | fire()` at event_t, `frame` again after the
+ * pulse width (new DIR levels go out with it), then schedules earliest().
+ * Times are in step generator timeline (lower 32 bits, wrapping).
+ *
+ * Methods are forced inline, so they end up in IRAM with the ISR using them.
+ */
+
+#ifndef _STEPOUT_H_
+#define _STEPOUT_H_
+
+#include "planner.h"
+#include "stepcompress.h"
+#include "ring.h"
+
+// Expansion state of one axis, times in step generator timeline
+typedef struct {
+    uint32_t last;              // time of last step
+    uint32_t next;              // time of next step (valid if count)
+    uint32_t interval;
+    int16_t add;
+    uint16_t count;             // steps left in current move
+} stepout_axis_t;
+
+template <uint32_t N>
+struct stepout_t {
+    spsc_ring_t<step_move_t, N> queue[NUM_AXIS];    // producer: motion task
+    stepout_axis_t axes[NUM_AXIS];
+    uint16_t step_bits[NUM_AXIS], dir_bits[NUM_AXIS];
+    uint16_t frame;             // DIR/EN pattern
+    uint32_t window;            // merge steps closer than this
+    uint32_t event_t;           // time of current event
+    bool notify;                // a ring dropped to half
+
+    void reset(const uint16_t *step, const uint16_t *dir, uint16_t idle,
+               uint32_t merge) {
+        for (uint8_t i = 0; i < NUM_AXIS; i++) {
+            queue[i].reset();
+            axes[i] = stepout_axis_t();
+            step_bits[i] = step[i];
+            dir_bits[i] = dir[i];
+        }
+        frame = idle;
+        window = merge;
+        event_t = 0;
+        notify = false;
+    }
+
+    // Pop moves until one with steps is found. Return false if ring is empty.
+    RING_INLINE bool load(uint8_t i) {
+        stepout_axis_t *ax = axes + i;
+        while (!ax->count) {
+            const step_move_t *move = queue[i].front();
+            if (!move) return false;
+            if (move->count) {
+                ax->interval = move->interval;
+                ax->add = move->add;
+                ax->count = move->count;
+                ax->next = ax->last + move->interval;
+            } else {
+                ax->last += move->interval;
+                if (move->add > 0) frame |= dir_bits[i];
+                if (move->add == 0) frame &= ~dir_bits[i];
+            }
+            queue[i].pop();
+            if (queue[i].level() == N / 2) notify = true;
+        }
+        return true;
+    }
+
+    RING_INLINE void load_all() {
+        for (uint8_t i = 0; i < NUM_AXIS; i++) load(i);
+    }
+
+    // Find the earliest step of all axes. Return false if no step is loaded.
+    RING_INLINE bool earliest(uint32_t *next) const {
+        bool found = false;
+        for (uint8_t i = 0; i < NUM_AXIS; i++) {
+            if (!axes[i].count) continue;
+            if (!found || (int32_t)(axes[i].next - *next) < 0)
+                *next = axes[i].next;
+            found = true;
+        }
+        return found;
+    }
+
+    // Take steps of all axes due within the merge window, return STEP bits
+    RING_INLINE uint16_t fire() {
+        uint16_t bits = 0;
+        for (uint8_t i = 0; i < NUM_AXIS; i++) {
+            stepout_axis_t *ax = axes + i;
+            if (!ax->count || (int32_t)(ax->next - event_t) >= (int32_t)window)
+                continue;
+            bits |= step_bits[i];
+            ax->last = ax->next;
+            if (--ax->count) {
+                ax->interval += ax->add;
+                ax->next += ax->interval;
+            }
+        }
+        return bits;
+    }
+};
+
+#endif // _STEPOUT_H_
@@ -0,0 +1,738 @@
+/*
+ * File: stepper.cpp
+ * Authors: Hank <hankso1106@gmail.com>
+ * Create: 2026-10-17 13:40:52
+ */
+
+#include "stepper.h"
+#include "motion.h"
+#include "drivers.h"
+#include "config.h"
+#include "stepout.h"
+#include "heater.h"
+#include "softpwm.h"
+
+#include <stdlib.h>
+#include <string.h>
+#include <strings.h>
+#include <math.h>
+
+#include "esp_log.h"
+#include "esp_attr.h"
+#include "rom/ets_sys.h"
+#include "xtensa/hal.h"
+#include "soc/timer_group_struct.h"
+#include "driver/timer.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "freertos/queue.h"
+
+#define TIMER_GROUP     TIMER_GROUP_1
+#define TIMER_INDEX     TIMER_0
+#define TIMER_DIVIDER   8               // 80MHz APB / 8 = 10MHz ticks
+#define TIMER_MARGIN    20              // ticks to set an alarm in future
+
+#define PROBE_CLEAR     5.0f            // Z to travel between probe points
+#define PROBE_BOTTOM    -2.0f           // give up below this Z
+#define PROBE_COARSE    0.2f            // Z steps to find the bed
+#define PROBE_FINE      0.01f           // Z steps to measure it
+#define PROBE_FEED      3000            // XY travel speed (mm/min)
+#define PROBE_ZFEED     300             // Z speed (mm/min)
+
+static const char *TAG = "Stepper";
+
+static timg_dev_t * const timer_dev = &TIMERG1;
+
+// Move rings and expansion of all axes: motion task pushes, ISR pops
+static stepout_t<STEPPER_QUEUE> out;
+
+// Time in step generator timeline (lower 32 bits, wrapping) until which all
+// moves are queued. ISR stops instead of running ahead of it.
+static volatile uint32_t horizon = 0;
+
+static volatile bool running = false;   // ISR is scheduled
+// STEP bits dropped while the DIR pin of the axis is high (<< 16) or low
+static volatile uint32_t halted = 0;
+static volatile bool draining = false;  // no more moves will be generated
+static bool pulsing;                    // STEP bits are high
+static uint64_t event_at;               // timer count of current event
+static uint64_t alarm_at;               // timer count of next alarm
+static uint64_t start_at;               // timer count engine started
+
+static stepper_stats_t stats;
+static TaskHandle_t motion_task = NULL;
+static QueueHandle_t gcode_queue = NULL;
+static journal_state_t snapshot;        // state after last command output
+static journal_state_t ahead;           // state after last command planned
+static portMUX_TYPE snapshot_mux = portMUX_INITIALIZER_UNLOCKED;
+
+// Item of gcode_queue
+typedef struct {
+    gcode_cmd_t cmd;
+    uint32_t offset;            // in file being printed or JOURNAL_NONE
+} queued_cmd_t;
+
+// State after a command, waiting for the moves planned before it
+typedef struct {
+    uint32_t block;             // planner head after the command
+    uint32_t end;               // horizon when blocks before `block` retired
+    bool retired;               // stepgen discarded all blocks before `block`
+    journal_state_t state;
+} tracked_t;
+// Free running counters, index by `& (STEPPER_TRACK - 1)`
+static tracked_t tracked[STEPPER_TRACK];
+static uint32_t tracked_head, tracked_tail;
+static mesh_t mesh;
+static mesh_grid_t mesh_grid;           // unpacked from NVS
+static mesh_mode_t mesh_mode;           // applied to `mesh`
+static bool mesh_loaded;                // mesh_grid is valid
+static bool mesh_stale = true;          // NVS blob changed: read it again
+
+static inline uint64_t IRAM_ATTR timer_now() {
+    timer_dev->hw_timer[TIMER_INDEX].update = 1;
+    return ((uint64_t)timer_dev->hw_timer[TIMER_INDEX].cnt_high << 32)
+         | timer_dev->hw_timer[TIMER_INDEX].cnt_low;
+}
+
+static inline void IRAM_ATTR timer_alarm(uint64_t at) {
+    uint64_t now = timer_now();
+    if (at < now + TIMER_MARGIN) {
+        at = now + TIMER_MARGIN;
+        stats.late++;
+    }
+    alarm_at = at;
+    timer_dev->hw_timer[TIMER_INDEX].alarm_high = (uint32_t)(at >> 32);
+    timer_dev->hw_timer[TIMER_INDEX].alarm_low = (uint32_t)at;
+    timer_dev->hw_timer[TIMER_INDEX].config.alarm_en = TIMER_ALARM_EN;
+}
+
+// STEP bits of axes moving towards a triggered endstop
+static inline uint16_t IRAM_ATTR stepper_halted(uint32_t halt) {
+    uint16_t high = 0;
+    for (uint8_t i = 0; i < NUM_AXIS; i++) {
+        if (out.frame & out.dir_bits[i]) high |= out.step_bits[i];
+    }
+    return (halt >> 16 & high) | (halt & ~high);
+}
+
+// Schedule the earliest step unless it is beyond horizon
+static inline bool IRAM_ATTR stepper_schedule() {
+    uint32_t next;
+    if (!out.earliest(&next) || (int32_t)(next - horizon) > 0) return false;
+    event_at += (int32_t)(next - out.event_t);
+    out.event_t = next;
+    timer_alarm(event_at);
+    return true;
+}
+
+static void IRAM_ATTR stepper_isr(void *arg) {
+    uint32_t cycles = xthal_get_ccount();
+    timer_dev->int_clr_timers.t0 = 1;
+    uint32_t jitter = timer_now() - alarm_at;
+    BaseType_t woken = pdFALSE;
+    bool scheduled = true;
+    if (!pulsing) {
+        // output steps of all axes due within the merge window
+        uint16_t bits = out.fire();
+        uint32_t halt = halted;
+        uint16_t drop = halt ? bits & stepper_halted(halt) : 0;
+        if (drop) {
+            bits &= ~drop;
+            stats.blocked++;
+        }
+        spi_gpio_write_isr(out.frame | bits);
+        stats.events++;
+        stats.steps += bits != 0;
+        pulsing = true;
+        timer_alarm(event_at + STEPPER_PULSE_TICKS);
+    } else {
+        // end of STEP pulse: new DIR levels go out with this frame
+        out.load_all();
+        spi_gpio_write_isr(out.frame);
+        pulsing = false;
+        scheduled = stepper_schedule();
+    }
+    if (!scheduled) {
+        running = false;
+        if (!draining) stats.underruns++;
+        stats.run_ticks += event_at - start_at;
+    }
+    if (!scheduled || out.notify) {
+        out.notify = false;
+        vTaskNotifyGiveFromISR(motion_task, &woken);
+    }
+    if (stats.jitter_min > jitter) stats.jitter_min = jitter;
+    if (stats.jitter_max < jitter) stats.jitter_max = jitter;
+    stats.jitter_sum += jitter;
+    stats.isr_count++;
+    cycles = xthal_get_ccount() - cycles;
+    if (stats.isr_cycles_min > cycles) stats.isr_cycles_min = cycles;
+    if (stats.isr_cycles_max < cycles) stats.isr_cycles_max = cycles;
+    stats.isr_cycles_sum += cycles;
+    if (woken) portYIELD_FROM_ISR();
+}
+
+// Timeline ticks queued ahead of current event
+static uint32_t stepper_buffered() {
+    uint32_t first = out.event_t;
+    if (!running) {
+        out.load_all();
+        if (!out.earliest(&first)) return 0;
+    }
+    return (int32_t)(horizon - first) > 0 ? horizon - first : 0;
+}
+
+static void stepper_start() {
+    if (running) return;
+    out.load_all();
+    if (!out.earliest(&out.event_t) || (int32_t)(out.event_t - horizon) > 0)
+        return;
+    esp_err_t err = spi_gpio_claim();
+    if (err) {
+        ESP_LOGE(TAG, "Could not claim HSPI bus: %s", esp_err_to_name(err));
+        return;
+    }
+    spi_gpio_write_isr(out.frame);      // DIR setup before the first step
+    start_at = event_at = timer_now() + STEPPER_PULSE_TICKS;
+    pulsing = false;
+    running = true;
+    timer_alarm(event_at);
+}
+
+static void timer_initialize() {
+    timer_config_t conf;
+    conf.alarm_en = TIMER_ALARM_DIS;
+    conf.counter_en = TIMER_PAUSE;
+    conf.intr_type = TIMER_INTR_LEVEL;
+    conf.counter_dir = TIMER_COUNT_UP;
+    conf.auto_reload = TIMER_AUTORELOAD_DIS;
+    conf.divider = TIMER_DIVIDER;
+    ESP_ERROR_CHECK( timer_init(TIMER_GROUP, TIMER_INDEX, &conf) );
+    ESP_ERROR_CHECK( timer_set_counter_value(TIMER_GROUP, TIMER_INDEX, 0) );
+    ESP_ERROR_CHECK( timer_enable_intr(TIMER_GROUP, TIMER_INDEX) );
+    // Interrupt is allocated on the core calling this function
+    ESP_ERROR_CHECK( timer_isr_register(
+        TIMER_GROUP, TIMER_INDEX, stepper_isr, NULL,
+        ESP_INTR_FLAG_IRAM | ESP_INTR_FLAG_LEVEL3, NULL) );
+    ESP_ERROR_CHECK( timer_start(TIMER_GROUP, TIMER_INDEX) );
+}
+
+// Apply motion settings of Config. Only call it when motion is settled.
+static void stepper_configure() {
+    shaper_type_t type = shaper_parse(Config.mtn.SHAPER);
+    float zeta = atof(Config.mtn.SHP_ZETA);
+    shaper_t *shaper = stepgen_config.shaper;
+    if (!shaper_init(shaper + AXIS_X, type, atof(Config.mtn.SHP_FX), zeta) ||
+        !shaper_init(shaper + AXIS_Y, type, atof(Config.mtn.SHP_FY), zeta)) {
+        if (type != SHAPER_NONE) ESP_LOGW(TAG, "Invalid input shaper config");
+        memset(shaper + AXIS_X, 0, sizeof(shaper_t));
+        memset(shaper + AXIS_Y, 0, sizeof(shaper_t));
+    }
+    // "K1,K2,K3": missing values repeat the last one
+    const char *str = Config.mtn.PA_K;
+    float k = 0;
+    for (uint8_t i = 0; i < NUM_EXTRUDER; i++) {
+        char *end;
+        float val = strtof(str, &end);
+        if (end != str) k = val;
+        stepgen_config.pa_advance[i] = k > 0 ? k : 0;
+        str = *end == ',' ? end + 1 : end;
+    }
+    stepgen_config.pa_smooth = atof(Config.mtn.PA_SMOOTH);
+    stepgen_update();
+    planner_config.profile = strcasecmp(Config.mtn.PROFILE, "scurve")
+                           ? PLANNER_TRAPEZOID : PLANNER_SCURVE;
+    float tol = atof(Config.mtn.ARC_TOL), time = atof(Config.mtn.ARC_TIME);
+    if (tol > 0) motion_config.arc_tolerance = tol;
+    if (time >= 0) motion_config.arc_min_time = time;
+    // mesh probed by G29 is kept in NVS, only the mode comes from Config:
+    // read the blob at init and after G29, redo cells when the mode changes
+    static uint8_t buf[MESH_PACKED_SIZE(MESH_MAX_POINTS, MESH_MAX_POINTS)];
+    mesh_mode_t mode = mesh_parse(Config.mtn.MESH_MODE);
+    if (mesh_stale) {
+        size_t len = config_nvs_get_blob(STEPPER_MESH_KEY, buf, sizeof(buf));
+        mesh_loaded = len && mesh_unpack(&mesh_grid, buf, len);
+    }
+    if (mesh_stale || mode != mesh_mode) {
+        mesh_stale = false;
+        mesh_mode = mode;
+        if (!mesh_loaded || !mesh_init(&mesh, &mesh_grid, mode)) {
+            if (mode != MESH_OFF)
+                ESP_LOGW(TAG, "No valid bed mesh, G29 first");
+            mesh.mode = MESH_OFF;
+        }
+        motion_set_mesh(&mesh);
+    }
+}
+
+/* Drive the E axis through the driver of extruder `e` (T0-T2): STEP/DIR
+ * bits of the axis move to its pins, EN pins of the others go high. The DIR
+ * level is carried over, as stepgen only emits DIR when it changes. Only
+ * call it when all moves are output.
+ */
+static void stepper_extruder(uint8_t e) {
+    const spi_pin_num_t step_pins[NUM_EXTRUDER] = {
+        PIN_E1STEP, PIN_E2STEP, PIN_E3STEP
+    };
+    const spi_pin_num_t dir_pins[NUM_EXTRUDER] = {
+        PIN_E1DIR, PIN_E2DIR, PIN_E3DIR
+    };
+    const spi_pin_num_t en_pins[NUM_EXTRUDER] = {
+        PIN_E1EN, PIN_E2EN, PIN_E3EN
+    };
+    uint16_t idle = 0, dir = SPI_FRAME_BIT(dir_pins[e]);
+    for (uint8_t i = 0; i < NUM_EXTRUDER; i++) {
+        if (i != e) idle |= SPI_FRAME_BIT(en_pins[i]);
+    }
+    uint16_t frame = out.frame & ~stepgen_config.idle_bits;
+    if (frame & out.dir_bits[AXIS_E]) {
+        frame = (frame & ~out.dir_bits[AXIS_E]) | dir;
+    }
+    out.frame = frame | idle;
+    out.step_bits[AXIS_E] = SPI_FRAME_BIT(step_pins[e]);
+    out.dir_bits[AXIS_E] = dir;
+    stepgen_config.step_bits[AXIS_E] = out.step_bits[AXIS_E];
+    stepgen_config.dir_bits[AXIS_E] = dir;
+    stepgen_config.idle_bits = idle;
+}
+
+void stepper_initialize() {
+    // Map axes to 74HC595 outputs: X/Y/Z and E1
+    const spi_pin_num_t step_pins[NUM_AXIS] = {
+        PIN_XSTEP, PIN_YSTEP, PIN_ZSTEP, PIN_E1STEP
+    };
+    const spi_pin_num_t dir_pins[NUM_AXIS] = {
+        PIN_XDIR, PIN_YDIR, PIN_ZDIR, PIN_E1DIR
+    };
+    for (uint8_t i = 0; i < NUM_AXIS; i++) {
+        stepgen_config.step_bits[i] = SPI_FRAME_BIT(step_pins[i]);
+        stepgen_config.dir_bits[i] = SPI_FRAME_BIT(dir_pins[i]);
+    }
+    // EN pins are active low: keep E2/E3 drivers disabled until T1/T2
+    stepgen_config.idle_bits = SPI_FRAME_BIT(PIN_E2EN)
+                             | SPI_FRAME_BIT(PIN_E3EN);
+    stepgen_config.tick_hz = TIMER_BASE_CLK / TIMER_DIVIDER;
+    stepgen_config.min_interval = STEPPER_PULSE_TICKS * 2;
+    out.reset(stepgen_config.step_bits, stepgen_config.dir_bits,
+              stepgen_config.idle_bits, stepgen_config.min_interval);
+    stepper_extruder(0);
+    motion_initialize();
+    stepgen_reset();
+    mesh_stale = true;                  // motion_initialize dropped the mesh
+    stepper_configure();
+    stepper_stats_reset();
+    if (!gcode_queue) {
+        gcode_queue = xQueueCreate(STEPPER_GCODE_QUEUE, sizeof(queued_cmd_t));
+    }
+}
+
+bool stepper_queue_gcode(const gcode_cmd_t *cmd, uint32_t timeout_ms,
+                         uint32_t offset) {
+    if (!gcode_queue) return false;
+    queued_cmd_t item = { *cmd, offset };
+    if (!xQueueSend(gcode_queue, &item, pdMS_TO_TICKS(timeout_ms)))
+        return false;
+    if (motion_task) xTaskNotifyGive(motion_task);
+    return true;
+}
+
+void stepper_snapshot(journal_state_t *state) {
+    portENTER_CRITICAL(&snapshot_mux);
+    *state = snapshot;
+    portEXIT_CRITICAL(&snapshot_mux);
+}
+
+void stepper_snapshot_offset(uint32_t offset) {
+    portENTER_CRITICAL(&snapshot_mux);
+    snapshot.offset = ahead.offset = offset;
+    for (uint32_t i = tracked_tail; i != tracked_head; i++) {
+        tracked[i & (STEPPER_TRACK - 1)].state.offset = offset;
+    }
+    portEXIT_CRITICAL(&snapshot_mux);
+}
+
+// All moves generated so far are output: engine stopped with empty rings
+static bool stepper_drained() {
+    uint32_t next;
+    if (running || stepgen_busy() || planner_count()) return false;
+    out.load_all();
+    return !out.earliest(&next);
+}
+
+// Mark states whose blocks stepgen has discarded, at the current horizon
+static void stepper_retire() {
+    for (uint32_t i = tracked_tail; i != tracked_head; i++) {
+        tracked_t *t = tracked + (i & (STEPPER_TRACK - 1));
+        if (t->retired) continue;
+        if ((int32_t)(planner.tail - t->block) < 0) break;
+        t->retired = true;
+        t->end = horizon;
+    }
+}
+
+// Move states into snapshot once the ISR has passed the end of their moves
+static void stepper_publish() {
+    bool drained = stepper_drained();
+    stepper_retire();
+    portENTER_CRITICAL(&snapshot_mux);
+    while (tracked_tail != tracked_head) {
+        tracked_t *t = tracked + (tracked_tail & (STEPPER_TRACK - 1));
+        if (!drained && !(t->retired && (int32_t)(out.event_t - t->end) > 0))
+            break;
+        snapshot = t->state;
+        tracked_tail++;
+    }
+    portEXIT_CRITICAL(&snapshot_mux);
+}
+
+/* Track state after a command is done (its moves are planned). It becomes
+ * the snapshot when the moves planned so far are output, so the offset
+ * and position in the journal never run ahead of the printer.
+ */
+static void stepper_track(const gcode_cmd_t *cmd, uint32_t offset) {
+    const motion_state_t *st = motion_state();
+    uint8_t flags = (st->relative ? JOURNAL_RELATIVE : 0) |
+                    (st->relative_e ? JOURNAL_RELATIVE_E : 0) |
+                    (st->units != 1 ? JOURNAL_INCH : 0);
+    uint32_t block = planner.head;
+    portENTER_CRITICAL(&snapshot_mux);
+    journal_track(&ahead, cmd);
+    memcpy(ahead.position, st->position, sizeof(ahead.position));
+    ahead.feedrate = st->feedrate;
+    ahead.extruder = st->extruder;
+    ahead.flags = flags;
+    if (offset != JOURNAL_NONE) ahead.offset = offset;
+    // without new blocks since the last state, both are due together
+    tracked_t *t = tracked + ((tracked_head - 1) & (STEPPER_TRACK - 1));
+    if (tracked_head == tracked_tail || t->block != block) {
+        if (tracked_head - tracked_tail == STEPPER_TRACK) {
+            // ring full: publish the oldest state early
+            snapshot = tracked[tracked_tail++ & (STEPPER_TRACK - 1)].state;
+        }
+        t = tracked + (tracked_head++ & (STEPPER_TRACK - 1));
+        t->block = block;
+        t->retired = false;
+    }
+    t->state = ahead;
+    portEXIT_CRITICAL(&snapshot_mux);
+    stepper_publish();
+}
+
+uint32_t stepper_queue_space() {
+    return gcode_queue ? uxQueueSpacesAvailable(gcode_queue) : 0;
+}
+
+void stepper_halt(uint8_t min, uint8_t max) {
+    uint16_t high = 0, low = 0;
+    for (uint8_t i = 0; i < NUM_AXIS; i++) {
+        // DIR level is high for moves towards min unless inverted
+        bool min_high = !stepgen_config.invert_dir[i];
+        uint16_t step = stepgen_config.step_bits[i];
+        if (min & BIT(i)) *(min_high ? &high : &low) |= step;
+        if (max & BIT(i)) *(min_high ? &low : &high) |= step;
+    }
+    halted = (uint32_t)high << 16 | low;
+}
+
+bool stepper_running() { return running; }
+
+const stepper_stats_t * stepper_stats() { return &stats; }
+
+void stepper_stats_reset() {
+    memset(&stats, 0, sizeof(stats));
+    stats.isr_cycles_min = stats.jitter_min = UINT32_MAX;
+    for (uint8_t i = 0; i < NUM_AXIS; i++) out.queue[i].reset_stats();
+}
+
+void stepper_info() {
+    const stepper_stats_t *st = &stats;
+    const stepgen_stats_t *sg = stepgen_stats();
+    const planner_stats_t *pl = planner_stats();
+    uint32_t mhz = ets_get_cpu_frequency();
+    uint32_t n = st->isr_count ? st->isr_count : 1;
+    double tick_us = 1e6 / stepgen_config.tick_hz;
+    uint64_t run_ticks = st->run_ticks;
+    if (running) run_ticks += event_at - start_at;
+    double secs = run_ticks * tick_us * 1e-6;
+    printf("Engine: %s, %.1fms buffered, %u commands, queue",
+           running ? "running" : "idle",
+           (running ? stepper_buffered() : 0) * tick_us / 1e3,
+           gcode_queue ? uxQueueMessagesWaiting(gcode_queue) : 0);
+    for (uint8_t i = 0; i < NUM_AXIS; i++) printf(" %u", out.queue[i].level());
+    printf(" / %d moves\n", STEPPER_QUEUE);
+    printf("Rings: peak / full / dry");
+    for (uint8_t i = 0; i < NUM_AXIS; i++) {
+        printf("%s %c %u/%u/%u", i ? "," : "", "XYZE"[i],
+               out.queue[i].peak, out.queue[i].full, out.queue[i].dry);
+    }
+    printf("\n");
+    printf("Output: %u events, %u steps in %.3fs (%.0f steps/s)\n",
+           st->events, st->steps, secs, secs > 0 ? st->steps / secs : 0.0);
+    printf("Faults: %u underruns, %u late alarms, %u clamped steps, "
+           "%u blocked at endstops\n", st->underruns, st->late, sg->clamped,
+           st->blocked);
+    if (st->isr_count) {
+        printf("ISR:    %u calls, %.2f / %.2f / %.2f us (min/avg/max)\n",
+               st->isr_count, (double)st->isr_cycles_min / mhz,
+               (double)st->isr_cycles_sum / n / mhz,
+               (double)st->isr_cycles_max / mhz);
+        printf("Jitter: %.1f / %.2f / %.1f us (min/avg/max)\n",
+               st->jitter_min * tick_us, (double)st->jitter_sum / n * tick_us,
+               st->jitter_max * tick_us);
+    }
+    printf("Stepgen: %u blocks, %u moves, steps X %u Y %u Z %u E %u\n",
+           sg->blocks, sg->moves,
+           sg->steps[AXIS_X], sg->steps[AXIS_Y], sg->steps[AXIS_Z],
+           sg->steps[AXIS_E]);
+    printf("Planner: %u/%u queued, %u blocks, %u starved, %u full\n",
+           planner_count(), PLANNER_BLOCKS, pl->blocks, pl->starved, pl->full);
+    printf("Profile: %s, %u S-curve solver iterations\n",
+           Config.mtn.PROFILE, sg->iters);
+    const shaper_t *sx = stepgen_config.shaper + AXIS_X;
+    printf("Shaper: %s, %u pulses, %.2fms delay, %u evaluations\n",
+           Config.mtn.SHAPER, sx->num, shaper_center(sx) * 1e3, sg->evals);
+    printf("Advance: K %.3f %.3f %.3f, smooth %.3fs\n",
+           stepgen_config.pa_advance[0], stepgen_config.pa_advance[1],
+           stepgen_config.pa_advance[2], stepgen_config.pa_smooth);
+    printf("Mesh: %s, %ux%u points, %u split segments\n",
+           mesh.mode == MESH_OFF ? "off" : Config.mtn.MESH_MODE,
+           mesh.mode == MESH_OFF ? 0 : mesh.nx,
+           mesh.mode == MESH_OFF ? 0 : mesh.ny, motion_state()->mesh_segments);
+}
+
+// Generate moves until a ring is full (return true) or no block is available
+static bool stepper_fill(bool more_cmds) {
+    static step_move_t move;
+    static uint8_t axis;
+    static bool pending = false;            // move not yet queued
+    static bool planned = false;            // stepgen works on planner block
+    uint32_t low = stepgen_config.tick_hz / 1000 * STEPPER_LOW_MS;
+    for (;;) {
+        if (pending) {
+            if (!out.queue[axis].push(move)) return true;
+            pending = false;
+            horizon = (uint32_t)stepgen_horizon();
+        }
+        if (!stepgen_busy()) {
+            // Give look-ahead a chance: don't freeze a block while commands
+            // are waiting, unless planner is full or rings are running low.
+            bool starving = running && stepper_buffered() < low;
+            if (more_cmds && !planner_full() && !starving) return false;
+            planner_block_t *block = planner_current();
+            if (block) {
+                stepgen_load(block);
+            } else if (more_cmds || !stepgen_load(NULL)) {
+                return false;               // nothing to move or settle
+            }
+            planned = block != NULL;
+        }
+        if (stepgen_next(&axis, &move)) {
+            pending = true;
+        } else {
+            if (planned) planner_discard();
+            horizon = (uint32_t)stepgen_horizon();
+            stepper_retire();
+        }
+    }
+}
+
+// Fill rings and start the engine when enough is buffered. Return idle.
+static bool stepper_pump(bool more_cmds) {
+    uint32_t ready = stepgen_config.tick_hz / 1000 * STEPPER_START_MS;
+    bool full = stepper_fill(more_cmds);
+    bool idle = !more_cmds && !stepgen_busy() && !planner_count();
+    draining = idle;
+    if (!running && (idle || full || stepper_buffered() >= ready)) {
+        stepper_start();
+    }
+    stepper_publish();
+    return idle;
+}
+
+// Execute one command and wait until motion stops (used by G29)
+static void stepper_run(const gcode_cmd_t *cmd) {
+    while (motion_execute(cmd) == MOTION_BUSY) {
+        stepper_pump(true);
+        ulTaskNotifyTake(pdTRUE, pdMS_TO_TICKS(10));
+    }
+    while (!stepper_pump(false) || running) {
+        ulTaskNotifyTake(pdTRUE, pdMS_TO_TICKS(10));
+    }
+}
+
+static void stepper_move(float x, float y, float z, float feedrate) {
+    gcode_cmd_t cmd;
+    memset(&cmd, 0, sizeof(cmd));
+    cmd.line = -1;
+    cmd.letter = 'G';
+    cmd.code = 1;
+    const char letters[] = { 'X', 'Y', 'Z', 'F' };
+    const float values[] = { x, y, z, feedrate };
+    for (uint8_t i = 0; i < sizeof(letters); i++) {
+        if (isnan(values[i])) continue;
+        cmd.params[cmd.nparam].letter = letters[i];
+        cmd.params[cmd.nparam++].value = values[i];
+    }
+    stepper_run(&cmd);
+}
+
+// Probe is active low
+static bool probe_triggered() { return !i2c_gpio_get_level(PIN_PROB, true); }
+
+// Lower Z from PROBE_CLEAR until probe triggers. Return false if not found.
+static bool probe_point(float x, float y, float *z) {
+    float pos = *z = PROBE_CLEAR;
+    stepper_move(NAN, NAN, pos, PROBE_ZFEED);
+    stepper_move(x, y, NAN, PROBE_FEED);
+    if (probe_triggered()) return false;        // stuck or not connected
+    while (!probe_triggered()) {
+        if ((pos -= PROBE_COARSE) < PROBE_BOTTOM) return false;
+        stepper_move(NAN, NAN, pos, PROBE_ZFEED);
+    }
+    pos += PROBE_COARSE;
+    stepper_move(NAN, NAN, pos, PROBE_ZFEED);
+    while (!probe_triggered() && pos > PROBE_BOTTOM) {
+        stepper_move(NAN, NAN, pos -= PROBE_FINE, PROBE_ZFEED);
+    }
+    *z = pos;
+    return probe_triggered();
+}
+
+// G29: probe `mtn.mesh.count` points over `mtn.mesh.area` and save the mesh
+static void stepper_probe() {
+    static mesh_grid_t grid;
+    static uint8_t buf[MESH_PACKED_SIZE(MESH_MAX_POINTS, MESH_MAX_POINTS)];
+    int nx = 0, ny = 0;
+    if (sscanf(Config.mtn.MESH_AREA, "%f,%f,%f,%f",
+               &grid.x0, &grid.y0, &grid.x1, &grid.y1) != 4 ||
+        sscanf(Config.mtn.MESH_CNT, "%d,%d", &nx, &ny) != 2 ||
+        nx < 2 || ny < 2 || nx > MESH_MAX_POINTS || ny > MESH_MAX_POINTS) {
+        ESP_LOGE(TAG, "Invalid mesh area or count");
+        return;
+    }
+    grid.nx = nx;
+    grid.ny = ny;
+    const motion_state_t *st = motion_state();
+    bool relative = st->relative, relative_e = st->relative_e;
+    float units = st->units;
+    gcode_cmd_t cmd;
+    memset(&cmd, 0, sizeof(cmd));
+    cmd.line = -1;
+    cmd.letter = 'G';
+    cmd.code = 90; stepper_run(&cmd);
+    cmd.code = 21; stepper_run(&cmd);
+    motion_set_mesh(NULL);                      // probe raw positions
+    float sum = 0;
+    bool ok = true;
+    for (int j = 0; ok && j < ny; j++) {
+        for (int k = 0; ok && k < nx; k++) {
+            int i = j % 2 ? nx - 1 - k : k;     // serpentine
+            float x = grid.x0 + (grid.x1 - grid.x0) * i / (nx - 1);
+            float y = grid.y0 + (grid.y1 - grid.y0) * j / (ny - 1);
+            float *z = grid.z + j * nx + i;
+            ok = probe_point(x, y, z);
+            if (ok) sum += *z;
+            ESP_LOGI(TAG, "Probe %.1f,%.1f: %s %.3f",
+                     x, y, ok ? "Z" : "failed at", *z);
+        }
+    }
+    stepper_move(NAN, NAN, PROBE_CLEAR, PROBE_ZFEED);
+    // heights relative to mean, so the mesh does not shift the whole print
+    for (int i = 0; ok && i < nx * ny; i++) grid.z[i] -= sum / (nx * ny);
+    size_t len = ok ? mesh_pack(&grid, buf, sizeof(buf)) : 0;
+    if (len && config_nvs_set_blob(STEPPER_MESH_KEY, buf, len)) {
+        ESP_LOGI(TAG, "Bed mesh saved: %dx%d points", nx, ny);
+    } else {
+        ESP_LOGE(TAG, "Bed mesh probing failed");
+    }
+    mesh_stale = true;
+    stepper_configure();                        // reload mesh
+    if (units != 1) { cmd.code = 20; stepper_run(&cmd); }
+    if (relative) { cmd.code = 91; stepper_run(&cmd); }
+    // G91 sets relative E too, G90 clears it: restore M82/M83 afterwards
+    if (relative_e != relative) {
+        cmd.letter = 'M';
+        cmd.code = relative_e ? 83 : 82;
+        stepper_run(&cmd);
+    }
+}
+
+static void stepper_loop(void *arg) {
+    queued_cmd_t item;
+    const gcode_cmd_t &cmd = item.cmd;
+    bool has_cmd = false;
+    int wait;
+    timer_initialize();
+    for (;;) {
+        // execute commands until planner is full
+        while (has_cmd || xQueueReceive(gcode_queue, &item, 0)) {
+            bool tool = cmd.letter == 'T' && cmd.code < NUM_EXTRUDER &&
+                        cmd.code != motion_state()->extruder;
+            float dwell = motion_dwell(&cmd);
+            if ((cmd.letter == 'G' && cmd.code == 29) || tool || dwell >= 0) {
+                // finish queued moves first
+                while (!stepper_pump(false) || running) {
+                    ulTaskNotifyTake(pdTRUE, pdMS_TO_TICKS(10));
+                }
+                stepper_publish();
+                if (tool) {
+                    motion_execute(&cmd);
+                    stepper_extruder(cmd.code);
+                } else if (dwell >= 0) {
+                    vTaskDelay(pdMS_TO_TICKS((uint32_t)(dwell * 1000)));
+                } else {
+                    stepper_probe();
+                }
+            } else if ((wait = heater_gcode(
+                            &cmd, motion_state()->extruder)) >= 0) {
+                // M109/M190: queued moves go on, later commands wait
+                while (wait < HEATER_NUM && !heater_reached(wait)) {
+                    stepper_pump(false);
+                    ulTaskNotifyTake(pdTRUE, pdMS_TO_TICKS(10));
+                }
+            } else if (softpwm_gcode(&cmd)) {
+                // M106/M107: fan duty from the next PWM slot
+            } else if (motion_execute(&cmd) == MOTION_BUSY) {
+                has_cmd = true;
+                break;
+            }
+            has_cmd = false;
+            stepper_track(&cmd, item.offset);
+        }
+        bool more = has_cmd || uxQueueMessagesWaiting(gcode_queue);
+        bool idle = stepper_pump(more);
+        if (idle && !running) {
+            // motion done: give HSPI back to SD card and wait for commands
+            stepper_publish();
+            spi_gpio_release();
+            xQueuePeek(gcode_queue, &item, portMAX_DELAY);
+            ulTaskNotifyTake(pdTRUE, 0);
+            stepper_configure();            // settings may have changed
+        } else {
+            ulTaskNotifyTake(pdTRUE, pdMS_TO_TICKS(10));
+        }
+    }
+}
+
+void stepper_loop_begin(int xCoreID) {
+    if (!gcode_queue) {
+        ESP_LOGE(TAG, "Stepper not initialized");
+        return;
+    }
+    const char * const pcName = "motion";
+    const uint32_t usStackDepth = 4096;
+    void * const pvParameters = NULL;
+    const UBaseType_t uxPriority = configMAX_PRIORITIES - 2;
+#ifndef CONFIG_FREERTOS_UNICORE
+    if (xCoreID == 0 || xCoreID == 1) {
+        xTaskCreatePinnedToCore(
+            stepper_loop, pcName, usStackDepth,
+            pvParameters, uxPriority, &motion_task, xCoreID);
+    } else
+#endif
+    {
+        xTaskCreate(
+            stepper_loop, pcName, usStackDepth,
+            pvParameters, uxPriority, &motion_task);
+    }
+}
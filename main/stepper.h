@@ -0,0 +1,99 @@
+/*
+ * File: stepper.h
+ * Authors: Hank <hankso1106@gmail.com>
+ * Create: 2026-10-17 13:40:52
+ *
+ * Timer driven step pulse engine.
+ *
+ * A FreeRTOS task (motion task on core 1) executes G-code commands into the
+ * planner and converts planned blocks into compressed moves of each axis
+ * (see stepgen.h and stepcompress.h). Moves are pushed into lock-free
+ * single-producer/single-consumer rings (ring.h), one per axis. A hardware
+ * timer ISR expands them on the fly (stepout.h): at each alarm it outputs
+ * STEP bits of all axes due, and after the pulse width it clears them and
+ * schedules the earliest next step. The ISR only adds and compares integers,
+ * no blocking I/O: it writes SPI registers directly and reloads the alarm.
+ * tools/bench/stepsim.cpp runs the same expansion on host against virtual
+ * 74HC595 chips.
+ *
+ *  /cmd gcode ---> gcode queue ---> motion task ---> move rings ---> timer ISR
+ *  /ws stream --'                  (plan + stepgen)                 (HSPI 595)
+ *
+ * Free slots of the gcode queue are the credits of /ws streaming (gstream.h).
+ * Commands of a print job carry their file offset, so that the state after
+ * each executed command can be checkpointed into the journal (job.h).
+ *
+ * Endstops (endstop.h) halt axes in the ISR: steps towards a triggered
+ * switch are dropped while moves are expanded, the rest of the queue goes
+ * on as planned.
+ *
+ * G29 is handled by the motion task itself: it waits for queued moves to
+ * finish, probes the bed mesh with PIN_PROB point by point and stores it in
+ * NVS (see mesh.h). A tool change (T0-T2) also waits for queued moves,
+ * then moves STEP/DIR of the E axis to the pins of the new extruder and
+ * enables only its driver. G4 waits for them too and then sleeps for the
+ * dwell time, so the head rests for the whole pause.
+ *
+ * While the engine is running, the HSPI bus is acquired by the step device,
+ * so SD card (sharing HSPI) is not accessible until motion stops.
+ */
+
+#ifndef _STEPPER_H_
+#define _STEPPER_H_
+
+#include "gcode.h"
+#include "stepgen.h"
+#include "journal.h"
+
+#define STEPPER_QUEUE       128     // moves per axis (must be power of 2)
+#define STEPPER_START_MS    100     // buffered motion to start the engine
+#define STEPPER_LOW_MS      50      // buffered motion to stop look-ahead
+#define STEPPER_PULSE_TICKS 40      // STEP high time: 4us
+#define STEPPER_GCODE_QUEUE 32      // parsed commands waiting for planner
+#define STEPPER_TRACK       32      // states waiting for output (power of 2)
+#define STEPPER_MESH_KEY    "mtn.mesh.data" // NVS blob of bed mesh by G29
+
+typedef struct {
+    uint32_t events;            // step events output by ISR
+    uint32_t steps;             // events with STEP bits
+    uint32_t underruns;         // ISR ran out of queued moves
+    uint32_t late;              // alarm already passed when scheduling
+    uint32_t blocked;           // events with steps dropped by stepper_halt
+    uint32_t isr_count;
+    uint32_t isr_cycles_min, isr_cycles_max;
+    uint64_t isr_cycles_sum;    // CPU cycles spent in ISR
+    uint32_t jitter_min, jitter_max;
+    uint64_t jitter_sum;        // ticks between alarm and ISR entry
+    uint64_t run_ticks;         // ticks engine is running
+} stepper_stats_t;
+
+void stepper_initialize();
+void stepper_loop_begin(int xCoreID = 1);
+
+/* Queue one parsed command for the motion task. Return false on timeout.
+ * `offset` is where the next command starts in the file being printed.
+ */
+bool stepper_queue_gcode(const gcode_cmd_t *cmd, uint32_t timeout_ms = 0,
+                         uint32_t offset = JOURNAL_NONE);
+uint32_t stepper_queue_space();     // free slots of the command queue
+
+/* Print state after the last command executed, without path and PRINTING.
+ * A command counts as executed when the ISR has output all moves planned
+ * up to it, not when it is planned: offset and position lag the planner
+ * and the move rings.
+ */
+void stepper_snapshot(journal_state_t *state);
+void stepper_snapshot_offset(uint32_t offset);  // e.g. when a job starts
+
+/* Drop steps of moves towards endstops: bit i of `min` / `max` is axis i
+ * at its min / max switch. Steps away from them are output. The step ISR
+ * applies it from its next event on, the position of the axis is lost.
+ */
+void stepper_halt(uint8_t min, uint8_t max);
+
+bool stepper_running();
+const stepper_stats_t * stepper_stats();
+void stepper_stats_reset();
+void stepper_info();                // print statistics to stdout
+
+#endif // _STEPPER_H_
@@ -0,0 +1,120 @@
+/*
+ * File: telemetry.cpp
+ * Authors: Hank <hankso1106@gmail.com>
+ * Create: 2026-10-18 16:20:31
+ */
+
+#include "telemetry.h"
+
+#include <math.h>
+#include <string.h>
+
+static const uint16_t periods[TELEM_LEVELS] = { 1, 10, 60 };
+static const uint16_t sizes[TELEM_LEVELS] = {
+    TELEM_RAW_SIZE, TELEM_10S_SIZE, TELEM_1M_SIZE
+};
+static const uint16_t offsets[TELEM_LEVELS] = {
+    0, TELEM_RAW_SIZE, TELEM_RAW_SIZE + TELEM_10S_SIZE
+};
+
+void telem_init(telem_t *t, uint16_t rate) {
+    memset(t, 0, sizeof(telem_t));
+    t->rate = rate ? rate : 1;
+}
+
+static int16_t mean(const telem_acc_t *a, uint8_t ch) {
+    int32_t sum = a->sum[ch], num = a->num[ch];
+    if (!num) return TELEM_INVALID;
+    return (sum + (sum < 0 ? -num : num) / 2) / num;
+}
+
+static void acc_add(telem_acc_t *a, const int16_t *v) {
+    for (uint8_t ch = 0; ch < TELEM_CHANNELS; ch++) {
+        if (v[ch] == TELEM_INVALID) continue;
+        a->sum[ch] += v[ch];
+        a->num[ch]++;
+    }
+    a->count++;
+}
+
+// Close the frame accumulated for `lvl` and feed it to the level above
+static void emit(telem_t *t, uint8_t lvl) {
+    telem_acc_t *a = t->acc + lvl;
+    telem_frame_t *f = t->buf + offsets[lvl] + t->count[lvl] % sizes[lvl];
+    for (uint8_t ch = 0; ch < TELEM_CHANNELS; ch++) f->v[ch] = mean(a, ch);
+    memset(a, 0, sizeof(telem_acc_t));
+    t->count[lvl]++;
+    if (++lvl == TELEM_LEVELS) return;
+    acc_add(t->acc + lvl, f->v);
+    if (t->acc[lvl].count >= periods[lvl] / periods[lvl - 1]) emit(t, lvl);
+}
+
+void telem_add(telem_t *t, const float *temps) {
+    int16_t v[TELEM_CHANNELS];
+    for (uint8_t ch = 0; ch < TELEM_CHANNELS; ch++) {
+        float c = temps[ch] * TELEM_SCALE;
+        v[ch] = isnan(c) || fabsf(c) >= INT16_MAX ? TELEM_INVALID
+                                                   : (int16_t)lroundf(c);
+    }
+    acc_add(t->acc, v);
+    if (t->acc[0].count >= t->rate) emit(t, 0);
+}
+
+uint32_t telem_now(const telem_t *t) { return t->count[0] * periods[0]; }
+
+size_t telem_read(const telem_t *t, uint32_t from, uint32_t to,
+                  uint16_t points, void *buf, size_t len) {
+    if (len < sizeof(telem_header_t)) return 0;
+    uint32_t now = telem_now(t);
+    if (to >= now) to = now ? now - 1 : 0;
+    if (!points || points > TELEM_POINTS_MAX) points = TELEM_POINTS_MAX;
+    uint32_t room = (len - sizeof(telem_header_t)) / sizeof(telem_frame_t);
+    if (points > room) points = room;
+    // finest level that still has `from`, else the coarsest
+    uint8_t lvl;
+    uint32_t first = 0, last = 0, oldest = 0;
+    for (lvl = 0; lvl < TELEM_LEVELS; lvl++) {
+        uint32_t num = t->count[lvl];
+        oldest = num > sizes[lvl] ? num - sizes[lvl] : 0;
+        first = from / periods[lvl];
+        last = to / periods[lvl] + 1;
+        if (last > num) last = num;
+        if (first >= oldest || lvl == TELEM_LEVELS - 1) break;
+    }
+    if (first < oldest) first = oldest;
+    if (last < first) last = first;
+    // merge `stride` frames into a point when there are too many
+    uint32_t stride = 1, start = first;
+    while (points && (last - start + stride - 1) / stride > points) {
+        stride++;
+        start = first - first % stride;
+    }
+
+    telem_header_t hdr = {
+        TELEM_VERSION, TELEM_CHANNELS, (uint16_t)(periods[lvl] * stride),
+        start * periods[lvl], now,
+        (uint16_t)(points ? (last - start + stride - 1) / stride : 0),
+        TELEM_SCALE
+    };
+    uint8_t *out = (uint8_t *)buf;
+    memcpy(out, &hdr, sizeof(hdr));
+    out += sizeof(hdr);
+    const telem_frame_t *ring = t->buf + offsets[lvl];
+    for (uint32_t k = start; k < last && points; k += stride) {
+        telem_frame_t f;
+        if (stride == 1) {
+            f = ring[k % sizes[lvl]];
+        } else {
+            telem_acc_t a;
+            memset(&a, 0, sizeof(a));
+            for (uint32_t i = k < oldest ? oldest : k;
+                 i < k + stride && i < last; i++)
+                acc_add(&a, ring[i % sizes[lvl]].v);
+            for (uint8_t ch = 0; ch < TELEM_CHANNELS; ch++)
+                f.v[ch] = mean(&a, ch);
+        }
+        memcpy(out, &f, sizeof(f));
+        out += sizeof(f);
+    }
+    return out - (uint8_t *)buf;
+}
@@ -0,0 +1,99 @@
+/*
+ * File: telemetry.h
+ * Authors: Hank <hankso1106@gmail.com>
+ * Create: 2026-10-18 16:20:31
+ *
+ * Temperature history in fixed memory. Samples of TELEM_CHANNELS sensors are
+ * averaged into frames of three levels, each a ring of its own:
+ *
+ *      Level   Period  Frames  Covers
+ *      raw     1s      300     5 minutes
+ *      10s     10s     360     1 hour
+ *      1min    60s     720     12 hours
+ *
+ * A frame of a level is the mean of the frames (or samples for raw) below
+ * it, skipping invalid readings, so rollups cost one add per sample and the
+ * memory is the same after 5 minutes or 5 days: 1380 frames, 11KB.
+ *
+ * Frames carry no timestamp. Time is counted in seconds since telem_init
+ * and frame `k` of a level covers [k * period, (k + 1) * period), so the
+ * index of a time is a division.
+ *
+ * telem_read answers a time window with the finest level that reaches back
+ * to its start and fits in `points` frames, as one binary response:
+ *
+ *      telem_header_t          16 bytes, little endian
+ *      int16_t[count][channels]  centidegrees, TELEM_INVALID if no reading
+ *
+ * That is 8 bytes per point of four sensors, against about 40 of JSON.
+ *
+ * Example:
+ *      static telem_t telem;               // 11KB, keep off the stack
+ *      telem_init(&telem, 10);             // 10 samples per second
+ *      telem_add(&telem, temps);           // every 100ms
+ *      len = telem_read(&telem, now - 600, now, 300, buf, sizeof(buf));
+ */
+
+#ifndef _TELEMETRY_H_
+#define _TELEMETRY_H_
+
+#include <stddef.h>
+#include <stdint.h>
+
+#define TELEM_CHANNELS      4           // bed, nozzle 1-3
+#define TELEM_LEVELS        3
+#define TELEM_RAW_SIZE      300         // frames of each level
+#define TELEM_10S_SIZE      360
+#define TELEM_1M_SIZE       720
+#define TELEM_FRAMES        (TELEM_RAW_SIZE + TELEM_10S_SIZE + TELEM_1M_SIZE)
+#define TELEM_POINTS_MAX    TELEM_1M_SIZE
+#define TELEM_INVALID       INT16_MIN
+#define TELEM_SCALE         100         // values per degC
+#define TELEM_VERSION       1
+
+typedef struct {
+    int16_t v[TELEM_CHANNELS];
+} telem_frame_t;
+
+typedef struct {
+    int32_t sum[TELEM_CHANNELS];
+    uint16_t num[TELEM_CHANNELS];       // valid values in sum
+    uint16_t count;                     // values of each channel added
+} telem_acc_t;
+
+typedef struct {
+    telem_frame_t buf[TELEM_FRAMES];    // all levels back to back
+    uint32_t count[TELEM_LEVELS];       // frames written, free running
+    telem_acc_t acc[TELEM_LEVELS];      // next frame of each level
+    uint16_t rate;                      // samples per raw frame
+} telem_t;
+
+typedef struct __attribute__((packed)) {
+    uint8_t version;                    // TELEM_VERSION
+    uint8_t channels;                   // values per frame
+    uint16_t period;                    // seconds per frame
+    uint32_t start;                     // seconds, start of first frame
+    uint32_t now;                       // seconds since telem_init
+    uint16_t count;                     // frames following
+    uint16_t scale;                     // TELEM_SCALE
+} telem_header_t;
+
+#define TELEM_RESPONSE_MAX \
+    (sizeof(telem_header_t) + TELEM_POINTS_MAX * sizeof(telem_frame_t))
+
+// Samples are added `rate` times per second
+void telem_init(telem_t *t, uint16_t rate);
+
+// Add one sample of degC, NAN if there is no reading
+void telem_add(telem_t *t, const float *temps);
+
+// Seconds of complete raw frames
+uint32_t telem_now(const telem_t *t);
+
+/* Write frames starting in [from, to] seconds, at most `points` of them, to
+ * `buf`. Return bytes written, 0 if `len` cannot hold the header.
+ */
+size_t telem_read(const telem_t *t, uint32_t from, uint32_t to,
+                  uint16_t points, void *buf, size_t len);
+
+#endif // _TELEMETRY_H_
@@ -0,0 +1,129 @@
+/*
+ * File: thermistor.h
+ * Authors: Hank <hankso1106@gmail.com>
+ * Create: 2026-10-18 15:02:46
+ *
+ * NTC thermistor conversion by table. The thermistor is the lower leg of a
+ * divider with a pull-up to the ADC reference, so the ADC code is
+ * proportional to R / (R + pullup) and the temperature follows from the
+ * Steinhart-Hart equation (the beta model is its special case C = 0):
+ *
+ *      1 / T = A + B ln(R) + C ln(R)^3         T in Kelvin
+ *
+ * Evaluating it needs a log() and divisions per reading. Instead the
+ * table is built at compile time by constexpr functions (recursive, so a
+ * C++11 compiler is enough): 2^THERM_INDEX_BITS + 1 entries in centidegrees,
+ * evenly spaced over the full ADC scale, 1KB of flash. A reading is the
+ * entry of its top bits plus integer interpolation with the bottom bits:
+ * two loads, one multiply and a shift. Interpolation error stays below
+ * 0.1 degC from 0 to 300 degC, about one code of a 14 bit ADC at 300 degC.
+ *
+ * Codes are THERM_CODE_BITS wide, which is the ADC resolution after
+ * oversampling (see adc_temp_raw in drivers.h). Temperatures are clamped
+ * to THERM_TMIN ~ THERM_TMAX; the ends of the scale mean open or shorted.
+ *
+ * Example:
+ *      static constexpr therm_lut_t lut =
+ *          therm_build(therm_beta(100000, 25, 3950, 4700));
+ *      float temp = therm_lookup(&lut, code);
+ */
+
+#ifndef _THERMISTOR_H_
+#define _THERMISTOR_H_
+
+#include <stdint.h>
+
+#define THERM_CODE_BITS     14          // 12 bit ADC, 16x oversampled
+#define THERM_INDEX_BITS    9
+#define THERM_ENTRIES       ((1 << THERM_INDEX_BITS) + 1)
+#define THERM_FRAC_BITS     (THERM_CODE_BITS - THERM_INDEX_BITS)
+#define THERM_TMIN          -50.0       // degC
+#define THERM_TMAX          320.0
+
+typedef struct {
+    double a, b, c;             // Steinhart-Hart coefficients
+    double pullup;              // ohm
+} therm_param_t;
+
+typedef struct {
+    int16_t t[THERM_ENTRIES];   // centidegrees at code i << THERM_FRAC_BITS
+} therm_lut_t;
+
+/* Compile time helpers. ln(x) is reduced to [1, 2) by powers of two, then
+ * ln(x) = 2 atanh(y) = 2 (y + y^3/3 + y^5/5 + ...) with y = (x-1)/(x+1)
+ * below 1/3, so 20 terms are more than double precision.
+ */
+#define THERM_LN2           0.69314718055994530942
+
+constexpr double therm_atanh(double y2, double term, int n) {
+    return n > 41 ? 0 : term / n + therm_atanh(y2, term * y2, n + 2);
+}
+
+constexpr double therm_ln(double x) {
+    return x >= 2 ? therm_ln(x / 2) + THERM_LN2 :
+           x < 1 ? therm_ln(x * 2) - THERM_LN2 :
+           2 * therm_atanh((x - 1) / (x + 1) * (x - 1) / (x + 1),
+                           (x - 1) / (x + 1), 1);
+}
+
+// Beta model: resistance `r0` at `t0` degC
+constexpr therm_param_t therm_beta(double r0, double t0, double beta,
+                                   double pullup) {
+    return therm_param_t{
+        1 / (t0 + 273.15) - therm_ln(r0) / beta, 1 / beta, 0, pullup
+    };
+}
+
+constexpr double therm_celsius(const therm_param_t &p, double l) {
+    return 1 / (p.a + p.b * l + p.c * l * l * l) - 273.15;
+}
+
+constexpr int16_t therm_centi(double t) {
+    return t > THERM_TMAX ? (int16_t)(THERM_TMAX * 100) :
+           t < THERM_TMIN ? (int16_t)(THERM_TMIN * 100) :
+           (int16_t)(t * 100 + (t < 0 ? -0.5 : 0.5));
+}
+
+// Entry `i`: code ratio i / N = R / (R + pullup)
+constexpr int16_t therm_entry(const therm_param_t &p, int i) {
+    return i <= 0 ? therm_centi(THERM_TMAX) :
+           i >= THERM_ENTRIES - 1 ? therm_centi(THERM_TMIN) :
+           therm_centi(therm_celsius(
+               p, therm_ln(p.pullup * i / (THERM_ENTRIES - 1 - i))));
+}
+
+// therm_make<N>::type is therm_seq<0, ..., N - 1>, built by doubling to
+// keep template recursion at log2(N)
+template <int... I> struct therm_seq {};
+template <typename S, int N, bool odd> struct therm_twice;
+template <int... I, int N> struct therm_twice<therm_seq<I...>, N, false> {
+    typedef therm_seq<I..., (N + I)...> type;
+};
+template <int... I, int N> struct therm_twice<therm_seq<I...>, N, true> {
+    typedef therm_seq<I..., (N + I)..., 2 * N> type;
+};
+template <int N> struct therm_make {
+    typedef typename therm_twice<
+        typename therm_make<N / 2>::type, N / 2, N % 2>::type type;
+};
+template <> struct therm_make<0> { typedef therm_seq<> type; };
+
+template <int... I>
+constexpr therm_lut_t therm_build(const therm_param_t &p, therm_seq<I...>) {
+    return therm_lut_t{{ therm_entry(p, I)... }};
+}
+
+constexpr therm_lut_t therm_build(const therm_param_t &p) {
+    return therm_build(p, therm_make<THERM_ENTRIES>::type());
+}
+
+// Temperature of a THERM_CODE_BITS code (degC)
+static inline float therm_lookup(const therm_lut_t *lut, uint32_t code) {
+    uint32_t i = code >> THERM_FRAC_BITS;
+    if (i >= THERM_ENTRIES - 1) return lut->t[THERM_ENTRIES - 1] * 0.01f;
+    int32_t a = lut->t[i], b = lut->t[i + 1];
+    int32_t f = code & ((1 << THERM_FRAC_BITS) - 1);
+    return (a + (((b - a) * f) >> THERM_FRAC_BITS)) * 0.01f;
+}
+
+#endif // _THERMISTOR_H_
@@ -77,10 +77,10 @@ static const char units[] = "BKMGT";
 const char * format_size(size_t size) {
     static char buf[7 + 1 + 1];  // xxxx.xxu\0
     static uint8_t maxlen = strlen(units) - 1;
-    uint8_t exponent = log2(size) / 10;
-    uint8_t idx = exponent > maxlen ? maxlen : exponent;
+    uint8_t idx = 0;                // no software double log2/pow
+    while (idx < maxlen && (uint64_t)size >> (10 * (idx + 1))) idx++;
     snprintf(buf, sizeof(buf), "%.*f%c", idx > 2 ? 2 : idx,
-             size/pow(1024, exponent), units[idx]);
+             (float)size / (1ULL << (10 * idx)), units[idx]);
     return buf;
 }
 
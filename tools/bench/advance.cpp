@@ -0,0 +1,110 @@
+/*
+ * File: advance.cpp
+ * Authors: Hank <hankso1106@gmail.com>
+ * Create: 2026-10-17 17:05:48
+ *
+ * Step rate overhead of pressure advance in main/stepgen.cpp. The same
+ * G-code is converted to steps with K = 0 (E uses trapezoid inversion) and
+ * with increasing K (E follows the advanced position). Generated steps per
+ * second of all axes and extra time per E step are reported. The final E
+ * position must not depend on K.
+ *
+ *      g++ -O2 -std=gnu++14 -Imain tools/bench/advance.cpp main/gcode.cpp \
+ *          main/motion.cpp main/planner.cpp main/stepgen.cpp \
+ *          main/stepcompress.cpp main/shaper.cpp main/scurve.cpp \
+ *          main/mesh.cpp -o /tmp/bench-advance && \
+ *          /tmp/bench-advance [file.gcode] [MB] [smooth]
+ */
+
+#include "bench.h"
+#include "motion.h"
+#include "stepgen.h"
+
+typedef struct {
+    int64_t clock;              // E time (ticks)
+    int32_t pos;                // E position (steps)
+    int8_t sign;
+} estate_t;
+
+static void record(estate_t *es, uint8_t axis, const step_move_t *move) {
+    if (axis != AXIS_E) return;
+    if (!move->count) {
+        es->clock += move->interval;
+        if (move->add >= 0) es->sign = move->add ? -1 : 1;
+        return;
+    }
+    es->clock += step_move_duration(move);
+    es->pos += es->sign * move->count;
+}
+
+static void drain(estate_t *es, bool end) {
+    step_move_t move;
+    uint8_t axis;
+    bool planned = false;
+    while (true) {
+        if (!stepgen_busy()) {
+            planner_block_t *block = planner_current();
+            if (block) {
+                stepgen_load(block);
+            } else if (!end || !stepgen_load(NULL)) {
+                return;
+            }
+            planned = block != NULL;
+        }
+        if (stepgen_next(&axis, &move)) {
+            record(es, axis, &move);
+        } else if (planned) {
+            planner_discard();
+        }
+    }
+}
+
+static void execute(const gcode_cmd_t *cmd, void *arg) {
+    while (motion_execute(cmd) == MOTION_BUSY) drain((estate_t *)arg, false);
+}
+
+int main(int argc, char **argv) {
+    const char *path = argc > 1 ? argv[1] : NULL;
+    size_t size = (argc > 2 ? atof(argv[2]) : 1) * 1024 * 1024;
+    float smooth = argc > 3 ? atof(argv[3]) : 0.04;
+    std::string src = bench_gcode(path, size);
+    printf("Input: %.2f MB, smooth time %.3fs\n",
+           src.size() / 1048576.0, smooth);
+
+    double base = 0;
+    int32_t final = 0;
+    bool ok = true;
+    const float ks[] = { 0, 0.02, 0.05, 0.1 };
+    for (float k : ks) {
+        estate_t es = {};
+        gcode_parser_t parser;
+        gcode_parser_init(&parser);
+        motion_initialize();
+        for (uint8_t i = 0; i < NUM_EXTRUDER; i++) {
+            stepgen_config.pa_advance[i] = k;
+        }
+        stepgen_config.pa_smooth = smooth;
+        stepgen_reset();
+        double t0 = bench_now();
+        gcode_parse(&parser, src.data(), src.size(), execute, &es);
+        gcode_parse_end(&parser, execute, &es);
+        drain(&es, true);
+        double dt = bench_now() - t0;
+        const stepgen_stats_t *st = stepgen_stats();
+        double steps = 0;
+        for (uint8_t i = 0; i < NUM_AXIS; i++) steps += st->steps[i];
+        if (k == 0) {
+            base = dt;
+            final = es.pos;
+        } else if (es.pos != final) {
+            ok = false;
+        }
+        printf("K %.2f: %8u E steps %5.2fs %6.2fM steps/s (%+5.1f%%) | "
+               "+%6.1f ns/E step %5.1f evals/E step | E %s\n",
+               k, st->steps[AXIS_E], dt, steps / dt / 1e6,
+               (base / dt - 1) * 100, (dt - base) / st->steps[AXIS_E] * 1e9,
+               (double)st->evals / st->steps[AXIS_E],
+               es.pos == final ? "ok" : "MISMATCH");
+    }
+    return ok ? 0 : 1;
+}
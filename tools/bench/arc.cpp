@@ -0,0 +1,115 @@
+/*
+ * File: arc.cpp
+ * Authors: Hank <hankso1106@gmail.com>
+ * Create: 2026-10-17 19:10:26
+ *
+ * Throughput and accuracy of G2/G3 segmentation in main/motion.cpp. Random
+ * arcs at several feedrates are parsed, split and planned, reporting segments
+ * per second and the shortest planned block. Then full circles of radius
+ * 100mm around the origin are split and every segment end is checked: its
+ * distance to the circle (drift of incremental rotation) and the deviation of
+ * the chord from the arc must stay within the chord tolerance.
+ *
+ *      g++ -O2 -std=gnu++14 -Imain tools/bench/arc.cpp main/gcode.cpp \
+ *          main/motion.cpp main/planner.cpp main/mesh.cpp \
+ *          -o /tmp/bench-arc && /tmp/bench-arc [arcs] [tolerance]
+ */
+
+#include "bench.h"
+#include "motion.h"
+
+typedef struct {
+    uint32_t blocks;
+    float min_time;             // shortest block (s)
+    float max_drift;            // distance of segment end to circle (mm)
+    float max_chord;            // chord deviation from arc (mm)
+    float radius;               // check circle around origin if > 0
+} result_t;
+
+static void drain(result_t *res) {
+    planner_block_t *block;
+    while ((block = planner_current())) {
+        float t = planner_block_time(block);
+        if (t < res->min_time) res->min_time = t;
+        if (res->radius > 0 && res->blocks) {     // first one is G1
+            float x = block->start[AXIS_X] + block->delta[AXIS_X];
+            float y = block->start[AXIS_Y] + block->delta[AXIS_Y];
+            float drift = fabsf(hypotf(x, y) - res->radius);
+            float r = res->radius, half = block->distance / 2;
+            float chord = r - sqrtf(r * r - half * half);
+            if (drift > res->max_drift) res->max_drift = drift;
+            if (chord > res->max_chord) res->max_chord = chord;
+        }
+        res->blocks++;
+        planner_discard();
+    }
+}
+
+static void execute(const gcode_cmd_t *cmd, void *arg) {
+    while (motion_execute(cmd) == MOTION_BUSY) drain((result_t *)arg);
+}
+
+static double run(const std::string &src, result_t *res) {
+    gcode_parser_t parser;
+    gcode_parser_init(&parser);
+    motion_initialize();
+    res->blocks = 0;
+    res->min_time = 1e9;
+    double t0 = bench_now();
+    gcode_parse(&parser, src.data(), src.size(), execute, res);
+    gcode_parse_end(&parser, execute, res);
+    drain(res);
+    return bench_now() - t0;
+}
+
+int main(int argc, char **argv) {
+    int arcs = argc > 1 ? atoi(argv[1]) : 20000;
+    motion_config.arc_tolerance = argc > 2 ? atof(argv[2]) : 0.01;
+    printf("Arc tolerance %.3f mm, min segment time %.1f ms\n",
+           motion_config.arc_tolerance, motion_config.arc_min_time * 1e3);
+
+    const int feeds[] = { 600, 3000, 12000 };
+    char line[96];
+    for (int feed : feeds) {
+        // random arcs by I/J and by R, radius 0.5 ~ 50mm
+        std::string src = "G21\nG90\nG1 X100 Y100 F";
+        src += std::to_string(feed) + "\n";
+        srand(1);
+        float x = 100, y = 100, e = 0;
+        for (int i = 0; i < arcs; i++) {
+            float r = 0.5f + (rand() % 1000) * 0.05f;
+            float a = (rand() % 628) * 0.01f, b = (rand() % 628) * 0.01f;
+            float cx = x - r * cosf(a), cy = y - r * sinf(a);
+            float tx = cx + r * cosf(b), ty = cy + r * sinf(b);
+            e += 0.05f * r;
+            if (i % 2) {
+                snprintf(line, sizeof(line), "G%d X%.3f Y%.3f I%.3f J%.3f "
+                         "E%.4f\n", 2 + i % 4 / 2, tx, ty, cx - x, cy - y, e);
+            } else {
+                snprintf(line, sizeof(line), "G%d X%.3f Y%.3f R%.3f E%.4f\n",
+                         2 + i % 4 / 2, tx, ty, r, e);
+            }
+            src += line;
+            x = tx;
+            y = ty;
+        }
+        result_t res = {};
+        double dt = run(src, &res);
+        uint32_t segs = motion_state()->arc_segments;
+        printf("F%-5d %6d arcs %8u segments %5.1f per arc | "
+               "%6.2fM segments/s | shortest block %.2f ms\n", feed, arcs, segs,
+               (double)segs / arcs, segs / dt / 1e6, res.min_time * 1e3);
+    }
+
+    // 100 full circles
+    std::string src = "G21\nG90\nG1 X100 Y0 F600\n";
+    for (int i = 0; i < 100; i++) src += "G3 X100 Y0 I-100 J0\n";
+    result_t res = {};
+    res.radius = 100;
+    run(src, &res);
+    bool ok = res.max_drift <= motion_config.arc_tolerance &&
+              res.max_chord <= motion_config.arc_tolerance;
+    printf("Circle r=100: %u segments, drift %.5f mm, chord %.5f mm %s\n",
+           res.blocks - 1, res.max_drift, res.max_chord, ok ? "ok" : "FAIL");
+    return ok ? 0 : 1;
+}
@@ -0,0 +1,129 @@
+/*
+ * File: bench.h
+ * Authors: Hank <hankso1106@gmail.com>
+ * Create: 2026-10-17 10:40:12
+ *
+ * Helpers shared by host-side benchmarks under tools/bench. Each benchmark
+ * is a single source file compiled together with the firmware modules it
+ * measures, e.g.:
+ *
+ *      g++ -O2 -std=gnu++14 -Imain tools/bench/gcode.cpp main/gcode.cpp \
+ *          -o /tmp/bench-gcode && /tmp/bench-gcode webdev/assets/example.gcode
+ *
+ * The firmware modules used here must not depend on ESP-IDF or Arduino.
+ */
+
+#ifndef _BENCH_H_
+#define _BENCH_H_
+
+#include <math.h>
+#include <time.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string>
+
+#define BENCH_DEFAULT_FILE "webdev/assets/example.gcode"
+
+static inline double bench_now() {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+// Read whole file into `out`. Return false if file cannot be opened.
+static inline bool bench_load(const char *path, std::string &out) {
+    FILE *fp = fopen(path, "rb");
+    if (!fp) return false;
+    char buf[4096];
+    size_t len;
+    out.clear();
+    while ((len = fread(buf, 1, sizeof(buf), fp))) out.append(buf, len);
+    fclose(fp);
+    return true;
+}
+
+// Repeat content of `src` until it is at least `size` bytes long
+static inline void bench_repeat(std::string &src, size_t size) {
+    if (src.empty()) return;
+    if (src.back() != '\n') src += '\n';
+    std::string unit = src;
+    while (src.size() < size) src += unit;
+}
+
+/* Generate G-code similar to dense slicer output: perimeters of small
+ * polygons and curves made of short G1 segments with extrusion, travel moves,
+ * retractions and layer changes. Result is deterministic for the same `size`.
+ */
+static inline std::string bench_synth_gcode(size_t size) {
+    std::string out;
+    char line[96];
+    unsigned seed = 12345;
+    double e = 0, z = 0.2;
+    int layer = 0;
+    out += "; synthetic slicer output\nG21\nG90\nM83\nG28\n";
+    out += "M104 S210\nM140 S60\nG1 Z0.2 F3000\n";
+    while (out.size() < size) {
+        snprintf(line, sizeof(line), ";LAYER:%d\nG1 Z%.2f F3000\n", layer, z);
+        out += line;
+        for (int island = 0; island < 4 && out.size() < size; island++) {
+            seed = seed * 1103515245 + 12345;
+            double cx = 60 + (seed >> 16) % 80, cy = 60 + (seed >> 8) % 80;
+            double r = 2 + (seed % 20);
+            int nseg = 100 + (seed >> 4) % 500;
+            snprintf(line, sizeof(line), "G1 E-0.8 F2400\n"
+                     "G0 X%.3f Y%.3f F9000\nG1 E0.8 F2400\n", cx + r, cy);
+            out += line;
+            double seglen = 2 * M_PI * r / nseg;
+            for (int i = 1; i <= nseg; i++) {
+                double a = 2 * M_PI * i / nseg;
+                // perturb radius a little bit like organic model surfaces
+                double rr = r * (1 + 0.05 * sin(a * 7 + layer));
+                e = seglen * 0.0333;
+                snprintf(line, sizeof(line), "G1 X%.3f Y%.3f E%.5f%s\n",
+                         cx + rr * cos(a), cy + rr * sin(a), e,
+                         i == 1 ? " F6000" : "");
+                out += line;
+            }
+        }
+        layer++;
+        z += 0.2;
+    }
+    out += "M104 S0\nM140 S0\nM84\n";
+    return out;
+}
+
+/* Load G-code for benchmarks: use `path` (or BENCH_DEFAULT_FILE) and repeat it
+ * up to `size` bytes. Files with less than 100 lines are too small to tell
+ * anything, so they are followed by synthetic slicer output. `source` gets
+ * the name to print with results: the path, or "synthetic" in that case.
+ */
+static inline std::string bench_gcode(const char *path, size_t size,
+                                      const char **source = NULL) {
+    std::string src;
+    if (!path) path = BENCH_DEFAULT_FILE;
+    if (!bench_load(path, src)) {
+        fprintf(stderr, "Cannot open %s, use synthetic G-code\n", path);
+    }
+    size_t lines = 0;
+    for (char c : src) lines += c == '\n';
+    if (lines < 100) {
+        if (!src.empty()) {
+            fprintf(stderr, "%s has %u lines, add synthetic G-code\n",
+                    path, (unsigned)lines);
+            if (src.back() != '\n') src += '\n';
+        }
+        src += bench_synth_gcode(size > src.size() ? size - src.size() : 0);
+        path = "synthetic";
+    }
+    if (source) *source = path;
+    bench_repeat(src, size);
+    return src;
+}
+
+static inline void bench_report(const char *name, double count,
+                                const char *unit, double secs) {
+    printf("%-24s %12.0f %s in %.3fs = %12.0f %s/s\n",
+           name, count, unit, secs, count / secs, unit);
+}
+
+#endif // _BENCH_H_
@@ -0,0 +1,155 @@
+/*
+ * File: endstop.cpp
+ * Authors: Hank <hankso1106@gmail.com>
+ * Create: 2026-10-18 19:02:36
+ *
+ * Endstop debouncing of main/endstop.cpp on the virtual PCF8574 of
+ * vchip.cpp, read through the pin layer like the endstop task does. A
+ * switch closes with contact bounce of random length and then opens again;
+ * between presses the open switch catches short spikes. Every change wakes
+ * the task after the interrupt latency, the task reads the chip back to
+ * back (bus time of vchip plus driver overhead per read) until the state
+ * settles. Prints the time from the first edge to the halt and the reads
+ * it took, and spikes or bounces taken as changes (must be none).
+ *
+ *      g++ -O2 -std=gnu++14 -Imain tools/bench/endstop.cpp main/endstop.cpp \
+ *          main/pins.cpp tools/bench/vchip.cpp -o /tmp/bench-endstop \
+ *          && /tmp/bench-endstop [wake_us] [overhead_us]
+ */
+
+#include "bench.h"
+#include "vchip.h"
+#include "endstop.h"
+
+#include <vector>
+#include <algorithm>
+
+#define PRESSES             2000
+#define BOUNCE_MAX_US       800         // contact bounce after an edge
+#define SPIKE_MAX_US        50
+#define BIT_ZMIN            4           // switch under test
+
+#define US(t)               ((uint64_t)(t) * VCHIP_TICK_HZ / 1000000)
+
+static uint32_t rng = 2463534242u;
+
+static uint32_t random32() {
+    rng ^= rng << 13; rng ^= rng >> 17; rng ^= rng << 5;
+    return rng;
+}
+
+// Contact level over time: every edge toggles it, an odd number of edges
+// ends in the new level
+typedef struct {
+    bool level0;                // before the first edge (true: closed)
+    std::vector<uint64_t> edges;
+} wave_t;
+
+static bool wave_at(const wave_t &w, uint64_t t) {
+    size_t n = std::upper_bound(w.edges.begin(), w.edges.end(), t)
+             - w.edges.begin();
+    return w.level0 != (n % 2);
+}
+
+static wave_t bounce(uint64_t start, bool close) {
+    wave_t w = { !close, { start } };
+    uint32_t n = random32() % 4 * 2;    // pairs of bounces
+    for (uint32_t i = 0; i < n; i++)
+        w.edges.push_back(start + US(random32() % BOUNCE_MAX_US) + 1);
+    std::sort(w.edges.begin(), w.edges.end());
+    return w;
+}
+
+static wave_t spike(uint64_t start) {
+    return { false, { start, start + US(1 + random32() % SPIKE_MAX_US) } };
+}
+
+typedef struct {
+    double wake_us, overhead_us;
+    uint32_t changes, wrong;    // debounced changes, of them not wanted
+    uint32_t reads, events;
+    std::vector<double> latency;            // us, press edge to halt
+} result_t;
+
+static endstop_t es;
+
+// One interrupt: wake the task, read until settled like endstop_loop
+static void wake(const wave_t &w, uint64_t irq, bool want, result_t *r) {
+    vchip.now = std::max(vchip.now, irq + US(r->wake_us));
+    r->events++;
+    for (uint8_t i = 0; i < ENDSTOP_READS_MAX; i++) {
+        // PCF8574 takes inputs at the ACK of its address
+        uint64_t ack = vchip.now + VCHIP_TICK_HZ / vchip.i2c_hz * 9;
+        bool closed = wave_at(w, ack);
+        vchip_set_input(0, BIT_ZMIN, !closed);          // active low
+        vchip.now += US(r->overhead_us);
+        i2c_sync_vals(0, I2C_PIN_INPUTS);
+        r->reads++;
+        uint8_t triggered = 0;
+        for (uint8_t b = 0; b < ENDSTOP_NUM; b++) {
+            if (!i2c_gpio_get_level((i2c_pin_num_t)(PIN_XMIN + b)))
+                triggered |= BIT(b);
+        }
+        uint8_t changed = endstop_update(&es, triggered);
+        if (changed) {
+            r->changes++;
+            bool now = es.state & BIT(BIT_ZMIN);
+            if (now != want) r->wrong++;
+            if (now) r->latency.push_back(
+                (double)(vchip.now - w.edges[0]) * 1e6 / VCHIP_TICK_HZ);
+        }
+        if (endstop_settled(&es)) break;
+    }
+}
+
+static void run(result_t *r) {
+    vchip_reset();
+    endstop_init(&es, 0);
+    uint64_t t = US(10000);
+    for (uint32_t n = 0; n < PRESSES; n++) {
+        // a spike on the open switch: must not trigger
+        wave_t s = spike(t);
+        wake(s, t, false, r);
+        t = vchip.now + US(5000);
+        // press, then release
+        for (bool close : { true, false }) {
+            wave_t w = bounce(t, close);
+            uint64_t done = w.edges.back();
+            // INT on every edge; the task takes one wake-up per read loop
+            size_t k = 0;
+            while (k < w.edges.size()) {
+                wake(w, std::max(w.edges[k], vchip.now), close, r);
+                while (k < w.edges.size() && w.edges[k] <= vchip.now) k++;
+            }
+            if (!(es.state & BIT(BIT_ZMIN)) == close) {
+                wake(w, done, close, r);        // the poll catches it
+            }
+            t = std::max(vchip.now, done) + US(20000);
+        }
+    }
+}
+
+int main(int argc, char **argv) {
+    result_t r = {};
+    r.wake_us = argc > 1 ? atof(argv[1]) : 20;
+    r.overhead_us = argc > 2 ? atof(argv[2]) : 60;
+    run(&r);
+    std::vector<double> &l = r.latency;
+    std::sort(l.begin(), l.end());
+    double sum = 0;
+    for (double v : l) sum += v;
+    bool ok = !r.wrong && r.changes == PRESSES * 2 && l.size() == PRESSES;
+    printf("%u presses with up to %uus bounce, spikes up to %uus, %.0fus "
+           "wake-up, %.0fus driver per read at %ukHz:\n", PRESSES,
+           BOUNCE_MAX_US, SPIKE_MAX_US, r.wake_us, r.overhead_us,
+           VCHIP_I2C_HZ / 1000);
+    printf("  edge to halt: %.0f / %.0f / %.0f / %.0f us "
+           "(min/avg/p99/max)\n", l.empty() ? 0 : l.front(),
+           l.empty() ? 0 : sum / l.size(),
+           l.empty() ? 0 : l[l.size() * 99 / 100],
+           l.empty() ? 0 : l.back());
+    printf("  %.1f reads per wake-up, %u changes, %u wrong: %s\n",
+           (double)r.reads / r.events, r.changes, r.wrong,
+           ok ? "ok" : "FAILED");
+    return !ok;
+}
@@ -0,0 +1,41 @@
+/*
+ * File: fixed.cpp
+ * Authors: Hank <hankso1106@gmail.com>
+ * Create: 2026-10-17 23:08:14
+ *
+ * Host side of main/fixedbench.cpp: planner and step generator workloads in
+ * float, double and fixed-point, same code as console command `fixedbench`
+ * on ESP32. Then sqrt and reciprocal of fixed.h are checked over the whole
+ * range of their input against the exact values.
+ *
+ *      g++ -O2 -std=gnu++14 -Imain tools/bench/fixed.cpp main/fixedbench.cpp \
+ *          -o /tmp/bench-fixed && /tmp/bench-fixed [rounds]
+ */
+
+#include "bench.h"
+#include "fixed.h"
+#include "fixedbench.h"
+
+int main(int argc, char **argv) {
+    uint32_t rounds = argc > 1 ? atoi(argv[1]) : 2000;
+    fbench_result_t res[FBENCH_RESULTS];
+    size_t num = fbench_run(bench_now, rounds, res, FBENCH_RESULTS);
+    fbench_print(res, num);
+
+    // sqrt of 64-bit integers, 1/x of Q16 over the int32 range
+    double sqrt_err = 0, recip_err = 0;
+    for (uint64_t v = 1; v < (1ULL << 56); v += v / 1000 + 1) {
+        double err = fabs(fixed_isqrt(v) - floor(sqrtl(v)));
+        if (err > sqrt_err) sqrt_err = err;
+    }
+    for (int64_t raw = 1; raw < INT32_MAX; raw += raw / 1000 + 1) {
+        fixed_t<16> x = fixed_t<16>::from_raw(raw);
+        double exact = fmin(65536.0 * 65536.0 / raw, INT32_MAX);
+        double err = fabs(fixed_recip<16>(x).raw - exact);
+        if (err > recip_err) recip_err = err;
+    }
+    bool ok = sqrt_err <= 1 && recip_err <= 1;
+    printf("fixed_isqrt max error %.3f LSB, fixed_recip max error %.3f LSB "
+           "%s\n", sqrt_err, recip_err, ok ? "ok" : "FAIL");
+    return ok ? 0 : 1;
+}
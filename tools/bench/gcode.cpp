@@ -0,0 +1,52 @@
+/*
+ * File: gcode.cpp
+ * Authors: Hank <hankso1106@gmail.com>
+ * Create: 2026-10-17 10:40:12
+ *
+ * Throughput of main/gcode.cpp tokenizer, fed in 512 bytes chunks like
+ * reading from FFS/SDFS, and as one buffer like an HTTP request body.
+ *
+ *      g++ -O2 -std=gnu++14 -Imain tools/bench/gcode.cpp main/gcode.cpp \
+ *          -o /tmp/bench-gcode && /tmp/bench-gcode [file.gcode] [MB]
+ */
+
+#include "bench.h"
+#include "gcode.h"
+
+static void count_params(const gcode_cmd_t *cmd, void *arg) {
+    *(size_t *)arg += cmd->nparam;
+}
+
+int main(int argc, char **argv) {
+    const char *path = argc > 1 ? argv[1] : NULL;
+    size_t size = (argc > 2 ? atof(argv[2]) : 16) * 1024 * 1024;
+    std::string src = bench_gcode(path, size, &path);
+    const char *buf = src.data();
+
+    gcode_parser_t parser;
+    size_t nparam = 0, ncmd = 0, chunk = 512;
+    double t0 = bench_now();
+    gcode_parser_init(&parser);
+    for (size_t i = 0; i < src.size(); i += chunk) {
+        size_t len = src.size() - i < chunk ? src.size() - i : chunk;
+        ncmd += gcode_parse(&parser, buf + i, len, count_params, &nparam);
+    }
+    ncmd += gcode_parse_end(&parser, count_params, &nparam);
+    double dt = bench_now() - t0;
+
+    printf("Input: %s, %.2f MB, %u lines, %u commands, %u params, %u errors\n",
+           path, src.size() / 1048576.0,
+           parser.lines, (unsigned)ncmd, (unsigned)nparam, parser.errors);
+    printf("Parser state: %u bytes\n", (unsigned)sizeof(gcode_parser_t));
+    bench_report("chunked(512B) lines", parser.lines, "lines", dt);
+    bench_report("chunked(512B) bytes", src.size(), "B", dt);
+
+    t0 = bench_now();
+    gcode_parser_init(&parser);
+    gcode_parse(&parser, buf, src.size(), NULL, NULL);
+    gcode_parse_end(&parser, NULL, NULL);
+    dt = bench_now() - t0;
+    bench_report("whole buffer lines", parser.lines, "lines", dt);
+    bench_report("whole buffer bytes", src.size(), "B", dt);
+    return 0;
+}
@@ -0,0 +1,116 @@
+/*
+ * File: gcodebin.cpp
+ * Authors: Hank <hankso1106@gmail.com>
+ * Create: 2026-10-17 19:48:51
+ *
+ * Binary precompiled G-code (main/gcodebin.cpp). Text is converted in TCP
+ * segment sized chunks like onUpload does, reporting conversion speed and
+ * bytes per command of text vs records. Then reading commands back is timed:
+ * decoding records vs tokenizing text, and every decoded command is checked
+ * against the parsed one (values within half a quantization step).
+ *
+ *      g++ -O2 -std=gnu++14 -Imain tools/bench/gcodebin.cpp main/gcode.cpp \
+ *          main/gcodebin.cpp -o /tmp/bench-gcodebin && \
+ *          /tmp/bench-gcodebin [file.gcode] [MB]
+ */
+
+#include "bench.h"
+#include "gcodebin.h"
+
+#include <vector>
+
+static size_t write_mem(const void *buf, size_t len, void *arg) {
+    std::string *out = (std::string *)arg;
+    out->append((const char *)buf, len);
+    return len;
+}
+
+static void count(const gcode_cmd_t *cmd, void *arg) {
+    if (cmd->letter) *(size_t *)arg += cmd->nparam;
+}
+
+static void collect(const gcode_cmd_t *cmd, void *arg) {
+    if (cmd->letter) ((std::vector<gcode_cmd_t> *)arg)->push_back(*cmd);
+}
+
+static bool same(const gcode_cmd_t *a, const gcode_cmd_t *b) {
+    if (a->letter != b->letter || a->code != b->code ||
+        a->subcode != b->subcode) return false;
+    for (uint8_t i = 0; i < b->nparam; i++) {
+        float value;
+        if (!gcode_param(a, b->params[i].letter, &value)) return false;
+        float tol = 0.5f / GCB_SCALE + fabsf(value) * 1e-6f;
+        if (fabsf(value - b->params[i].value) > tol) return false;
+    }
+    return true;
+}
+
+int main(int argc, char **argv) {
+    const char *path = argc > 1 ? argv[1] : NULL;
+    size_t size = (argc > 2 ? atof(argv[2]) : 16) * 1024 * 1024;
+    std::string src = bench_gcode(path, size), bin;
+    const size_t chunk = 1436;                  // TCP MSS
+
+    static gcb_encoder_t enc;
+    bin.reserve(src.size());
+    double t0 = bench_now();
+    gcb_encode_init(&enc, write_mem, &bin);
+    for (size_t i = 0; i < src.size(); i += chunk) {
+        size_t len = src.size() - i < chunk ? src.size() - i : chunk;
+        gcb_encode(&enc, src.data() + i, len);
+    }
+    gcb_encode_end(&enc);
+    double dt = bench_now() - t0;
+    memcpy(&bin[0], &enc.header, sizeof(gcb_header_t));
+
+    const gcb_header_t *hdr = (const gcb_header_t *)bin.data();
+    if (!gcb_check(hdr)) return printf("Bad header\n"), 1;
+    printf("Input: %.2f MB, %u lines -> %.2f MB, %u commands in %u "
+           "records (%.0f%%)\n", src.size() / 1048576.0, hdr->lines,
+           bin.size() / 1048576.0, hdr->commands, hdr->records, 100.0 * bin.size() / src.size());
+    printf("Header: %u moves, %u layers, %.1f mm filament, %u dropped, "
+           "X %.1f~%.1f Y %.1f~%.1f Z %.2f~%.2f\n", hdr->moves, hdr->layers,
+           hdr->filament, hdr->dropped, hdr->min[0], hdr->max[0],
+           hdr->min[1], hdr->max[1], hdr->min[2], hdr->max[2]);
+    printf("Bytes per command: text %.1f, binary %.1f\n",
+           (double)src.size() / hdr->commands,
+           (double)(bin.size() - sizeof(*hdr)) / hdr->commands);
+    bench_report("encode(1436B) bytes", src.size(), "B", dt);
+
+    // read back: tokenize text vs decode records
+    gcode_parser_t parser;
+    size_t nparam = 0;
+    t0 = bench_now();
+    gcode_parser_init(&parser);
+    gcode_parse(&parser, src.data(), src.size(), count, &nparam);
+    gcode_parse_end(&parser, count, &nparam);
+    double tp = bench_now() - t0;
+
+    const gcb_record_t *rec = (const gcb_record_t *)(bin.data() + sizeof(*hdr));
+    gcode_cmd_t cmd;
+    size_t ndecode = 0;
+    t0 = bench_now();
+    for (uint32_t i = 0; i < hdr->records;) {
+        i += gcb_decode(rec + i, hdr->records - i, &cmd);
+        ndecode += cmd.nparam;
+    }
+    double td = bench_now() - t0;
+    printf("Read: parse %.1f ns/cmd, decode %.1f ns/cmd (%.1fx), "
+           "params %u / %u\n", tp / hdr->commands * 1e9,
+           td / hdr->commands * 1e9, tp / td, (unsigned)nparam,
+           (unsigned)ndecode);
+
+    std::vector<gcode_cmd_t> cmds;
+    cmds.reserve(hdr->records);
+    gcode_parser_init(&parser);
+    gcode_parse(&parser, src.data(), src.size(), collect, &cmds);
+    gcode_parse_end(&parser, collect, &cmds);
+    uint32_t bad = cmds.size() != hdr->commands;
+    for (uint32_t i = 0, j = 0; !bad && i < hdr->records; j++) {
+        uint8_t n = gcb_decode(rec + i, hdr->records - i, &cmd);
+        bad += !n || !same(&cmds[j], &cmd);
+        i += n;
+    }
+    printf("Verify: %u commands %s\n", hdr->commands, bad ? "FAIL" : "ok");
+    return bad ? 1 : 0;
+}
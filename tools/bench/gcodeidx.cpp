@@ -0,0 +1,95 @@
+/*
+ * File: gcodeidx.cpp
+ * Authors: Hank <hankso1106@gmail.com>
+ * Create: 2026-10-17 20:31:05
+ *
+ * Layer index builder (main/gcodeidx.cpp). G-code is fed in TCP segment sized
+ * chunks like onUpload does, and the time is compared with copying the chunks
+ * (lower bound of storing them) and with the G-code tokenizer. Then every
+ * entry is checked: it must start a line, its line number must match, Z must
+ * increase, and looking it up by layer, Z and offset must find it again.
+ *
+ *      g++ -O2 -std=gnu++14 -Imain tools/bench/gcodeidx.cpp main/gcode.cpp \
+ *          main/gcodeidx.cpp -o /tmp/bench-gcodeidx && \
+ *          /tmp/bench-gcodeidx [file.gcode] [MB]
+ */
+
+#include "bench.h"
+#include "gcode.h"
+#include "gcodeidx.h"
+
+static size_t write_mem(const void *buf, size_t len, void *arg) {
+    ((std::string *)arg)->append((const char *)buf, len);
+    return len;
+}
+
+static size_t read_mem(void *buf, size_t len, size_t offset, void *arg) {
+    const std::string *src = (const std::string *)arg;
+    if (offset >= src->size()) return 0;
+    len = std::min(len, src->size() - offset);
+    memcpy(buf, src->data() + offset, len);
+    return len;
+}
+
+int main(int argc, char **argv) {
+    const char *path = argc > 1 ? argv[1] : NULL;
+    size_t size = (argc > 2 ? atof(argv[2]) : 16) * 1024 * 1024;
+    std::string src = bench_gcode(path, size), idx;
+    const size_t chunk = 1436;                  // TCP MSS
+    static char copy[chunk];
+
+    double t0 = bench_now();
+    for (size_t i = 0; i < src.size(); i += chunk) {
+        memcpy(copy, src.data() + i, std::min(chunk, src.size() - i));
+        __asm__ volatile("" : : "r"(copy) : "memory");
+    }
+    double tc = bench_now() - t0;
+
+    static gidx_builder_t builder;
+    t0 = bench_now();
+    gidx_init(&builder, write_mem, &idx);
+    for (size_t i = 0; i < src.size(); i += chunk) {
+        gidx_feed(&builder, src.data() + i, std::min(chunk, src.size() - i));
+    }
+    gidx_end(&builder);
+    double ti = bench_now() - t0;
+    memcpy(&idx[0], &builder.header, sizeof(gidx_header_t));
+
+    gcode_parser_t parser;
+    t0 = bench_now();
+    gcode_parser_init(&parser);
+    for (size_t i = 0; i < src.size(); i += chunk) {
+        gcode_parse(&parser, src.data() + i, std::min(chunk, src.size() - i),
+                    NULL, NULL);
+    }
+    gcode_parse_end(&parser, NULL, NULL);
+    double tp = bench_now() - t0;
+
+    const gidx_header_t *hdr = (const gidx_header_t *)idx.data();
+    if (!gidx_check(hdr)) return printf("Bad header\n"), 1;
+    printf("Input: %.2f MB, %u lines -> %u layers up to Z%.2f, index %u bytes\n",
+           hdr->bytes / 1048576.0, hdr->lines, hdr->layers, hdr->height,
+           (unsigned)idx.size());
+    bench_report("copy(1436B) bytes", src.size(), "B", tc);
+    bench_report("index(1436B) bytes", src.size(), "B", ti);
+    bench_report("tokenize(1436B) bytes", src.size(), "B", tp);
+    printf("Index costs %.1f%% of tokenizing\n", ti / tp * 100);
+
+    // verify entries against the text
+    uint32_t bad = hdr->lines != parser.lines, line = 0;
+    size_t pos = 0;
+    float last_z = -1e9;
+    for (uint32_t i = 0; i < hdr->layers; i++) {
+        gidx_entry_t entry, found;
+        if (!gidx_layer(read_mem, &idx, hdr, i, &entry)) { bad++; break; }
+        for (; pos < entry.offset; pos++) line += src[pos] == '\n';
+        bad += entry.offset && src[entry.offset - 1] != '\n';
+        bad += entry.line != line || entry.z <= last_z;
+        bad += gidx_find_z(read_mem, &idx, hdr, entry.z, &found) != (int)i;
+        bad += gidx_find_offset(read_mem, &idx, hdr, entry.offset, &found)
+               != (int)i;
+        last_z = entry.z;
+    }
+    printf("Verify: %u layers %s\n", hdr->layers, bad ? "FAIL" : "ok");
+    return bad ? 1 : 0;
+}
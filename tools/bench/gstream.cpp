@@ -0,0 +1,395 @@
+/*
+ * File: gstream.cpp
+ * Authors: Hank <hankso1106@gmail.com>
+ * Create: 2026-10-18 09:12:47
+ *
+ * G-code streaming throughput over a local TCP loopback standing in for the
+ * /ws WebSocket. Messages are framed by a 4 bytes length (instead of the
+ * WebSocket header) and fed to main/gstream.cpp in 1436 bytes pieces like
+ * AsyncTCP packets. The printer side has a command buffer of N slots drained
+ * by a "motion task" thread and a timer thread pushing credits, like
+ * server.cpp. Network latency is added on the client: replies are not seen
+ * before `rtt` after they arrived.
+ *
+ *      sync        one line per message, wait for its reply (like /cmd)
+ *      credit      pipeline messages of up to 1400 bytes until the limit
+ *      +foreign    another producer takes a slot every 1ms (like /cmd), so
+ *                  lines get rejected and the client has to go back
+ *      slow        motion task takes 500us per command, buffer stays full
+ *
+ * Each run lasts about one second. The commands drained are checked against
+ * the source: all accepted lines, once and in order.
+ *
+ *      g++ -O2 -std=gnu++14 -pthread -Imain tools/bench/gstream.cpp \
+ *          main/gstream.cpp main/gcode.cpp -o /tmp/bench-gstream && \
+ *          /tmp/bench-gstream [file.gcode]
+ */
+
+#include "bench.h"
+#include "gstream.h"
+
+#include <string.h>
+#include <unistd.h>
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <sys/socket.h>
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <deque>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#define PACKET_SIZE         1436        // TCP payload per packet
+#define MESSAGE_SIZE        1400        // max bytes of lines per message
+#define RUN_SECS            1.0
+#define FOREIGN_CODE        9999        // M9999 from the other producer
+
+typedef std::chrono::steady_clock clk;
+
+/******************************************************************************
+ * Printer: command buffer, motion task, credit timer, network task
+ */
+
+static struct {
+    std::mutex lock;
+    std::condition_variable cv;
+    std::deque<gcode_cmd_t> queue;
+    uint32_t slots;
+    std::vector<gcode_cmd_t> done;      // commands drained in order
+    uint32_t delay_us;          // time to execute a command
+    bool stop;
+} buffer;
+
+static bool buffer_push(const gcode_cmd_t *cmd, void *arg) {
+    std::lock_guard<std::mutex> guard(buffer.lock);
+    if (buffer.queue.size() >= buffer.slots) return false;
+    buffer.queue.push_back(*cmd);
+    buffer.cv.notify_one();
+    return true;
+}
+
+static uint32_t buffer_space(void *arg) {
+    std::lock_guard<std::mutex> guard(buffer.lock);
+    return buffer.slots - buffer.queue.size();
+}
+
+static void motion_task() {
+    std::unique_lock<std::mutex> guard(buffer.lock);
+    while (true) {
+        buffer.cv.wait(guard, [] {
+            return buffer.stop || !buffer.queue.empty();
+        });
+        if (buffer.queue.empty()) break;
+        buffer.done.push_back(buffer.queue.front());
+        if (buffer.delay_us) {
+            guard.unlock();
+            std::this_thread::sleep_for(
+                std::chrono::microseconds(buffer.delay_us));
+            guard.lock();
+        }
+        buffer.queue.pop_front();
+    }
+}
+
+static gstream_t stream;
+static std::mutex stream_lock, send_lock;
+static std::atomic<bool> running;
+
+static bool recv_all(int fd, void *buf, size_t len) {
+    char *p = (char *)buf;
+    while (len) {
+        ssize_t n = recv(fd, p, len, 0);
+        if (n <= 0) return false;
+        p += n; len -= n;
+    }
+    return true;
+}
+
+static void send_msg(int fd, const char *buf, uint32_t len) {
+    std::lock_guard<std::mutex> guard(send_lock);
+    std::string out((const char *)&len, 4);
+    out.append(buf, len);
+    send(fd, out.data(), out.size(), 0);
+}
+
+static void timer_task(int fd) {
+    char buf[32];
+    while (running) {
+        std::this_thread::sleep_for(
+            std::chrono::milliseconds(GSTREAM_POLL_MS));
+        std::unique_lock<std::mutex> guard(stream_lock);
+        bool push = gstream_poll(&stream, buf, sizeof(buf));
+        guard.unlock();
+        if (push) send_msg(fd, buf, strlen(buf));
+    }
+}
+
+static void network_task(int fd) {
+    char buf[PACKET_SIZE], reply[48];
+    uint32_t len;
+    while (recv_all(fd, &len, 4)) {
+        std::unique_lock<std::mutex> guard(stream_lock);
+        gstream_begin(&stream, 1);
+        guard.unlock();
+        while (len) {
+            uint32_t n = len < PACKET_SIZE ? len : PACKET_SIZE;
+            if (!recv_all(fd, buf, n)) return;
+            guard.lock();
+            gstream_feed(&stream, buf, n);
+            guard.unlock();
+            len -= n;
+        }
+        guard.lock();
+        int rlen = gstream_end(&stream, reply, sizeof(reply));
+        guard.unlock();
+        send_msg(fd, reply, rlen);
+    }
+}
+
+static void foreign_task() {
+    gcode_cmd_t cmd;
+    memset(&cmd, 0, sizeof(cmd));
+    cmd.letter = 'M';
+    cmd.code = FOREIGN_CODE;
+    cmd.line = -1;
+    while (running) {
+        std::this_thread::sleep_for(std::chrono::milliseconds(1));
+        buffer_push(&cmd, NULL);
+    }
+}
+
+/******************************************************************************
+ * Client
+ */
+
+typedef struct {
+    clk::time_point seen;       // arrival + rtt
+    std::string text;
+} reply_t;
+
+static struct {
+    std::mutex lock;
+    std::condition_variable cv;
+    std::deque<reply_t> queue;
+    bool closed;
+} replies;
+
+static void reader_task(int fd, clk::duration rtt) {
+    std::string text;
+    uint32_t len;
+    while (recv_all(fd, &len, 4)) {
+        text.resize(len);
+        if (!recv_all(fd, &text[0], len)) break;
+        std::lock_guard<std::mutex> guard(replies.lock);
+        replies.queue.push_back(reply_t { clk::now() + rtt, text });
+        replies.cv.notify_one();
+    }
+    std::lock_guard<std::mutex> guard(replies.lock);
+    replies.closed = true;
+    replies.cv.notify_one();
+}
+
+static bool next_reply(std::string &text) {
+    std::unique_lock<std::mutex> guard(replies.lock);
+    replies.cv.wait(guard, [] {
+        return replies.closed || !replies.queue.empty();
+    });
+    if (replies.queue.empty()) return false;
+    reply_t r = replies.queue.front();
+    replies.queue.pop_front();
+    guard.unlock();
+    std::this_thread::sleep_until(r.seen);
+    text = r.text;
+    return true;
+}
+
+typedef struct {
+    uint32_t lines;             // acked at the end
+    uint32_t messages;
+    uint32_t resends;           // go back to acked
+    uint32_t resent;            // lines sent again
+    double secs;
+} client_result_t;
+
+// Send `lines` until RUN_SECS passed, then wait for the last ack
+static client_result_t client_run(int fd,
+                                  const std::vector<std::string> &lines,
+                                  bool sync) {
+    client_result_t res = client_result_t();
+    std::deque<std::pair<uint32_t, uint32_t>> flight;   // seq, lines
+    uint32_t sent = 0, acked = 0, limit = 0, total = lines.size(), top = 0;
+    std::string msg, text;
+    send_msg(fd, "gcode 0", 7);                         // open, query credit
+    flight.push_back(std::make_pair(0, 0));
+    double start = bench_now();
+    while (true) {
+        if (bench_now() - start > RUN_SECS) total = sent;
+        while (sent < total && sent < limit && (!sync || flight.empty())) {
+            uint32_t seq = sent;
+            msg = "gcode " + std::to_string(seq) + "\n";
+            while (sent < total && sent < limit) {
+                if (msg.size() + lines[sent].size() > MESSAGE_SIZE &&
+                    sent > seq) break;
+                msg += lines[sent++];
+                if (sync) break;
+            }
+            if (seq < top) res.resent += (top < sent ? top : sent) - seq;
+            if (sent > top) top = sent;
+            send_msg(fd, msg.data(), msg.size());
+            flight.push_back(std::make_pair(seq, sent - seq));
+            res.messages++;
+        }
+        if (flight.empty() && acked >= total) break;
+        if (!next_reply(text)) break;
+        unsigned a, b, c;
+        if (sscanf(text.c_str(), "ack %u %u %u", &a, &b, &c) == 3) {
+            uint32_t seq = flight.front().first, n = flight.front().second;
+            flight.pop_front();
+            if (seq != a) fprintf(stderr, "reply of %u for %u\n", a, seq);
+            acked = b; limit = c;
+            if (a <= b && b < a + n) {                  // go back
+                sent = b;
+                res.resends++;
+            }
+        } else if (sscanf(text.c_str(), "credit %u %u", &a, &b) == 2) {
+            acked = a; limit = b;
+        } else {
+            fprintf(stderr, "%s\n", text.c_str());
+            break;
+        }
+    }
+    res.secs = bench_now() - start;
+    res.lines = acked;
+    return res;
+}
+
+/******************************************************************************
+ * Runs
+ */
+
+static std::vector<std::string> expect;     // formatted command of each line
+
+static void on_expect(const gcode_cmd_t *cmd, void *arg) {
+    gcode_parser_t *parser = (gcode_parser_t *)arg;
+    char buf[128];
+    gcode_format(cmd, buf, sizeof(buf));
+    expect.resize(parser->lines);
+    expect[parser->lines - 1] = buf;
+}
+
+// Drained commands of the stream must be the source lines below `lines`
+static bool verify(uint32_t lines) {
+    size_t i = 0, bad = 0;
+    char buf[128];
+    for (const gcode_cmd_t &cmd : buffer.done) {
+        if (cmd.letter == 'M' && cmd.code == FOREIGN_CODE) continue;
+        while (i < lines && i < expect.size() && expect[i].empty()) i++;
+        gcode_format(&cmd, buf, sizeof(buf));
+        if (i >= lines || i >= expect.size() || expect[i] != buf) bad++;
+        i++;
+    }
+    while (i < lines && i < expect.size() && expect[i].empty()) i++;
+    return !bad && i >= lines;
+}
+
+static void run(const char *name, const std::vector<std::string> &lines,
+               uint32_t slots, bool sync, bool foreign, int rtt_ms,
+               uint32_t delay_us = 0) {
+    int pair[2], lfd = socket(AF_INET, SOCK_STREAM, 0), one = 1;
+    struct sockaddr_in addr;
+    socklen_t alen = sizeof(addr);
+    memset(&addr, 0, sizeof(addr));
+    addr.sin_family = AF_INET;
+    addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    setsockopt(lfd, SOL_SOCKET, SO_REUSEADDR, &one, sizeof(one));
+    if (bind(lfd, (struct sockaddr *)&addr, sizeof(addr)) ||
+        listen(lfd, 1) || getsockname(lfd, (struct sockaddr *)&addr, &alen)) {
+        perror("loopback");
+        exit(1);
+    }
+    pair[0] = socket(AF_INET, SOCK_STREAM, 0);
+    if (connect(pair[0], (struct sockaddr *)&addr, sizeof(addr))) {
+        perror("connect");
+        exit(1);
+    }
+    pair[1] = accept(lfd, NULL, NULL);
+    close(lfd);
+    for (int fd : pair) {
+        setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+    }
+
+    const gstream_sink_t sink = { buffer_push, buffer_space, NULL };
+    gstream_init(&stream, &sink);
+    buffer.slots = slots;
+    buffer.delay_us = delay_us;
+    buffer.stop = false;
+    buffer.queue.clear();
+    buffer.done.clear();
+    replies.queue.clear();
+    replies.closed = false;
+    running = true;
+    std::thread motion(motion_task), timer(timer_task, pair[1]);
+    std::thread network(network_task, pair[1]);
+    std::thread reader(reader_task, pair[0],
+                       std::chrono::milliseconds(rtt_ms));
+    std::thread other;
+    if (foreign) other = std::thread(foreign_task);
+
+    client_result_t res = client_run(pair[0], lines, sync);
+
+    running = false;
+    if (foreign) other.join();
+    timer.join();
+    shutdown(pair[0], SHUT_RDWR);
+    network.join();
+    reader.join();
+    {
+        std::lock_guard<std::mutex> guard(buffer.lock);
+        buffer.stop = true;
+        buffer.cv.notify_one();
+    }
+    motion.join();
+    close(pair[0]);
+    close(pair[1]);
+
+    char title[32];
+    snprintf(title, sizeof(title), "%s %ums", name, rtt_ms);
+    bench_report(title, res.lines, "lines", res.secs);
+    const gstream_stats_t *st = &stream.stats;
+    printf("  %u messages, %u credits, %u rejected, %u resends (%u lines), "
+           "%u skipped: %s\n", res.messages, st->credits, st->rejected,
+           res.resends, res.resent, st->skipped,
+           verify(res.lines) ? "verified" : "MISMATCH");
+}
+
+int main(int argc, char **argv) {
+    std::string src = bench_gcode(argc > 1 ? argv[1] : NULL, 8 << 20);
+    std::vector<std::string> lines;
+    for (size_t pos = 0, end; pos < src.size(); pos = end + 1) {
+        end = src.find('\n', pos);
+        if (end == std::string::npos) end = src.size() - 1;
+        lines.push_back(src.substr(pos, end - pos + 1));
+    }
+    gcode_parser_t parser;
+    gcode_parser_init(&parser);
+    gcode_parse(&parser, src.data(), src.size(), on_expect, &parser);
+    expect.resize(lines.size());
+    printf("%zu lines, %zu bytes\n", lines.size(), src.size());
+
+    const int rtts[] = { 0, 2, 10 };
+    for (int rtt : rtts) {
+        run("sync", lines, 32, true, false, rtt);
+        run("credit16", lines, 16, false, false, rtt);
+        run("credit32", lines, 32, false, false, rtt);
+        run("credit32+foreign", lines, 32, false, true, rtt);
+    }
+    run("sync slow", lines, 32, true, false, 2, 500);
+    run("credit32 slow", lines, 32, false, false, 2, 500);
+    run("credit32+foreign slow", lines, 32, false, true, 2, 500);
+    return 0;
+}
@@ -0,0 +1,213 @@
+/*
+ * File: heater.cpp
+ * Authors: Hank <hankso1106@gmail.com>
+ * Create: 2026-10-18 13:40:07
+ *
+ * Closed loop test of main/heater.cpp on a thermal model. Heater block and
+ * thermistor are two lumped masses: the block gets P * level and loses
+ * (T - ambient) / R, the thermistor follows the block with a time constant,
+ * and readings have some noise. The model is stepped every millisecond,
+ * the controller every HEATER_PERIOD_MS like the task on the ESP32.
+ *
+ * For the bed and a nozzle: relay autotune, then a warm-up from ambient with
+ * the tuned parameters (time to settle, overshoot, ripple at target) and a
+ * disturbance (part fan on the nozzle, a draft on the bed). Output edges per
+ * second bound the I2C writes of the time-proportioned windows. None of
+ * these may trip the guard.
+ *
+ * Then the faults the guard is for, each injected into a fresh run: the
+ * thermistor falls off the block and cools in air, the heater falls off or
+ * loses most of its power, the thermistor wire breaks (invalid readings),
+ * and the MOSFET fails shorted so the heater stays on. For each: the fault
+ * found, time from injection to detection, hottest block temperature until
+ * then, and whether the output was off from the detecting period on.
+ *
+ *      g++ -O2 -std=gnu++14 -Imain tools/bench/heater.cpp main/heater.cpp \
+ *          -o /tmp/bench-heater && /tmp/bench-heater
+ */
+
+#include "bench.h"
+#include "heater.h"
+
+typedef struct {
+    const char *name;
+    float power;                // W at full duty
+    float cap;                  // heat capacity of block (J/K)
+    float res;                  // thermal resistance to ambient (K/W)
+    float lag;                  // thermistor time constant (s)
+    float target;
+    float disturb;              // resistance factor of the disturbance
+    uint16_t window;
+    guard_param_t guard;
+} plant_t;
+
+typedef struct {
+    float block, sensor;
+    float res;
+    float power;                // factor of plant power
+    bool loose;                 // thermistor off the block, in air
+    bool open;                  // thermistor wire broken
+    bool stuck;                 // heater on whatever the output
+} plant_state_t;
+
+#define PLANT_INIT(p)   { HEATER_AMBIENT, HEATER_AMBIENT, (p)->res, 1, \
+                          false, false, false }
+
+static uint32_t rng = 88172645u;
+
+static float noise(float amp) {
+    rng ^= rng << 13; rng ^= rng >> 17; rng ^= rng << 5;
+    return amp * ((rng & 0xFFFF) / 32768.0f - 1);
+}
+
+// Advance model by one controller period with output `level`
+static float step(const plant_t *p, plant_state_t *s, bool level) {
+    const float dt = 0.001f;
+    float power = level || s->stuck ? p->power * s->power : 0;
+    for (int i = 0; i < HEATER_PERIOD_MS; i++) {
+        float loss = (s->block - HEATER_AMBIENT) / s->res;
+        s->block += (power - loss) / p->cap * dt;
+        if (s->loose) {         // a bead in air is slower than in a block
+            s->sensor += (HEATER_AMBIENT - s->sensor) / (p->lag * 5) * dt;
+        } else {
+            s->sensor += (s->block - s->sensor) / p->lag * dt;
+        }
+    }
+    return s->open ? NAN : s->sensor + noise(0.1f);
+}
+
+static bool autotune(const plant_t *p, pid_param_t *pid) {
+    heater_t h;
+    plant_state_t s = PLANT_INIT(p);
+    heater_init(&h, pid, p->window, &p->guard);
+    heater_update(&h, s.sensor, HEATER_PERIOD_MS / 1e3f);
+    heater_autotune(&h, p->target);
+    uint32_t n = 0;
+    while (h.tune.state == TUNE_RUNNING) {
+        float temp = step(p, &s, heater_output(&h));
+        heater_update(&h, temp, HEATER_PERIOD_MS / 1e3f);
+        n++;
+    }
+    if (h.tune.state != TUNE_DONE) {
+        printf("%s: autotune FAILED after %.0fs, guard %s\n", p->name,
+               h.tune.time, heater_fault_str(h.guard.fault));
+        return false;
+    }
+    *pid = h.tune.result;
+    printf("%s: autotune %.0fs, Ku %.4f Tu %.1fs, holding %.0f%%\n"
+           "    kp %.4f ki %.5f kd %.3f kf %.5f\n", p->name,
+           n * HEATER_PERIOD_MS / 1e3, h.tune.ku, h.tune.tu,
+           h.tune.bias * 100, pid->kp, pid->ki, pid->kd, pid->kf);
+    return true;
+}
+
+static bool run(const plant_t *p, const pid_param_t *pid, const char *desc) {
+    heater_t h;
+    plant_state_t s = PLANT_INIT(p);
+    heater_init(&h, pid, p->window, &p->guard);
+    h.target = p->target;
+    const float dt = HEATER_PERIOD_MS / 1e3f;
+    float settle = -1, peak = 0, ripple = 0, dip = 0, recover = -1;
+    float t_total = 1800, t_disturb = 1200;
+    uint32_t edges = 0, window = 300;     // seconds at target measured
+    for (float t = 0; t < t_total; t += dt) {
+        if (t >= t_disturb) s.res = p->res * p->disturb;
+        float temp = step(p, &s, heater_output(&h));
+        heater_update(&h, temp, dt);
+        float err = s.sensor - p->target;
+        if (t < t_disturb) {
+            if (err > peak) peak = err;
+            if (fabsf(err) > HEATER_TOLERANCE) settle = -1;
+            else if (settle < 0) settle = t;
+            if (t < t_disturb - window) edges = h.edges;
+            else if (fabsf(err) > ripple) ripple = fabsf(err);
+        } else {
+            if (t - dt < t_disturb) edges = h.edges - edges;
+            if (-err > dip) dip = -err;
+            if (fabsf(err) > HEATER_TOLERANCE) recover = -1;
+            else if (recover < 0) recover = t - t_disturb;
+        }
+    }
+    printf("    %-8s settled %5.0fs, overshoot %4.1f, ripple +-%.2f, "
+           "%.2f edges/s; disturbance dip %4.1f, back in %4.0fs\n", desc,
+           settle, peak, ripple, (float)edges / window, dip,
+           recover);
+    if (h.guard.fault == FAULT_NONE) return true;
+    printf("    %-8s FAILED: guard tripped (%s)\n", desc,
+           heater_fault_str(h.guard.fault));
+    return false;
+}
+
+typedef struct {
+    const char *name;
+    float at;                   // seconds after target set
+    heater_fault_t expect;
+    void (*inject)(plant_state_t *s);
+} scenario_t;
+
+static const scenario_t scenarios[] = {
+    { "thermistor off, hold", 900, FAULT_RUNAWAY,
+      [](plant_state_t *s) { s->loose = true; } },
+    { "heater off, warm-up",   10, FAULT_HEATING,
+      [](plant_state_t *s) { s->power = 0; } },
+    { "heater weak, hold",    900, FAULT_RUNAWAY,
+      [](plant_state_t *s) { s->power = 0.2f; } },
+    { "wire broken, hold",    900, FAULT_SENSOR,
+      [](plant_state_t *s) { s->open = true; } },
+    { "MOSFET shorted, hold", 900, FAULT_OVERHEAT,
+      [](plant_state_t *s) { s->stuck = true; } },
+};
+
+static bool fault(const plant_t *p, const pid_param_t *pid,
+                  const scenario_t *sc) {
+    heater_t h;
+    plant_state_t s = PLANT_INIT(p);
+    heater_init(&h, pid, p->window, &p->guard);
+    h.target = p->target;
+    const float dt = HEATER_PERIOD_MS / 1e3f;
+    float t = 0, hottest = 0, found = -1;
+    bool off = true, level = false;
+    for (; t < sc->at + 3600 && found < 0; t += dt) {
+        if (t >= sc->at && t - dt < sc->at) sc->inject(&s);
+        float temp = step(p, &s, level);
+        heater_update(&h, temp, dt);
+        level = heater_output(&h);
+        if (t >= sc->at) hottest = fmaxf(hottest, s.block);
+        if (h.guard.state == GUARD_FAULT) found = t - sc->at;
+    }
+    for (int i = 0; i < h.window * 2; i++) {    // stays off after that
+        if (i) level = heater_output(&h);
+        if (level) off = false;
+        heater_update(&h, step(p, &s, level), dt);
+    }
+    bool ok = found >= 0 && h.guard.fault == sc->expect && off;
+    printf("    %-21s %-8s after %5.1fs, block up to %5.1f, output %s: "
+           "%s\n", sc->name, heater_fault_str(h.guard.fault), found, hottest,
+           off ? "off" : "ON", ok ? "ok" : "FAILED");
+    return ok;
+}
+
+int main(int argc, char **argv) {
+    const plant_t plants[] = {
+        // name      W    J/K   K/W  lag  degC  disturb  window
+        { "Bed",    220, 400, 0.55f, 8,   60, 0.7f, HEATER_WINDOW_BED,
+          GUARD_BED },
+        { "Nozzle",  40,   8,  12,   2,  210, 0.6f, HEATER_WINDOW_NOZ,
+          GUARD_NOZ },
+    };
+    int ret = 0;
+    for (const plant_t &p : plants) {
+        pid_param_t pid = { 0, 0, 0, 0 };
+        if (!autotune(&p, &pid)) {
+            ret = 1;
+            continue;
+        }
+        if (!run(&p, &pid, "PID+FF")) ret = 1;
+        pid_param_t noff = pid;
+        noff.kf = 0;
+        if (!run(&p, &noff, "PID")) ret = 1;
+        for (const scenario_t &sc : scenarios)
+            if (!fault(&p, &pid, &sc)) ret = 1;
+    }
+    return ret;
+}
@@ -0,0 +1,122 @@
+/*
+ * File: i2cbus.cpp
+ * Authors: Hank <hankso1106@gmail.com>
+ * Create: 2026-10-18 18:10:47
+ *
+ * Batched transfers of the PCF8574 pin layer (i2c_sync_vals of pins.cpp) on
+ * the virtual chips of vchip.cpp. Every combination of chips written and
+ * read in one transaction is checked against the latches and inputs of the
+ * chips. Then the cost of a full I/O refresh (write temperature and valve
+ * chips, read endstops): one transaction per chip as before against one
+ * transaction for all, at the old 50kHz clock and at I2C_CLK_HZ. Driver
+ * time of a transaction is added from the argument (us, see the overhead
+ * printed by i2c_initialize at boot).
+ *
+ *      g++ -O2 -std=gnu++14 -Imain tools/bench/i2cbus.cpp main/pins.cpp \
+ *          tools/bench/vchip.cpp -o /tmp/bench-i2cbus \
+ *          && /tmp/bench-i2cbus [overhead]
+ */
+
+#include "bench.h"
+#include "vchip.h"
+
+#define ROUNDS              1000
+#define OLD_HZ              50000
+
+static uint32_t rng = 2463534242u;
+
+static uint8_t random8() {
+    rng ^= rng << 13; rng ^= rng >> 17; rng ^= rng << 5;
+    return rng;
+}
+
+static i2c_pin_num_t pin_of(uint8_t idx, uint8_t bit) {
+    return (i2c_pin_num_t)(PIN_I2C_MIN + 1 + idx * 8 + bit);
+}
+
+// Random patterns through every write / read mask, return mismatches
+static uint32_t check() {
+    uint32_t bad = 0;
+    uint8_t vals[I2C_PIN_CHIPS];
+    vchip_reset();
+    for (uint32_t n = 0; n < ROUNDS; n++) {
+        uint8_t wmask = random8() & 7, rmask = random8() & 7 & ~wmask;
+        uint8_t before[I2C_PIN_CHIPS];
+        for (uint8_t idx = 0; idx < I2C_PIN_CHIPS; idx++) {
+            for (uint8_t bit = 0; bit < 8; bit++)
+                vchip_set_input(idx, bit, random8() & 1);
+            before[idx] = vchip.latch[idx];
+            vals[idx] = random8();
+        }
+        // patterns of written chips, then all in one transaction
+        uint32_t trans = vchip.stats.i2c_trans;
+        if (i2c_set_vals(wmask, vals)) bad++;
+        if (rmask && i2c_sync_vals(0, rmask)) bad++;
+        if (i2c_sync_vals(wmask, rmask)) bad++;
+        uint32_t want = !!wmask + !!rmask + !!(wmask | rmask);
+        if (vchip.stats.i2c_trans - trans != want) bad++;
+        for (uint8_t idx = 0; idx < I2C_PIN_CHIPS; idx++) {
+            uint8_t latch = wmask & BIT(idx) ? vals[idx] : before[idx];
+            if (vchip.latch[idx] != latch) bad++;
+            if (!(rmask & BIT(idx))) continue;
+            for (uint8_t bit = 0; bit < 8; bit++) {
+                bool level = vchip_8574_pins(idx) & BIT(bit);
+                if ((i2c_gpio_get_level(pin_of(idx, bit)) != 0) != level)
+                    bad++;
+            }
+        }
+    }
+    return bad;
+}
+
+typedef struct {
+    uint32_t trans;             // per refresh
+    double bus_us;
+} cost_t;
+
+static cost_t refresh(uint32_t hz, bool batched) {
+    vchip_reset();
+    vchip.i2c_hz = hz;
+    for (uint32_t n = 0; n < ROUNDS; n++) {
+        if (batched) {
+            i2c_sync_vals();
+            continue;
+        }
+        for (uint8_t idx = 0; idx < I2C_PIN_CHIPS; idx++) {
+            if (I2C_PIN_OUTPUTS & BIT(idx)) i2c_set_val(idx);
+            if (I2C_PIN_INPUTS & BIT(idx)) i2c_get_val(idx);
+        }
+    }
+    cost_t c = {
+        vchip.stats.i2c_trans / ROUNDS,
+        (double)vchip.stats.i2c_ticks / ROUNDS * 1e6 / VCHIP_TICK_HZ
+    };
+    return c;
+}
+
+int main(int argc, char **argv) {
+    double overhead = argc > 1 ? atof(argv[1]) : 0;
+    uint32_t bad = check();
+    printf("Write / read masks, %u rounds: %u mismatches: %s\n",
+           ROUNDS, bad, bad ? "FAILED" : "ok");
+
+    printf("Full I/O refresh (%u output, %u input chips), driver %.0f us "
+           "per transaction:\n", __builtin_popcount(I2C_PIN_OUTPUTS),
+           __builtin_popcount(I2C_PIN_INPUTS), overhead);
+    const struct { const char *name; uint32_t hz; bool batched; } rows[] = {
+        { "per chip", OLD_HZ, false },
+        { "batched", OLD_HZ, true },
+        { "per chip", I2C_CLK_HZ, false },
+        { "batched", I2C_CLK_HZ, true },
+    };
+    double base = 0;
+    for (const auto &r : rows) {
+        cost_t c = refresh(r.hz, r.batched);
+        double total = c.bus_us + c.trans * overhead;
+        if (!base) base = total;
+        printf("  %-9s %3ukHz: %u transactions, bus %4.0f us, total %4.0f "
+               "us (%.0f%%)\n", r.name, r.hz / 1000, c.trans, c.bus_us,
+               total, total * 100 / base);
+    }
+    return bad != 0;
+}
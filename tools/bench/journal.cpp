@@ -0,0 +1,197 @@
+/*
+ * File: journal.cpp
+ * Authors: Hank <hankso1106@gmail.com>
+ * Create: 2026-10-18 11:05:23
+ *
+ * Power cut test of main/journal.cpp on a simulated NOR flash region: a
+ * program only clears bits and an erase sets a sector to 0xFF. Each cycle
+ * boots (mounts the journal), checks the recovered state and checkpoints a
+ * print until the power is cut at a random byte of a program or erase:
+ *
+ *      program     bytes before the cut are written, the one at the cut
+ *                  only partly (random bits), the rest stays as it was
+ *      erase       every byte is either erased, untouched or random
+ *
+ * The state recovered at the next boot must be the last record whose write
+ * returned, or the one being written when it happened to complete. Then a
+ * long print without cuts shows wear: erases per sector and records per
+ * erase. Mount time is measured on host, bytes read tell it for the ESP32.
+ *
+ *      g++ -O2 -std=gnu++14 -Imain tools/bench/journal.cpp main/journal.cpp \
+ *          main/gcode.cpp -o /tmp/bench-journal && /tmp/bench-journal [cycles]
+ */
+
+#include "bench.h"
+#include "journal.h"
+
+#include <string.h>
+#include <vector>
+
+#define SECTORS             4           // partitions.csv: 16KB
+
+static struct {
+    std::vector<uint8_t> data;
+    int64_t budget;             // bytes left to program or erase, -1: no cut
+    bool dead;                  // power is cut
+    uint32_t erases[SECTORS];
+    uint32_t torn_writes, torn_erases;
+} flash;
+
+static uint32_t rng = 2463534242u;
+
+static uint32_t rand32() {
+    rng ^= rng << 13; rng ^= rng >> 17; rng ^= rng << 5;
+    return rng;
+}
+
+// Consume budget for `len` bytes. Return bytes done before the cut.
+static size_t spend(size_t len) {
+    if (flash.dead) return 0;
+    if (flash.budget < 0 || flash.budget >= (int64_t)len) {
+        if (flash.budget >= 0) flash.budget -= len;
+        return len;
+    }
+    size_t done = flash.budget;
+    flash.dead = true;
+    return done;
+}
+
+static bool sim_read(uint32_t addr, void *buf, size_t len, void *arg) {
+    if (flash.dead || addr + len > flash.data.size()) return false;
+    memcpy(buf, &flash.data[addr], len);
+    return true;
+}
+
+static bool sim_write(uint32_t addr, const void *buf, size_t len, void *arg) {
+    const uint8_t *src = (const uint8_t *)buf;
+    if (flash.dead) return false;
+    size_t done = spend(len);
+    for (size_t i = 0; i < done; i++) flash.data[addr + i] &= src[i];
+    if (done == len) return true;
+    flash.data[addr + done] &= src[done] | rand32();
+    flash.torn_writes++;
+    return false;
+}
+
+static bool sim_erase(uint32_t sector, void *arg) {
+    uint8_t *p = &flash.data[sector * JOURNAL_SECTOR];
+    if (flash.dead) return false;
+    if (spend(JOURNAL_SLOT) == JOURNAL_SLOT) {   // cut as likely as a record
+        memset(p, 0xFF, JOURNAL_SECTOR);
+        flash.erases[sector]++;
+        return true;
+    }
+    for (size_t i = 0; i < JOURNAL_SECTOR; i++) {
+        uint32_t r = rand32() % 3;
+        if (r == 0) p[i] = 0xFF;
+        else if (r == 1) p[i] = rand32();
+    }
+    flash.torn_erases++;
+    return false;
+}
+
+static const journal_flash_t sim_flash = {
+    sim_read, sim_write, sim_erase, SECTORS, NULL
+};
+
+// State of a print after `n` checkpoints, deterministic
+static journal_state_t make_state(uint32_t n) {
+    journal_state_t st;
+    memset(&st, 0, sizeof(st));
+    snprintf(st.path, sizeof(st.path), "/data/part%u.gcode", n / 1000);
+    st.offset = n * 1234;
+    st.position[AXIS_X] = (n % 200) * 0.5f;
+    st.position[AXIS_Y] = (n % 170) * 0.7f;
+    st.position[AXIS_Z] = 0.2f + (n / 100) * 0.2f;
+    st.position[AXIS_E] = n * 0.033f;
+    st.feedrate = 100;
+    st.target[0] = 60;
+    st.target[1] = 210;
+    st.fan[0] = n % 256;
+    st.flags = JOURNAL_PRINTING | (n % 7 ? 0 : JOURNAL_RELATIVE_E);
+    return st;
+}
+
+static bool check_track() {
+    const char *text = "T1\nM104 S215\nM104 S200 T0\nM140 S65\n"
+                       "M106 P2 S128\nM106\nM107 P2\n";
+    journal_state_t st;
+    memset(&st, 0, sizeof(st));
+    gcode_parser_t parser;
+    gcode_parser_init(&parser);
+    gcode_parse(&parser, text, strlen(text),
+                [](const gcode_cmd_t *cmd, void *arg) {
+                    journal_track((journal_state_t *)arg, cmd);
+                }, &st);
+    return st.extruder == 1 && st.target[2] == 215 && st.target[1] == 200 &&
+           st.target[0] == 65 && st.fan[0] == 255 && st.fan[2] == 0;
+}
+
+int main(int argc, char **argv) {
+    uint32_t cycles = argc > 1 ? atoi(argv[1]) : 20000;
+    flash.data.assign(SECTORS * JOURNAL_SECTOR, 0xFF);
+    printf("journal_track: %s\n", check_track() ? "ok" : "FAILED");
+
+    static journal_t j;
+    journal_state_t st;
+    uint32_t committed = 0, inflight = 0, lost = 0, bad = 0, fallback = 0;
+    uint32_t max_reads = 0;
+    double mount_secs = 0, mount_max = 0;
+    for (uint32_t c = 0; c < cycles; c++) {
+        flash.dead = false;
+        flash.budget = -1;
+        double t0 = bench_now();
+        bool found = journal_mount(&j, &sim_flash, 1);
+        double dt = bench_now() - t0;
+        mount_secs += dt;
+        if (dt > mount_max) mount_max = dt;
+        if (j.stats.mount_reads > max_reads) max_reads = j.stats.mount_reads;
+        fallback += j.stats.previous;
+        if (!committed) {
+            if (found) bad++;
+        } else if (!found) {
+            lost++;
+        } else if (j.seq != committed && j.seq != inflight) {
+            lost++;
+        } else {
+            st = make_state(j.seq);
+            if (memcmp(&st, &j.state, sizeof(st))) bad++;
+            committed = j.seq;
+        }
+        // print until the power is cut within the next ~12 records
+        flash.budget = rand32() % (12 * JOURNAL_SLOT);
+        for (uint32_t now = 1; !flash.dead; now++) {
+            inflight = j.seq + 1;
+            st = make_state(inflight);
+            journal_update(&j, &st);
+            if (journal_tick(&j, now)) committed = j.seq;
+        }
+    }
+    printf("%u power cuts: %u torn writes, %u torn erases, %u recovered from "
+           "previous sector\n", cycles, flash.torn_writes, flash.torn_erases,
+           fallback);
+    printf("Recovery: %u lost, %u wrong: %s\n", lost, bad,
+           lost || bad ? "FAILED" : "ok");
+    printf("Mount: %.1fus average, %.1fus max, up to %u bytes read\n",
+           mount_secs / cycles * 1e6, mount_max * 1e6, max_reads);
+
+    // wear of a 10 hour print, checkpoint every 10 seconds
+    flash.data.assign(SECTORS * JOURNAL_SECTOR, 0xFF);
+    memset(flash.erases, 0, sizeof(flash.erases));
+    flash.dead = false;
+    flash.budget = -1;
+    journal_mount(&j, &sim_flash, 10000);
+    uint32_t n = 0;
+    for (uint32_t now = 1000; now <= 10 * 3600 * 1000; now += 1000) {
+        st = make_state(n++);                   // state changes every second
+        journal_update(&j, &st);
+        journal_tick(&j, now);
+    }
+    printf("10h print, 10s interval: %u records, %u erases (", j.stats.records,
+           j.stats.erases);
+    for (uint32_t i = 0; i < SECTORS; i++)
+        printf("%s%u", i ? " " : "", flash.erases[i]);
+    printf(" per sector), %.1f records per erase\n",
+           (double)j.stats.records / j.stats.erases);
+    return lost || bad;
+}
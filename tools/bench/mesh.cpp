@@ -0,0 +1,139 @@
+/*
+ * File: mesh.cpp
+ * Authors: Hank <hankso1106@gmail.com>
+ * Create: 2026-10-17 22:24:03
+ *
+ * Cost of bed mesh correction in main/mesh.cpp and main/motion.cpp. A random
+ * 7x7 mesh over 200x200mm corrects slicer-like G-code with the mesh off,
+ * bilinear and bicubic, reporting corrected segments (planner blocks) per
+ * second and how many extra segments the cell splitting adds. A second,
+ * slower pass checks every planned line end against mesh_z. Then the raw
+ * mesh_z cost is measured, the surfaces must pass through the probed points
+ * and the packed NVS format must round trip within 1um.
+ *
+ *      g++ -O2 -std=gnu++14 -Imain tools/bench/mesh.cpp main/gcode.cpp \
+ *          main/motion.cpp main/planner.cpp main/mesh.cpp \
+ *          -o /tmp/bench-mesh && /tmp/bench-mesh [size]
+ */
+
+#include "bench.h"
+#include "motion.h"
+
+typedef struct {
+    const mesh_t *mesh;
+    bool check;                 // drain before every command to check Z
+    uint32_t blocks;
+    float max_error;            // planned Z vs logical Z + mesh_z (mm)
+} result_t;
+
+static void drain(result_t *res) {
+    planner_block_t *block;
+    while ((block = planner_current())) {
+        if (res->check) {
+            float x = block->start[AXIS_X] + block->delta[AXIS_X];
+            float y = block->start[AXIS_Y] + block->delta[AXIS_Y];
+            float z = block->start[AXIS_Z] + block->delta[AXIS_Z];
+            // slicer output keeps Z constant within a layer
+            float err = fabsf(z - motion_state()->position[AXIS_Z] -
+                              mesh_z(res->mesh, x, y));
+            if (block->delta[AXIS_Z] == 0 && err > res->max_error) {
+                res->max_error = err;
+            }
+        }
+        res->blocks++;
+        planner_discard();
+    }
+}
+
+static void execute(const gcode_cmd_t *cmd, void *arg) {
+    // blocks left in planner belong to previous commands
+    if (((result_t *)arg)->check) drain((result_t *)arg);
+    while (motion_execute(cmd) == MOTION_BUSY) drain((result_t *)arg);
+}
+
+static double run(const std::string &src, result_t *res) {
+    gcode_parser_t parser;
+    gcode_parser_init(&parser);
+    motion_initialize();
+    motion_set_mesh(res->mesh);
+    res->blocks = 0;
+    res->max_error = 0;
+    double t0 = bench_now();
+    gcode_parse(&parser, src.data(), src.size(), execute, res);
+    gcode_parse_end(&parser, execute, res);
+    drain(res);
+    return bench_now() - t0;
+}
+
+int main(int argc, char **argv) {
+    size_t size = argc > 1 ? atol(argv[1]) : 4 << 20;
+    std::string src = bench_synth_gcode(size);
+    static mesh_grid_t grid, back;
+    static mesh_t meshes[3];
+    grid.nx = grid.ny = 7;
+    grid.x0 = grid.y0 = 0;
+    grid.x1 = grid.y1 = 200;
+    srand(1);
+    for (int i = 0; i < grid.nx * grid.ny; i++) {
+        grid.z[i] = (rand() % 401 - 200) * 1e-3f;     // +-0.2mm
+    }
+    printf("%.1f MB G-code, %ux%u mesh over %.0fx%.0f mm\n", src.size() / 1e6,
+           grid.nx, grid.ny, grid.x1 - grid.x0, grid.y1 - grid.y0);
+
+    const char *names[] = { "off", "bilinear", "bicubic" };
+    bool ok = true;
+    double base = 0;
+    for (int m = MESH_OFF; m <= MESH_BICUBIC; m++) {
+        mesh_init(meshes + m, &grid, (mesh_mode_t)m);
+        result_t res = {};
+        res.mesh = m == MESH_OFF ? NULL : meshes + m;
+        double dt = run(src, &res);
+        if (m == MESH_OFF) base = dt;
+        uint32_t extra = motion_state()->mesh_segments;
+        if (res.mesh) {
+            res.check = true;
+            run(src, &res);
+        }
+        printf("%-8s %8u segments (+%5.1f%% split) %6.2fM segments/s "
+               "%5.2fx time | max Z error %.5f mm\n", names[m], res.blocks,
+               100.0 * extra / (res.blocks - extra), res.blocks / dt / 1e6,
+               dt / base, res.max_error);
+        if (res.max_error > 1e-4f) ok = false;
+    }
+
+    // raw mesh_z cost and exactness at probed points
+    const int N = 10000000;
+    for (int m = MESH_BILINEAR; m <= MESH_BICUBIC; m++) {
+        volatile float sink = 0;
+        double t0 = bench_now();
+        for (int i = 0; i < N; i++) {
+            sink = sink + mesh_z(meshes + m, (i % 2000) * 0.1f,
+                                 (i / 2000 % 2000) * 0.1f);
+        }
+        double dt = bench_now() - t0;
+        float err = 0;
+        for (int j = 0; j < grid.ny; j++) {
+            for (int i = 0; i < grid.nx; i++) {
+                float x = grid.x0 + (grid.x1 - grid.x0) * i / (grid.nx - 1);
+                float y = grid.y0 + (grid.y1 - grid.y0) * j / (grid.ny - 1);
+                float z = grid.z[j * grid.nx + i];
+                err = fmaxf(err, fabsf(mesh_z(meshes + m, x, y) - z));
+            }
+        }
+        printf("mesh_z %-8s %5.1f ns/point, error at probed points %.6f mm\n",
+               names[m], dt / N * 1e9, err);
+        if (err > 1e-5f) ok = false;
+    }
+
+    uint8_t buf[MESH_PACKED_SIZE(MESH_MAX_POINTS, MESH_MAX_POINTS)];
+    size_t len = mesh_pack(&grid, buf, sizeof(buf));
+    float err = 0;
+    if (!len || !mesh_unpack(&back, buf, len)) ok = false;
+    for (int i = 0; i < grid.nx * grid.ny; i++) {
+        err = fmaxf(err, fabsf(back.z[i] - grid.z[i]));
+    }
+    if (err > 0.5e-3f || back.x1 != grid.x1) ok = false;
+    printf("Packed %zu bytes, round trip error %.6f mm %s\n",
+           len, err, ok ? "ok" : "FAIL");
+    return ok ? 0 : 1;
+}
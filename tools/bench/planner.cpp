@@ -0,0 +1,105 @@
+/*
+ * File: planner.cpp
+ * Authors: Hank <hankso1106@gmail.com>
+ * Create: 2026-10-17 12:10:36
+ *
+ * Throughput of main/planner.cpp look-ahead and queue underruns on dense
+ * slicer output. Underruns are simulated by a consumer executing blocks in
+ * print time while the producer (parser + planner) can only append `rate`
+ * blocks per second, which is how fast the firmware task runs on ESP32.
+ *
+ *      g++ -O2 -std=gnu++14 -Imain tools/bench/planner.cpp main/gcode.cpp \
+ *          main/motion.cpp main/planner.cpp main/mesh.cpp \
+ *          -o /tmp/bench-planner && /tmp/bench-planner [file.gcode] [MB]
+ */
+
+#include "bench.h"
+#include "motion.h"
+
+typedef struct {
+    double prod_t;          // time producer append the next block
+    double cons_t;          // time consumer finish current block / got idle
+    double rate;            // producer blocks per second (0: unlimited)
+    double print_t;         // total print time
+    bool running;           // consumer is executing a block
+    bool idle;              // consumer found queue empty
+    uint32_t underruns;     // consumer stopped with more G-code to go
+} sim_t;
+
+// Let consumer execute blocks until time `t`
+static void sim_advance(sim_t *s, double t) {
+    while (true) {
+        if (s->running) {
+            if (s->cons_t > t) return;
+            planner_discard();
+            s->running = false;
+        }
+        planner_block_t *block = planner_current();
+        if (!block) {
+            s->idle = true;
+            return;
+        }
+        if (s->idle) {
+            // block arrived just now at time `t`
+            if (s->cons_t < t) s->cons_t = t;
+            if (planner_stats()->blocks > 1) s->underruns++;
+            s->idle = false;
+        }
+        double dt = planner_block_time(block);
+        s->cons_t += dt;
+        s->print_t += dt;
+        s->running = true;
+    }
+}
+
+static void sim_execute(const gcode_cmd_t *cmd, void *arg) {
+    sim_t *s = (sim_t *)arg;
+    while (motion_execute(cmd) == MOTION_BUSY) {
+        if (!s->rate) {
+            planner_current();
+            planner_discard();
+            continue;
+        }
+        // producer wait for consumer to free one block
+        if (s->prod_t < s->cons_t) s->prod_t = s->cons_t;
+        sim_advance(s, s->prod_t);
+    }
+    if (s->rate) {
+        s->prod_t += 1 / s->rate;
+        sim_advance(s, s->prod_t);
+    }
+}
+
+static void run(const std::string &src, double rate) {
+    sim_t sim = { 0, 0, rate, 0, false, true, 0 };
+    gcode_parser_t parser;
+    gcode_parser_init(&parser);
+    motion_initialize();
+    double t0 = bench_now();
+    gcode_parse(&parser, src.data(), src.size(), sim_execute, &sim);
+    gcode_parse_end(&parser, sim_execute, &sim);
+    if (rate) sim_advance(&sim, 1e300);
+    double dt = bench_now() - t0;
+    const planner_stats_t *st = planner_stats();
+    if (!rate) {
+        printf("Input: %.2f MB, %u lines, %u blocks, block %u bytes\n",
+               src.size() / 1048576.0, parser.lines, st->blocks,
+               (unsigned)sizeof(planner_block_t));
+        bench_report("parse + plan", st->blocks, "blocks", dt);
+        return;
+    }
+    printf("%8.0f blocks/s | %8.1fs print | %7u underruns | %7u starved "
+           "(%5.2f%%)\n", rate, sim.print_t, sim.underruns, st->starved,
+           100.0 * st->starved / st->blocks);
+}
+
+int main(int argc, char **argv) {
+    const char *path = argc > 1 ? argv[1] : NULL;
+    size_t size = (argc > 2 ? atof(argv[2]) : 4) * 1024 * 1024;
+    std::string src = bench_gcode(path, size);
+    run(src, 0);
+    printf("Simulated producer rate (ESP32 is about 1/20 of this host):\n");
+    const double rates[] = { 250, 500, 1000, 2000, 4000, 8000 };
+    for (double rate : rates) run(src, rate);
+    return 0;
+}
@@ -0,0 +1,135 @@
+/*
+ * File: ring.cpp
+ * Authors: Hank <hankso1106@gmail.com>
+ * Create: 2026-10-17 23:40:26
+ *
+ * Two-thread stress test of main/ring.h with the step move ring layout used
+ * by main/stepper.cpp. The producer pushes numbered moves as fast as it can,
+ * the consumer pops and checks that every move arrives once, in order and
+ * not torn. It runs once with both sides free running, then with a consumer
+ * that pauses now and then like the step ISR waiting for the next alarm.
+ * A mutex protected std::queue of the same size is the baseline. Waiting
+ * sides yield, so the test also runs on a single core.
+ *
+ *      g++ -O2 -std=gnu++14 -pthread -Imain tools/bench/ring.cpp \
+ *          -o /tmp/bench-ring && /tmp/bench-ring [millions]
+ */
+
+#include "bench.h"
+#include "ring.h"
+#include "stepcompress.h"
+
+#include <mutex>
+#include <queue>
+#include <thread>
+
+#define RING_SIZE           128         // STEPPER_QUEUE
+
+static spsc_ring_t<step_move_t, RING_SIZE> ring;
+
+static inline step_move_t make_move(uint32_t i) {
+    step_move_t move;
+    move.interval = i;
+    move.count = (uint16_t)(i * 7);
+    move.add = (int16_t)~i;
+    return move;
+}
+
+static inline bool check_move(const step_move_t *move, uint32_t i) {
+    return move->interval == i && move->count == (uint16_t)(i * 7) &&
+           move->add == (int16_t)~i;
+}
+
+static void pause(uint32_t i, uint32_t every) {
+    if (every && i % every == 0) {
+        for (volatile int k = 0; k < 2000; k++) {}
+    }
+}
+
+static uint32_t run_ring(uint32_t total, uint32_t pause_every) {
+    uint32_t errors = 0;
+    ring.reset();
+    std::thread producer([total] {
+        for (uint32_t i = 0; i < total; i++) {
+            while (!ring.push(make_move(i))) std::this_thread::yield();
+        }
+    });
+    std::thread consumer([&errors, total, pause_every] {
+        for (uint32_t i = 0; i < total; i++) {
+            const step_move_t *move;
+            while (!(move = ring.front())) std::this_thread::yield();
+            if (!check_move(move, i)) errors++;
+            ring.pop();
+            pause(i, pause_every);
+        }
+    });
+    producer.join();
+    consumer.join();
+    return errors;
+}
+
+static uint32_t run_mutex(uint32_t total, uint32_t pause_every) {
+    std::queue<step_move_t> queue;
+    std::mutex lock;
+    uint32_t errors = 0;
+    std::thread producer([&] {
+        for (uint32_t i = 0; i < total; i++) {
+            for (;;) {
+                std::lock_guard<std::mutex> guard(lock);
+                if (queue.size() < RING_SIZE) {
+                    queue.push(make_move(i));
+                    break;
+                }
+                std::this_thread::yield();
+            }
+        }
+    });
+    std::thread consumer([&] {
+        for (uint32_t i = 0; i < total; i++) {
+            step_move_t move;
+            for (;;) {
+                std::lock_guard<std::mutex> guard(lock);
+                if (queue.empty()) {
+                    std::this_thread::yield();
+                    continue;
+                }
+                move = queue.front();
+                queue.pop();
+                break;
+            }
+            if (!check_move(&move, i)) errors++;
+            pause(i, pause_every);
+        }
+    });
+    producer.join();
+    consumer.join();
+    return errors;
+}
+
+int main(int argc, char **argv) {
+    uint32_t total = (argc > 1 ? atof(argv[1]) : 20) * 1e6;
+    const uint32_t pauses[] = { 0, 1000 };
+    bool ok = true;
+    printf("%u moves of %zu bytes, ring of %d, indices %zu bytes apart\n",
+           total, sizeof(step_move_t), RING_SIZE,
+           (size_t)((char *)&ring.tail - (char *)&ring.head));
+    for (uint32_t every : pauses) {
+        double t0 = bench_now();
+        uint32_t errors = run_ring(total, every);
+        double dt = bench_now() - t0;
+        printf("spsc  pause/%-5u %7.1fM moves/s | %u errors, peak %u, "
+               "%u full, %u dry\n", every, total / dt / 1e6, errors,
+               ring.peak, ring.full, ring.dry);
+        ok = ok && !errors && ring.level() == 0;
+
+        uint32_t n = total / 10;            // mutex is much slower
+        t0 = bench_now();
+        errors = run_mutex(n, every);
+        dt = bench_now() - t0;
+        printf("mutex pause/%-5u %7.1fM moves/s | %u errors\n",
+               every, n / dt / 1e6, errors);
+        ok = ok && !errors;
+    }
+    printf("%s\n", ok ? "ok" : "FAIL");
+    return ok ? 0 : 1;
+}
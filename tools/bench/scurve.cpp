@@ -0,0 +1,117 @@
+/*
+ * File: scurve.cpp
+ * Authors: Hank <hankso1106@gmail.com>
+ * Create: 2026-10-17 18:02:37
+ *
+ * Trapezoid vs S-curve speed profile (main/scurve.cpp). The same G-code is
+ * planned and converted to compressed moves with each profile; generation
+ * time per step, solver iterations and print time are reported. Then the
+ * fixed-point solver is checked against a double precision reference on
+ * random phases of 1 second: error is reported in timer ticks and must stay
+ * within 1us. Errors above 1 tick only happen close to standstill, where
+ * position barely changes with time.
+ *
+ *      g++ -O2 -std=gnu++14 -Imain tools/bench/scurve.cpp main/gcode.cpp \
+ *          main/motion.cpp main/planner.cpp main/stepgen.cpp \
+ *          main/stepcompress.cpp main/shaper.cpp main/scurve.cpp \
+ *          main/mesh.cpp -o /tmp/bench-scurve && \
+ *          /tmp/bench-scurve [file.gcode] [MB]
+ */
+
+#include "bench.h"
+#include "motion.h"
+#include "stepgen.h"
+#include "scurve.h"
+
+static void drain(bool end) {
+    step_move_t move;
+    uint8_t axis;
+    bool planned = false;
+    while (true) {
+        if (!stepgen_busy()) {
+            planner_block_t *block = planner_current();
+            if (block) {
+                stepgen_load(block);
+            } else if (!end || !stepgen_load(NULL)) {
+                return;
+            }
+            planned = block != NULL;
+        }
+        if (!stepgen_next(&axis, &move) && planned) planner_discard();
+    }
+}
+
+static void execute(const gcode_cmd_t *cmd, void *arg) {
+    while (motion_execute(cmd) == MOTION_BUSY) drain(false);
+}
+
+// Reference: solve s(u) / D = sigma in double by bisection
+static double reference(double v0, double v1, double sigma) {
+    double lo = 0, hi = 1, d = (v0 + v1) / 2;
+    for (int i = 0; i < 60; i++) {
+        double u = (lo + hi) / 2, u2 = u * u;
+        double s = v0 * u + (v1 - v0) * u2 * u2 * (2.5 + u * (u - 3));
+        if (s / d < sigma) lo = u; else hi = u;
+    }
+    return (lo + hi) / 2;
+}
+
+int main(int argc, char **argv) {
+    const char *path = argc > 1 ? argv[1] : NULL;
+    size_t size = (argc > 2 ? atof(argv[2]) : 1) * 1024 * 1024;
+    std::string src = bench_gcode(path, size);
+    printf("Input: %.2f MB\n", src.size() / 1048576.0);
+
+    double base = 0;
+    const planner_profile_t profiles[] = { PLANNER_TRAPEZOID, PLANNER_SCURVE };
+    for (planner_profile_t profile : profiles) {
+        gcode_parser_t parser;
+        gcode_parser_init(&parser);
+        motion_initialize();
+        planner_config.profile = profile;
+        stepgen_reset();
+        double t0 = bench_now();
+        gcode_parse(&parser, src.data(), src.size(), execute, NULL);
+        gcode_parse_end(&parser, execute, NULL);
+        drain(true);
+        double dt = bench_now() - t0;
+        const stepgen_stats_t *st = stepgen_stats();
+        double steps = 0;
+        for (uint8_t i = 0; i < NUM_AXIS; i++) steps += st->steps[i];
+        if (profile == PLANNER_TRAPEZOID) base = dt;
+        printf("%-9s %9.0f steps %5.2fs %6.1f ns/step (%+5.1f%%) "
+               "%4.2f iters/step | print time %.3fs\n",
+               profile == PLANNER_SCURVE ? "S-curve" : "trapezoid",
+               steps, dt, dt / steps * 1e9, (dt / base - 1) * 100,
+               st->iters / steps,
+               stepgen_horizon() / (double)stepgen_config.tick_hz);
+    }
+    planner_config.profile = PLANNER_TRAPEZOID;
+
+    // 1s phases: a tick is 1e-7 of the phase
+    const int64_t ticks = 10000000;
+    uint32_t iters = 0, n = 0, above = 0;
+    double worst = 0;
+    srand(1);
+    for (int i = 0; i < 2000; i++) {
+        double v0 = rand() % 4 ? rand() % 300 : 0, v1 = rand() % 300;
+        scurve_phase_t phase;
+        if (!scurve_init(&phase, v0, v1)) continue;
+        int64_t u = 0;
+        for (int j = 1; j < 1000; j++) {
+            double sigma = j / 1000.0;
+            u = scurve_solve(&phase, (int64_t)(sigma * SCURVE_ONE), u,
+                             SCURVE_ONE / ticks, &iters);
+            double err = fabs((double)u / SCURVE_ONE - reference(
+                v0, v1, (double)(int64_t)(sigma * SCURVE_ONE) / SCURVE_ONE));
+            if (err > worst) worst = err;
+            if (err * ticks > 1) above++;
+            n++;
+        }
+    }
+    bool ok = worst * ticks <= 10;
+    printf("Solver: %u solves, %.2f iters/solve, worst error %.2f ticks %s, "
+           "%u solves above 1 tick\n", n, (double)iters / n, worst * ticks,
+           ok ? "ok" : "FAIL", above);
+    return ok ? 0 : 1;
+}
@@ -0,0 +1,144 @@
+/*
+ * File: shaper.cpp
+ * Authors: Hank <hankso1106@gmail.com>
+ * Create: 2026-10-17 16:20:05
+ *
+ * CPU cost of input shaping in main/stepgen.cpp and its effect on ringing.
+ * The same G-code is converted to steps without shaper and with ZV, MZV and
+ * EI on X/Y. Extra time per X/Y step and per block is reported. The X steps
+ * then drive a simulated toolhead: a mass on a spring resonating at `freq`
+ * with damping `zeta`. Ringing is the RMS distance between the toolhead and
+ * the commanded position, sampled while commanded speed is constant (so the
+ * lag of the spring under acceleration is not counted).
+ *
+ *      g++ -O2 -std=gnu++14 -Imain tools/bench/shaper.cpp main/gcode.cpp \
+ *          main/motion.cpp main/planner.cpp main/stepgen.cpp \
+ *          main/stepcompress.cpp main/shaper.cpp main/scurve.cpp \
+ *          main/mesh.cpp -o /tmp/bench-shaper && \
+ *          /tmp/bench-shaper [file.gcode] [MB] [freq] [zeta]
+ */
+
+#include "bench.h"
+#include "motion.h"
+#include "stepgen.h"
+
+#include <vector>
+
+typedef struct {
+    std::vector<uint64_t> time;     // X step times
+    std::vector<int8_t> sign;       // X step direction
+    uint64_t clock;
+    int8_t sign_now;
+} xsteps_t;
+
+static void record(xsteps_t *xs, uint8_t axis, const step_move_t *move) {
+    if (axis != AXIS_X) return;
+    if (!move->count) {
+        xs->clock += move->interval;
+        if (move->add >= 0) xs->sign_now = move->add ? -1 : 1;
+        return;
+    }
+    uint32_t interval = move->interval;
+    for (uint16_t j = 0; j < move->count; j++) {
+        xs->clock += interval;
+        interval += move->add;
+        xs->time.push_back(xs->clock);
+        xs->sign.push_back(xs->sign_now);
+    }
+}
+
+static void drain(xsteps_t *xs, bool end) {
+    step_move_t move;
+    uint8_t axis;
+    bool planned = false;
+    while (true) {
+        if (!stepgen_busy()) {
+            planner_block_t *block = planner_current();
+            if (block) {
+                stepgen_load(block);
+            } else if (!end || !stepgen_load(NULL)) {
+                return;
+            }
+            planned = block != NULL;
+        }
+        if (stepgen_next(&axis, &move)) {
+            record(xs, axis, &move);
+        } else if (planned) {
+            planner_discard();
+        }
+    }
+}
+
+static void execute(const gcode_cmd_t *cmd, void *arg) {
+    while (motion_execute(cmd) == MOTION_BUSY) drain((xsteps_t *)arg, false);
+}
+
+// Integrate toolhead x'' = w^2 (u - x) + 2 zeta w (u' - x') driven by step
+// position u. Return RMS of x - u while u moves at constant speed.
+static double ringing(const xsteps_t *xs, double freq, double zeta) {
+    const double dt = 2e-5, tick = 1.0 / stepgen_config.tick_hz;
+    const double mm = 1 / stepgen_config.steps_per_mm[AXIS_X];
+    const size_t lag = 500;             // 10ms to compare speed
+    std::vector<double> hist(2 * lag + 1, 0);
+    double w = 2 * M_PI * freq, x = 0, v = 0, u = 0, sum = 0;
+    size_t k = 0, n = 0, i = 0;
+    if (xs->time.empty()) return 0;
+    double end = xs->time.back() * tick;
+    for (double t = 0; t < end; t += dt, i++) {
+        double u0 = u;
+        while (k < xs->time.size() && xs->time[k] * tick <= t) {
+            u += xs->sign[k++] * mm;
+        }
+        double du = (u - u0) / dt;
+        double acc = w * w * (u - x) + 2 * zeta * w * (du - v);
+        v += acc * dt;
+        x += v * dt;
+        hist[i % hist.size()] = u;
+        if (i < hist.size()) continue;
+        double d1 = u - hist[(i - lag) % hist.size()];
+        double d2 = hist[(i - lag) % hist.size()]
+                  - hist[(i - 2 * lag) % hist.size()];
+        if (fabs(d1 - d2) > 2 * mm || fabs(d1) < 2 * mm) continue;
+        sum += (x - u) * (x - u);
+        n++;
+    }
+    return n ? sqrt(sum / n) : 0;
+}
+
+int main(int argc, char **argv) {
+    const char *path = argc > 1 ? argv[1] : NULL;
+    size_t size = (argc > 2 ? atof(argv[2]) : 0.25) * 1024 * 1024;
+    float freq = argc > 3 ? atof(argv[3]) : 40;
+    float zeta = argc > 4 ? atof(argv[4]) : 0.1;
+    std::string src = bench_gcode(path, size);
+    printf("Input: %.2f MB, shaper %.1f Hz, damping %.2f\n",
+           src.size() / 1048576.0, freq, zeta);
+
+    double base = 0;
+    const shaper_type_t types[] = {
+        SHAPER_NONE, SHAPER_ZV, SHAPER_MZV, SHAPER_EI
+    };
+    for (shaper_type_t type : types) {
+        xsteps_t xs = {};
+        gcode_parser_t parser;
+        gcode_parser_init(&parser);
+        motion_initialize();
+        shaper_init(&stepgen_config.shaper[AXIS_X], type, freq, zeta);
+        shaper_init(&stepgen_config.shaper[AXIS_Y], type, freq, zeta);
+        stepgen_reset();
+        double t0 = bench_now();
+        gcode_parse(&parser, src.data(), src.size(), execute, &xs);
+        gcode_parse_end(&parser, execute, &xs);
+        drain(&xs, true);
+        double dt = bench_now() - t0;
+        if (type == SHAPER_NONE) base = dt;
+        const stepgen_stats_t *st = stepgen_stats();
+        double xy = st->steps[AXIS_X] + st->steps[AXIS_Y];
+        printf("%-4s %8.0f XY steps %6u blocks %5.2fs | +%6.1f ns/step "
+               "+%6.2f us/block %4.1f evals/step | ringing %.4f mm\n",
+               shaper_name(type), xy, st->blocks, dt,
+               (dt - base) / xy * 1e9, (dt - base) / st->blocks * 1e6,
+               st->evals / xy, ringing(&xs, freq, zeta));
+    }
+    return 0;
+}
@@ -0,0 +1,148 @@
+/*
+ * File: softpwm.cpp
+ * Authors: Hank <hankso1106@gmail.com>
+ * Create: 2026-10-18 17:05:12
+ *
+ * Software PWM scheduler of main/softpwm.cpp on the virtual PCF8574 chips
+ * of vchip.cpp, slot by slot in virtual time like the timer task does.
+ * Heaters switch by their time-proportioned windows and flush at once, the
+ * three fans and eight valves run fixed duties. From the recorded pin
+ * trace: on-time of every PWM pin against its duty, I2C transactions and
+ * bus time against writing each pin change by itself (i2c_gpio_set_level),
+ * and the bus load counted by the scheduler against the virtual bus.
+ * Then the bus load of other resolutions and frequencies with all sixteen
+ * channels at different duties, the worst case.
+ *
+ *      g++ -O2 -std=gnu++14 -Imain tools/bench/softpwm.cpp \
+ *          main/softpwm.cpp main/pins.cpp tools/bench/vchip.cpp \
+ *          -o /tmp/bench-softpwm && /tmp/bench-softpwm [res] [freq]
+ */
+
+#include "bench.h"
+#include "vchip.h"
+#include "softpwm.h"
+
+#define SECONDS             60
+#define HEATER_MS           100         // heater task period
+
+static const float duties[SOFTPWM_PINS] = {
+    0.30f, 0.45f, 0.45f, 0,             // heaters: windowed, see below
+    0.50f, 0.75f, 1, 0,                 // fans, reserved
+    0.25f, 0.50f, 0.50f, 0.10f, 0, 1, 0.90f, 0.60f,     // valves
+};
+static const uint16_t windows[4] = { 40, 10, 10, 10 };  // heater periods
+
+typedef struct {
+    double load;                // bus time / time
+    double trans, edges;        // per second
+    double bits_load;           // from I2C_XFER_BITS
+    double max_err;             // on-time of PWM pins
+} result_t;
+
+static result_t run(uint16_t res, uint32_t freq, const float *duty,
+                    bool heaters) {
+    const uint64_t tick = VCHIP_TICK_HZ / (res * freq);
+    const uint64_t end = (uint64_t)SECONDS * VCHIP_TICK_HZ;
+    static softpwm_t pwm;
+    vchip_reset();
+    vchip.record = true;
+    softpwm_init(&pwm, res);
+    for (uint8_t ch = 0; ch < SOFTPWM_PINS; ch++) {
+        if (ch >= 4 || !heaters)
+            softpwm_set(&pwm, (i2c_pin_num_t)(SOFTPWM_PIN0 + ch), duty[ch]);
+    }
+    softpwm_flush(&pwm);
+    uint64_t next_slot = tick, next_heat = 0;
+    uint32_t heat_tick = 0;
+    while (vchip.now < end) {
+        if (heaters && next_heat <= next_slot) {
+            vchip.now = next_heat > vchip.now ? next_heat : vchip.now;
+            for (uint8_t i = 0; i < 4; i++) {
+                uint16_t on = (uint16_t)(duty[i] * windows[i] + 0.5f);
+                bool level = heat_tick % windows[i] < on;
+                softpwm_set(&pwm, (i2c_pin_num_t)(SOFTPWM_PIN0 + i), level);
+            }
+            softpwm_flush(&pwm);
+            heat_tick++;
+            next_heat += (uint64_t)HEATER_MS * VCHIP_TICK_HZ / 1000;
+            continue;
+        }
+        vchip.now = next_slot > vchip.now ? next_slot : vchip.now;
+        softpwm_slot(&pwm);
+        next_slot += tick;
+    }
+
+    // on-time of each pin from the trace
+    double high[SOFTPWM_PINS] = { 0 }, since[SOFTPWM_PINS] = { 0 };
+    uint32_t edges = 0;
+    for (const vchip_edge_t &e : vchip.trace) {
+        if (e.chip < VCHIP_8574 + SOFTPWM_CHIP0) continue;
+        uint8_t c = e.chip - VCHIP_8574 - SOFTPWM_CHIP0;
+        uint8_t changed = e.before ^ e.after;
+        for (uint8_t bit = 0; bit < 8; bit++) {
+            if (!(changed & BIT(bit))) continue;
+            edges++;
+            uint8_t ch = c * 8 + bit;
+            if (e.after & BIT(bit)) since[ch] = e.time;
+            else high[ch] += e.time - since[ch];
+        }
+    }
+    result_t r = { 0, 0, 0, 0, 0 };
+    double secs = (double)vchip.now / VCHIP_TICK_HZ;
+    for (uint8_t ch = heaters ? 4 : 0; ch < SOFTPWM_PINS; ch++) {
+        uint8_t c = ch / 8, bit = ch % 8;
+        if (vchip.latch[SOFTPWM_CHIP0 + c] & (1 << bit))
+            high[ch] += vchip.now - since[ch];
+        double want = (double)pwm.duty[ch] / res;
+        double got = high[ch] / vchip.now;
+        if (fabs(got - want) > r.max_err) r.max_err = fabs(got - want);
+    }
+    r.load = (double)vchip.stats.i2c_ticks / vchip.now;
+    r.trans = vchip.stats.i2c_trans / secs;
+    r.edges = edges / secs;
+    r.bits_load = (double)pwm.stats.bits / VCHIP_I2C_HZ / secs;
+    return r;
+}
+
+int main(int argc, char **argv) {
+    uint16_t res = argc > 1 ? atoi(argv[1]) : 16;
+    uint32_t freq = argc > 2 ? atoi(argv[2]) : 10;
+    result_t r = run(res, freq, duties, true);
+    // edges lag by their place in the transaction: up to one full write
+    double limit = (double)I2C_XFER_BITS(SOFTPWM_CHIPS) / VCHIP_I2C_HZ
+                   * freq;
+    // one transaction of one byte per pin change: START, 2 bytes, STOP
+    double naive = r.edges * (1 + 9 + 9 + 1) / VCHIP_I2C_HZ;
+    bool ok = r.max_err < limit && fabs(r.load - r.bits_load) < 1e-3;
+    printf("%u slots at %uHz, %u us per slot, %d s:\n", res, freq,
+           (unsigned)(1000000 / (res * freq)), SECONDS);
+    printf("    duty error max %.4f (limit %.4f), %.1f pin changes/s\n",
+           r.max_err, limit, r.edges);
+    printf("    slots: %.1f transactions/s, bus load %.2f%% (counted "
+           "%.2f%%)\n", r.trans, r.load * 100, r.bits_load * 100);
+    printf("    per pin change: %.1f transactions/s, bus load %.2f%% "
+           "(%.1fx): %s\n", r.edges, naive * 100, naive / r.load,
+           ok ? "ok" : "FAILED");
+
+    // worst case: every channel a different duty
+    float spread[SOFTPWM_PINS];
+    for (uint8_t ch = 0; ch < SOFTPWM_PINS; ch++)
+        spread[ch] = (ch + 1.0f) / (SOFTPWM_PINS + 1);
+    printf("All 16 channels at different duties, bus load:\n  slots");
+    const uint32_t freqs[] = { 5, 10, 25, 50 };
+    for (uint32_t f : freqs) printf("  %4uHz", f);
+    printf("\n");
+    const uint16_t resolutions[] = { 8, 16, 32, 64 };
+    for (uint16_t n : resolutions) {
+        printf("  %5u", n);
+        for (uint32_t f : freqs) {
+            if (1000000 / (n * f) < 1000) {
+                printf("  %6s", "-");   // slot shorter than SOFTPWM_SLOT_MIN
+                continue;
+            }
+            printf("  %5.1f%%", run(n, f, spread, false).load * 100);
+        }
+        printf("\n");
+    }
+    return !ok;
+}
@@ -0,0 +1,138 @@
+/*
+ * File: stepcompress.cpp
+ * Authors: Hank <hankso1106@gmail.com>
+ * Create: 2026-10-17 15:12:40
+ *
+ * Compression ratio and timing error of main/stepcompress.cpp on dense
+ * slicer output. G-code is planned and converted to compressed moves by the
+ * step generator. Moves are decoded again like the step ISR does and every
+ * step is compared with the exact timeline (generated with max_error = 0).
+ *
+ *      g++ -O2 -std=gnu++14 -Imain tools/bench/stepcompress.cpp \
+ *          main/gcode.cpp main/motion.cpp main/planner.cpp main/stepgen.cpp \
+ *          main/stepcompress.cpp main/shaper.cpp main/scurve.cpp \
+ *          main/mesh.cpp -o /tmp/bench-stepcompress && \
+ *          /tmp/bench-stepcompress [file] [MB]
+ */
+
+#include "bench.h"
+#include "motion.h"
+#include "stepgen.h"
+
+#include <vector>
+
+typedef std::vector<uint64_t> timeline_t;
+
+typedef struct {
+    timeline_t steps[NUM_AXIS];     // decoded step times of each axis
+    uint64_t clock[NUM_AXIS];       // decoded time of last step
+    uint32_t moves;
+} decoder_t;
+
+static void decode(decoder_t *dec, uint8_t axis, const step_move_t *move) {
+    dec->moves++;
+    if (!move->count) {
+        dec->clock[axis] += move->interval;
+        return;
+    }
+    // same as the step ISR: add interval, then add `add` to interval
+    uint64_t time = dec->clock[axis];
+    uint32_t interval = move->interval;
+    for (uint16_t j = 0; j < move->count; j++) {
+        time += interval;
+        interval += move->add;
+        dec->steps[axis].push_back(time);
+    }
+    dec->clock[axis] = time;
+}
+
+// Generate moves of queued blocks. At the end, let shaped axes settle too.
+static void drain(decoder_t *dec, bool end) {
+    step_move_t move;
+    uint8_t axis;
+    bool planned = false;
+    while (true) {
+        if (!stepgen_busy()) {
+            planner_block_t *block = planner_current();
+            if (block) {
+                stepgen_load(block);
+            } else if (!end || !stepgen_load(NULL)) {
+                return;
+            }
+            planned = block != NULL;
+        }
+        if (stepgen_next(&axis, &move)) {
+            decode(dec, axis, &move);
+        } else if (planned) {
+            planner_discard();
+        }
+    }
+}
+
+static void execute(const gcode_cmd_t *cmd, void *arg) {
+    while (motion_execute(cmd) == MOTION_BUSY) drain((decoder_t *)arg, false);
+}
+
+// Parse, plan and compress whole `src`. Return seconds spent.
+static double run(const std::string &src, uint32_t max_error, decoder_t *dec) {
+    gcode_parser_t parser;
+    gcode_parser_init(&parser);
+    motion_initialize();
+    stepgen_reset();
+    stepgen_config.max_error = max_error;
+    double t0 = bench_now();
+    gcode_parse(&parser, src.data(), src.size(), execute, dec);
+    gcode_parse_end(&parser, execute, dec);
+    drain(dec, true);
+    return bench_now() - t0;
+}
+
+int main(int argc, char **argv) {
+    const char *path = argc > 1 ? argv[1] : NULL;
+    size_t size = (argc > 2 ? atof(argv[2]) : 1) * 1024 * 1024;
+    std::string src = bench_gcode(path, size);
+
+    decoder_t exact = {};
+    double dt = run(src, 0, &exact);
+    size_t steps = 0;
+    for (uint8_t i = 0; i < NUM_AXIS; i++) steps += exact.steps[i].size();
+    printf("Input: %.2f MB, %zu steps, %.1fs print, %u steps clamped\n",
+           src.size() / 1048576.0, steps,
+           stepgen_horizon() / (double)stepgen_config.tick_hz,
+           stepgen_stats()->clamped);
+    printf("Uncompressed: %zu bytes as 64-bit timestamps, move %u bytes\n",
+           steps * sizeof(uint64_t), (unsigned)sizeof(step_move_t));
+    bench_report("exact (max_error 0)", exact.moves, "moves", dt);
+
+    const uint32_t errors[] = { 0, 5, 10, 25, 50, 79 };
+    bool ok = true;
+    for (uint32_t max_error : errors) {
+        decoder_t dec = {};
+        dt = run(src, max_error, &dec);
+        int64_t worst = 0;
+        size_t total = 0;
+        for (uint8_t i = 0; i < NUM_AXIS; i++) {
+            const timeline_t &a = exact.steps[i], &b = dec.steps[i];
+            if (a.size() != b.size()) {
+                printf("Axis %d: %zu steps decoded, %zu expected\n",
+                       i, b.size(), a.size());
+                ok = false;
+                continue;
+            }
+            for (size_t j = 0; j < a.size(); j++) {
+                int64_t diff = (int64_t)(b[j] - a[j]);
+                if (diff < 0) diff = -diff;
+                if (diff > worst) worst = diff;
+            }
+            total += b.size();
+        }
+        if (worst > max_error) ok = false;
+        double bytes = (double)dec.moves * sizeof(step_move_t);
+        printf("max_error %2u ticks: %8u moves, %5.1f steps/move, "
+               "ratio %6.1fx, worst error %2d ticks %s, %6.1fM steps/s\n",
+               max_error, dec.moves, (double)total / dec.moves,
+               total * sizeof(uint64_t) / bytes, (int)worst,
+               worst > max_error ? "FAIL" : "ok", total / dt / 1e6);
+    }
+    return ok ? 0 : 1;
+}
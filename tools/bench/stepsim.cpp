@@ -0,0 +1,502 @@
+/*
+ * File: stepsim.cpp
+ * Authors: Hank <hankso1106@gmail.com>
+ * Create: 2026-10-18 00:20:36
+ *
+ * Step output pipeline on host, down to the pins. G-code is planned and
+ * converted to compressed moves (main/stepgen.cpp), moves are pushed into the
+ * move rings and the step ISR core (main/stepout.h) expands them in virtual
+ * time. Frames go through the pin layer (main/pins.cpp) into the virtual
+ * 74HC595 chain of vchip.cpp, which records every pin transition. The motion
+ * task and the timer ISR of main/stepper.cpp are replayed in turn: moves are
+ * generated until a ring is full, then alarms are served until a ring drops
+ * to half. Each ISR call costs `isr_us` of virtual time (the `stepper`
+ * console command prints the real figure).
+ *
+ * The trace is checked against the moves pushed:
+ *      - number of STEP rising edges and DIR level of each one
+ *      - edge time vs step time: not earlier than the merge window, not
+ *        later than SIM_LATE (SPI transfer, stalls and late alarms add up)
+ *      - STEP high time and DIR setup time (A4988: 1us, 200ns)
+ *      - EN pins never drop, final position equals stepgen_position
+ * PCF8574 pins are checked through the same pin layer. At last, an X/Y move
+ * is run at increasing step rates. All of them must pass the checks without
+ * clamped steps: rates above the limit of stepgen_update are slowed down by
+ * the planner instead of jamming the move rings.
+ *
+ *      g++ -O2 -std=gnu++14 -Imain tools/bench/stepsim.cpp \
+ *          tools/bench/vchip.cpp main/pins.cpp main/gcode.cpp \
+ *          main/motion.cpp main/planner.cpp main/stepgen.cpp \
+ *          main/stepcompress.cpp main/shaper.cpp main/scurve.cpp \
+ *          main/mesh.cpp -o /tmp/bench-stepsim && \
+ *          /tmp/bench-stepsim [file] [MB] [isr_us]
+ */
+
+#include "bench.h"
+#include "vchip.h"
+#include "motion.h"
+#include "stepper.h"
+#include "stepout.h"
+
+#include <vector>
+
+#define SIM_MARGIN      20      // TIMER_MARGIN of stepper.cpp
+#define SIM_LATE        80      // ticks a STEP edge may lag its step time
+#define SIM_PULSE_MIN   10      // STEP high time
+#define SIM_DIR_SETUP   2       // DIR stable before STEP rises
+
+// Step times decoded from the moves pushed, like the ISR expands them
+typedef struct {
+    std::vector<uint64_t> time;
+    std::vector<uint8_t> level;     // DIR level of each step
+    uint64_t clock;
+    uint8_t dir;
+} expect_t;
+
+typedef struct {
+    uint64_t at;                    // timer time of engine start
+    int64_t offset;                 // timer time - step generator time
+} run_t;
+
+typedef struct {
+    uint32_t steps[NUM_AXIS];       // STEP rising edges
+    uint32_t missing, extra;        // edges vs steps pushed
+    uint32_t early, late;           // edges out of time
+    uint32_t bad_dir, short_pulse, dir_setup, en_drop, position;
+    int64_t err_min, err_max;       // edge time - step time (ticks)
+    double err_sum;
+    uint64_t pulse_min, setup_min;
+} check_t;
+
+static struct {
+    stepout_t<STEPPER_QUEUE> out;
+    uint32_t horizon;
+    uint64_t horizon64;             // stepgen_horizon, not truncated
+    uint64_t event_at, alarm_at;
+    uint64_t event_t64;             // out.event_t, not truncated
+    bool running, pulsing, draining;
+    bool stuck;                     // ring full of moves beyond horizon
+    uint32_t isr_ticks;
+    // producer (stepper_fill)
+    step_move_t move;
+    uint8_t axis;
+    bool pending, planned;
+    // statistics
+    uint32_t events, steps, underruns, late, isrs;
+    double produce_secs, consume_secs;
+    expect_t expect[NUM_AXIS];
+    std::vector<run_t> runs;
+} sim;
+
+static void sim_reset(uint32_t isr_ticks) {
+    const stepgen_config_t *cfg = &stepgen_config;
+    sim.out.reset(cfg->step_bits, cfg->dir_bits, cfg->idle_bits,
+                  cfg->min_interval);
+    sim.horizon = sim.horizon64 = 0;
+    sim.event_at = sim.alarm_at = sim.event_t64 = 0;
+    sim.running = sim.pulsing = sim.draining = sim.stuck = false;
+    sim.isr_ticks = isr_ticks;
+    sim.pending = sim.planned = false;
+    sim.events = sim.steps = sim.underruns = sim.late = sim.isrs = 0;
+    sim.produce_secs = sim.consume_secs = 0;
+    for (uint8_t i = 0; i < NUM_AXIS; i++) {
+        sim.expect[i].time.clear();
+        sim.expect[i].level.clear();
+        sim.expect[i].clock = 0;
+        sim.expect[i].dir = 0;
+    }
+    sim.runs.clear();
+}
+
+static void expect_move(uint8_t axis, const step_move_t *move) {
+    expect_t *ex = sim.expect + axis;
+    if (!move->count) {
+        ex->clock += move->interval;
+        if (move->add >= 0) ex->dir = move->add > 0;
+        return;
+    }
+    uint32_t interval = move->interval;
+    for (uint16_t j = 0; j < move->count; j++) {
+        ex->clock += interval;
+        interval += move->add;
+        ex->time.push_back(ex->clock);
+        ex->level.push_back(ex->dir);
+    }
+}
+
+// timer_alarm of stepper.cpp
+static void sim_alarm(uint64_t at) {
+    if (at < vchip.now + SIM_MARGIN) {
+        at = vchip.now + SIM_MARGIN;
+        sim.late++;
+    }
+    sim.alarm_at = at;
+}
+
+static bool sim_schedule() {
+    uint32_t next = 0;
+    if (!sim.out.earliest(&next) || (int32_t)(next - sim.horizon) > 0)
+        return false;
+    int32_t delta = next - sim.out.event_t;
+    sim.event_at += delta;
+    sim.event_t64 += delta;
+    sim.out.event_t = next;
+    sim_alarm(sim.event_at);
+    return true;
+}
+
+// stepper_isr of stepper.cpp at the pending alarm
+static void sim_isr() {
+    if (vchip.now < sim.alarm_at) vchip.now = sim.alarm_at;
+    bool scheduled = true;
+    if (!sim.pulsing) {
+        uint16_t bits = sim.out.fire();
+        spi_gpio_write_isr(sim.out.frame | bits);
+        sim.events++;
+        sim.steps += bits != 0;
+        sim.pulsing = true;
+        vchip.now += sim.isr_ticks;
+        sim_alarm(sim.event_at + STEPPER_PULSE_TICKS);
+    } else {
+        sim.out.load_all();
+        spi_gpio_write_isr(sim.out.frame);
+        sim.pulsing = false;
+        vchip.now += sim.isr_ticks;
+        scheduled = sim_schedule();
+    }
+    if (!scheduled) {
+        sim.running = false;
+        if (!sim.draining) sim.underruns++;
+    }
+    sim.isrs++;
+}
+
+static uint32_t sim_buffered() {
+    uint32_t first = sim.out.event_t;
+    if (!sim.running) {
+        sim.out.load_all();
+        if (!sim.out.earliest(&first)) return 0;
+    }
+    return (int32_t)(sim.horizon - first) > 0 ? sim.horizon - first : 0;
+}
+
+static void sim_start() {
+    if (sim.running) return;
+    sim.out.load_all();
+    if (!sim.out.earliest(&sim.out.event_t) ||
+        (int32_t)(sim.out.event_t - sim.horizon) > 0) return;
+    spi_gpio_claim();
+    spi_gpio_write_isr(sim.out.frame);  // DIR setup before the first step
+    sim.event_t64 = sim.horizon64 - (uint32_t)(sim.horizon - sim.out.event_t);
+    sim.event_at = vchip.now + STEPPER_PULSE_TICKS;
+    run_t run = { sim.event_at, (int64_t)(sim.event_at - sim.event_t64) };
+    sim.runs.push_back(run);
+    sim.pulsing = false;
+    sim.running = true;
+    sim_alarm(sim.event_at);
+}
+
+static void sim_horizon() {
+    sim.horizon64 = stepgen_horizon();
+    sim.horizon = (uint32_t)sim.horizon64;
+}
+
+// stepper_fill of stepper.cpp
+static bool sim_fill(bool more_cmds) {
+    uint32_t low = stepgen_config.tick_hz / 1000 * STEPPER_LOW_MS;
+    for (;;) {
+        if (sim.pending) {
+            if (!sim.out.queue[sim.axis].push(sim.move)) return true;
+            expect_move(sim.axis, &sim.move);
+            sim.pending = false;
+            sim_horizon();
+        }
+        if (!stepgen_busy()) {
+            bool starving = sim.running && sim_buffered() < low;
+            if (more_cmds && !planner_full() && !starving) return false;
+            planner_block_t *block = planner_current();
+            if (block) {
+                stepgen_load(block);
+            } else if (more_cmds || !stepgen_load(NULL)) {
+                return false;
+            }
+            sim.planned = block != NULL;
+        }
+        if (stepgen_next(&sim.axis, &sim.move)) {
+            sim.pending = true;
+        } else {
+            if (sim.planned) planner_discard();
+            sim_horizon();
+        }
+    }
+}
+
+// stepper_pump, then let the ISR run while the motion task would wait
+static bool sim_pump(bool more_cmds) {
+    uint32_t ready = stepgen_config.tick_hz / 1000 * STEPPER_START_MS;
+    bool full = sim_fill(more_cmds);
+    bool idle = !more_cmds && !stepgen_busy() && !planner_count();
+    sim.draining = idle;
+    if (!sim.running && (idle || full || sim_buffered() >= ready)) {
+        sim_start();
+    }
+    // stepgen waits for ring space, the ISR for moves before the horizon
+    if (full && !sim.running) sim.stuck = true;
+    double t0 = bench_now();
+    while ((full || idle) && sim.running) {
+        sim_isr();
+        if (sim.out.notify) {
+            sim.out.notify = false;
+            break;
+        }
+    }
+    sim.consume_secs += bench_now() - t0;
+    return idle;
+}
+
+static void execute(const gcode_cmd_t *cmd, void *arg) {
+    while (!sim.stuck && motion_execute(cmd) == MOTION_BUSY) sim_pump(true);
+}
+
+static void simulate(const std::string &src, uint32_t isr_ticks) {
+    gcode_parser_t parser;
+    gcode_parser_init(&parser);
+    motion_initialize();
+    stepgen_reset();
+    stepgen_update();
+    vchip_reset();
+    vchip.record = true;
+    sim_reset(isr_ticks);
+    double t0 = bench_now();
+    gcode_parse(&parser, src.data(), src.size(), execute, NULL);
+    gcode_parse_end(&parser, execute, NULL);
+    while (!sim.stuck && (!sim_pump(false) || sim.running)) {}
+    spi_gpio_release();
+    sim.produce_secs = bench_now() - t0 - sim.consume_secs;
+}
+
+static int64_t run_offset(uint64_t time) {
+    size_t i = sim.runs.size();
+    while (i > 1 && sim.runs[i - 1].at > time) i--;
+    return i ? sim.runs[i - 1].offset : 0;
+}
+
+// Walk the 74HC595 trace and compare it with the expected steps
+static check_t check_trace() {
+    const stepgen_config_t *cfg = &stepgen_config;
+    check_t chk = {};
+    chk.err_min = INT64_MAX;
+    chk.err_max = INT64_MIN;
+    chk.pulse_min = chk.setup_min = UINT64_MAX;
+    uint64_t rise[NUM_AXIS] = {}, dir_at[NUM_AXIS] = {};
+    int32_t pos[NUM_AXIS] = {};
+    for (const vchip_edge_t &e : vchip.trace) {
+        if (e.chip != VCHIP_595) continue;
+        uint16_t changed = e.before ^ e.after;
+        if ((e.before & cfg->idle_bits) == cfg->idle_bits &&
+            (e.after & cfg->idle_bits) != cfg->idle_bits) chk.en_drop++;
+        for (uint8_t i = 0; i < NUM_AXIS; i++) {
+            if (changed & cfg->dir_bits[i]) dir_at[i] = e.time;
+            if (!(changed & cfg->step_bits[i])) continue;
+            if (!(e.after & cfg->step_bits[i])) {
+                uint64_t width = e.time - rise[i];
+                if (width < chk.pulse_min) chk.pulse_min = width;
+                if (width < SIM_PULSE_MIN) chk.short_pulse++;
+                continue;
+            }
+            rise[i] = e.time;
+            bool level = (e.after & cfg->dir_bits[i]) != 0;
+            pos[i] += level != cfg->invert_dir[i] ? -1 : 1;
+            uint64_t setup = e.time - dir_at[i];
+            if (setup < chk.setup_min) chk.setup_min = setup;
+            if (setup < SIM_DIR_SETUP) chk.dir_setup++;
+            const expect_t *ex = sim.expect + i;
+            uint32_t j = chk.steps[i]++;
+            if (j >= ex->time.size()) {
+                chk.extra++;
+                continue;
+            }
+            if (level != ex->level[j]) chk.bad_dir++;
+            int64_t err = (int64_t)(e.time - ex->time[j]) - run_offset(e.time);
+            if (err < chk.err_min) chk.err_min = err;
+            if (err > chk.err_max) chk.err_max = err;
+            chk.err_sum += err;
+            if (err <= -(int64_t)cfg->min_interval) chk.early++;
+            if (err > SIM_LATE) chk.late++;
+        }
+    }
+    int32_t final[NUM_AXIS];
+    stepgen_position(final);
+    for (uint8_t i = 0; i < NUM_AXIS; i++) {
+        if (chk.steps[i] < sim.expect[i].time.size())
+            chk.missing += sim.expect[i].time.size() - chk.steps[i];
+        if (pos[i] != final[i]) chk.position++;
+    }
+    return chk;
+}
+
+static uint32_t check_errors(const check_t *chk) {
+    return chk->missing + chk->extra + chk->early + chk->late + chk->bad_dir
+         + chk->short_pulse + chk->dir_setup + chk->en_drop + chk->position;
+}
+
+static uint32_t check_steps(const check_t *chk) {
+    uint32_t steps = 0;
+    for (uint8_t i = 0; i < NUM_AXIS; i++) steps += chk->steps[i];
+    return steps;
+}
+
+static void print_check(const check_t *chk) {
+    const stepgen_stats_t *sg = stepgen_stats();
+    double us = 1e6 / stepgen_config.tick_hz;
+    uint32_t steps = check_steps(chk);
+    printf("Edges:  X %u Y %u Z %u E %u, stepgen X %u Y %u Z %u E %u\n",
+           chk->steps[AXIS_X], chk->steps[AXIS_Y], chk->steps[AXIS_Z],
+           chk->steps[AXIS_E], sg->steps[AXIS_X], sg->steps[AXIS_Y],
+           sg->steps[AXIS_Z], sg->steps[AXIS_E]);
+    if (steps) {
+        printf("Timing: %.1f / %.2f / %.1f us (min/avg/max edge - step), "
+               "STEP high >= %.1f us, DIR setup >= %.1f us\n",
+               chk->err_min * us, chk->err_sum / steps * us,
+               chk->err_max * us, chk->pulse_min * us, chk->setup_min * us);
+    }
+    printf("Errors: %u missing, %u extra, %u early, %u late, %u wrong DIR, "
+           "%u short pulses, %u DIR setup, %u EN drops, %u positions %s\n",
+           chk->missing, chk->extra, chk->early, chk->late, chk->bad_dir,
+           chk->short_pulse, chk->dir_setup, chk->en_drop, chk->position,
+           check_errors(chk) ? "FAIL" : "ok");
+}
+
+// Pin layer over the virtual PCF8574s: outputs, inputs and unknown address
+static bool check_i2c() {
+    vchip_reset();
+    vchip.record = true;
+    bool ok = true;
+    // pin layer starts with all outputs low, chips power up high
+    ok &= !i2c_gpio_set_level(PIN_FAN1, 1) && !i2c_gpio_set_level(PIN_VLV3, 1);
+    ok &= vchip_8574_pins(1) == BIT(PIN_FAN1 - PIN_BED);
+    ok &= vchip_8574_pins(2) == BIT(PIN_VLV3 - PIN_VLV1);
+    ok &= !i2c_gpio_set_level(PIN_FAN1, 0) && !vchip_8574_pins(1);
+    vchip_set_input(0, PIN_PROB - PIN_XMIN, 0);         // probe triggered
+    ok &= !i2c_gpio_get_level(PIN_PROB, true);
+    vchip_set_input(0, PIN_PROB - PIN_XMIN, 1);
+    ok &= i2c_gpio_get_level(PIN_PROB, true) != 0;
+    ok &= !i2c_get_val(0) && !i2c_set_val(2);
+    ok &= pinbus_i2c(0x27, false, NULL, 0) == ESP_FAIL;
+    ok &= vchip.trace.size() == 5;                      // 3 writes, 2 inputs
+    printf("PCF8574: %zu edges, %u transactions in %.2f ms %s\n",
+           vchip.trace.size(), vchip.stats.i2c_trans,
+           vchip.stats.i2c_ticks * 1e3 / VCHIP_TICK_HZ, ok ? "ok" : "FAIL");
+    return ok;
+}
+
+// Virtual ticks since the engine first started
+static uint64_t sim_ticks() {
+    return sim.runs.empty() ? 0 : vchip.now - sim.runs[0].at;
+}
+
+// Highest X step rate over 100 steps of the last simulation
+static double peak_rate() {
+    const std::vector<uint64_t> &t = sim.expect[AXIS_X].time;
+    uint64_t span = UINT64_MAX;
+    for (size_t j = 0; j + 100 < t.size(); j++) {
+        if (t[j + 100] - t[j] < span) span = t[j + 100] - t[j];
+    }
+    return span == UINT64_MAX ? 0 : 100.0 * stepgen_config.tick_hz / span;
+}
+
+/* X at `rate` steps/s and Y at 0.618 of it, steps not aligned. Rates above
+ * the limit of stepgen_update must be slowed down by the planner.
+ */
+static bool sweep_rate(double rate, uint32_t isr_ticks) {
+    const float speed = 100, dx = 300, dy = 185.4;  // X speed mm/s, mm
+    float spm[NUM_AXIS];
+    memcpy(spm, stepgen_config.steps_per_mm, sizeof(spm));
+    stepgen_config.steps_per_mm[AXIS_X] = rate / speed;
+    stepgen_config.steps_per_mm[AXIS_Y] = rate / speed;
+    char src[96];
+    snprintf(src, sizeof(src), "G1 X%.1f Y%.1f F%.0f\n",
+             dx, dy, speed * 60 * sqrtf(dx * dx + dy * dy) / dx);
+    simulate(src, isr_ticks);
+    check_t chk = check_trace();
+    uint32_t clamped = stepgen_stats()->clamped;
+    double peak = peak_rate(), limit = planner_config.step_speed[AXIS_X]
+                                     * stepgen_config.steps_per_mm[AXIS_X];
+    bool limited = peak < rate * 0.99;
+    bool ok = !check_errors(&chk) && !clamped && !sim.underruns &&
+              !sim.stuck && peak < limit * 1.01;
+    double us = 1e6 / stepgen_config.tick_hz;
+    printf("%9.0f  %9.0f  %8.0f  %7u  %6u  %6u  %6.1f  %6.1f  %s\n", rate,
+           peak, sim_ticks() ? sim.events * (double)VCHIP_TICK_HZ /
+           sim_ticks() : 0, clamped, sim.late, vchip.stats.stalls,
+           chk.err_min * us, chk.err_max * us, sim.stuck ? "stuck" :
+           !ok ? "FAIL" : limited ? "limited" : "ok");
+    memcpy(stepgen_config.steps_per_mm, spm, sizeof(spm));
+    stepgen_update();
+    return ok;
+}
+
+int main(int argc, char **argv) {
+    const char *path = argc > 1 ? argv[1] : NULL;
+    size_t size = (argc > 2 ? atof(argv[2]) : 0.25) * 1024 * 1024;
+    double isr_us = argc > 3 ? atof(argv[3]) : 2;
+    std::string src = bench_gcode(path, size);
+
+    // map axes to 74HC595 outputs like stepper_initialize
+    const spi_pin_num_t step_pins[NUM_AXIS] = {
+        PIN_XSTEP, PIN_YSTEP, PIN_ZSTEP, PIN_E1STEP
+    };
+    const spi_pin_num_t dir_pins[NUM_AXIS] = {
+        PIN_XDIR, PIN_YDIR, PIN_ZDIR, PIN_E1DIR
+    };
+    for (uint8_t i = 0; i < NUM_AXIS; i++) {
+        stepgen_config.step_bits[i] = SPI_FRAME_BIT(step_pins[i]);
+        stepgen_config.dir_bits[i] = SPI_FRAME_BIT(dir_pins[i]);
+    }
+    stepgen_config.idle_bits = SPI_FRAME_BIT(PIN_E2EN)
+                             | SPI_FRAME_BIT(PIN_E3EN);
+    stepgen_config.min_interval = STEPPER_PULSE_TICKS * 2;
+    uint32_t isr_ticks = isr_us * stepgen_config.tick_hz / 1e6;
+
+    bool ok = check_i2c();
+    vchip_reset();
+    ok &= !spi_gpio_set_level(PIN_XYZEN, 1);
+    ok &= vchip.out595 == SPI_FRAME_BIT(PIN_XYZEN);
+    ok &= spi_gpio_get_level(PIN_XYZEN) == 1;
+    ok &= !spi_gpio_set_level(PIN_XYZEN, 0) && !vchip.out595;
+    printf("74HC595: pin mapping %s\n", ok ? "ok" : "FAIL");
+
+    simulate(src, isr_ticks);
+    check_t chk = check_trace();
+    uint32_t steps = check_steps(&chk);
+    double secs = sim_ticks() / (double)VCHIP_TICK_HZ;
+    printf("Input:  %.2f MB, %u blocks, %u moves, %.1fs of motion, "
+           "ISR %.1f us\n", src.size() / 1048576.0, stepgen_stats()->blocks,
+           stepgen_stats()->moves, secs, isr_us);
+    printf("Engine: %u events, %u ISR calls, %zu starts, %u underruns, "
+           "%u late alarms, %u clamped steps%s\n",
+           sim.events, sim.isrs, sim.runs.size(), sim.underruns, sim.late,
+           stepgen_stats()->clamped, sim.stuck ? ", stuck" : "");
+    printf("HSPI:   %u frames, %.1f%% busy, %u stalls (%.1f us)\n",
+           vchip.stats.frames, vchip.stats.busy_ticks * 100.0 /
+           (sim_ticks() ? sim_ticks() : 1), vchip.stats.stalls,
+           vchip.stats.stall_ticks * 1e6 / VCHIP_TICK_HZ);
+    print_check(&chk);
+    ok &= !check_errors(&chk) && !sim.underruns && !sim.stuck;
+    bench_report("host: parse to moves", steps, "steps", sim.produce_secs);
+    bench_report("host: ISR core + pins", steps, "steps", sim.consume_secs);
+
+    printf("\nX steps/s  X planned  events/s  clamped    late  stalls  "
+           "min us  max us\n");
+    const double rates[] = {
+        10e3, 20e3, 40e3, 60e3, 80e3, 100e3, 120e3, 140e3, 160e3, 250e3
+    };
+    uint32_t failed = 0;
+    for (double rate : rates) failed += !sweep_rate(rate, isr_ticks);
+    printf("Step rate limit: %.0f steps/s per axis (%.0f%% of 1 / "
+           "min_interval), HSPI limit %d events/s (2 frames each): %s\n",
+           STEPGEN_RATE_USE * stepgen_config.tick_hz /
+           stepgen_config.min_interval, STEPGEN_RATE_USE * 100,
+           VCHIP_SPI_HZ / VCHIP_595_BITS / 2, failed ? "FAIL" : "ok");
+    return ok && !failed ? 0 : 1;
+}
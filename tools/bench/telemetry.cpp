@@ -0,0 +1,141 @@
+/*
+ * File: telemetry.cpp
+ * Authors: Hank <hankso1106@gmail.com>
+ * Create: 2026-10-18 16:20:31
+ *
+ * Checks main/telemetry.cpp over a day of samples at the heater task rate:
+ * four sensors follow slow ramps with noise, one is unplugged for a while.
+ * Every frame still in the rings is compared with the mean of the samples
+ * it covers, computed directly from the full history. Then the cost of a
+ * sample and the size of responses for usual chart windows, against the
+ * same points as JSON.
+ *
+ *      g++ -O2 -std=gnu++14 -Imain tools/bench/telemetry.cpp \
+ *          main/telemetry.cpp -o /tmp/bench-telem && /tmp/bench-telem
+ */
+
+#include "bench.h"
+#include "telemetry.h"
+
+#include <vector>
+
+#define RATE                10          // samples per second
+#define HOURS               24
+#define END                 (HOURS * 3600)
+#define ERR_LIMIT           0.02        // degC, two rounding steps
+
+static uint32_t rng = 2463534242u;
+
+static float noise(float amp) {
+    rng ^= rng << 13; rng ^= rng >> 17; rng ^= rng << 5;
+    return amp * ((rng & 0xFFFF) / 32768.0f - 1);
+}
+
+static float profile(uint8_t ch, uint32_t sample) {
+    float t = (float)sample / RATE;
+    if (ch == 3 && t >= END - 2000 && t < END - 1700) return NAN; // open
+    if (ch == 2 && t >= END - 100 && t < END - 97) return NAN;    // glitch
+    float target = ch ? 210 : 60, period = ch ? 1800 : 7200;
+    return 25 + (target - 25) * (1 - cosf(t * 2 * M_PI / period)) / 2 +
+           noise(0.5f);
+}
+
+static telem_t telem;
+
+static bool check(const std::vector<float> &hist) {
+    const uint32_t period[] = { 1, 10, 60 }, size[] = {
+        TELEM_RAW_SIZE, TELEM_10S_SIZE, TELEM_1M_SIZE
+    };
+    static uint8_t buf[TELEM_RESPONSE_MAX];
+    uint32_t now = telem_now(&telem);
+    bool ok = true;
+    for (uint8_t lvl = 0; lvl < TELEM_LEVELS; lvl++) {
+        uint32_t span = period[lvl] * size[lvl];
+        // a window that fits in `size` points and is only in this level
+        size_t len = telem_read(&telem, now - span, now, size[lvl],
+                                buf, sizeof(buf));
+        const telem_header_t *hdr = (const telem_header_t *)buf;
+        const int16_t *vals = (const int16_t *)(hdr + 1);
+        double max_err = 0;
+        uint32_t invalid = 0;
+        for (uint32_t k = 0; k < hdr->count; k++) {
+            uint32_t s0 = (hdr->start + k * hdr->period) * RATE;
+            for (uint8_t ch = 0; ch < TELEM_CHANNELS; ch++) {
+                double sum = 0;
+                uint32_t num = 0;
+                for (uint32_t s = s0; s < s0 + hdr->period * RATE; s++) {
+                    float v = hist[s * TELEM_CHANNELS + ch];
+                    if (!isnan(v)) { sum += v; num++; }
+                }
+                int16_t got = vals[k * TELEM_CHANNELS + ch];
+                if (!num || got == TELEM_INVALID) {
+                    if (!num != (got == TELEM_INVALID)) max_err = INFINITY;
+                    invalid += got == TELEM_INVALID;
+                    continue;
+                }
+                max_err = fmax(max_err,
+                               fabs((double)got / TELEM_SCALE - sum / num));
+            }
+        }
+        bool good = hdr->period == period[lvl] && max_err < ERR_LIMIT;
+        printf("Level %2us: %3u frames from %5us, %4zu bytes, max error "
+               "%.4f, %u invalid: %s\n", hdr->period, hdr->count,
+               hdr->start, len, max_err, invalid, good ? "ok" : "FAILED");
+        ok = ok && good;
+    }
+    return ok;
+}
+
+static size_t json_size(const uint8_t *buf) {
+    const telem_header_t *hdr = (const telem_header_t *)buf;
+    const int16_t *vals = (const int16_t *)(hdr + 1);
+    char line[128];
+    size_t size = 2;
+    for (uint32_t k = 0; k < hdr->count; k++) {
+        int n = snprintf(line, sizeof(line), "[%u",
+                         hdr->start + k * hdr->period);
+        for (uint8_t ch = 0; ch < TELEM_CHANNELS; ch++) {
+            int16_t v = vals[k * TELEM_CHANNELS + ch];
+            n += v == TELEM_INVALID
+                ? snprintf(line + n, sizeof(line) - n, ",null")
+                : snprintf(line + n, sizeof(line) - n, ",%.2f",
+                           (float)v / TELEM_SCALE);
+        }
+        size += n + 2;
+    }
+    return size;
+}
+
+int main(int argc, char **argv) {
+    const uint32_t samples = HOURS * 3600 * RATE;
+    std::vector<float> hist(samples * TELEM_CHANNELS);
+    for (uint32_t s = 0; s < samples; s++)
+        for (uint8_t ch = 0; ch < TELEM_CHANNELS; ch++)
+            hist[s * TELEM_CHANNELS + ch] = profile(ch, s);
+
+    telem_init(&telem, RATE);
+    double t0 = bench_now();
+    for (uint32_t s = 0; s < samples; s++)
+        telem_add(&telem, &hist[s * TELEM_CHANNELS]);
+    double t1 = bench_now();
+    printf("Memory %zu bytes, %u hours at %u Hz: %.1f ns per sample\n",
+           sizeof(telem_t), HOURS, RATE, (t1 - t0) / samples * 1e9);
+    bool ok = check(hist);
+
+    static uint8_t buf[TELEM_RESPONSE_MAX];
+    uint32_t now = telem_now(&telem);
+    const struct { const char *name; uint32_t span; } windows[] = {
+        { "5 min", 300 }, { "1 hour", 3600 }, { "12 hours", 43200 },
+        { "1 day", 86400 },
+    };
+    for (const auto &w : windows) {
+        size_t len = telem_read(&telem, now - w.span, now, 300,
+                                buf, sizeof(buf));
+        const telem_header_t *hdr = (const telem_header_t *)buf;
+        size_t json = json_size(buf);
+        printf("%-9s %3u points of %2us, from %5us: %4zu bytes, "
+               "JSON %5zu (%.1fx)\n", w.name, hdr->count, hdr->period,
+               now - hdr->start, len, json, (double)json / len);
+    }
+    return !ok;
+}
@@ -0,0 +1,134 @@
+/*
+ * File: thermistor.cpp
+ * Authors: Hank <hankso1106@gmail.com>
+ * Create: 2026-10-18 15:02:46
+ *
+ * Accuracy and speed of main/thermistor.h. The compile time tables of a
+ * beta and a Steinhart-Hart thermistor are checked at every ADC code
+ * against the closed-form equation evaluated in double with log(): max
+ * and RMS error inside the printing range. Conversion time is compared
+ * with the float formula the heater task used before. Then an ADC with
+ * gaussian noise shows the spread of readings at 210 degC with one sample
+ * and with 16x oversampling and decimation to THERM_CODE_BITS.
+ *
+ *      g++ -O2 -std=gnu++11 -Imain tools/bench/thermistor.cpp \
+ *          -o /tmp/bench-therm && /tmp/bench-therm
+ */
+
+#include "bench.h"
+#include "thermistor.h"
+
+#include <random>
+
+#define CODES               (1 << THERM_CODE_BITS)
+#define ERR_LIMIT           0.1         // degC, inside 0 ~ 300
+
+static constexpr therm_param_t beta_100k = therm_beta(100000, 25, 3950, 4700);
+static constexpr therm_param_t epcos_100k = {   // B57560G104F
+    0.000722378300319346, 0.000216301852054578, 9.2641025635702e-08, 4700
+};
+static constexpr therm_lut_t lut_beta = therm_build(beta_100k);
+static constexpr therm_lut_t lut_epcos = therm_build(epcos_100k);
+
+static_assert(lut_beta.t[0] == THERM_TMAX * 100 &&
+              lut_beta.t[THERM_ENTRIES - 1] == THERM_TMIN * 100,
+              "table ends are clamped");
+
+static double closed_form(const therm_param_t &p, double code) {
+    double ratio = code / CODES, l = log(p.pullup * ratio / (1 - ratio));
+    return 1 / (p.a + p.b * l + p.c * l * l * l) - 273.15;
+}
+
+static float formula_float(const therm_param_t &p, uint32_t code) {
+    float r = p.pullup * code / (CODES - code);
+    float l = logf(r);
+    return 1 / (p.a + p.b * l + p.c * l * l * l) - 273.15f;
+}
+
+static bool check(const char *name, const therm_param_t &p,
+                  const therm_lut_t *lut) {
+    double max_err = 0, sum = 0, worst = 0;
+    uint32_t n = 0;
+    for (uint32_t code = 1; code < CODES; code++) {
+        double ref = closed_form(p, code);
+        if (ref < 0 || ref > 300) continue;
+        double err = fabs(therm_lookup(lut, code) - ref);
+        sum += err * err;
+        n++;
+        if (err > max_err) {
+            max_err = err;
+            worst = ref;
+        }
+    }
+    // constexpr ln against libm over the resistances of the table
+    double ln_err = 0;
+    for (double x = 1; x < 1e7; x *= 1.01)
+        ln_err = fmax(ln_err, fabs(therm_ln(x) - log(x)));
+    bool ok = max_err < ERR_LIMIT;
+    printf("%-10s %u codes in 0~300 degC: max %.4f (at %.0f), RMS %.4f, "
+           "ln error %.1e: %s\n", name, n, max_err, worst, sqrt(sum / n),
+           ln_err, ok ? "ok" : "FAILED");
+    return ok;
+}
+
+static void timing(const therm_param_t &p, const therm_lut_t *lut) {
+    const uint32_t rounds = 200;
+    volatile float sink = 0;
+    double t0 = bench_now();
+    for (uint32_t r = 0; r < rounds; r++)
+        for (uint32_t c = 64; c < CODES - 64; c++)
+            sink = sink + therm_lookup(lut, c);
+    double t1 = bench_now();
+    for (uint32_t r = 0; r < rounds; r++)
+        for (uint32_t c = 64; c < CODES - 64; c++)
+            sink = sink + formula_float(p, c);
+    double t2 = bench_now();
+    double n = rounds * (CODES - 128.0);
+    printf("Conversion: table %.1f ns, logf formula %.1f ns (%.1fx)\n",
+           (t1 - t0) / n * 1e9, (t2 - t1) / n * 1e9, (t2 - t1) / (t1 - t0));
+}
+
+// Readings at `temp` by a 12 bit ADC with noise `sigma` LSB
+static void oversampling(const therm_param_t &p, const therm_lut_t *lut,
+                         double temp, double sigma) {
+    double l = 0;
+    for (double lo = 0, hi = 20, t; hi - lo > 1e-9; ) {  // invert for ln(R)
+        l = (lo + hi) / 2;
+        t = 1 / (p.a + p.b * l + p.c * l * l * l) - 273.15;
+        if (t > temp) lo = l; else hi = l;
+    }
+    double r = exp(l), ideal = 4096 * r / (r + p.pullup);
+    std::mt19937 gen(1);
+    std::normal_distribution<double> noise(0, sigma);
+    auto sample = [&]() -> int {
+        long v = lround(ideal + noise(gen));
+        return v < 0 ? 0 : v > 4095 ? 4095 : v;
+    };
+    const int shift = THERM_CODE_BITS - 12, count = 1 << (2 * shift);
+    double s1 = 0, q1 = 0, s16 = 0, q16 = 0;
+    const int trials = 20000;
+    for (int i = 0; i < trials; i++) {
+        float t = therm_lookup(lut, sample() << shift);
+        s1 += t; q1 += t * t;
+        uint32_t sum = 0;
+        for (int k = 0; k < count; k++) sum += sample();
+        t = therm_lookup(lut, sum >> shift);
+        s16 += t; q16 += t * t;
+    }
+    s1 /= trials; s16 /= trials;
+    printf("ADC noise %.1f LSB at %.0f degC: 1 sample %.3f degC RMS, "
+           "%d samples %.3f degC RMS\n", sigma, temp,
+           sqrt(q1 / trials - s1 * s1), count,
+           sqrt(q16 / trials - s16 * s16));
+}
+
+int main(int argc, char **argv) {
+    printf("Table: %d entries, %u bytes, %d bit codes\n", THERM_ENTRIES,
+           (unsigned)sizeof(therm_lut_t), THERM_CODE_BITS);
+    bool ok = check("Beta 3950", beta_100k, &lut_beta);
+    ok = check("EPCOS", epcos_100k, &lut_epcos) && ok;
+    timing(beta_100k, &lut_beta);
+    oversampling(beta_100k, &lut_beta, 210, 2);
+    oversampling(beta_100k, &lut_beta, 60, 2);
+    return !ok;
+}
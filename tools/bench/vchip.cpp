@@ -0,0 +1,147 @@
+/*
+ * File: vchip.cpp
+ * Authors: Hank <hankso1106@gmail.com>
+ * Create: 2026-10-18 00:20:36
+ */
+
+#include "vchip.h"
+
+#define SPI_BIT_TICKS   (VCHIP_TICK_HZ / VCHIP_SPI_HZ)
+#define I2C_BIT_TICKS   (VCHIP_TICK_HZ / vchip.i2c_hz)
+#define FRAME_TICKS     (VCHIP_595_BITS * SPI_BIT_TICKS)
+
+vchip_t vchip;
+
+void vchip_reset() {
+    vchip.now = vchip.spi_busy = 0;
+    vchip.i2c_hz = VCHIP_I2C_HZ;
+    vchip.sreg = vchip.out595 = 0;
+    for (uint8_t i = 0; i < VCHIP_8574_NUM; i++) {
+        vchip.latch[i] = 0xFF;          // PCF8574 powers up high
+        vchip.input[i] = 0xFF;
+    }
+    vchip.trace.clear();
+    vchip.stats = vchip_stats_t();
+}
+
+static void edge(uint8_t chip, uint64_t time, uint16_t before,
+                 uint16_t after) {
+    if (!vchip.record || before == after) return;
+    vchip_edge_t e = { time, before, after, chip };
+    vchip.trace.push_back(e);
+}
+
+uint8_t vchip_8574_pins(uint8_t idx) {
+    return vchip.latch[idx] & vchip.input[idx];
+}
+
+void vchip_set_input(uint8_t idx, uint8_t bit, bool level) {
+    uint8_t before = vchip_8574_pins(idx);
+    bitWrite(vchip.input[idx], bit, level);
+    edge(VCHIP_8574 + idx, vchip.now, before, vchip_8574_pins(idx));
+}
+
+// Shift `frame` into the chain starting at `start`, latch at the end
+static void shift_frame(uint64_t start, spi_frame_t frame) {
+    const uint8_t bytes[2] = { (uint8_t)frame, (uint8_t)(frame >> 8) };
+    for (uint8_t i = 0; i < VCHIP_595_BITS; i++) {
+        bool bit = bytes[i / 8] & (0x80 >> (i % 8));
+        vchip.sreg = (vchip.sreg << 1) | bit;
+    }
+    // chip next to MCU holds the last byte: Q of far chip are frame bits 0-7
+    uint16_t pins = (vchip.sreg >> 8) | (vchip.sreg << 8);
+    vchip.spi_busy = start + FRAME_TICKS;
+    edge(VCHIP_595, vchip.spi_busy, vchip.out595, pins);
+    vchip.out595 = pins;
+    vchip.stats.frames++;
+    vchip.stats.busy_ticks += FRAME_TICKS;
+}
+
+static uint64_t spi_start() {
+    return vchip.spi_busy > vchip.now ? vchip.spi_busy : vchip.now;
+}
+
+esp_err_t pinbus_spi_write(spi_frame_t frame) {
+    shift_frame(spi_start(), frame);
+    vchip.now = vchip.spi_busy;
+    return ESP_OK;
+}
+
+esp_err_t pinbus_spi_queue(spi_frame_t frame) {
+    shift_frame(spi_start(), frame);
+    return ESP_OK;
+}
+
+esp_err_t pinbus_spi_wait() {
+    vchip.now = spi_start();
+    return ESP_OK;
+}
+
+esp_err_t pinbus_spi_claim(spi_frame_t frame) {
+    return pinbus_spi_write(frame);
+}
+
+void pinbus_spi_release() { pinbus_spi_wait(); }
+
+void pinbus_spi_write_isr(spi_frame_t frame) {
+    if (vchip.spi_busy > vchip.now) {
+        vchip.stats.stalls++;
+        vchip.stats.stall_ticks += vchip.spi_busy - vchip.now;
+        vchip.now = vchip.spi_busy;
+    }
+    shift_frame(vchip.now, frame);
+}
+
+esp_err_t pinbus_i2c_xfer(const uint8_t *addr, uint8_t rmask, uint8_t *data,
+                          size_t num) {
+    // (repeated) START, address + ACK, byte + ACK for each chip, STOP
+    uint64_t t = vchip.now;
+    esp_err_t err = ESP_OK;
+    vchip.stats.i2c_trans++;
+    for (size_t i = 0; i < num; i++) {
+        uint8_t idx = addr[i] - VCHIP_8574_ADDR;
+        t += I2C_BIT_TICKS * 10;
+        if (addr[i] < VCHIP_8574_ADDR || idx >= VCHIP_8574_NUM) {
+            err = ESP_FAIL;             // NACK ends the transaction
+            break;
+        }
+        t += I2C_BIT_TICKS * 9;
+        if (rmask & BIT(i)) {
+            data[i] = vchip_8574_pins(idx);
+            continue;
+        }
+        uint8_t before = vchip_8574_pins(idx);
+        vchip.latch[idx] = data[i];
+        edge(VCHIP_8574 + idx, t, before, vchip_8574_pins(idx));
+    }
+    t += I2C_BIT_TICKS;
+    vchip.stats.i2c_ticks += t - vchip.now;
+    vchip.now = t;
+    return err;
+}
+
+esp_err_t pinbus_i2c(uint8_t addr, bool read, uint8_t *data, size_t size) {
+    // START, address + ACK, bytes + ACK each, STOP
+    uint64_t t = vchip.now + I2C_BIT_TICKS * 10;
+    uint8_t idx = addr - VCHIP_8574_ADDR;
+    vchip.stats.i2c_trans++;
+    if (addr < VCHIP_8574_ADDR || idx >= VCHIP_8574_NUM) {
+        vchip.stats.i2c_ticks += t - vchip.now;
+        vchip.now = t;
+        return ESP_FAIL;
+    }
+    for (size_t i = 0; i < size; i++) {
+        t += I2C_BIT_TICKS * 9;
+        if (read) {
+            data[i] = vchip_8574_pins(idx);
+        } else {
+            uint8_t before = vchip_8574_pins(idx);
+            vchip.latch[idx] = data[i];
+            edge(VCHIP_8574 + idx, t, before, vchip_8574_pins(idx));
+        }
+    }
+    t += I2C_BIT_TICKS;
+    vchip.stats.i2c_ticks += t - vchip.now;
+    vchip.now = t;
+    return ESP_OK;
+}
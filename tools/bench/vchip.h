@@ -0,0 +1,76 @@
+/*
+ * File: vchip.h
+ * Authors: Hank <hankso1106@gmail.com>
+ * Create: 2026-10-18 00:20:36
+ *
+ * Virtual 74HC595 chain and PCF8574 expanders behind the transports of
+ * main/pinbus.h, so main/pins.cpp runs unchanged on host. Every change of an
+ * output pattern is recorded with its virtual time, the time it becomes
+ * visible on the pins:
+ *
+ *      74HC595     bits are shifted in MSB first, low byte of the frame
+ *                  first, and latched at the end of the transfer (CS high).
+ *                  Frames queued or written from the ISR go out back to
+ *                  back; writing while the previous one still shifts waits
+ *                  for it like spi_gpio_write_isr does (a stall).
+ *      PCF8574     quasi-bidirectional pins: a pin reads low if its output
+ *                  latch is 0 or something outside pulls it low (inputs set
+ *                  by vchip_set_input). The latch changes at the ACK of the
+ *                  data byte. Unknown addresses are not acknowledged.
+ *
+ * Time is counted in ticks of VCHIP_TICK_HZ, same as the step timer. The
+ * simulator moves `vchip.now` forward, blocking transfers move it to their
+ * end and the ISR write moves it to the end of a stall.
+ */
+
+#ifndef _VCHIP_H_
+#define _VCHIP_H_
+
+#include "pinbus.h"
+
+#include <vector>
+
+#define VCHIP_TICK_HZ       10000000    // 80MHz APB / 8 (stepper.cpp)
+#define VCHIP_SPI_HZ        5000000     // spi_initialize
+#define VCHIP_I2C_HZ        I2C_CLK_HZ  // i2c_initialize
+#define VCHIP_595_BITS      16          // two chips
+#define VCHIP_8574_NUM      3
+#define VCHIP_8574_ADDR     0x20        // first address, then +1, +2
+
+enum { VCHIP_595, VCHIP_8574 };         // chip of an edge (+idx for 8574)
+
+typedef struct {
+    uint64_t time;              // ticks, when pins change
+    uint16_t before, after;     // pin levels
+    uint8_t chip;               // VCHIP_595 or VCHIP_8574 + idx
+} vchip_edge_t;
+
+typedef struct {
+    uint32_t frames;            // 74HC595 latches
+    uint32_t stalls;            // ISR writes waiting for the previous frame
+    uint64_t stall_ticks;
+    uint64_t busy_ticks;        // SPI bus shifting
+    uint32_t i2c_trans;         // I2C transactions (incl. NACKed)
+    uint64_t i2c_ticks;
+} vchip_stats_t;
+
+typedef struct {
+    uint64_t now;               // current virtual time
+    uint64_t spi_busy;          // SPI shifts until then
+    uint32_t i2c_hz;            // SCL, VCHIP_I2C_HZ after vchip_reset
+    uint16_t sreg;              // 74HC595 shift registers
+    uint16_t out595;            // 74HC595 storage registers (pins)
+    uint8_t latch[VCHIP_8574_NUM];  // PCF8574 output latches
+    uint8_t input[VCHIP_8574_NUM];  // 0 bits: pulled low from outside
+    bool record;                // keep edges in `trace`
+    std::vector<vchip_edge_t> trace;
+    vchip_stats_t stats;
+} vchip_t;
+
+extern vchip_t vchip;
+
+void vchip_reset();                     // all outputs low, empty trace
+void vchip_set_input(uint8_t idx, uint8_t bit, bool level);
+uint8_t vchip_8574_pins(uint8_t idx);   // levels seen on PCF8574 pins
+
+#endif // _VCHIP_H_
@@ -0,0 +1,59 @@
+/*
+ * File: estimate.cpp
+ * Authors: Hank <hankso1106@gmail.com>
+ * Create: 2026-10-17 21:12:40
+ *
+ * Host CLI of main/estimate.cpp: print time and filament of G-code files,
+ * planned by the same code and default kinematics as the firmware.
+ *
+ *      g++ -O2 -std=gnu++14 -Imain tools/estimate.cpp main/estimate.cpp \
+ *          main/gcode.cpp main/motion.cpp main/planner.cpp main/mesh.cpp \
+ *          -o /tmp/estimate && /tmp/estimate file.gcode [...]
+ */
+
+#include "estimate.h"
+
+#include <time.h>
+
+static double now() {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+static void format_time(float secs, char *buf, size_t len) {
+    uint32_t t = secs + 0.5f;
+    snprintf(buf, len, "%uh%02um%02us", t / 3600, t / 60 % 60, t % 60);
+}
+
+int main(int argc, char **argv) {
+    static estimator_t est;
+    static char buf[64 * 1024];
+    if (argc < 2) {
+        fprintf(stderr, "Usage: %s file.gcode [...]\n", argv[0]);
+        return 1;
+    }
+    for (int i = 1; i < argc; i++) {
+        FILE *file = fopen(argv[i], "rb");
+        if (!file) {
+            fprintf(stderr, "Cannot open %s\n", argv[i]);
+            return 1;
+        }
+        double t0 = now();
+        size_t len;
+        estimate_init(&est);
+        while ((len = fread(buf, 1, sizeof(buf), file))) {
+            estimate_feed(&est, buf, len);
+        }
+        fclose(file);
+        const estimate_t *res = estimate_end(&est);
+        double dt = now() - t0;
+        char time[32];
+        format_time(res->time, time, sizeof(time));
+        printf("%s: %s (%.1fs, dwell %.1fs), %.1f mm filament, %u lines, "
+               "%u blocks | %.2f MB in %.2fs = %.1f MB/s\n", argv[i], time,
+               res->time, res->dwell, res->filament, res->lines, res->blocks,
+               res->size / 1048576.0, dt, res->size / 1048576.0 / dt);
+    }
+    return 0;
+}
@@ -20,28 +20,49 @@
             chart = echarts.init(document.getElementById("echart"));
             chart.setOption(option);
             window.addEventListener("resize", chart.resize);
+            // Binary frames of /temp (see main/telemetry.h): a 16 byte
+            // header, then int16 centidegrees per channel, little endian
+            var next = -600;
+            function parseTemp(buf) {
+                var view = new DataView(buf), data = [];
+                var channels = view.getUint8(1), period = view.getUint16(2, true);
+                var start = view.getUint32(4, true), now = view.getUint32(8, true);
+                var count = view.getUint16(12, true), scale = view.getUint16(14, true);
+                var base = Date.now() - now * 1000;
+                for (var k = 0; k < count; k++) {
+                    var time = base + (start + k * period) * 1000, vals = [];
+                    for (var ch = 0; ch < channels; ch++) {
+                        var v = view.getInt16(16 + (k * channels + ch) * 2, true);
+                        vals.push(v == -32768 ? null : v / scale);
+                    }
+                    data.push([time, vals]);
+                }
+                next = start + count * period;
+                return data;
+            }
             function loopTask() {
-                $.ajax({
-                    url: "/temp",
-                    dataType: "json",
-                    method: "GET",
-                    success: function(msg) {
-                        var date = Date.now();
-                        chart.setOption({
-                            xAxis: {
-                                max: date
-                            }
-                        });
-                        for (var i = 0; i < msg.length; i++) {
-                            chart.appendData({
-                                seriesIndex: i,
-                                data: [
-                                    [date, msg[i]]
-                                ]
-                            });
+                var xhr = new XMLHttpRequest();
+                xhr.open("GET", "/temp?from=" + next);
+                xhr.responseType = "arraybuffer";
+                xhr.onload = function() {
+                    if (xhr.status != 200) return;
+                    var data = parseTemp(xhr.response);
+                    if (!data.length) return;
+                    chart.setOption({
+                        xAxis: {
+                            max: data[data.length - 1][0]
                         }
+                    });
+                    for (var i = 0; i < data[0][1].length; i++) {
+                        chart.appendData({
+                            seriesIndex: i,
+                            data: data.map(function(p) {
+                                return [p[0], p[1][i]];
+                            })
+                        });
                     }
-                });
+                };
+                xhr.send();
             }
             $('#toggle').click(function(){
                 if ($(this).hasClass('fa-pause')) {